@@ -0,0 +1,497 @@
+/**
+ * @file main.cpp
+ * @copyright Copyright © UCLouvain 2020
+ *
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ *
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ *
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#include "mpi.h"
+#include "omp.h"
+#include "flups.h"
+
+using namespace std;
+
+//default values
+const static char* d_nglob   = "32,64";
+const static char* d_bc      = "unb,per";
+const static char* d_lda     = "1,3";
+const static char* d_type    = "std,rot";
+const static char* d_switch  = "a2a,nb";
+const static char* d_decomp  = "pencil";
+const static int   d_nsolve  = 10;
+const static char* d_outfile = "flups_bench.json";
+
+/**
+ * @brief one case of the benchmark and its measurements
+ *
+ * The times are per solve and averaged among the processors, except for the setup (max among the processors)
+ */
+typedef struct {
+    int                nglob[3];
+    int                nproc[3];
+    FLUPS_BoundaryType bc;
+    int                lda;
+    FLUPS_SolverType   type;
+    FLUPS_SwitchType   switchType;
+    FLUPS_DecompType   decompType;
+    int                nthreads;
+    // measurements
+    double timeSetup;
+    double timeSolve;
+    double timeCopy;
+    double timeSwitch;
+    double timeFFTW;
+    double timeDomagic;
+    double timeComm;
+    double bytesSent;
+    size_t memAlloc;
+    size_t memHighWater;
+} BenchCase;
+
+static void print_help() {
+    printf("This is FLUPS benchmark code: \n");
+    printf(" --help, -h :                   print this message\n");
+    printf(" --nglob, -n N1,N2,... :        the list of sizes to sweep: the number of cells in each direction (strong) or per process (weak), default %s\n", d_nglob);
+    printf(" --weak, -w :                   weak scaling: the global size is N times the number of processes in each direction\n");
+    printf(" --bc, -bc B1,B2,... :          the list of boundary conditions (applied on every face) among unb,per,even,odd, default %s\n", d_bc);
+    printf(" --lda, -l L1,L2,... :          the list of leading dimensions among 1,3, default %s\n", d_lda);
+    printf(" --type, -t T1,T2,... :         the list of solver types among std,rot (rot only with lda=3), default %s\n", d_type);
+    printf(" --switch, -s S1,S2,... :       the list of switch patterns among a2a,nb,node,dt,auto, default %s\n", d_switch);
+    printf(" --decomp, -d D1,D2,... :       the list of decompositions among pencil,slab, default %s\n", d_decomp);
+    printf(" --threads, -nt T1,T2,... :     the list of thread counts, default omp_get_max_threads()\n");
+    printf(" --nsolve, -ns Ns :             the number of timed solves per case (after one warm-up solve), default %d\n", d_nsolve);
+    printf(" --output, -o file :            the JSON output file, default %s\n", d_outfile);
+}
+
+/**
+ * @brief split a comma separated list
+ */
+static vector<string> split_list(const string& list) {
+    vector<string> items;
+    size_t         start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        if (end > start) items.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+static int parse_bc(const string& name, FLUPS_BoundaryType* bc) {
+    if (name == "unb") {
+        *bc = UNB;
+    } else if (name == "per") {
+        *bc = PER;
+    } else if (name == "even") {
+        *bc = EVEN;
+    } else if (name == "odd") {
+        *bc = ODD;
+    } else {
+        fprintf(stderr, "unknown boundary condition %s\n", name.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_switch(const string& name, FLUPS_SwitchType* type) {
+    if (name == "a2a") {
+        *type = SWITCH_A2A;
+    } else if (name == "nb") {
+        *type = SWITCH_NB;
+    } else if (name == "node") {
+        *type = SWITCH_NODE;
+    } else if (name == "dt") {
+        *type = SWITCH_DT;
+    } else if (name == "auto") {
+        *type = SWITCH_AUTO;
+    } else {
+        fprintf(stderr, "unknown switch %s\n", name.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_decomp(const string& name, FLUPS_DecompType* type) {
+    if (name == "pencil") {
+        *type = DECOMP_PENCIL;
+    } else if (name == "slab") {
+        *type = DECOMP_SLAB;
+    } else {
+        fprintf(stderr, "unknown decomposition %s\n", name.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+static const char* bc_name(const FLUPS_BoundaryType bc) {
+    switch (bc) {
+        case UNB: return "unb";
+        case PER: return "per";
+        case EVEN: return "even";
+        case ODD: return "odd";
+        default: return "none";
+    }
+}
+
+static const char* switch_name(const FLUPS_SwitchType type) {
+    switch (type) {
+        case SWITCH_A2A: return "a2a";
+        case SWITCH_NB: return "nb";
+        case SWITCH_NODE: return "node";
+        case SWITCH_DT: return "dt";
+        case SWITCH_AUTO: return "auto";
+        default: return "default";
+    }
+}
+
+static const char* decomp_name(const FLUPS_DecompType type) {
+    return (type == DECOMP_SLAB) ? "slab" : "pencil";
+}
+
+/**
+ * @brief parse the arguments
+ *
+ * @return int 0 if the benchmark can run, 1 if the arguments are wrong, -1 if the help has been printed
+ */
+static int parse_args(int argc, char* argv[], vector<int>* nglob, bool* isWeak, vector<FLUPS_BoundaryType>* bc, vector<int>* lda,
+                      vector<FLUPS_SolverType>* type, vector<FLUPS_SwitchType>* switchType, vector<FLUPS_DecompType>* decompType, vector<int>* nthreads, int* nsolve,
+                      string* outfile) {
+    string l_nglob   = d_nglob;
+    string l_bc      = d_bc;
+    string l_lda     = d_lda;
+    string l_type    = d_type;
+    string l_switch  = d_switch;
+    string l_decomp  = d_decomp;
+    string l_threads = to_string(omp_get_max_threads());
+    *isWeak          = false;
+    *nsolve          = d_nsolve;
+    *outfile         = d_outfile;
+
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if ((arg == "-h") || (arg == "--help")) {
+            print_help();
+            return -1;
+        } else if ((arg == "-w") || (arg == "--weak")) {
+            *isWeak = true;
+            continue;
+        }
+        // all the other arguments have a value
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        const string val = argv[++i];
+        if ((arg == "-n") || (arg == "--nglob")) {
+            l_nglob = val;
+        } else if ((arg == "-bc") || (arg == "--bc")) {
+            l_bc = val;
+        } else if ((arg == "-l") || (arg == "--lda")) {
+            l_lda = val;
+        } else if ((arg == "-t") || (arg == "--type")) {
+            l_type = val;
+        } else if ((arg == "-s") || (arg == "--switch")) {
+            l_switch = val;
+        } else if ((arg == "-d") || (arg == "--decomp")) {
+            l_decomp = val;
+        } else if ((arg == "-nt") || (arg == "--threads")) {
+            l_threads = val;
+        } else if ((arg == "-ns") || (arg == "--nsolve")) {
+            *nsolve = atoi(val.c_str());
+        } else if ((arg == "-o") || (arg == "--output")) {
+            *outfile = val;
+        } else {
+            fprintf(stderr, "unknown argument %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    for (const string& item : split_list(l_nglob)) {
+        nglob->push_back(atoi(item.c_str()));
+        if (nglob->back() < 1) {
+            fprintf(stderr, "nglob must be >0\n");
+            return 1;
+        }
+    }
+    for (const string& item : split_list(l_bc)) {
+        FLUPS_BoundaryType mybc;
+        if (parse_bc(item, &mybc)) return 1;
+        bc->push_back(mybc);
+    }
+    for (const string& item : split_list(l_lda)) {
+        lda->push_back(atoi(item.c_str()));
+        if (lda->back() != 1 && lda->back() != 3) {
+            fprintf(stderr, "lda must be 1 or 3\n");
+            return 1;
+        }
+    }
+    for (const string& item : split_list(l_type)) {
+        if (item == "std") {
+            type->push_back(STD);
+        } else if (item == "rot") {
+            type->push_back(ROT);
+        } else {
+            fprintf(stderr, "unknown solver type %s\n", item.c_str());
+            return 1;
+        }
+    }
+    for (const string& item : split_list(l_switch)) {
+        FLUPS_SwitchType mytype;
+        if (parse_switch(item, &mytype)) return 1;
+        switchType->push_back(mytype);
+    }
+    for (const string& item : split_list(l_decomp)) {
+        FLUPS_DecompType mytype;
+        if (parse_decomp(item, &mytype)) return 1;
+        decompType->push_back(mytype);
+    }
+    for (const string& item : split_list(l_threads)) {
+        nthreads->push_back(atoi(item.c_str()));
+        if (nthreads->back() < 1) {
+            fprintf(stderr, "threads must be >0\n");
+            return 1;
+        }
+    }
+    if (*nsolve < 1) {
+        fprintf(stderr, "nsolve must be >0\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief setup a solver for the case, time a warm-up solve followed by nsolve solves and fill the measurements
+ */
+static void run_case(BenchCase* myCase, const int nsolve, MPI_Comm comm) {
+    const double L[3] = {1.0, 1.0, 1.0};
+    const double h[3] = {L[0] / myCase->nglob[0], L[1] / myCase->nglob[1], L[2] / myCase->nglob[2]};
+
+    omp_set_num_threads(myCase->nthreads);
+
+    FLUPS_BoundaryType* mybc[3][2];
+    for (int id = 0; id < 3; id++) {
+        for (int is = 0; is < 2; is++) {
+            mybc[id][is] = (FLUPS_BoundaryType*)flups_malloc(sizeof(int) * myCase->lda);
+            for (int lia = 0; lia < myCase->lda; lia++) {
+                mybc[id][is][lia] = myCase->bc;
+            }
+        }
+    }
+
+    FLUPS_Profiler* prof     = flups_profiler_new_n("bench");
+    FLUPS_Topology* topo     = flups_topo_new(0, myCase->lda, myCase->nglob, myCase->nproc, false, NULL, FLUPS_ALIGNMENT, comm);
+    flups_topo_set_decompType(topo, myCase->decompType);
+    FLUPS_Solver*   mysolver = flups_init_timed(topo, mybc, h, L, (myCase->type == ROT) ? SPE : NOD, prof);
+    flups_set_switchType(mysolver, myCase->switchType);
+
+    MPI_Barrier(comm);
+    const double tSetup = MPI_Wtime();
+    flups_setup(mysolver, false);
+    const double tSetupLoc = MPI_Wtime() - tSetup;
+    MPI_Allreduce(&tSetupLoc, &myCase->timeSetup, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    // fill the rhs with a smooth field
+    const size_t memsize = flups_topo_get_memsize(topo);
+    int          istart[3];
+    int          nmem[3];
+    flups_topo_get_istartGlob(topo, istart);
+    for (int id = 0; id < 3; id++) {
+        nmem[id] = flups_topo_get_nmem(topo, id);
+    }
+    double* rhs   = (double*)flups_malloc(sizeof(double) * memsize);
+    double* field = (double*)flups_malloc(sizeof(double) * memsize);
+    memset(rhs, 0, sizeof(double) * memsize);
+    for (int lia = 0; lia < myCase->lda; lia++) {
+        for (int i2 = 0; i2 < flups_topo_get_nloc(topo, 2); i2++) {
+            for (int i1 = 0; i1 < flups_topo_get_nloc(topo, 1); i1++) {
+                for (int i0 = 0; i0 < flups_topo_get_nloc(topo, 0); i0++) {
+                    const double x  = (istart[0] + i0 + 0.5) * h[0];
+                    const double y  = (istart[1] + i1 + 0.5) * h[1];
+                    const double z  = (istart[2] + i2 + 0.5) * h[2];
+                    const size_t id = flups_locID(0, i0, i1, i2, lia, 0, nmem, 1);
+                    rhs[id]         = exp(-((x - 0.5) * (x - 0.5) + (y - 0.5) * (y - 0.5) + (z - 0.5) * (z - 0.5)) / 0.01);
+                }
+            }
+        }
+    }
+
+    // warm-up solve, excluded from the measurements
+    flups_solve(mysolver, field, rhs, myCase->type);
+    flups_reset_commStats(mysolver);
+    const double t0Solve   = flups_profiler_get_time(prof, "solve");
+    const double t0Copy    = flups_profiler_get_time(prof, "copy");
+    const double t0FFTW    = flups_profiler_get_time(prof, "fftw");
+    const double t0Domagic = flups_profiler_get_time(prof, "domagic");
+    const double t0Reorder = flups_profiler_get_time(prof, "reorder");
+
+    for (int is = 0; is < nsolve; is++) {
+        flups_solve(mysolver, field, rhs, myCase->type);
+    }
+
+    myCase->timeSolve   = (flups_profiler_get_time(prof, "solve") - t0Solve) / nsolve;
+    myCase->timeCopy    = (flups_profiler_get_time(prof, "copy") - t0Copy) / nsolve;
+    myCase->timeFFTW    = (flups_profiler_get_time(prof, "fftw") - t0FFTW) / nsolve;
+    myCase->timeDomagic = (flups_profiler_get_time(prof, "domagic") - t0Domagic) / nsolve;
+    // the switches are timed by the "reorder" timer if compiled with PROF, they take the rest of the solve otherwise
+    const double timeReorder = (flups_profiler_get_time(prof, "reorder") - t0Reorder) / nsolve;
+    myCase->timeSwitch       = (timeReorder > 0.0) ? timeReorder : (myCase->timeSolve - myCase->timeCopy - myCase->timeFFTW - myCase->timeDomagic);
+
+    // gather the communication counters of the switches
+    double timeComm  = 0.0;
+    double bytesSent = 0.0;
+    for (int ip = 0; ip < 3; ip++) {
+        FLUPS_CommStats stats;
+        flups_get_commStats(mysolver, ip, &stats);
+        timeComm += stats.timeComm;
+        bytesSent += (double)stats.bytesSent;
+    }
+    int commSize;
+    MPI_Comm_size(comm, &commSize);
+    MPI_Allreduce(MPI_IN_PLACE, &timeComm, 1, MPI_DOUBLE, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &bytesSent, 1, MPI_DOUBLE, MPI_SUM, comm);
+    myCase->timeComm  = timeComm / (commSize * nsolve);
+    myCase->bytesSent = bytesSent / nsolve;
+
+    // memory: the allocation of the solver and the high-water mark of the processes, both max among the processors
+    size_t memAlloc = flups_get_allocSize(mysolver);
+    MPI_Allreduce(&memAlloc, &myCase->memAlloc, 1, MPI_UNSIGNED_LONG, MPI_MAX, comm);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    size_t memHighWater = (size_t)usage.ru_maxrss * 1024;
+    MPI_Allreduce(&memHighWater, &myCase->memHighWater, 1, MPI_UNSIGNED_LONG, MPI_MAX, comm);
+
+    flups_free(rhs);
+    flups_free(field);
+    flups_cleanup(mysolver);
+    flups_topo_free(topo);
+    flups_profiler_free(prof);
+    for (int id = 0; id < 3; id++) {
+        for (int is = 0; is < 2; is++) {
+            flups_free(mybc[id][is]);
+        }
+    }
+}
+
+static void write_json(const string& filename, const vector<BenchCase>& cases, const bool isWeak, const int commSize, const int nsolve) {
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == NULL) {
+        fprintf(stderr, "unable to open %s\n", filename.c_str());
+        return;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "  \"scaling\": \"%s\",\n", isWeak ? "weak" : "strong");
+    fprintf(file, "  \"nrank\": %d,\n", commSize);
+    fprintf(file, "  \"nsolve\": %d,\n", nsolve);
+    fprintf(file, "  \"cases\": [\n");
+    for (size_t ic = 0; ic < cases.size(); ic++) {
+        const BenchCase& c = cases[ic];
+        fprintf(file, "    {\"nglob\": [%d, %d, %d], \"nproc\": [%d, %d, %d], \"bc\": \"%s\", \"lda\": %d, \"type\": \"%s\", \"switch\": \"%s\", \"decomp\": \"%s\", \"nthreads\": %d,\n",
+                c.nglob[0], c.nglob[1], c.nglob[2], c.nproc[0], c.nproc[1], c.nproc[2], bc_name(c.bc), c.lda, (c.type == ROT) ? "rot" : "std", switch_name(c.switchType), decomp_name(c.decompType), c.nthreads);
+        fprintf(file, "     \"time_setup\": %e, \"time_solve\": %e, \"time_copy\": %e, \"time_switch\": %e, \"time_fftw\": %e, \"time_domagic\": %e, \"time_comm\": %e,\n",
+                c.timeSetup, c.timeSolve, c.timeCopy, c.timeSwitch, c.timeFFTW, c.timeDomagic, c.timeComm);
+        fprintf(file, "     \"bytes_sent\": %.0f, \"mem_alloc\": %zu, \"mem_highwater\": %zu}%s\n", c.bytesSent, c.memAlloc, c.memHighWater, (ic + 1 < cases.size()) ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+int main(int argc, char* argv[]) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    int      rank, commSize;
+    MPI_Comm comm = MPI_COMM_WORLD;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &commSize);
+
+    vector<int>                nglob, lda, nthreads;
+    vector<FLUPS_BoundaryType> bc;
+    vector<FLUPS_SolverType>   type;
+    vector<FLUPS_SwitchType>   switchType;
+    vector<FLUPS_DecompType>   decompType;
+    bool                       isWeak;
+    int                        nsolve;
+    string                     outfile;
+
+    const int err = parse_args(argc, argv, &nglob, &isWeak, &bc, &lda, &type, &switchType, &decompType, &nthreads, &nsolve, &outfile);
+    if (err) {
+        MPI_Finalize();
+        return (err > 0);
+    }
+
+    // distribute the ranks as a pencil along the first direction
+    int nproc[3] = {1, 0, 0};
+    MPI_Dims_create(commSize, 3, nproc);
+
+    vector<BenchCase> cases;
+    for (int n : nglob) {
+        for (FLUPS_BoundaryType mybc : bc) {
+            for (int mylda : lda) {
+                for (FLUPS_SolverType mytype : type) {
+                    // the rotational needs a vector field
+                    if (mytype == ROT && mylda != 3) continue;
+                    for (FLUPS_SwitchType myswitch : switchType) {
+                        for (FLUPS_DecompType mydecomp : decompType) {
+                            for (int nt : nthreads) {
+                                BenchCase myCase;
+                                memset(&myCase, 0, sizeof(BenchCase));
+                                for (int id = 0; id < 3; id++) {
+                                    myCase.nproc[id] = nproc[id];
+                                    myCase.nglob[id] = isWeak ? n * nproc[id] : n;
+                                }
+                                myCase.bc         = mybc;
+                                myCase.lda        = mylda;
+                                myCase.type       = mytype;
+                                myCase.switchType = myswitch;
+                                myCase.decompType = mydecomp;
+                                myCase.nthreads   = nt;
+
+                                run_case(&myCase, nsolve, comm);
+                                cases.push_back(myCase);
+
+                                if (rank == 0) {
+                                    printf("[bench] %d %d %d - %s - lda %d - %s - %s - %s - %d threads: setup %e s, solve %e s (copy %e, switch %e, fftw %e, domagic %e)\n",
+                                           myCase.nglob[0], myCase.nglob[1], myCase.nglob[2], bc_name(mybc), mylda, (mytype == ROT) ? "rot" : "std", switch_name(myswitch), decomp_name(mydecomp), nt,
+                                           myCase.timeSetup, myCase.timeSolve, myCase.timeCopy, myCase.timeSwitch, myCase.timeFFTW, myCase.timeDomagic);
+                                    fflush(stdout);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (rank == 0) write_json(outfile, cases, isWeak, commSize, nsolve);
+
+    MPI_Finalize();
+    return 0;
+}
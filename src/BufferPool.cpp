@@ -0,0 +1,162 @@
+/**
+ * @file BufferPool.cpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @brief 
+ * @version
+ * 
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+#include "BufferPool.hpp"
+#include <algorithm>
+#include <cstring>
+
+double*               BufferPool::_data       = NULL;
+size_t                BufferPool::_size       = 0;
+int                   BufferPool::_generation = 0;
+int                   BufferPool::_nextUser   = 0;
+int                   BufferPool::_lockUser   = -1;
+std::map<int, size_t> BufferPool::_request;
+
+/**
+ * @brief returns size rounded up so that a buffer of size doubles ends on an aligned address
+ * 
+ * @param size the number of doubles
+ * @return size_t 
+ */
+size_t BufferPool::_alignedSize(const size_t size) {
+    const size_t alignDouble = std::max((size_t)1, (size_t)(FLUPS_ALIGNMENT / sizeof(double)));
+    return ((size + alignDouble - 1) / alignDouble) * alignDouble;
+}
+
+/**
+ * @brief register a new user of the pool
+ * 
+ * @return int the id of the user, to be used in request() and remove_user()
+ */
+int BufferPool::add_user() {
+    BEGIN_FUNC;
+    const int id = _nextUser;
+    _nextUser++;
+    _request[id] = 0;
+    END_FUNC;
+    return id;
+}
+
+/**
+ * @brief release the request of the user and remove it from the pool
+ * 
+ * @param id the id of the user
+ */
+void BufferPool::remove_user(const int id) {
+    BEGIN_FUNC;
+    _request.erase(id);
+    _resize();
+    END_FUNC;
+}
+
+/**
+ * @brief set the size of the buffers requested by a user, and resize the pool if needed
+ * 
+ * @param id the id of the user
+ * @param size the number of doubles of each of the send and recv buffers, 0 to release the request
+ */
+void BufferPool::request(const int id, const size_t size) {
+    BEGIN_FUNC;
+    FLUPS_CHECK(_request.count(id) == 1, "the user %d is not registered in the pool", id, LOCATION);
+    _request[id] = size;
+    _resize();
+    END_FUNC;
+}
+
+/**
+ * @brief lock the pool during a split-phase solve of the user, no other user can use it nor reallocate it until unlock()
+ * 
+ * @param id the id of the user
+ */
+void BufferPool::lock(const int id) {
+    BEGIN_FUNC;
+    if (_lockUser >= 0) {
+        FLUPS_ERROR("the communication pool is already locked by the user %d", _lockUser, LOCATION);
+    }
+    _lockUser = id;
+    END_FUNC;
+}
+
+/**
+ * @brief check that the pool can be used by the user, i.e. that it is not locked by another user
+ * 
+ * @param id the id of the user
+ */
+void BufferPool::check_access(const int id) {
+    if (_lockUser >= 0 && _lockUser != id) {
+        FLUPS_ERROR("the communication pool is used by the split-phase solve of the user %d, it must be completed first", _lockUser, LOCATION);
+    }
+}
+
+/**
+ * @brief release the lock taken by lock()
+ * 
+ * @param id the id of the user
+ */
+void BufferPool::unlock(const int id) {
+    BEGIN_FUNC;
+    if (_lockUser != id) {
+        FLUPS_ERROR("the communication pool is locked by the user %d, not by %d", _lockUser, id, LOCATION);
+    }
+    _lockUser = -1;
+    END_FUNC;
+}
+
+/**
+ * @brief reallocate the pool to the maximum of the requests if it has changed
+ * 
+ * The new buffers are set to 0, as if they were just allocated by the Solver.
+ */
+void BufferPool::_resize() {
+    BEGIN_FUNC;
+    size_t max_mem = 0;
+    for (std::map<int, size_t>::const_iterator it = _request.begin(); it != _request.end(); ++it) {
+        max_mem = std::max(max_mem, it->second);
+    }
+    if (max_mem == _size) {
+        END_FUNC;
+        return;
+    }
+    if (_lockUser >= 0) {
+        FLUPS_ERROR("the communication pool cannot be reallocated during the split-phase solve of the user %d", _lockUser, LOCATION);
+    }
+
+    if (_data != NULL) {
+        flups_free(_data);
+        _data = NULL;
+    }
+    _size = max_mem;
+    if (_size > 0) {
+        _data = (double*)flups_malloc(memsize(_size) * sizeof(double));
+        // the first touch places the pages close to the threads which pack the buffers
+        flups_first_touch(_data, memsize(_size));
+    }
+    _generation++;
+    FLUPS_INFO("the communication pool now holds 2 x %ld doubles (generation %d)", _size, _generation);
+    END_FUNC;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file BufferPool.hpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @brief 
+ * @version
+ * 
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <map>
+#include "defines.hpp"
+
+/**
+ * @brief Process-wide pool of the communication buffers used by the SwitchTopo
+ * 
+ * Each Solver registers as a user of the pool and requests the buffer size it needs, i.e. the maximum of the SwitchTopo::get_bufMemSize() of its switches.
+ * The pool holds the send and the recv buffers in one allocation, sized to the maximum request of all its users,
+ * so that the Green's function setup and every Solver share the same memory instead of owning their own buffers.
+ * 
+ * A request of 0 releases the user: the pool shrinks to the maximum of the remaining requests and is freed when no request remains.
+ * Any reallocation increments the generation of the pool, the users must then link their switches to the new buffers (see SwitchTopo::setup_buffers()).
+ * 
+ * During a split-phase solve (see Solver::solve_begin()), the solver owning the solve locks the pool until the end of the solve:
+ * the buffers are then in use by the pending communications and the pool must not be used nor reallocated by any other solver.
+ * 
+ * @warning the solvers sharing the pool must not execute their switches concurrently.
+ */
+class BufferPool {
+   protected:
+    static double*               _data;       /**<@brief the raw memory of the pool */
+    static size_t                _size;       /**<@brief the number of doubles in one buffer of the pool */
+    static int                   _generation; /**<@brief the number of reallocations of the pool */
+    static int                   _nextUser;   /**<@brief the id given to the next user */
+    static int                   _lockUser;   /**<@brief the id of the user which locks the pool, -1 if the pool is free */
+    static std::map<int, size_t> _request;    /**<@brief the buffer size requested by each user */
+
+    static size_t _alignedSize(const size_t size);
+    static void   _resize();
+
+   public:
+    static int  add_user();
+    static void remove_user(const int id);
+    static void request(const int id, const size_t size);
+    static void lock(const int id);
+    static void unlock(const int id);
+    static void check_access(const int id);
+
+    /**
+     * @brief returns the padded size (in doubles) of memory required to store a send and a recv buffer of size doubles each
+     */
+    static size_t memsize(const size_t size) { return 2 * _alignedSize(size); }
+
+    static opt_double_ptr sendBuf() { return _data; }
+    static opt_double_ptr recvBuf() { return (_data == NULL) ? NULL : _data + _alignedSize(_size); }
+    static size_t         size() { return _size; }
+    static int            generation() { return _generation; }
+    static bool           busy() { return _lockUser >= 0; }
+};
+
+#endif
@@ -116,9 +116,9 @@ FFTW_plan_dim::~FFTW_plan_dim() {
     BEGIN_FUNC;
 
     if (_type == SYMSYM || _type == MIXUNB) {
-        // if the solver is SYMSYM or MIXUNB, each dimension has its own plan
+        // if the solver is SYMSYM or MIXUNB, each dimension has its own plan, unless it has the same kind as a previous one
         for (int lia = 0; lia < _lda; lia++) {
-            if (_plan != NULL) fftw_destroy_plan(_plan[lia]);
+            if (_plan != NULL && _sharedPlanID(lia) == lia) fftw_destroy_plan(_plan[lia]);
         }
     } else {
         // else, the first plan is the same as all the other ones
@@ -131,6 +131,7 @@ FFTW_plan_dim::~FFTW_plan_dim() {
     if (_kind != NULL) flups_free(_kind);
     if (_corrtype != NULL) flups_free(_corrtype);
     if (_plan != NULL) flups_free(_plan);
+    if (_pencilCount != NULL) flups_free(_pencilCount);
     END_FUNC;
 }
 
@@ -151,6 +152,8 @@ FFTW_plan_dim::~FFTW_plan_dim() {
  * - #_kind the kind of FFTW plan to execute (for SYMSYM and MIXUNB plans only)
  * - #_symstart the symmetry start = id of symmetry, for the Green's function only
  * 
+ * The dry run can be done again, the arrays of the previous one are then freed.
+ * 
  * @param size the current size of data in during dry run (hence already partially transformed)
  * @param isComplex the current complex state of the data
  */
@@ -160,6 +163,14 @@ void FFTW_plan_dim::init(const int size[3], const bool isComplex) {
     // sanity checks
     //-------------------------------------------------------------------------
     assert(size[_dimID] >= 0);
+    FLUPS_CHECK(_plan == NULL, "the plan cannot be initialized once allocated", LOCATION);
+
+    if (_imult != NULL) flups_free(_imult);
+    if (_kind != NULL) flups_free(_kind);
+    if (_corrtype != NULL) flups_free(_corrtype);
+    _imult    = NULL;
+    _kind     = NULL;
+    _corrtype = NULL;
 
     //-------------------------------------------------------------------------
     // redirect to the corresponding subfunction
@@ -179,6 +190,33 @@ void FFTW_plan_dim::init(const int size[3], const bool isComplex) {
     END_FUNC;
 }
 
+/**
+ * @brief returns true if the plan leads to the same layout of data as other, i.e. the same direction, sizes and complex state
+ * 
+ * If it is the case for every plan of two solvers, the solvers have the same topologies and switches.
+ * 
+ * @param other the other plan, already initialized
+ */
+bool FFTW_plan_dim::is_sameLayout(const FFTW_plan_dim* other) const {
+    return (_lda == other->_lda) && (_dimID == other->_dimID) && (_isr2c == other->_isr2c) &&
+           (_n_in == other->_n_in) && (_n_out == other->_n_out) && (_fieldstart == other->_fieldstart);
+}
+
+/**
+ * @brief returns true if the plan does the same transforms as other, and can therefore be used instead of it
+ * 
+ * @param other the other plan, already initialized
+ */
+bool FFTW_plan_dim::is_same(const FFTW_plan_dim* other) const {
+    bool same = is_sameLayout(other) && (_isGreen == other->_isGreen) && (_sign == other->_sign) && (_type == other->_type) &&
+                (_isSpectral == other->_isSpectral) && (_normfact == other->_normfact) && (_volfact == other->_volfact) &&
+                (_kfact == other->_kfact) && (_koffset == other->_koffset) && (_symstart == other->_symstart);
+    for (int lia = 0; lia < _lda && same; lia++) {
+        same = (_bc[0][lia] == other->_bc[0][lia]) && (_bc[1][lia] == other->_bc[1][lia]);
+    }
+    return same;
+}
+
 /**
  * @brief Initialize for a real to real plan
  * 
@@ -512,9 +550,11 @@ void FFTW_plan_dim::_init_unbounded(const int size[3], const bool isComplex) {
  * @param size_plan the size of the data BEFORE THE PLAN is executed
  * @param isComplex if the transpoed data is complex or real
  * @param data the pointer to the transposed data (has to be allocated)
+ * @param fftwFlag the FFTW planner flag (FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT,...)
  */
-void FFTW_plan_dim::allocate_plan(const Topology *topo, double* data) {
+void FFTW_plan_dim::allocate_plan(const Topology *topo, double* data, const unsigned fftwFlag) {
     BEGIN_FUNC;
+    _fftwFlag = fftwFlag;
     //-------------------------------------------------------------------------
     // allocate the plan
     //-------------------------------------------------------------------------
@@ -523,6 +563,13 @@ void FFTW_plan_dim::allocate_plan(const Topology *topo, double* data) {
     } else if (_type == PERPER || _type == UNBUNB) {
         _allocate_plan_complex(topo, data);
     }
+    //-------------------------------------------------------------------------
+    // allocate the pencil counters, once for all the executions
+    //-------------------------------------------------------------------------
+    const int ax0 = topo->axis();
+    _npencil      = (size_t)topo->nmem((ax0 + 1) % 3) * (size_t)topo->nmem((ax0 + 2) % 3);
+    if (_pencilCount != NULL) flups_free(_pencilCount);
+    _pencilCount = (int*)flups_malloc(_npencil * sizeof(int));
     END_FUNC;
 }
 
@@ -580,15 +627,21 @@ void FFTW_plan_dim::_allocate_plan_real(const Topology *topo, double* data) {
 
     // we initiate the plan with the size #_n_in, because this is the real number of data needed
     for (int lia = 0; lia < _lda; lia++) {
+        // the components with the same kind of transform use the same plan
+        const int iplan = _sharedPlanID(lia);
+        if (iplan < lia) {
+            _plan[lia] = _plan[iplan];
+            continue;
+        }
         if (topo->nf() == 1) {
             _fftw_stride = memsize[_dimID];
-            _plan[lia]   = fftw_plan_r2r_1d(_n_in, data, data, _kind[lia], FFTW_FLAG);
+            _plan[lia]   = fftw_plan_r2r_1d(_n_in, data, data, _kind[lia], _fftwFlag);
 
         } else if (topo->nf() == 2) {
             _fftw_stride = memsize[_dimID] * topo->nf();
             _plan[lia]   = fftw_plan_many_r2r(1, (int*)(&_n_in), 1,
                                             data, NULL, topo->nf(), memsize[_dimID] * topo->nf(),
-                                            data, NULL, topo->nf(), memsize[_dimID] * topo->nf(), _kind + lia, FFTW_FLAG);
+                                            data, NULL, topo->nf(), memsize[_dimID] * topo->nf(), _kind + lia, _fftwFlag);
         }
     }
 
@@ -612,6 +665,21 @@ void FFTW_plan_dim::_allocate_plan_real(const Topology *topo, double* data) {
     END_FUNC;
 }
 
+/**
+ * @brief returns the first component that has the same kind of real to real transform as the component lia, i.e. whose plan is used for lia
+ * 
+ * @param lia the component
+ * @return int the component owning the plan, lia itself if none of the previous components has the same kind
+ */
+int FFTW_plan_dim::_sharedPlanID(const int lia) const {
+    for (int ia = 0; ia < lia; ia++) {
+        if (_kind[ia] == _kind[lia]) {
+            return ia;
+        }
+    }
+    return lia;
+}
+
 /**
  * @brief allocate a plan that treats complex numbers (r2c or c2c)
  * 
@@ -675,9 +743,9 @@ void FFTW_plan_dim::_allocate_plan_complex(const Topology *topo, double* data) {
         FLUPS_INFO("------------------------------------------");
 
         if (_sign == FLUPS_FORWARD) {
-            _plan[0] = fftw_plan_dft_r2c_1d(_n_in, data, (fftw_complex*)data, FFTW_FLAG);
+            _plan[0] = fftw_plan_dft_r2c_1d(_n_in, data, (fftw_complex*)data, _fftwFlag);
         } else {
-            _plan[0] = fftw_plan_dft_c2r_1d(_n_in, (fftw_complex*)data, data, FFTW_FLAG);
+            _plan[0] = fftw_plan_dft_c2r_1d(_n_in, (fftw_complex*)data, data, _fftwFlag);
         }
 
     } else {
@@ -700,7 +768,7 @@ void FFTW_plan_dim::_allocate_plan_complex(const Topology *topo, double* data) {
         FLUPS_INFO("size n    = %d", _n_in);
         FLUPS_INFO("------------------------------------------");
 
-        _plan[0] = fftw_plan_dft_1d(_n_in, (fftw_complex*)data, (fftw_complex*)data, _sign, FFTW_FLAG);
+        _plan[0] = fftw_plan_dft_1d(_n_in, (fftw_complex*)data, (fftw_complex*)data, _sign, _fftwFlag);
     }
 
     // the plan is the same in every other direction
@@ -823,11 +891,18 @@ void FFTW_plan_dim::correct_plan(const Topology* topo, double* data) {
  * Every transform is done as a 1 thread 1d transform.
  * The multi-threading is used to perfom several FFT's at once
  * 
+ * If a support is given, only the pencils whose local indexes in the two other directions are in [start,end[ are transformed,
+ * the other ones are left untouched (see Solver::set_support()).
+ * 
  * @warning to access the memory, we cannot use #_howmany since it is based on the local size of the topo on the input.
  * Then, we have to use the memdim() function of the Topology
  * 
+ * @param topo the topology in which the data lives
+ * @param data the memory
+ * @param start the first local index of the pencils to transform in each direction, NULL to transform every pencil
+ * @param end the last local index (excluded) of the pencils to transform in each direction, NULL to transform every pencil
  */
-void FFTW_plan_dim::execute_plan(const Topology* topo, double* data) const {
+void FFTW_plan_dim::execute_plan(const Topology* topo, double* data, const int start[3], const int end[3]) const {
     BEGIN_FUNC;
     FLUPS_CHECK(!_isSpectral, "Trying to execute a plan for data which has already been setup spectraly", LOCATION);
     FLUPS_CHECK(topo->lda() == _lda, "The given topology's lda does not match with the initialisation one", LOCATION);
@@ -845,11 +920,21 @@ void FFTW_plan_dim::execute_plan(const Topology* topo, double* data) const {
         return;
     }
 
+    // get the pencils to transform: a box in the two other directions
+    const int ax1  = (topo->axis() + 1) % 3;
+    const int ax2  = (topo->axis() + 2) % 3;
+    const int s1   = (start == NULL) ? 0 : start[ax1];
+    const int s2   = (start == NULL) ? 0 : start[ax2];
+    const int n1   = (end == NULL) ? topo->nloc(ax1) : std::max(end[ax1] - s1, 0);
+    const int n2   = (end == NULL) ? topo->nloc(ax2) : std::max(end[ax2] - s2, 0);
+    const int nmem1 = topo->nmem(ax1);
+
     // copy the variable to avoid issues while compiling using openMP and gcc
-    const size_t howmany     = _howmany;
-    const size_t onmax       = _howmany * _lda;
+    const size_t howmany     = (size_t)n1 * (size_t)n2;
+    const size_t onmax       = howmany * _lda;
     const size_t fftw_stride = (size_t)_fftw_stride;
     const size_t memdim      = topo->memdim();
+    FLUPS_CHECK(howmany <= (size_t)_howmany, "the number of pencils to transform = %zu cannot be larger than the plan one = %zu", howmany, (size_t)_howmany, LOCATION);
     // get the plan pointer
     const fftw_plan* plan = _plan;
 
@@ -863,10 +948,11 @@ void FFTW_plan_dim::execute_plan(const Topology* topo, double* data) const {
     //-------------------------------------------------------------------------
     // incomming arrays depends if we are a complex switcher or not
     if (_type == SYMSYM || _type == MIXUNB) {  // R2R
-#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim)
+#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim, n1, s1, s2, nmem1)
         for (size_t id = 0; id < onmax; id++) {
             size_t lia = id / howmany;
-            size_t io  = id % howmany;
+            size_t ip  = id % howmany;
+            size_t io  = (ip % n1 + s1) + nmem1 * (ip / n1 + s2);
             // get the memory
             double* mydata = (double*)data + lia * memdim + io * fftw_stride;
             // execute the plan on it
@@ -876,10 +962,11 @@ void FFTW_plan_dim::execute_plan(const Topology* topo, double* data) const {
         if (_isr2c) {
             if (_sign == FLUPS_FORWARD) {  // DFT - R2C
                 FLUPS_CHECK(topo->nf() == 1, "nf should be 1 at this stage", LOCATION);
-#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim)
+#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim, n1, s1, s2, nmem1)
                 for (size_t id = 0; id < onmax; id++) {
                     size_t lia = id / howmany;
-                    size_t io  = id % howmany;
+                    size_t ip  = id % howmany;
+            size_t io  = (ip % n1 + s1) + nmem1 * (ip / n1 + s2);
                     // get the memory
                     double* mydata = (double*)data + lia * memdim + io * fftw_stride;
                     // execute the plan on it
@@ -887,10 +974,11 @@ void FFTW_plan_dim::execute_plan(const Topology* topo, double* data) const {
                 }
             } else {  // DFT - C2R
                 FLUPS_CHECK(topo->nf() == 2, "nf should be 2 at this stage", LOCATION);
-#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim)
+#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim, n1, s1, s2, nmem1)
                 for (size_t id = 0; id < onmax; id++) {
                     size_t lia = id / howmany;
-                    size_t io  = id % howmany;
+                    size_t ip  = id % howmany;
+            size_t io  = (ip % n1 + s1) + nmem1 * (ip / n1 + s2);
                     // WARNING the stride is given in the input size =  REAL => id * _fftw_stride/2 * nf = id * _fftw_stride
                     double* mydata = (double*)data + lia * memdim + io * fftw_stride;
                     // execute the plan on it
@@ -900,10 +988,11 @@ void FFTW_plan_dim::execute_plan(const Topology* topo, double* data) const {
 
         } else {  // DFT
             FLUPS_CHECK(topo->nf() == 2, "nf should be 2 at this stage", LOCATION);
-#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim)
+#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(plan, data, fftw_stride, onmax, howmany, memdim, n1, s1, s2, nmem1)
             for (size_t id = 0; id < onmax; id++) {
                 size_t lia = id / howmany;
-                size_t io  = id % howmany;
+                size_t ip  = id % howmany;
+            size_t io  = (ip % n1 + s1) + nmem1 * (ip / n1 + s2);
                 // we access complex info with a fftw_stride real
                 double* mydata = (double*)data + lia * memdim + io * fftw_stride * 2;
                 // execute the plan on it
@@ -914,6 +1003,89 @@ void FFTW_plan_dim::execute_plan(const Topology* topo, double* data) const {
     END_FUNC;
 }
 
+/**
+ * @brief Executes the plan (and its correction) on one single pencil, for every component
+ * 
+ * This function is used to overlap the FFTs with the communications (see SwitchTopo::execute_pipelined):
+ * the pencils are transformed one by one as soon as they are available in memory.
+ * 
+ * The correction is applied in the same order as in the full transform: after the plan if going forward
+ * and before the plan if going backward (see correct_plan() and execute_plan()).
+ * 
+ * @warning For a R2C/C2R plan, the topology has to be given in its REAL state (nf = 1), whatever the sign.
+ * This function is called from inside an OpenMP loop: no check and no verbosity are done here.
+ * 
+ * @param topo the topology in which the pencil lives
+ * @param data the memory
+ * @param io the collapsed index of the pencil (see collapsedIndex()), i.e. i1 + nmem[ax1] * i2
+ */
+void FFTW_plan_dim::execute_pencil(const Topology* topo, double* data, const size_t io) const {
+    if (_type == EMPTY) {
+        return;
+    }
+    const int    nloc        = topo->nloc(topo->axis());
+    const size_t memdim      = topo->memdim();
+    const size_t fftw_stride = (size_t)_fftw_stride;
+
+    for (int lia = 0; lia < _lda; lia++) {
+        if (_type == SYMSYM || _type == MIXUNB) {  // R2R
+            opt_double_ptr dataloc = data + lia * memdim + io * fftw_stride;
+            // the backward correction is done before the transform
+            if (_corrtype[lia] == CORRECTION_DST && _sign == FLUPS_BACKWARD) {
+                for (int ii = 1; ii < nloc; ii++) {
+                    dataloc[ii - 1] = dataloc[ii];
+                }
+            }
+            fftw_execute_r2r(_plan[lia], (double*)dataloc, (double*)dataloc);
+            // the forward correction is done after the transform
+            if (_corrtype[lia] == CORRECTION_DCT && _sign == FLUPS_FORWARD) {
+                dataloc[nloc - 1] = 0.0;
+            } else if (_corrtype[lia] == CORRECTION_DST && _sign == FLUPS_FORWARD) {
+                for (int ii = nloc - 2; ii >= 0; ii--) {
+                    dataloc[ii + 1] = dataloc[ii];
+                }
+                dataloc[0] = 0.0;
+            }
+        } else if (_type == PERPER || _type == UNBUNB) {
+            if (_isr2c) {
+                // the stride is given in the real size
+                double* dataloc = data + lia * memdim + io * fftw_stride;
+                if (_sign == FLUPS_FORWARD) {  // DFT - R2C
+                    fftw_execute_dft_r2c(_plan[lia], (double*)dataloc, (fftw_complex*)dataloc);
+                } else {  // DFT - C2R
+                    fftw_execute_dft_c2r(_plan[lia], (fftw_complex*)dataloc, (double*)dataloc);
+                }
+            } else {  // DFT
+                // we access complex info with a fftw_stride real
+                double* dataloc = data + lia * memdim + io * fftw_stride * 2;
+                fftw_execute_dft(_plan[lia], (fftw_complex*)dataloc, (fftw_complex*)dataloc);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Executes the plan (and its correction) on every local pencil of the topology, the pencils being shared among the threads
+ * 
+ * @warning For a R2C/C2R plan, the topology has to be given in its REAL state (nf = 1), see execute_pencil().
+ * 
+ * @param topo the topology in which the pencils live
+ * @param data the memory
+ */
+void FFTW_plan_dim::execute_pencils(const Topology* topo, double* data) const {
+    BEGIN_FUNC;
+    const int ax0    = topo->axis();
+    const int nloc1  = topo->nloc((ax0 + 1) % 3);
+    const int nmem1  = topo->nmem((ax0 + 1) % 3);
+    const int id_max = nloc1 * topo->nloc((ax0 + 2) % 3);
+#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(topo, data, nloc1, nmem1, id_max)
+    for (int id = 0; id < id_max; id++) {
+        const size_t io = (id % nloc1) + nmem1 * (id / nloc1);
+        execute_pencil(topo, data, io);
+    }
+    END_FUNC;
+}
+
 /**
  * @brief display the FFTW_plan_dim object
  * 
@@ -93,16 +93,23 @@ class FFTW_plan_dim {
     bool*               _imult    = NULL;        /**< @brief boolean indicating that we have to multiply by (-i) in forward and (i) in backward*/
     fftw_r2r_kind*      _kind     = NULL;         /**< @brief kind of transfrom to perform (used by r2r and mix plan only)*/
     fftw_plan*          _plan     = NULL;         /**< @brief the array of FFTW plan*/
+    unsigned            _fftwFlag = FFTW_FLAG;    /**< @brief the FFTW planner flag used to create the plans*/
+    int*                _pencilCount = NULL;      /**< @brief one counter per pencil of the topology, used by the switches to know when a pencil can be transformed (see SwitchTopo::execute_pipelined)*/
+    size_t              _npencil     = 0;         /**< @brief the number of counters in #_pencilCount*/
 
    public:
     FFTW_plan_dim(const int lda, const int dimID, const double h[3], const double L[3], BoundaryType* mybc[2], const int sign, const bool isGreen);
     ~FFTW_plan_dim();
 
     void init(const int size[3], const bool isComplex);
+    bool is_sameLayout(const FFTW_plan_dim* other) const;
+    bool is_same(const FFTW_plan_dim* other) const;
 
-    void allocate_plan(const Topology* topo, double* data);
+    void allocate_plan(const Topology* topo, double* data, const unsigned fftwFlag = FFTW_FLAG);
     void correct_plan(const Topology*, double* data);
-    void execute_plan(const Topology* topo, double* data) const;
+    void execute_plan(const Topology* topo, double* data, const int start[3] = NULL, const int end[3] = NULL) const;
+    void execute_pencil(const Topology* topo, double* data, const size_t io) const;
+    void execute_pencils(const Topology* topo, double* data) const;
 
     /**
      * @name Getters - return the value
@@ -123,6 +130,8 @@ class FFTW_plan_dim {
     inline void   get_outsize(int* size) const { size[_dimID] = _n_out; };
     inline void   get_fieldstart(int* start) const { start[_dimID] = _fieldstart; };
     inline void   get_isNowComplex(bool* isComplex) const { (*isComplex) = (*isComplex) || _isr2c; };
+    inline int*   pencilCount() const { return _pencilCount; }
+    inline size_t npencil() const { return _npencil; }
     /**@} */
 
     void disp();
@@ -146,6 +155,7 @@ class FFTW_plan_dim {
     /**@{ */
     void _allocate_plan_real(const Topology* topo, double* data);
     void _allocate_plan_complex(const Topology* topo, double* data);
+    int  _sharedPlanID(const int lia) const;
     /**@} */
 };
 
@@ -24,6 +24,7 @@
  */
 
 #include "Profiler.hpp"
+#include <omp.h>
 
 
 /**
@@ -36,26 +37,40 @@ TimerAgent::TimerAgent(string name){
 }
 
 /**
- * @brief start the timer
+ * @brief start the timer, only on the master thread inside an OpenMP region
  * 
  */
 void TimerAgent::start() {
+    if (omp_get_thread_num() != 0) return;
     _count += 1;
     _t0 = MPI_Wtime();
 }
 
 /**
- * @brief stop the timer
+ * @brief stop the timer, only on the master thread inside an OpenMP region
  * 
  */
 void TimerAgent::stop() {
+    if (omp_get_thread_num() != 0) return;
     // get the time
     _t1 = MPI_Wtime();
     // store it
     double dt = _t1 - _t0;
     _timeAcc  = _timeAcc + dt;
     _timeMax  = max(_timeMax, dt);
-    _timeMin  = min(_timeMax, dt);
+    _timeMin  = (_count == 1) ? dt : min(_timeMin, dt);
+    // get the bin of the histogram: the number of bits of the time in microseconds
+    int    ibin = 0;
+    size_t dtus = (size_t)(dt * 1.0e+6);
+    while (dtus > 0 && ibin < FLUPS_PROF_NHIST - 1) {
+        dtus >>= 1;
+        ibin++;
+    }
+    _hist[ibin]++;
+    if (_isTraced) {
+        _trace.push_back(_t0);
+        _trace.push_back(_t1);
+    }
 }
 
 /**
@@ -63,11 +78,16 @@ void TimerAgent::stop() {
  * 
  */
 void TimerAgent::reset() {
+    _count   = 0;
     _t1      = 0.0;
     _t0      = 0.0;
     _timeAcc = 0.0;
     _timeMax = 0.0;
     _timeMin = 0.0;
+    for (int ib = 0; ib < FLUPS_PROF_NHIST; ib++) {
+        _hist[ib] = 0;
+    }
+    _trace.clear();
 }
 
 /**
@@ -270,6 +290,35 @@ void TimerAgent::disp(FILE* file,const int level, const double totalTime){
     }
 }
 
+/**
+ * @brief write the histogram of the time per call of every rank, one line per rank, and do the same for the children
+ * 
+ * @param file the file, only used on rank 0
+ * @param rank the rank in MPI_COMM_WORLD
+ * @param commSize the size of MPI_COMM_WORLD
+ */
+void TimerAgent::dispHist(FILE* file, const int rank, const int commSize) {
+    int totalCount;
+    MPI_Allreduce(&_count, &totalCount, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    if (totalCount > 0) {
+        int* hist = (rank == 0) ? (int*)flups_malloc(sizeof(int) * FLUPS_PROF_NHIST * commSize) : NULL;
+        MPI_Gather(_hist, FLUPS_PROF_NHIST, MPI_INT, hist, FLUPS_PROF_NHIST, MPI_INT, 0, MPI_COMM_WORLD);
+        if (rank == 0) {
+            for (int ir = 0; ir < commSize; ir++) {
+                fprintf(file, "%s;%d", _name.c_str(), ir);
+                for (int ib = 0; ib < FLUPS_PROF_NHIST; ib++) {
+                    fprintf(file, ";%d", hist[ir * FLUPS_PROF_NHIST + ib]);
+                }
+                fprintf(file, "\n");
+            }
+            flups_free(hist);
+        }
+    }
+    for (map<string, TimerAgent*>::iterator it = _children.begin(); it != _children.end(); it++) {
+        it->second->dispHist(file, rank, commSize);
+    }
+}
+
 //===============================================================================================================================
 //===============================================================================================================================
 //===============================================================================================================================
@@ -284,36 +333,38 @@ Profiler::Profiler(const string myname): _name(myname)
     _createSingle("root");
 }
 Profiler::~Profiler() {
-    for (map<string, TimerAgent*>::iterator it = _timeMap.begin(); it != _timeMap.end(); it++) {
-        TimerAgent* current = it->second;
-        delete(current);
+    for (size_t ih = 0; ih < _timers.size(); ih++) {
+        delete(_timers[ih]);
     }
 }
 
 /**
- * @brief create a TimerAgent inside the #_timeMap
+ * @brief create a TimerAgent, or reset it if it already exists
  * 
- * @param name the key of the entry
+ * @param name the name of the timer
+ * @return int the handle of the timer
  */
-void Profiler::_createSingle(string name) {
-    map<string, TimerAgent*>::iterator it = _timeMap.find(name);
-    // if it does not already exist
-    if (it != _timeMap.end()){
-        _timeMap[name]->reset();
-    }
-    else if (it == _timeMap.end()) {
-        _timeMap[name] = new TimerAgent(name);
-        _timeMap[name]->reset();
+int Profiler::_createSingle(string name) {
+    map<string, int>::iterator it = _handles.find(name);
+    if (it != _handles.end()) {
+        _timers[it->second]->reset();
+        return it->second;
     }
+    const int h = (int)_timers.size();
+    _timers.push_back(new TimerAgent(name));
+    _timers[h]->set_trace(_isTraced);
+    _handles[name] = h;
+    return h;
 }
 
 /**
  * @brief create a new TimerAgent with "root" as parent
  * 
  * @param name the TimerAgent name
+ * @return int the handle of the timer
  */
-void Profiler::create(string name) {
-    create(name,"root");
+int Profiler::create(string name) {
+    return create(name,"root");
 }
 
 /**
@@ -321,16 +372,67 @@ void Profiler::create(string name) {
  * 
  * @param child the new TimerAgent
  * @param daddy the dad of the new TimerAgent if it does not exists, it is created
+ * @return int the handle of the timer
  */
-void Profiler::create(string child, string daddy) {
+int Profiler::create(string child, string daddy) {
     // create a new guy
-    _createSingle(child);
+    const int h = _createSingle(child);
     // find the daddy agent in the root
-    map<string, TimerAgent*>::iterator it = _timeMap.find(daddy);
-    if(it == _timeMap.end()){
-        create(daddy);
+    int hdad = handle(daddy);
+    if (hdad < 0) {
+        hdad = create(daddy);
     }
-    _timeMap[daddy]->addChild(_timeMap[child]);
+    _timers[hdad]->addChild(_timers[h]);
+    return h;
+}
+
+/**
+ * @brief returns the handle of a timer
+ * 
+ * @param name the TimerAgent name
+ * @return int the handle, -1 if the timer does not exist
+ */
+int Profiler::handle(const string name) const {
+    map<string, int>::const_iterator it = _handles.find(name);
+    return (it != _handles.end()) ? it->second : -1;
+}
+
+/**
+ * @brief start the timer of the TimerAgent
+ * 
+ * @param handle the handle of the TimerAgent, see create()
+ */
+void Profiler::start(const int handle) {
+#ifndef NDEBUG
+    // the check is skipped in release since the location is a string
+    FLUPS_CHECK(handle >= 0 && handle < (int)_timers.size(), "timer %d not found", handle, LOCATION);
+#endif
+    _timers[handle]->start();
+}
+
+/**
+ * @brief stop the timer of the TimerAgent
+ * 
+ * @param handle the handle of the TimerAgent, see create()
+ */
+void Profiler::stop(const int handle) {
+#ifndef NDEBUG
+    FLUPS_CHECK(handle >= 0 && handle < (int)_timers.size(), "timer %d not found", handle, LOCATION);
+#endif
+    _timers[handle]->stop();
+}
+
+/**
+ * @brief adds memory to the TimerAgent to compute the bandwidth
+ * 
+ * @param handle the handle of the TimerAgent, see create()
+ * @param mem the memory
+ */
+void Profiler::addMem(const int handle, size_t mem) {
+#ifndef NDEBUG
+    FLUPS_CHECK(handle >= 0 && handle < (int)_timers.size(), "timer %d not found", handle, LOCATION);
+#endif
+    _timers[handle]->addMem(mem);
 }
 
 /**
@@ -339,18 +441,9 @@ void Profiler::create(string child, string daddy) {
  * @param name the TimerAgent name
  */
 void Profiler::start(string name) {
-#ifdef NDEBUG
-    _timeMap[name]->start();
-#else
-    map<string, TimerAgent*>::iterator it = _timeMap.find(name);
-    if (it != _timeMap.end()) {
-        _timeMap[name]->start();
-    }
-    else{
-        string msg = "timer "+name+ " not found";
-        FLUPS_ERROR(msg, LOCATION);
-    }
-#endif
+    const int h = handle(name);
+    FLUPS_CHECK(h >= 0, "timer %s not found", name.c_str(), LOCATION);
+    _timers[h]->start();
 }
 
 /**
@@ -359,33 +452,27 @@ void Profiler::start(string name) {
  * @param name the TimerAgent name
  */
 void Profiler::stop(string name) {
-#ifdef NDEBUG
-    _timeMap[name]->stop();
-#else
-    map<string, TimerAgent*>::iterator it = _timeMap.find(name);
-    if (it != _timeMap.end()) {
-        _timeMap[name]->stop();
-    }
-    else{
-        string msg = "timer "+name+ " not found";
-        FLUPS_ERROR(msg, LOCATION);
-    }
-#endif
+    const int h = handle(name);
+    FLUPS_CHECK(h >= 0, "timer %s not found", name.c_str(), LOCATION);
+    _timers[h]->stop();
 }
 
 void Profiler::addMem(string name,size_t mem) {
-#ifdef NDEBUG
-    _timeMap[name]->addMem(mem);
-#else
-    map<string, TimerAgent*>::iterator it = _timeMap.find(name);
-    if (it != _timeMap.end()) {
-        _timeMap[name]->addMem(mem);
-    }
-    else{
-        string msg = "timer "+name+ " not found";
-        FLUPS_ERROR(msg, LOCATION);
+    const int h = handle(name);
+    FLUPS_CHECK(h >= 0, "timer %s not found", name.c_str(), LOCATION);
+    _timers[h]->addMem(mem);
+}
+
+/**
+ * @brief store the start and end time of every call of every timer, to be written by write_trace()
+ * 
+ * @param isTraced 
+ */
+void Profiler::set_trace(const bool isTraced) {
+    _isTraced = isTraced;
+    for (size_t ih = 0; ih < _timers.size(); ih++) {
+        _timers[ih]->set_trace(isTraced);
     }
-#endif
 }
 
 /**
@@ -397,7 +484,9 @@ void Profiler::addMem(string name,size_t mem) {
 double Profiler::get_timeAcc(const std::string ref){
 
     int commSize;
-    double localTotalTime = _timeMap[ref]->timeAcc();
+    const int h = handle(ref);
+    // a timer that has not been created (e.g. compiled without PROF) did not accumulate any time
+    double localTotalTime = (h < 0) ? 0.0 : _timers[h]->timeAcc();
     double totalTime;
     MPI_Comm_size(MPI_COMM_WORLD, &commSize);
 
@@ -441,7 +530,7 @@ void Profiler::disp(const std::string ref) {
         file            = fopen(filename.c_str(), "w+");
 
         if (file != NULL) {
-            _timeMap["root"]->writeParentality(file,0);
+            _timers[0]->writeParentality(file,0);
             fclose(file);
         } else {
             printf("unable to open file %s !", filename.c_str());
@@ -468,7 +557,7 @@ void Profiler::disp(const std::string ref) {
     double totalTime = this->get_timeAcc(ref);
 
     // display root with the total time
-    _timeMap["root"]->disp(file,0,totalTime);
+    _timers[0]->disp(file,0,totalTime);
     // display footer
     if (rank == 0) {
         printf("===================================================================================================================================================\n");
@@ -489,4 +578,65 @@ void Profiler::disp(const std::string ref) {
             printf("unable to open file for profiling !");
         }
     }
+
+    //-------------------------------------------------------------------------
+    /** - do the IO of the histograms of the time per call of each rank */
+    //-------------------------------------------------------------------------
+    if (rank == 0) {
+        string filename = folder + "/" + _name + "_hist.csv";
+        file            = fopen(filename.c_str(), "w+");
+        if (file == NULL) {
+            printf("unable to open file %s !", filename.c_str());
+        }
+    }
+    int isOpen = (rank != 0 || file != NULL);
+    MPI_Bcast(&isOpen, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (isOpen) {
+        _timers[0]->dispHist(file, rank, commSize);
+    }
+    if (rank == 0 && file != NULL) {
+        fclose(file);
+    }
+}
+
+/**
+ * @brief write the calls recorded since set_trace() in the Chrome trace format (see chrome://tracing), one file per rank
+ * 
+ * The files are ./prof/<name>_trace<rank>.json, the time is given in microseconds since the first call.
+ */
+void Profiler::write_trace() {
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // get the origin of the time, common to every rank
+    double t0 = MPI_Wtime();
+    for (size_t ih = 0; ih < _timers.size(); ih++) {
+        if (_timers[ih]->trace().size() > 0) {
+            t0 = min(t0, _timers[ih]->trace()[0]);
+        }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &t0, 1, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+
+    string folder = "./prof";
+    struct stat st = {0};
+    if (stat(folder.c_str(), &st) == -1) {
+        mkdir(folder.c_str(), 0770);
+    }
+    string filename = folder + "/" + _name + "_trace" + to_string(rank) + ".json";
+    FILE*  file     = fopen(filename.c_str(), "w+");
+    if (file == NULL) {
+        printf("unable to open file %s !", filename.c_str());
+        return;
+    }
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool isFirst = true;
+    for (size_t ih = 0; ih < _timers.size(); ih++) {
+        const vector<double>& trace = _timers[ih]->trace();
+        for (size_t ic = 0; ic < trace.size() / 2; ic++) {
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}", (isFirst) ? "" : ",\n", _timers[ih]->name().c_str(), rank, (trace[2 * ic] - t0) * 1.0e+6, (trace[2 * ic + 1] - trace[2 * ic]) * 1.0e+6);
+            isFirst = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
 }
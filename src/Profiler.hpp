@@ -28,6 +28,7 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -38,16 +39,26 @@
 
 using namespace std;
 
+/**
+ * @brief number of bins of the per-call histogram of a TimerAgent: the bin b counts the calls with 2^(b-1) <= dt < 2^b microseconds, the last one the longer calls
+ * 
+ */
+#define FLUPS_PROF_NHIST 24
+
 #if defined(PROF)
 #define PROF_START(name) if (_prof != NULL) _prof->start(name);
 #define PROF_STARTi(name,ip) if (_prof != NULL) _prof->start(name+to_string(ip));
 #define PROF_STOP(name) if (_prof != NULL) _prof->stop(name);
 #define PROF_STOPi(name,ip) if (_prof != NULL) _prof->stop(name+to_string(ip));
+#define PROF_STARTh(handle) if (_prof != NULL) _prof->start(handle);
+#define PROF_STOPh(handle) if (_prof != NULL) _prof->stop(handle);
 #else
 #define PROF_START(name) ((void)0);
 #define PROF_STARTi(name,ip) ((void)0);
 #define PROF_STOP(name) ((void)0);
 #define PROF_STOPi(name,ip) ((void)0);
+#define PROF_STARTh(handle) ((void)0);
+#define PROF_STOPh(handle) ((void)0);
 #endif
 
 class TimerAgent {
@@ -62,6 +73,10 @@ class TimerAgent {
     double _timeMax = 0.0;
     double _timeMin = 0.0;
 
+    int            _hist[FLUPS_PROF_NHIST] = {0}; /**< @brief histogram of the time per call, see FLUPS_PROF_NHIST */
+    bool           _isTraced = false;             /**< @brief if true, every call is stored in #_trace */
+    vector<double> _trace;                        /**< @brief the start and end time of every call, if #_isTraced */
+
     string _name = "noname";
 
     TimerAgent*       _daddy = NULL;
@@ -75,6 +90,7 @@ class TimerAgent {
     void reset();
     void addMem(size_t mem);
     void disp(FILE* file, const int level, const double totalTime);
+    void dispHist(FILE* file, const int rank, const int commSize);
 
     int    count() const { return _count; };
     bool   isroot() const { return _isroot; };
@@ -83,34 +99,52 @@ class TimerAgent {
     double timeMin() const;
     double timeMax() const;
 
+    void                  set_trace(const bool isTraced) { _isTraced = isTraced; };
+    const vector<double>& trace() const { return _trace; };
+
     void addChild(TimerAgent* child);
     void setDaddy(TimerAgent* daddy);
     void writeParentality(FILE* file, const int level);
 };
 
+/**
+ * @brief Hierarchy of timers
+ * 
+ * The timers are created with a name and identified by an integer handle, returned by create() or handle().
+ * Starting and stopping a timer with its handle avoids the lookup by name, which is recommended in the loops.
+ * Only the master thread is timed inside an OpenMP region, the calls from the other threads are ignored.
+ */
 class Profiler {
    protected:
-    map<string, TimerAgent*> _timeMap;
+    vector<TimerAgent*> _timers;  /**< @brief the timers, indexed by their handle */
+    map<string, int>    _handles; /**< @brief the handle of each timer name */
+    bool                _isTraced = false;
 
     const string _name;
-    void _createSingle(string name);
+    int _createSingle(string name);
 
    public:
     Profiler();
     Profiler(const string myname);
     ~Profiler();
 
-    void create(string name);
-    void create(string child, string daddy);
+    int create(string name);
+    int create(string child, string daddy);
+    int handle(const string name) const;
 
+    void start(const int handle);
+    void stop(const int handle);
+    void addMem(const int handle, size_t mem);
     void start(string name);
     void stop(string name);
-    void addMem(string name,size_t mem);
+    void addMem(string name, size_t mem);
 
     double get_timeAcc(const std::string ref);
 
+    void set_trace(const bool isTraced);
     void disp();
     void disp(const std::string ref);
+    void write_trace();
 };
 
 #endif
@@ -25,6 +25,8 @@
 
 #include "Solver.hpp"
 
+int Solver::_nalive = 0;
+
 /**
  * @brief Constructs a fftw Poisson solver, initilizes the plans and determines their order of execution
  * 
@@ -37,6 +39,48 @@
  */
 Solver::Solver(Topology *topo, BoundaryType* rhsbc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, Profiler *prof){
     BEGIN_FUNC;
+    _init(topo, rhsbc, h, L, orderDiff, prof);
+    END_FUNC;
+}
+
+/**
+ * @brief Constructs a fftw Poisson solver on the same topology as ref, sharing with it everything that does not depend on the Green's function
+ * 
+ * If the data layout is the same as the one of ref (same order of the transforms, same sizes and same complex state),
+ * the topologies, the switches and the data of ref are used. If the transforms are also the same (same boundary conditions, orderDiff, h and L),
+ * the plans of ref are used as well. Only the Green's function (and what is not shared) is computed during the setup.
+ * 
+ * @warning ref must be setup before this solver and destroyed after it.
+ * As they share their data, the two solvers must not be used at the same time.
+ * The switch type (see set_switchType()) is the one of ref if the switches are shared.
+ * 
+ * @param ref the reference solver
+ * @param rhsbc the boundary conditions of the computational domain, see Solver()
+ * @param h the grid spacing
+ * @param L the domain size
+ * @param orderDiff the differential order used for the rotational case, see Solver()
+ * @param prof the profiler to use for the solve timing
+ */
+Solver::Solver(Solver *ref, BoundaryType* rhsbc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, Profiler *prof){
+    BEGIN_FUNC;
+    FLUPS_CHECK(ref != NULL, "the reference solver cannot be NULL", LOCATION);
+    _ref = ref;
+    _ref->_nderived++;
+    _init(ref->_topo_phys, rhsbc, h, L, orderDiff, prof);
+    END_FUNC;
+}
+
+/**
+ * @brief initializes the plans and determines their order of execution, see Solver()
+ * 
+ * If #_ref is given, its topologies, switches and plans are used when possible.
+ */
+void Solver::_init(Topology *topo, BoundaryType* rhsbc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, Profiler *prof){
+    BEGIN_FUNC;
+
+    // the communication buffers are shared with the other solvers
+    _poolId = BufferPool::add_user();
+    _nalive++;
 
     // //-------------------------------------------------------------------------
     // /** - Initialize the OpenMP threads for FFTW */
@@ -89,10 +133,10 @@ Solver::Solver(Topology *topo, BoundaryType* rhsbc[3][2], const double h[3], con
     if (_prof != NULL) _prof->create("green_plan", "green");
     if (_prof != NULL) _prof->create("green_func", "green");
     if (_prof != NULL) _prof->create("green_final", "green");
-    if (_prof != NULL) _prof->create("solve", "root");
-    if (_prof != NULL) _prof->create("copy", "solve");
-    if (_prof != NULL) _prof->create("fftw", "solve");
-    if (_prof != NULL) _prof->create("domagic", "solve");
+    if (_prof != NULL) _profSolve = _prof->create("solve", "root");
+    if (_prof != NULL) _profCopy = _prof->create("copy", "solve");
+    if (_prof != NULL) _profFFTW = _prof->create("fftw", "solve");
+    if (_prof != NULL) _profDomagic = _prof->create("domagic", "solve");
     if (_prof != NULL) _prof->start("init");
 
     
@@ -142,6 +186,7 @@ Solver::Solver(Topology *topo, BoundaryType* rhsbc[3][2], const double h[3], con
     _sort_plans(_plan_forward);
     _sort_plans(_plan_backward);
     _sort_plans(_plan_green);
+    _sort_plans2D(topo);
     FLUPS_INFO("I will proceed with forward transforms in the following direction order: %d, %d, %d", _plan_forward[0]->dimID(), _plan_forward[1]->dimID(), _plan_forward[2]->dimID());
 
     // create the backward plan in the EXACT same order as the backward one
@@ -168,13 +213,61 @@ Solver::Solver(Topology *topo, BoundaryType* rhsbc[3][2], const double h[3], con
     /** - Initialise the topos, the plans and the SwitchTopos */
     //-------------------------------------------------------------------------
     _topo_phys = topo; //store pointer to the topo of the user
-    _init_plansAndTopos(topo, _topo_hat, _switchtopo, _plan_forward, false);
+    // with a reference solver, the dry run of the plans tells if the data has the same layout
+    if (_ref != NULL) {
+        _init_plansAndTopos(topo, NULL, NULL, _plan_forward, false);
+        _shareTopo = (_ndim == _ref->_ndim) && (_lda == _ref->_lda);
+        for (int ip = 0; ip < 3; ip++) {
+            _shareTopo = _shareTopo && _plan_forward[ip]->is_sameLayout(_ref->_plan_forward[ip]);
+        }
+    }
+    if (_shareTopo) {
+        for (int ip = 0; ip < 3; ip++) {
+            _topo_hat[ip]   = _ref->_topo_hat[ip];
+            _switchtopo[ip] = _ref->_switchtopo[ip];
+            _isSlab         = _ref->_isSlab;
+            for (int id = 0; id < 3; id++) {
+                _switchShift[ip][id] = _ref->_switchShift[ip][id];
+            }
+        }
+    } else {
+        _init_plansAndTopos(topo, _topo_hat, _switchtopo, _plan_forward, false);
+    }
     _init_plansAndTopos(topo, NULL, NULL, _plan_backward, false);
     _init_plansAndTopos(topo, _topo_green, _switchtopo_green, _plan_green, true);
     if(_odiff != NOD){
         _init_plansAndTopos(topo, NULL, NULL, _plan_backward_diff, false);
     }
 
+    // the plans of the reference can be used if they do the same transforms
+    if (_shareTopo) {
+        _sharePlans = (_odiff == _ref->_odiff);
+        for (int ip = 0; ip < 3; ip++) {
+            _sharePlans = _sharePlans && _plan_forward[ip]->is_same(_ref->_plan_forward[ip]);
+            _sharePlans = _sharePlans && _plan_backward[ip]->is_same(_ref->_plan_backward[ip]);
+            if (_odiff != NOD) {
+                _sharePlans = _sharePlans && _plan_backward_diff[ip]->is_same(_ref->_plan_backward_diff[ip]);
+            }
+        }
+    }
+    if (_sharePlans) {
+        _delete_plans(_plan_forward);
+        _delete_plans(_plan_backward);
+        if (_odiff != NOD) {
+            _delete_plans(_plan_backward_diff);
+        }
+        for (int ip = 0; ip < 3; ip++) {
+            _plan_forward[ip]  = _ref->_plan_forward[ip];
+            _plan_backward[ip] = _ref->_plan_backward[ip];
+            if (_odiff != NOD) {
+                _plan_backward_diff[ip] = _ref->_plan_backward_diff[ip];
+            }
+        }
+    }
+    if (_ref != NULL) {
+        FLUPS_INFO(">> created from a reference solver: topologies and switches %s, plans %s", _shareTopo ? "shared" : "recomputed", _sharePlans ? "shared" : "recomputed");
+    }
+
     //-------------------------------------------------------------------------
     /** - Get the factors #_normfact, #_volfact, #_shiftgreen */
     //-------------------------------------------------------------------------
@@ -222,6 +315,7 @@ Solver::Solver(Topology *topo, BoundaryType* rhsbc[3][2], const double h[3], con
  */
 double* Solver::setup(const bool changeTopoComm) {
     BEGIN_FUNC;
+    FLUPS_CHECK(_ref == NULL || _ref->_data != NULL, "the reference solver must be setup before this one", LOCATION);
     if (_prof != NULL) _prof->start("setup");
 
     //-------------------------------------------------------------------------
@@ -229,234 +323,430 @@ double* Solver::setup(const bool changeTopoComm) {
     //-------------------------------------------------------------------------
     
 #ifdef REORDER_RANKS
-    //-------------------------------------------------------------------------
-    /** - Precompute the communication graph */
-    //-------------------------------------------------------------------------
-    // get the communication size
-    int worldsize, rank;
-    MPI_Comm_size(_topo_phys->get_comm(), &worldsize);
-    MPI_Comm_rank(_topo_phys->get_comm(), &rank);
-    
-    // initialize the sources, sources weights, destination and destination weights
-    int* sources  = (int*)flups_malloc(worldsize * sizeof(int));
-    int* sourcesW = (int*)flups_malloc(worldsize * sizeof(int));
-    int* dests    = (int*)flups_malloc(worldsize * sizeof(int));
-    int* destsW   = (int*)flups_malloc(worldsize * sizeof(int));
-
-    //Preparing the graph:
-    // we setup the thing as if every node was to communicate with every other node
-    // the default communication weight is null
-    memset(sourcesW,0,sizeof(int)*worldsize);
-    memset(destsW,0,sizeof(int)*worldsize);
-    for(int i =0;i<worldsize;i++){
-        sources[i] = i;
-        dests[i] = i;
-    }
-
-    //Count the total number of edges for the switchtopos
-    // if we are not allowed to change the physical topology,
-    // do it only for the 2nd and 3rd switchtopo.
-    // These are the switches that we hope to optimize with the rank
-    // reordering. We do not account the 1st switchtopo because that
-    // one will be used to reach the optimized layout associated with
-    // the graph_comm, and it is thus very likely that the communication
-    // involved in the first switchtopo is a real all 2 all (with some
-    // ranks not having a self block) !
-    // if we can change the topology, do it for every swithTopo
-    if (changeTopoComm) {
+    if (_shareTopo) {
+        // the topologies have been reordered by the reference solver, only Green follows
         for (int i = 0; i < _ndim; i++) {
-            _switchtopo[i]->add_toGraph(sourcesW, destsW);
+            _topo_green[i]->change_comm(_topo_hat[i]->get_comm());
         }
     } else {
-        for (int i = 1; i < _ndim; i++) {
-            _switchtopo[i]->add_toGraph(sourcesW, destsW);
+        //-------------------------------------------------------------------------
+        /** - Precompute the communication graph */
+        //-------------------------------------------------------------------------
+        // get the communication size
+        int worldsize, rank;
+        MPI_Comm_size(_topo_phys->get_comm(), &worldsize);
+        MPI_Comm_rank(_topo_phys->get_comm(), &rank);
+    
+        // initialize the sources, sources weights, destination and destination weights
+        int* sources  = (int*)flups_malloc(worldsize * sizeof(int));
+        int* sourcesW = (int*)flups_malloc(worldsize * sizeof(int));
+        int* dests    = (int*)flups_malloc(worldsize * sizeof(int));
+        int* destsW   = (int*)flups_malloc(worldsize * sizeof(int));
+
+        //Preparing the graph:
+        // we setup the thing as if every node was to communicate with every other node
+        // the default communication weight is null
+        memset(sourcesW,0,sizeof(int)*worldsize);
+        memset(destsW,0,sizeof(int)*worldsize);
+        for(int i =0;i<worldsize;i++){
+            sources[i] = i;
+            dests[i] = i;
         }
-    }
 
-    //-------------------------------------------------------------------------
-    /** - Build the new comm based on that graph using metis if available, graph_topo if not */
-    //-------------------------------------------------------------------------
-    MPI_Comm graph_comm;
+        //Count the total number of edges for the switchtopos
+        // if we are not allowed to change the physical topology,
+        // do it only for the 2nd and 3rd switchtopo.
+        // These are the switches that we hope to optimize with the rank
+        // reordering. We do not account the 1st switchtopo because that
+        // one will be used to reach the optimized layout associated with
+        // the graph_comm, and it is thus very likely that the communication
+        // involved in the first switchtopo is a real all 2 all (with some
+        // ranks not having a self block) !
+        // if we can change the topology, do it for every swithTopo
+        if (changeTopoComm) {
+            for (int i = 0; i < _ndim; i++) {
+                _switchtopo[i]->add_toGraph(sourcesW, destsW);
+            }
+        } else {
+            for (int i = 1; i < _ndim; i++) {
+                _switchtopo[i]->add_toGraph(sourcesW, destsW);
+            }
+        }
+
+        //-------------------------------------------------------------------------
+        /** - Build the new comm based on that graph using metis if available, graph_topo if not */
+        //-------------------------------------------------------------------------
+        MPI_Comm graph_comm;
 #ifndef HAVE_METIS
-    MPI_Dist_graph_create_adjacent(_topo_phys->get_comm(), worldsize, sources, sourcesW,
-                                   worldsize, dests, destsW,
-                                   MPI_INFO_NULL, 1, &graph_comm);
+        MPI_Dist_graph_create_adjacent(_topo_phys->get_comm(), worldsize, sources, sourcesW,
+                                       worldsize, dests, destsW,
+                                       MPI_INFO_NULL, 1, &graph_comm);
 
 #if defined(VERBOSE) && VERBOSE == 2
-    int inD, outD, wei;
-    MPI_Dist_graph_neighbors_count(graph_comm, &inD, &outD, &wei);
-    printf("[FGRAPH] inD:%d outD:%d wei:%d\n", inD, outD, wei);
+        int inD, outD, wei;
+        MPI_Dist_graph_neighbors_count(graph_comm, &inD, &outD, &wei);
+        printf("[FGRAPH] inD:%d outD:%d wei:%d\n", inD, outD, wei);
 
-    int *Sour  = (int *)malloc(sizeof(int) * inD);
-    int *SourW = (int *)malloc(sizeof(int) * inD);
-    int *Dest  = (int *)malloc(sizeof(int) * outD);
-    int *DestW = (int *)malloc(sizeof(int) * outD);
+        int *Sour  = (int *)malloc(sizeof(int) * inD);
+        int *SourW = (int *)malloc(sizeof(int) * inD);
+        int *Dest  = (int *)malloc(sizeof(int) * outD);
+        int *DestW = (int *)malloc(sizeof(int) * outD);
 
-    MPI_Dist_graph_neighbors(graph_comm, inD, Sour, SourW,
-                             outD, Dest, DestW);
+        MPI_Dist_graph_neighbors(graph_comm, inD, Sour, SourW,
+                                 outD, Dest, DestW);
 
-    printf("[FGRAPH] INedges: ");
-    for (int i = 0; i < inD; i++) {
-        printf("%d (%d), ", Sour[i], SourW[i]);
-    }
-    printf("\n[FGRAPH] OUTedges: ");
-    for (int i = 0; i < outD; i++) {
-        printf("%d (%d), ", Dest[i], DestW[i]);
-    }
-    printf("\n");
+        printf("[FGRAPH] INedges: ");
+        for (int i = 0; i < inD; i++) {
+            printf("%d (%d), ", Sour[i], SourW[i]);
+        }
+        printf("\n[FGRAPH] OUTedges: ");
+        for (int i = 0; i < outD; i++) {
+            printf("%d (%d), ", Dest[i], DestW[i]);
+        }
+        printf("\n");
 
-    free(Sour);
-    free(SourW);
-    free(Dest);
-    free(DestW);
+        free(Sour);
+        free(SourW);
+        free(Dest);
+        free(DestW);
 #endif
 
-    //-------------------------------------------------------------------------
-    /** - if asked by the user, we overwrite the graph comm by a forced version (for test purpose) */
-    //-------------------------------------------------------------------------
+        //-------------------------------------------------------------------------
+        /** - if asked by the user, we overwrite the graph comm by a forced version (for test purpose) */
+        //-------------------------------------------------------------------------
 #ifdef DEV_SIMULATE_GRAPHCOMM
-    //switch indices by a random number:
-    #ifdef DEV_REORDER_SHIFT
-        int shift = DEV_REORDER_SHIFT;
-    #else
-        int shift = worldsize/2;
-    #endif
-
-    int* outRanks = (int*) flups_malloc(sizeof(int)*worldsize);
-    if(rank == 0){
-        FLUPS_INFO("SIMULATED GRAPH_COMM with shift = %d : REORDERING RANKS AS FOLLOWS",shift);
-    }
-    for (int i=0;i<worldsize;i++){
-        outRanks[i] = (i + shift)%worldsize;
+        //switch indices by a random number:
+        #ifdef DEV_REORDER_SHIFT
+            int shift = DEV_REORDER_SHIFT;
+        #else
+            int shift = worldsize/2;
+        #endif
+
+        int* outRanks = (int*) flups_malloc(sizeof(int)*worldsize);
         if(rank == 0){
-            FLUPS_INFO("old rank: %d \t new rank: %d",i,outRanks[i]);
+            FLUPS_INFO("SIMULATED GRAPH_COMM with shift = %d : REORDERING RANKS AS FOLLOWS",shift);
+        }
+        for (int i=0;i<worldsize;i++){
+            outRanks[i] = (i + shift)%worldsize;
+            if(rank == 0){
+                FLUPS_INFO("old rank: %d \t new rank: %d",i,outRanks[i]);
+            }
         }
-    }
     
-    MPI_Group group_in, group_out;
-    MPI_Comm_group(_topo_phys->get_comm(), &group_in);                //get the group of the current comm
-    MPI_Group_incl(group_in, worldsize, outRanks, &group_out);        //manually reorder the ranks
-    MPI_Comm_create(_topo_phys->get_comm(), group_out, &graph_comm);  // create the new comm
+        MPI_Group group_in, group_out;
+        MPI_Comm_group(_topo_phys->get_comm(), &group_in);                //get the group of the current comm
+        MPI_Group_incl(group_in, worldsize, outRanks, &group_out);        //manually reorder the ranks
+        MPI_Comm_create(_topo_phys->get_comm(), group_out, &graph_comm);  // create the new comm
 
-    flups_free(outRanks);
+        flups_free(outRanks);
 #endif
-//end simulate_graph
+    //end simulate_graph
 
-    #ifdef PROF
-    //writing reordering to console
-    int newrank;
-    MPI_Comm_rank(graph_comm, &newrank);
-    printf("[MPI ORDER] %i : %i \n", rank, newrank);
-    #endif
+        #ifdef PROF
+        //writing reordering to console
+        int newrank;
+        MPI_Comm_rank(graph_comm, &newrank);
+        printf("[MPI ORDER] %i : %i \n", rank, newrank);
+        #endif
 
 #else
-    //Use METIS to find a smart partition of the graph
-    int *order = (int *)flups_malloc(sizeof(int) * worldsize);
-    _reorder_metis(_topo_phys->get_comm(), sources, sourcesW, dests, destsW, order);
-    // create a new comm based on the order given by metis
-    MPI_Group group_in, group_out;
-    MPI_Comm_group(_topo_phys->get_comm(), &group_in);                //get the group of the current comm
-    MPI_Group_incl(group_in, worldsize, order, &group_out);           //manually reorder the ranks
-    MPI_Comm_create(_topo_phys->get_comm(), group_out, &graph_comm);  // create the new comm
-    flups_free(order);
+        //Use METIS to find a smart partition of the graph
+        int *order = (int *)flups_malloc(sizeof(int) * worldsize);
+        _reorder_metis(_topo_phys->get_comm(), sources, sourcesW, dests, destsW, order);
+        // create a new comm based on the order given by metis
+        MPI_Group group_in, group_out;
+        MPI_Comm_group(_topo_phys->get_comm(), &group_in);                //get the group of the current comm
+        MPI_Group_incl(group_in, worldsize, order, &group_out);           //manually reorder the ranks
+        MPI_Comm_create(_topo_phys->get_comm(), group_out, &graph_comm);  // create the new comm
+        flups_free(order);
 #endif // METIS
 
-    flups_free(sources);
-    flups_free(sourcesW);
-    flups_free(dests);
-    flups_free(destsW);
-
-    std::string commname = "graph_comm";
-    MPI_Comm_set_name(graph_comm, commname.c_str());
+        flups_free(sources);
+        flups_free(sourcesW);
+        flups_free(dests);
+        flups_free(destsW);
+
+        std::string commname = "graph_comm";
+        MPI_Comm_set_name(graph_comm, commname.c_str());
+
+        // Advise the topologies that they will be associated with an other comm
+        // if we cannot change topo phys, the _topo_phys remains without graph_comm.
+        // The first switch topo will serve to redistribute
+        // data following the optimized topology on the cluster, with reordered 
+        // ranks
+        for(int i=0;i<_ndim;i++){
+            _topo_hat[i]->change_comm(graph_comm);
+            _topo_green[i]->change_comm(graph_comm);
+        }
+        if(changeTopoComm){
+            _topo_phys->change_comm(graph_comm);
+        }
 
-    // Advise the topologies that they will be associated with an other comm
-    // if we cannot change topo phys, the _topo_phys remains without graph_comm.
-    // The first switch topo will serve to redistribute
-    // data following the optimized topology on the cluster, with reordered 
-    // ranks
-    for(int i=0;i<_ndim;i++){
-        _topo_hat[i]->change_comm(graph_comm);
-        _topo_green[i]->change_comm(graph_comm);
-    }
-    if(changeTopoComm){
-        _topo_phys->change_comm(graph_comm);
+        #ifdef PERF_VERBOSE
+        _topo_hat[0]->disp_rank();
+        #endif
     }
-
-    #ifdef PERF_VERBOSE
-    _topo_hat[0]->disp_rank();
-    #endif
-
 #endif //REORDER_RANKS
 
     //-------------------------------------------------------------------------
     /** In every cases, we do */
     //-------------------------------------------------------------------------
 
+    //-------------------------------------------------------------------------
+    /** - get the FFTW wisdom from rank 0 */
+    //-------------------------------------------------------------------------
+    _import_wisdom();
+
+    //-------------------------------------------------------------------------
+    /** - check if the Green's function can be evaluated on the fly */
+    //-------------------------------------------------------------------------
+    if (_greenMatrixFree) {
+        _init_greenMatrixFree(_plan_green);
+    }
+
     //-------------------------------------------------------------------------
     /** - allocate the data for the Green's function */
     //-------------------------------------------------------------------------
+    if (!_greenMatrixFree) {
+        if (_prof != NULL) _prof->start("alloc_data");
+        // allocate to the maximum size needed by all the topologies
+        _allocate_data(_topo_green, NULL, &_green);
+        if (_prof != NULL) _prof->stop("alloc_data");
+    }
+
+    //-------------------------------------------------------------------------
+    /** - compute the Green's function, its topologies, plans and switches are kept for update_green() */
+    //-------------------------------------------------------------------------
+    _setup_green();
+
+    //-------------------------------------------------------------------------
+    /** - allocate the data for the field */
+    //-------------------------------------------------------------------------
     if (_prof != NULL) _prof->start("alloc_data");
-    // allocate to the maximum size needed by all the topologies
-    _allocate_data(_topo_green, NULL, &_green);
+    if (_shareTopo) {
+        _data = _ref->_data;
+    } else {
+        _allocate_data(_topo_hat, _topo_phys, &_data);
+    }
     if (_prof != NULL) _prof->stop("alloc_data");
 
+    //-------------------------------------------------------------------------
+    /** - allocate the plans forward, forward_diff and backward for the field */
+    //-------------------------------------------------------------------------
+    if (_prof != NULL) _prof->start("alloc_plans");
+    if (!_sharePlans) {
+        FFTW_plan_dim** planmaps[3] = {_plan_forward, _plan_backward, _plan_backward_diff};
+        const int       nplanmap    = (_odiff != NOD) ? 3 : 2;
+        // without a wisdom file, rank 0 plans first and its wisdom is broadcast once, so that the other ranks only plan
+        // the transforms that differ from those of rank 0 (the wisdom is not worth sharing with FFTW_ESTIMATE)
+        const bool rank0First = (!_wisdomRead && _fftwFlag != FFTW_ESTIMATE);
+        int        rank;
+        MPI_Comm_rank(_topo_phys->get_comm(), &rank);
+        if (!rank0First || rank == 0) {
+            for (int im = 0; im < nplanmap; im++) {
+                _allocate_plans(_topo_hat, planmaps[im], _data);
+            }
+        }
+        if (rank0First) {
+            _bcast_wisdom();
+            if (rank != 0) {
+                for (int im = 0; im < nplanmap; im++) {
+                    _allocate_plans(_topo_hat, planmaps[im], _data);
+                }
+            }
+        }
+    }
+    if (_prof != NULL) _prof->stop("alloc_plans");
+
+    if (_shareTopo) {
+        // the switches are setup and linked to their buffers by the reference solver
+        _bufMemSize = _ref->_bufMemSize;
+    } else {
+        //-------------------------------------------------------------------------
+        /** - Change the communication pattern if asked, the switches of the dry run are not setup yet */
+        //-------------------------------------------------------------------------
+        if (_switchType == SWITCH_A2A || _switchType == SWITCH_NB || _switchType == SWITCH_NODE || _switchType == SWITCH_DT) {
+            _reset_switchTopo(_switchType, _prof);
+        }
+
+        //-------------------------------------------------------------------------
+        /** - Setup the SwitchTopo, this will take the latest comm into account */
+        //-------------------------------------------------------------------------
+        if (_switchType == SWITCH_AUTO) {
+            _autotune_switchTopo();
+        } else {
+            _allocate_switchTopo(_ndim, _switchtopo, &_sendBuf, &_recvBuf);
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    /** - gather the FFTW wisdom on rank 0 and store it if needed */
+    //-------------------------------------------------------------------------
+    _export_wisdom();
+
+    // the executions done during the setup (e.g. to tune the switches) are not counted
+    reset_commStats();
+
+    if (_prof != NULL) _prof->stop("setup");
+
+    FLUPS_INFO(">> convolution kernels: %s", magic_kernel_isa());
+    FLUPS_INFO(">>>>>>>>>> DONE WITH SOLVER INITIALIZATION <<<<<<<<<<");
+
+    END_FUNC;
+    return _data;
+}
+
+/**
+ * @brief compute the Green's function in #_green and bring it to the last topology of the field
+ * 
+ * The Green's function is read from #_greenCache if possible, otherwise it is computed using #_topo_green, #_plan_green
+ * and #_switchtopo_green. The plans and the switches are only setup the first time, so that update_green() reuses them.
+ * 
+ * @warning #_green must be allocated with the size required by #_topo_green (unless #_greenMatrixFree) and the Green topologies must be in their real state.
+ * On exit, the communication buffers are released.
+ */
+void Solver::_setup_green() {
+    BEGIN_FUNC;
     //-------------------------------------------------------------------------
     /** - allocate the plan and comnpute the Green's function */
     //-------------------------------------------------------------------------
     if (_prof != NULL) _prof->start("green");
-    if (_prof != NULL) _prof->start("green_plan");
-    _allocate_plans(_topo_green, _plan_green, _green);
-    if (_prof != NULL) _prof->stop("green_plan");
-    // setup the buffers for Green
-    _allocate_switchTopo(3, _switchtopo_green, &_sendBuf, &_recvBuf);
-    if (_prof != NULL) _prof->start("green_func");
-    _cmptGreenFunction(_topo_green, _green, _plan_green);
-    if (_prof != NULL) _prof->stop("green_func");
+    // try to read the Green's function in full spectral space from the cache
+    bool        isCached = false;
+    std::string greenKey = "";
+    if (!_greenCache.empty() && !_greenMatrixFree) {
+        // the topologies are in their final state once the Green's function has been transformed
+        for (int ip = 0; ip < _ndim; ip++) {
+            if (_plan_green[ip]->isr2c_doneByFFT()) {
+                _topo_green[ip]->switch2complex();
+            }
+        }
+        greenKey = _cmptGreenKey(_topo_green[_ndim - 1], _plan_green);
+        isCached = hdf5_read_cache(_topo_green[_ndim - 1], _greenCache, greenKey, _green);
+        // if not read, get back to the initial state to compute it
+        if (!isCached) {
+            for (int ip = 0; ip < _ndim; ip++) {
+                if (_plan_green[ip]->isr2c_doneByFFT()) {
+                    _topo_green[ip]->switch2real();
+                }
+            }
+        } else {
+            FLUPS_INFO(">> Green's function read from %s", _greenCache.c_str());
+        }
+    }
+    // setup the buffers for Green, the switches are setup only the first time
+    _allocate_switchTopo(3, _switchtopo_green, &_sendBuf, &_recvBuf, _greenSwitchReady);
+    _greenSwitchReady = true;
+    if (!isCached && !_greenMatrixFree) {
+        if (!_greenPlanned) {
+            if (_prof != NULL) _prof->start("green_plan");
+            _allocate_plans(_topo_green, _plan_green, _green);
+            if (_prof != NULL) _prof->stop("green_plan");
+            _greenPlanned = true;
+        }
+        if (_prof != NULL) _prof->start("green_func");
+        _cmptGreenFunction(_topo_green, _green, _plan_green);
+        if (_prof != NULL) _prof->stop("green_func");
+        // store it for the next runs
+        if (!_greenCache.empty()) {
+            hdf5_write_cache(_topo_green[_ndim - 1], _greenCache, greenKey, _green);
+        }
+    }
     // finalize green by replacing some data in full spectral if needed by the kernel,
     // and by doing a last switch to the field topo
     if (_prof != NULL) _prof->start("green_final");
-    _finalizeGreenFunction(_topo_hat[_ndim-1], _green, _topo_green[_ndim-1], _plan_green);
+    if (!_greenMatrixFree) {
+        _finalizeGreenFunction(_topo_hat[_ndim-1], _green, _topo_green[_ndim-1], _plan_green);
+        // reduce the memory of the Green's function if asked
+        _compactGreenFunction(_topo_green[_ndim-1], &_green);
+    }
     if (_prof != NULL) _prof->stop("green_final");
 
     //-------------------------------------------------------------------------
-    /** - Clean the Green's function accessories (allocated topo and plans) */
+    /** - Release the buffers of the Green's function, its topologies, plans and switches are kept for update_green() */
     //-------------------------------------------------------------------------
-    // delete the switchTopos and the plans if we allocated them
     _deallocate_switchTopo(_switchtopo_green, &_sendBuf, &_recvBuf);
-    _delete_switchtopos(_switchtopo_green);
-    _delete_topologies(_topo_green);
-    _delete_plans(_plan_green);
     if (_prof != NULL) _prof->stop("green");
+    END_FUNC;
+}
+
+/**
+ * @brief recompute the Green's function for a new kernel or regularization parameter, without setting up the solver again
+ * 
+ * The topologies, the switches and the plans of the field are not changed, and those of the Green's function set up by setup() are reused.
+ * Only the Green's function itself is computed again (see _setup_green()). If the Green's function is evaluated on the fly, only
+ * the parameters are changed.
+ * 
+ * @warning no split-phase solve can be in progress
+ * 
+ * @param type the new type of Green's function
+ * @param alpha the new regularization parameter of the HEJ kernels
+ */
+void Solver::update_green(const GreenType type, const double alpha) {
+    BEGIN_FUNC;
+    if (_data == NULL) {
+        FLUPS_ERROR("the solver must be setup before updating its Green's function", LOCATION);
+    }
+    if (_splitStage >= 0) {
+        FLUPS_ERROR("a split-phase solve is in progress, call solve_end() first", LOCATION);
+    }
+    _typeGreen  = type;
+    _alphaGreen = alpha;
+    if (_prof != NULL) _prof->start("update_green");
 
     //-------------------------------------------------------------------------
-    /** - allocate the data for the field */
+    /** - if evaluated on the fly, only check the kernel */
     //-------------------------------------------------------------------------
-    if (_prof != NULL) _prof->start("alloc_data");
-    _allocate_data(_topo_hat, _topo_phys, &_data);
-    if (_prof != NULL) _prof->stop("alloc_data");
+    if (_greenMatrixFree) {
+        _cmptGreenLength();
+        FLUPS_INFO(">> the Green's function of type %d is evaluated on the fly", _typeGreen);
+        if (_prof != NULL) _prof->stop("update_green");
+        END_FUNC;
+        return;
+    }
 
     //-------------------------------------------------------------------------
-    /** - allocate the plans forward, forward_diff and backward for the field */
+    /** - get back the Green topologies in their initial state and the full size array (it may have been compacted) */
     //-------------------------------------------------------------------------
-    if (_prof != NULL) _prof->start("alloc_plans");
-    _allocate_plans(_topo_hat, _plan_forward, _data);
-    _allocate_plans(_topo_hat, _plan_backward, _data);
-    if (_odiff != NOD) {
-        _allocate_plans(_topo_hat, _plan_backward_diff, _data);
+    for (int ip = 0; ip < _ndim; ip++) {
+        if (_plan_green[ip]->isr2c_doneByFFT()) {
+            _topo_green[ip]->switch2real();
+        }
     }
-    if (_prof != NULL) _prof->stop("alloc_plans");
+    flups_free(_green);
+    _green = NULL;
+    _allocate_data(_topo_green, NULL, &_green);
 
     //-------------------------------------------------------------------------
-    /** - Setup the SwitchTopo, this will take the latest comm into account */
+    /** - compute the new Green's function */
     //-------------------------------------------------------------------------
-    _allocate_switchTopo(_ndim, _switchtopo, &_sendBuf, &_recvBuf);
-
-    if (_prof != NULL) _prof->stop("setup");
+    _setup_green();
 
-    FLUPS_INFO(">>>>>>>>>> DONE WITH SOLVER INITIALIZATION <<<<<<<<<<");
+    //-------------------------------------------------------------------------
+    /** - link the switches of the field to the buffers again */
+    //-------------------------------------------------------------------------
+    if (_shareTopo) {
+        _bufMemSize = _ref->_bufMemSize;
+    } else {
+        _allocate_switchTopo(_ndim, _switchtopo, &_sendBuf, &_recvBuf, true);
+    }
+    if (_prof != NULL) _prof->stop("update_green");
+    END_FUNC;
+}
 
+/**
+ * @brief changes the screening parameter of a solver which has been setup, e.g. for the implicit diffusion at each stage of a time integration
+ * 
+ * The equation solved becomes (nabla^2 - kappa^2) u = f. As for update_green(), only the Green's function is computed again,
+ * or nothing is done if it is evaluated on the fly.
+ * 
+ * @param kappa the new screening parameter, 0 for the Poisson equation
+ */
+void Solver::update_kappa(const double kappa) {
+    BEGIN_FUNC;
+    _kappaGreen = kappa;
+    update_green(_typeGreen, _alphaGreen);
     END_FUNC;
-    return _data;
 }
 
 /**
@@ -465,32 +755,53 @@ double* Solver::setup(const bool changeTopoComm) {
  */
 Solver::~Solver() {
     BEGIN_FUNC;
+    if (_nderived > 0) {
+        FLUPS_ERROR("the %d solvers created from this one must be destroyed first", _nderived, LOCATION);
+    }
+    if (_splitStage >= 0) {
+        FLUPS_ERROR("a split-phase solve is still in progress, call solve_end() first", LOCATION);
+    }
     // for Green
     if (_green != NULL) flups_free(_green);
+    if (_greenBuf != NULL) flups_free(_greenBuf);
+    _delete_switchtopos(_switchtopo_green);
+    _delete_topologies(_topo_green);
+    _delete_plans(_plan_green);
     // delete the plans
-    _delete_plans(_plan_forward);
-    _delete_plans(_plan_backward);
-    if(_odiff != NOD){
-        _delete_plans(_plan_backward_diff);
+    if (!_sharePlans) {
+        _delete_plans(_plan_forward);
+        _delete_plans(_plan_backward);
+        if (_odiff != NOD) {
+            _delete_plans(_plan_backward_diff);
+        }
     }
-    
-    // free the sendBuf,recvBuf
-    _deallocate_switchTopo(_switchtopo, &_sendBuf, &_recvBuf);
-    // deallocate the swithTopo
-    _delete_switchtopos(_switchtopo);
 
-    // cleanup the communicator if any
+    if (!_shareTopo) {
+        // free the sendBuf,recvBuf
+        _deallocate_switchTopo(_switchtopo, &_sendBuf, &_recvBuf);
+        // deallocate the swithTopo
+        _delete_switchtopos(_switchtopo);
+
+        // cleanup the communicator if any
 #ifdef REORDER_RANKS
-    MPI_Comm mycomm = _topo_hat[_ndim-1]->get_comm();
-    MPI_Comm_free(&mycomm);
+        MPI_Comm mycomm = _topo_hat[_ndim-1]->get_comm();
+        MPI_Comm_free(&mycomm);
 #endif
-    _delete_topologies(_topo_hat);
-    
-    if (_data != NULL) flups_free(_data);
+        _delete_topologies(_topo_hat);
+
+        if (_data != NULL) flups_free(_data);
+    }
+    BufferPool::remove_user(_poolId);
+    if (_ref != NULL) {
+        _ref->_nderived--;
+    }
 
-    //cleanup
-    fftw_cleanup_threads();
-    fftw_cleanup();
+    //cleanup, only once the last solver is gone since the others still use their plans
+    _nalive--;
+    if (_nalive == 0) {
+        fftw_cleanup_threads();
+        fftw_cleanup();
+    }
 
     END_FUNC;
 }
@@ -526,6 +837,120 @@ void Solver::_delete_plans(FFTW_plan_dim *planmap[3]) {
     END_FUNC;
 }
 
+/**
+ * @brief import the FFTW wisdom on rank 0 from #_wisdomFile (if any) and broadcast it to every rank
+ * 
+ * The plans which are the same on every rank are then not computed again.
+ * If there is no wisdom to read, rank 0 computes the plans of the field first and broadcasts its wisdom before the other ranks compute theirs (see setup()).
+ */
+void Solver::_import_wisdom() {
+    BEGIN_FUNC;
+    MPI_Comm comm = _topo_phys->get_comm();
+    int      rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // read the file on rank 0
+    int isRead = 0;
+    if (rank == 0 && !_wisdomFile.empty()) {
+        isRead = fftw_import_wisdom_from_filename(_wisdomFile.c_str());
+        if (isRead) {
+            FLUPS_INFO(">> FFTW wisdom read from %s", _wisdomFile.c_str());
+        } else {
+            FLUPS_INFO(">> unable to read the FFTW wisdom from %s", _wisdomFile.c_str());
+        }
+    }
+    MPI_Bcast(&isRead, 1, MPI_INT, 0, comm);
+    _wisdomRead = isRead;
+    if (_wisdomRead) {
+        _bcast_wisdom();
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief broadcast the FFTW wisdom of rank 0 and import it on the other ranks
+ */
+void Solver::_bcast_wisdom() {
+    BEGIN_FUNC;
+    MPI_Comm comm = _topo_phys->get_comm();
+    int      rank;
+    MPI_Comm_rank(comm, &rank);
+
+    char* wisdom = NULL;
+    int   len    = 0;
+    if (rank == 0) {
+        wisdom = fftw_export_wisdom_to_string();
+        len    = strlen(wisdom) + 1;
+    }
+    MPI_Bcast(&len, 1, MPI_INT, 0, comm);
+    if (rank != 0) {
+        wisdom = (char*)malloc(len * sizeof(char));
+    }
+    MPI_Bcast(wisdom, len, MPI_CHAR, 0, comm);
+    if (rank != 0) {
+        // the wisdom only speeds up the planning, the plans are computed without it otherwise
+        const int err = fftw_import_wisdom_from_string(wisdom);
+        if (err == 0) {
+            FLUPS_WARNING("unable to import the FFTW wisdom from rank 0, the plans are computed without it", LOCATION);
+        }
+    }
+    // the string from FFTW has to be freed using free
+    free(wisdom);
+    END_FUNC;
+}
+
+/**
+ * @brief gather the FFTW wisdom of every rank on rank 0 and write it to #_wisdomFile (if any)
+ */
+void Solver::_export_wisdom() {
+    BEGIN_FUNC;
+    if (_wisdomFile.empty()) {
+        END_FUNC;
+        return;
+    }
+    MPI_Comm comm = _topo_phys->get_comm();
+    int      rank, comm_size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &comm_size);
+
+    // gather the size of the wisdom of every rank
+    char*     wisdom = fftw_export_wisdom_to_string();
+    const int len    = strlen(wisdom) + 1;
+    int*      count  = NULL;
+    int*      start  = NULL;
+    char*     all    = NULL;
+    if (rank == 0) {
+        count = (int*)flups_malloc(comm_size * sizeof(int));
+        start = (int*)flups_malloc(comm_size * sizeof(int));
+    }
+    MPI_Gather(&len, 1, MPI_INT, count, 1, MPI_INT, 0, comm);
+    if (rank == 0) {
+        start[0] = 0;
+        for (int ir = 1; ir < comm_size; ir++) {
+            start[ir] = start[ir - 1] + count[ir - 1];
+        }
+        all = (char*)flups_malloc((start[comm_size - 1] + count[comm_size - 1]) * sizeof(char));
+    }
+    // gather the wisdoms, rank 0 merges them and writes the file
+    MPI_Gatherv(wisdom, len, MPI_CHAR, all, count, start, MPI_CHAR, 0, comm);
+    if (rank == 0) {
+        for (int ir = 1; ir < comm_size; ir++) {
+            fftw_import_wisdom_from_string(all + start[ir]);
+        }
+        const int err = fftw_export_wisdom_to_filename(_wisdomFile.c_str());
+        if (err) {
+            FLUPS_INFO(">> FFTW wisdom written to %s", _wisdomFile.c_str());
+        } else {
+            FLUPS_WARNING("unable to write the FFTW wisdom to %s", _wisdomFile.c_str(), LOCATION);
+        }
+        flups_free(count);
+        flups_free(start);
+        flups_free(all);
+    }
+    free(wisdom);
+    END_FUNC;
+}
+
 /**
  * @brief delete the switchtopo objects
  * 
@@ -556,6 +981,35 @@ void Solver::_delete_topologies(Topology *topo[3]) {
     END_FUNC;
 }
 
+/**
+ * @brief in 2D, start with the direction in which the physical topology is not distributed, if the order of the transforms allows it
+ * 
+ * The first switch then keeps the data on the rank, so that a solve needs a single transpose between the two pencils.
+ * The plans must have been sorted by _sort_plans() first. The swap is applied to the forward, backward and Green's plans.
+ * 
+ * @param topo the physical topology
+ */
+void Solver::_sort_plans2D(const Topology *topo) {
+    BEGIN_FUNC;
+    // only in 2D, when the two directions can be done in any order
+    const bool is2D   = (_plan_forward[2]->type() == FFTW_plan_dim::EMPTY) && (_plan_forward[1]->type() != FFTW_plan_dim::EMPTY);
+    bool       isSwap = is2D && (_plan_forward[0]->type() == _plan_forward[1]->type()) && (topo->nproc(_plan_forward[0]->dimID()) > 1) && (topo->nproc(_plan_forward[1]->dimID()) == 1);
+    // the field and the Green's function must keep the same order, the swap is only done if it is allowed for every set of plans
+    FFTW_plan_dim **plans[3] = {_plan_forward, _plan_backward, _plan_green};
+    for (int i = 0; i < 3; i++) {
+        isSwap = isSwap && (plans[i][0]->type() == plans[i][1]->type()) && (plans[i][0]->dimID() == _plan_forward[0]->dimID());
+    }
+    if (isSwap) {
+        for (int i = 0; i < 3; i++) {
+            FFTW_plan_dim *temp_plan = plans[i][0];
+            plans[i][0]              = plans[i][1];
+            plans[i][1]              = temp_plan;
+        }
+        FLUPS_INFO("2D: the direction %d is done first since the physical topology is not distributed in it", _plan_forward[0]->dimID());
+    }
+    END_FUNC;
+}
+
 /**
  * @brief smartly determines in which order the FFTs will be executed
  * 
@@ -646,6 +1100,22 @@ void Solver::_init_plansAndTopos(const Topology *topo, Topology *topomap[3], Swi
     //-------------------------------------------------------------------------
     bool isComplex = false;  //this refers to the "current state" of the data during dry run
     int  nproc[3];
+
+    //-------------------------------------------------------------------------
+    /** - In slab mode, the two first topologies are only distributed along the last direction of the transforms
+     *    and the last one along the second direction. The switch between the two first topologies then stays on the rank.
+     *    We need enough points in these directions to give some to every rank, the r2c transform possibly halving them. */
+    //-------------------------------------------------------------------------
+    if (!isGreen && topomap != NULL && switchtopo != NULL) {
+        _isSlab = false;
+        if (_ndim == 3 && topo->decompType() == DECOMP_SLAB) {
+            _isSlab = (topo->nglob(dimOrder[2]) >= comm_size) && (topo->nglob(dimOrder[1]) / 2 + 1 >= comm_size);
+            if (!_isSlab) {
+                FLUPS_WARNING("not enough points (%d and %d) for a slab decomposition on %d ranks, I use pencils instead.", topo->nglob(dimOrder[2]), topo->nglob(dimOrder[1]), comm_size, LOCATION);
+            }
+        }
+    }
+
     for (int ip = 0; ip < _ndim; ip++) {
         // initialize the plan (for Green only, using info from _plan_forward)
         planmap[ip]->init(size_tmp, isComplex);
@@ -661,12 +1131,16 @@ void Solver::_init_plansAndTopos(const Topology *topo, Topology *topomap[3], Swi
             // determines the proc repartition using the previous one if available
             if (ip == 0) {
                 // for the first switchTopo, we keep the number of proc constant in the 3rd direction
-                const int nproc_hint[3] = {topo->nproc(0), topo->nproc(1), topo->nproc(2)};
-                pencil_nproc_hint(dimID, nproc, comm_size, dimOrder[1], nproc_hint);
+                // (or we put all of them in the 3rd direction for a slab)
+                int nproc_hint[3] = {topo->nproc(0), topo->nproc(1), topo->nproc(2)};
+                if (_isSlab) {
+                    nproc_hint[dimOrder[2]] = comm_size;
+                }
+                pencil_nproc_hint(dimID, nproc, comm_size, dimOrder[1], nproc_hint, _ndim, _isSlab);
             } else {
                 const int nproc_hint[3] = {current_topo->nproc(0), current_topo->nproc(1), current_topo->nproc(2)};
                 // for the other switchtopos, we keep constant the id that is not mine, neither the old topo id
-                pencil_nproc_hint(dimID, nproc, comm_size, planmap[ip - 1]->dimID(), nproc_hint);
+                pencil_nproc_hint(dimID, nproc, comm_size, planmap[ip - 1]->dimID(), nproc_hint, _ndim, _isSlab);
             }
             // create the new topology corresponding to planmap[ip] in the output layout (size and isComplex)
             topomap[ip] = new Topology(dimID, _lda, size_tmp, nproc, isComplex, dimOrder, _fftwalignment, _topo_phys->get_comm());
@@ -674,24 +1148,20 @@ void Solver::_init_plansAndTopos(const Topology *topo, Topology *topomap[3], Swi
             // There are cases (typically for MIXUNB) where the data after being switched starts with an offset in memory in the new topo.
             int fieldstart[3] = {0};
             planmap[ip]->get_fieldstart(fieldstart);
+            // store it in case we need to create the switch again
+            for (int id = 0; id < 3; id++) {
+                _switchShift[ip][id] = fieldstart[id];
+            }
             // compute the Switch between the current topo (the one from which we come) and the new one (the one we just created).
             // if the topo was real before the plan and is now complex
             if (planmap[ip]->isr2c()) {
                 topomap[ip]->switch2real();
-#if defined(COMM_NONBLOCK)
-                switchtopo[ip] = new SwitchTopo_nb(current_topo, topomap[ip], fieldstart, _prof);
-#else
-                switchtopo[ip] = new SwitchTopo_a2a(current_topo, topomap[ip], fieldstart, _prof);
-#endif
+                switchtopo[ip] = _new_switchTopo(current_topo, topomap[ip], fieldstart, _prof, SWITCH_DEFAULT);
                 topomap[ip]->switch2complex();
 
             } else {
                 // create the switchtopoMPI to change topology
-#if defined(COMM_NONBLOCK)
-                switchtopo[ip] = new SwitchTopo_nb(current_topo, topomap[ip], fieldstart, _prof);
-#else
-                switchtopo[ip] = new SwitchTopo_a2a(current_topo, topomap[ip], fieldstart, _prof);
-#endif
+                switchtopo[ip] = _new_switchTopo(current_topo, topomap[ip], fieldstart, _prof, SWITCH_DEFAULT);
             }
             // #ifdef PERF_VERBOSE
             // switchtopo[ip]->disp_rankgraph(ip - 1, ip);
@@ -730,7 +1200,7 @@ void Solver::_init_plansAndTopos(const Topology *topo, Topology *topomap[3], Swi
                 }
             }else{
                 const int nproc_hint[3] = {current_topo->nproc(0), current_topo->nproc(1), current_topo->nproc(2)};
-                pencil_nproc_hint(dimID, nproc, comm_size, planmap[ip+1]->dimID(), nproc_hint);
+                pencil_nproc_hint(dimID, nproc, comm_size, planmap[ip+1]->dimID(), nproc_hint, _ndim, _isSlab);
             }
 
             // create the new topology in the output layout (size and isComplex). lda of Green is always 1.
@@ -742,11 +1212,7 @@ void Solver::_init_plansAndTopos(const Topology *topo, Topology *topomap[3], Swi
                 // it shouldn't be different from 0 for this case since we are doing green, but safety first
                 planmap[ip + 1]->get_fieldstart(fieldstart);
                 // we do the link between topomap[ip] and the current_topo
-#if defined(COMM_NONBLOCK)
-                switchtopo[ip + 1] = new SwitchTopo_nb(topomap[ip], current_topo, fieldstart, NULL);
-#else
-                switchtopo[ip + 1] = new SwitchTopo_a2a(topomap[ip], current_topo, fieldstart, NULL);
-#endif
+                switchtopo[ip + 1] = _new_switchTopo(topomap[ip], current_topo, fieldstart, NULL, SWITCH_DEFAULT);
                 switchtopo[ip + 1]->disp();
             }
 
@@ -787,55 +1253,257 @@ void Solver::_init_plansAndTopos(const Topology *topo, Topology *topomap[3], Swi
 }
 
 /**
- * @brief 
+ * @brief setup the switches and associate them to the communication buffers
  * 
- * @param ntopo 
- * @param switchtopo 
- * @param send_buff 
- * @param recv_buff 
+ * The buffers are stored in the scratch given by the user if it is large enough (see set_commScratch()),
+ * and in the BufferPool shared by all the solvers otherwise.
+ * The switches which allocate their own buffers (see SwitchTopo::ownBuffers()) are not counted, and no buffer is used if there are only such switches.
+ * 
+ * @param ntopo the number of switches
+ * @param switchtopo the switches
+ * @param send_buff the send buffer, does not own the memory
+ * @param recv_buff the recv buffer, does not own the memory
+ * @param isSetup if true, the switches have already been setup and they are only associated to the buffers
  */
-void Solver::_allocate_switchTopo(const int ntopo, SwitchTopo **switchtopo, opt_double_ptr *send_buff, opt_double_ptr *recv_buff) {
+void Solver::_allocate_switchTopo(const int ntopo, SwitchTopo **switchtopo, opt_double_ptr *send_buff, opt_double_ptr *recv_buff, const bool isSetup) {
     BEGIN_FUNC;
     size_t max_mem = 0;
 
     // setup the communication. During this step, the size of the buffers required by each switchtopo might change.
     for (int id = 0; id < ntopo; id++) {
-        if (switchtopo[id] != NULL){
+        if (switchtopo[id] != NULL && !isSetup){
             switchtopo[id]->setup();
             FLUPS_INFO("--------------- switchtopo %d set up ----------",id);
         } 
     }
 
-    //get the maximum size required for the buffers
+    //get the maximum size required for the buffers, the switches allocating their own buffers are not pooled
+    bool hasSwitch = false;
     for (int id = 0; id < ntopo; id++) {
-        if (switchtopo[id] != NULL) {
-            max_mem = std::max(max_mem, switchtopo[id]->get_bufMemSize());
+        if (switchtopo[id] != NULL && !switchtopo[id]->ownBuffers()) {
+            max_mem   = std::max(max_mem, switchtopo[id]->get_bufMemSize());
+            hasSwitch = true;
         }
     }
-    FLUPS_CHECK(max_mem > 0, "number of memory %d should be >0", max_mem, LOCATION);
-
-    *send_buff = (opt_double_ptr)flups_malloc(max_mem * sizeof(double));
-    *recv_buff = (opt_double_ptr)flups_malloc(max_mem * sizeof(double));
-    std::memset(*send_buff, 0, max_mem * sizeof(double));
-    std::memset(*recv_buff, 0, max_mem * sizeof(double));
+    FLUPS_CHECK(!hasSwitch || max_mem > 0, "number of memory %d should be >0", max_mem, LOCATION);
+
+    _bufMemSize = max_mem;
+
+    const size_t scratch_mem = BufferPool::memsize(max_mem);
+    if (!hasSwitch) {
+        BufferPool::request(_poolId, 0);
+        *send_buff  = NULL;
+        *recv_buff  = NULL;
+        _useScratch = false;
+    } else if (_scratch != NULL && _scratchSize >= scratch_mem && FLUPS_ISALIGNED(_scratch)) {
+        BufferPool::request(_poolId, 0);
+        *send_buff  = _scratch;
+        *recv_buff  = _scratch + scratch_mem / 2;
+        _useScratch = true;
+    } else {
+        if (_scratch != NULL) {
+            FLUPS_WARNING("the scratch is too small (%ld < %ld doubles) or not aligned, I use the communication pool", _scratchSize, scratch_mem, LOCATION);
+        }
+        BufferPool::check_access(_poolId);
+        BufferPool::request(_poolId, max_mem);
+        *send_buff  = BufferPool::sendBuf();
+        *recv_buff  = BufferPool::recvBuf();
+        _useScratch = false;
+    }
+    _poolGeneration = BufferPool::generation();
+    if (hasSwitch) {
+        flups_first_touch(*send_buff, max_mem);
+        flups_first_touch(*recv_buff, max_mem);
+    }
 
     // associate the buffers to the switchtopo
     for (int id = 0; id < ntopo; id++) {
         if (switchtopo[id] != NULL){
+            switchtopo[id]->set_fftwFlag(_fftwFlag);
             switchtopo[id]->setup_buffers(*send_buff, *recv_buff);
         } 
     }
     END_FUNC;
 }
+/**
+ * @brief creates a new SwitchTopo with the given communication pattern
+ * 
+ * @param topo_in the input topology
+ * @param topo_out the output topology
+ * @param shift the shift in memory, see SwitchTopo
+ * @param prof the profiler
+ * @param type the communication pattern, SWITCH_DEFAULT and SWITCH_AUTO give the pattern chosen at compilation
+ * @return SwitchTopo* 
+ */
+SwitchTopo* Solver::_new_switchTopo(const Topology *topo_in, const Topology *topo_out, const int shift[3], Profiler *prof, const FLUPS_SwitchType type) {
+    BEGIN_FUNC;
+    SwitchTopo* switchtopo = NULL;
+#if defined(COMM_NONBLOCK)
+    const bool isNonBlocking = (type != SWITCH_A2A);
+#else
+    const bool isNonBlocking = (type == SWITCH_NB);
+#endif
+    if (type == SWITCH_NODE) {
+        switchtopo = new SwitchTopo_node(topo_in, topo_out, shift, prof);
+    } else if (type == SWITCH_DT) {
+        switchtopo = new SwitchTopo_dt(topo_in, topo_out, shift, prof);
+    } else if (isNonBlocking) {
+        switchtopo = new SwitchTopo_nb(topo_in, topo_out, shift, prof);
+    } else {
+        switchtopo = new SwitchTopo_a2a(topo_in, topo_out, shift, prof);
+    }
+    END_FUNC;
+    return switchtopo;
+}
+
+/**
+ * @brief replaces the SwitchTopo of the field with new ones using the given communication pattern
+ * 
+ * The topologies are put in the same state as during the dry run in order to create the switches: the output topology is in its state before
+ * the plan is executed and the input one in its state after the previous plan.
+ * The new switches are not setup (see _allocate_switchTopo()).
+ * 
+ * @warning the buffers of the former switches must have been freed if they were setup.
+ * 
+ * @param type the communication pattern
+ * @param prof the profiler given to the switches
+ */
+void Solver::_reset_switchTopo(const FLUPS_SwitchType type, Profiler *prof) {
+    BEGIN_FUNC;
+    _delete_switchtopos(_switchtopo);
+    for (int ip = 0; ip < _ndim; ip++) {
+        const Topology* current_topo = (ip == 0) ? _topo_phys : _topo_hat[ip - 1];
+        _switchtopo[ip]              = _new_switchTopo(current_topo, _topo_hat[ip], _switchShift[ip], prof, type);
+        if (_plan_forward[ip]->isr2c()) {
+            _topo_hat[ip]->switch2complex();
+        }
+    }
+    // reset the topologies in their state before the plan
+    for (int ip = 0; ip < _ndim; ip++) {
+        if (_plan_forward[ip]->isr2c()) {
+            _topo_hat[ip]->switch2real();
+        }
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief times the all-to-all, the non-blocking, the node-aware and the derived datatypes switches on a few forward and backward FFTs and keeps the fastest one
+ * 
+ * Every candidate is setup once: the fastest switches so far are kept aside while the next candidate is tested, and the winner is only linked
+ * to the buffers again at the end.
+ * The time measured is the maximum over the ranks so that every rank takes the same decision.
+ */
+void Solver::_autotune_switchTopo() {
+    BEGIN_FUNC;
+    const int              ntest     = 3;
+    const int              ntype     = 4;
+    const FLUPS_SwitchType types[4]  = {SWITCH_A2A, SWITCH_NB, SWITCH_NODE, SWITCH_DT};
+    double                 timing[4] = {0.0, 0.0, 0.0, 0.0};
+
+    MPI_Comm comm = _topo_phys->get_comm();
+    // the profiler is not used during the test
+    Profiler* prof = _prof;
+    _prof          = NULL;
+
+    int         best          = -1;
+    SwitchTopo* bestSwitch[3] = {NULL, NULL, NULL};
+    for (int it = 0; it < ntype; it++) {
+        _deallocate_switchTopo(_switchtopo, &_sendBuf, &_recvBuf);
+        // keep the fastest switches so far, the other ones are deleted
+        if (best == it - 1 && it > 0) {
+            _delete_switchtopos(bestSwitch);
+            for (int ip = 0; ip < 3; ip++) {
+                bestSwitch[ip]  = _switchtopo[ip];
+                _switchtopo[ip] = NULL;
+            }
+        }
+        // the switches get the profiler to create their timers, which are only used by the winner
+        _reset_switchTopo(types[it], prof);
+        for (int ip = 0; ip < _ndim; ip++) {
+            _switchtopo[ip]->set_prof(NULL);
+        }
+        _allocate_switchTopo(_ndim, _switchtopo, &_sendBuf, &_recvBuf);
+
+        std::memset(_data, 0, sizeof(double) * get_allocSize());
+        // warm up
+        do_FFT(_data, FLUPS_FORWARD);
+        do_FFT(_data, FLUPS_BACKWARD);
+        // time it
+        MPI_Barrier(comm);
+        const double t0 = MPI_Wtime();
+        for (int itest = 0; itest < ntest; itest++) {
+            do_FFT(_data, FLUPS_FORWARD);
+            do_FFT(_data, FLUPS_BACKWARD);
+        }
+        const double t1 = MPI_Wtime() - t0;
+        MPI_Allreduce(&t1, &timing[it], 1, MPI_DOUBLE, MPI_MAX, comm);
+        best = (best < 0 || timing[it] < timing[best]) ? it : best;
+    }
+    _prof = prof;
+    FLUPS_INFO(">> autotune of the switches: a2a = %f [s] vs nb = %f [s] vs node = %f [s] vs dt = %f [s]", timing[0] / ntest, timing[1] / ntest, timing[2] / ntest, timing[3] / ntest);
+
+    // put the winner back if it is not the last candidate, its setup is kept and it is only linked to the buffers
+    if (best != ntype - 1) {
+        _deallocate_switchTopo(_switchtopo, &_sendBuf, &_recvBuf);
+        _delete_switchtopos(_switchtopo);
+        for (int ip = 0; ip < 3; ip++) {
+            _switchtopo[ip] = bestSwitch[ip];
+            bestSwitch[ip]  = NULL;
+        }
+        _allocate_switchTopo(_ndim, _switchtopo, &_sendBuf, &_recvBuf, true);
+    } else {
+        _delete_switchtopos(bestSwitch);
+    }
+    for (int ip = 0; ip < _ndim; ip++) {
+        _switchtopo[ip]->set_prof(_prof);
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief release the communication buffers of the switches
+ * 
+ * The request to the BufferPool is released, which frees or shrinks the pool if no other solver needs it.
+ * 
+ * @param switchtopo the switches
+ * @param send_buff the send buffer
+ * @param recv_buff the recv buffer
+ */
 void Solver::_deallocate_switchTopo(SwitchTopo **switchtopo, opt_double_ptr *send_buff, opt_double_ptr *recv_buff) {
-    if (*send_buff != NULL) {
-        flups_free(*send_buff);
-        (*send_buff) = NULL;
+    BufferPool::request(_poolId, 0);
+    (*send_buff)    = NULL;
+    (*recv_buff)    = NULL;
+    _useScratch     = false;
+    _poolGeneration = -1;
+}
+
+/**
+ * @brief associate the switches to the new buffers if the BufferPool has been reallocated by another solver
+ * 
+ * If the switches are shared with the reference solver, it links them instead.
+ */
+void Solver::_relink_switchTopo() {
+    // the buffers of the pool may be in use by the split-phase solve of another solver
+    if (_usePool()) BufferPool::check_access(_poolId);
+    if (_shareTopo) {
+        _ref->_relink_switchTopo();
+        return;
     }
-    if (*recv_buff != NULL) {
-        flups_free(*recv_buff);
-        (*recv_buff) = NULL;
+    if (_useScratch || _sendBuf == NULL || _poolGeneration == BufferPool::generation()) {
+        return;
     }
+    BEGIN_FUNC;
+    FLUPS_INFO(">> the communication pool has changed, linking the switches to the new buffers");
+    _sendBuf = BufferPool::sendBuf();
+    _recvBuf = BufferPool::recvBuf();
+    for (int id = 0; id < _ndim; id++) {
+        if (_switchtopo[id] != NULL) {
+            _switchtopo[id]->setup_buffers(_sendBuf, _recvBuf);
+        }
+    }
+    _poolGeneration = BufferPool::generation();
+    END_FUNC;
 }
 
 /**
@@ -848,7 +1516,7 @@ void Solver::_deallocate_switchTopo(SwitchTopo **switchtopo, opt_double_ptr *sen
 void Solver::_allocate_plans(const Topology *const topo[3], FFTW_plan_dim *planmap[3], double *data) {
     BEGIN_FUNC;
     for (int ip = 0; ip < _ndim; ip++) {
-        planmap[ip]->allocate_plan(topo[ip], data);
+        planmap[ip]->allocate_plan(topo[ip], data, _fftwFlag);
     }
     END_FUNC;
 }
@@ -882,7 +1550,8 @@ void Solver::_allocate_data(const Topology *const topo[3], const Topology *topo_
     FLUPS_INFO_3("Complex memory allocation, size = %ld", size_tot);
     (*data) = (double *)flups_malloc(size_tot * sizeof(double));
 
-    std::memset(*data, 0, size_tot * sizeof(double));
+    // the first touch places the pages close to the threads of the compute loops
+    flups_first_touch(*data, size_tot);
 
     //-------------------------------------------------------------------------
     /** - Check memory alignement */
@@ -916,14 +1585,7 @@ void Solver:: _cmptGreenFunction(Topology *topo[3], double *green, FFTW_plan_dim
     double kfact[3]      = {0.0, 0.0, 0.0};  // multiply the index by this factor to obtain the wave number (1/2/3 corresponds to x/y/z )
     double koffset[3]    = {0.0, 0.0, 0.0};  // add this to the index to obtain the wave number (1/2/3 corresponds to x/y/z )
     double symstart[3]   = {0.0, 0.0, 0.0};
-    double kernelLength  = _alphaGreen * _hgrid[0];  //the kernel length scale of the HEJ kernels (smoothing for regularization or spectral normalization h/pi)
-    if (_typeGreen == HEJ_0) {
-        kernelLength = _hgrid[0]/M_PI;
-    }
-
-    if ((_typeGreen == HEJ_2 || _typeGreen == HEJ_4 || _typeGreen == HEJ_6 || _typeGreen == HEJ_8 || _typeGreen == HEJ_10 || _typeGreen == HEJ_0 || _typeGreen == LGF_2) && ((_ndim == 3 && (_hgrid[0] != _hgrid[1] || _hgrid[1] != _hgrid[2])) || (_ndim == 2 && _hgrid[0] != _hgrid[1]))) {
-        FLUPS_ERROR("You are trying to use a regularized kernel or a LGF while not having dx=dy=dz.", LOCATION);
-    }
+    double kernelLength  = _cmptGreenLength();  //the kernel length scale of the HEJ kernels (smoothing for regularization or spectral normalization h/pi)
 
     // get the info + determine which green function to use:
     for (int ip = 0; ip < _ndim; ip++) {
@@ -960,17 +1622,17 @@ void Solver:: _cmptGreenFunction(Topology *topo[3], double *green, FFTW_plan_dim
     int n_unbounded = _ndim - nbr_spectral;
     if ((n_unbounded) == 3) {
         FLUPS_INFO(">> using Green function type %d on 3 dir unbounded", _typeGreen);
-        cmpt_Green_3dirunbounded(topo[0], hfact, symstart, green, _typeGreen, kernelLength);
+        cmpt_Green_3dirunbounded(topo[0], hfact, symstart, green, _typeGreen, kernelLength, _kappaGreen);
     } else if ((n_unbounded) == 2) {
         FLUPS_CHECK(!(_typeGreen == LGF_2 && nbr_spectral == 1), "You cannot use LGF with one spectral direction!!", LOCATION);
         FLUPS_INFO(">> using Green function of type %d on 2 dir unbounded", _typeGreen);
-        cmpt_Green_2dirunbounded(topo[0], hfact, kfact, koffset, symstart, green, _typeGreen, kernelLength);
+        cmpt_Green_2dirunbounded(topo[0], hfact, kfact, koffset, symstart, green, _typeGreen, kernelLength, _kappaGreen);
     } else if ((n_unbounded) == 1) {
         FLUPS_INFO(">> using Green function of type %d on 1 dir unbounded", _typeGreen);
-        cmpt_Green_1dirunbounded(topo[0], hfact, kfact, koffset, symstart, green, _typeGreen, kernelLength);
+        cmpt_Green_1dirunbounded(topo[0], hfact, kfact, koffset, symstart, green, _typeGreen, kernelLength, _kappaGreen);
     } else if ((n_unbounded) == 0) {
         FLUPS_INFO(">> using Green function of type %d on 3 dir spectral", _typeGreen);
-        cmpt_Green_0dirunbounded(topo[0], _hgrid[0], kfact, koffset, symstart, green, _typeGreen, kernelLength);
+        cmpt_Green_0dirunbounded(topo[0], _hgrid[0], kfact, koffset, symstart, green, _typeGreen, kernelLength, _kappaGreen);
     }
     // else {
     //     FLUPS_ERROR("Sorry, the number of unbounded directions does not match: %d = %d - %d", n_unbounded, _ndim, nbr_spectral, LOCATION);
@@ -1023,7 +1685,7 @@ void Solver:: _cmptGreenFunction(Topology *topo[3], double *green, FFTW_plan_dim
             istart_cstm[ip] = isSpectral[ip] ? 1 : 0;  //avoid rewriting on the part of Green already computed
             kfact[dimID]    = planmap[ip]->kfact();
         }
-        cmpt_Green_0dirunbounded(topo[_ndim-1], _hgrid[0], kfact, koffset, symstart, green, _typeGreen, kernelLength, istart_cstm, NULL);
+        cmpt_Green_0dirunbounded(topo[_ndim-1], _hgrid[0], kfact, koffset, symstart, green, _typeGreen, kernelLength, _kappaGreen, istart_cstm, NULL);
     }
 #ifdef DUMP_DBG
     hdf5_dump(topo[_ndim-1], "green_h", green);
@@ -1031,6 +1693,87 @@ void Solver:: _cmptGreenFunction(Topology *topo[3], double *green, FFTW_plan_dim
     END_FUNC;
 }
 
+/**
+ * @brief returns the kernel length scale of the HEJ kernels (smoothing for regularization or spectral normalization h/pi)
+ * 
+ * It also checks that the grid spacing is the same in every direction for the kernels that require it.
+ * 
+ * @return double 
+ */
+double Solver::_cmptGreenLength() const {
+    BEGIN_FUNC;
+    double kernelLength = _alphaGreen * _hgrid[0];
+    if (_typeGreen == HEJ_0) {
+        kernelLength = _hgrid[0] / M_PI;
+    }
+
+    if ((_typeGreen == HEJ_2 || _typeGreen == HEJ_4 || _typeGreen == HEJ_6 || _typeGreen == HEJ_8 || _typeGreen == HEJ_10 || _typeGreen == HEJ_0 || _typeGreen == LGF_2) && ((_ndim == 3 && (_hgrid[0] != _hgrid[1] || _hgrid[1] != _hgrid[2])) || (_ndim == 2 && _hgrid[0] != _hgrid[1]))) {
+        FLUPS_ERROR("You are trying to use a regularized kernel or a LGF while not having dx=dy=dz.", LOCATION);
+    }
+    if (_kappaGreen < 0.0 || (_kappaGreen != 0.0 && (_typeGreen == HEJ_2 || _typeGreen == HEJ_4 || _typeGreen == HEJ_6 || _typeGreen == HEJ_8 || _typeGreen == HEJ_10))) {
+        FLUPS_ERROR("The screening parameter must be positive and cannot be used with the HEJ_2 to HEJ_10 kernels: kappa = %e", _kappaGreen, LOCATION);
+    }
+    END_FUNC;
+    return kernelLength;
+}
+
+/**
+ * @brief initialize the on the fly evaluation of the Green's function (see #_greenMatrixFree)
+ * 
+ * This is only possible if every direction is spectral, i.e. when the Green's function is given by cmpt_Green_0dirunbounded.
+ * Otherwise #_greenMatrixFree is set to false and the Green's function is stored as usual.
+ * 
+ * @param planmap the list of plans for the Green's function
+ */
+void Solver::_init_greenMatrixFree(FFTW_plan_dim *planmap[3]) {
+    BEGIN_FUNC;
+    bool isSpectral = true;
+    for (int ip = 0; ip < _ndim; ip++) {
+        isSpectral = isSpectral && planmap[ip]->isSpectral();
+    }
+    if (!isSpectral) {
+        FLUPS_WARNING("the matrix-free Green's function is only available when every direction is spectral, the Green's function will be stored", LOCATION);
+        _greenMatrixFree = false;
+        END_FUNC;
+        return;
+    }
+    // get the spectral information, the same as in _cmptGreenFunction
+    for (int ip = 0; ip < _ndim; ip++) {
+        const int dimID        = planmap[ip]->dimID();
+        _greenKfact[dimID]     = planmap[ip]->kfact();
+        _greenKoffset[dimID]   = planmap[ip]->koffset();
+        _greenSymstart[dimID]  = planmap[ip]->symstart();
+    }
+    // check the kernel now since _cmptGreenFunction is not called
+    _cmptGreenLength();
+
+    // one pencil is evaluated at a time, we keep it aligned
+    const Topology *topo       = _topo_hat[_ndim - 1];
+    const size_t    inmax      = topo->nloc(topo->axis());
+    const size_t    pencilSize = inmax * sizeof(double);
+    _greenNf                   = 1;
+    _greenStride               = (pencilSize % FLUPS_ALIGNMENT == 0) ? inmax : (pencilSize + FLUPS_ALIGNMENT - pencilSize % FLUPS_ALIGNMENT) / sizeof(double);
+    // the pencils of the threads are allocated once for all the solves
+    _get_greenBuf();
+    FLUPS_INFO(">> the Green's function of type %d is evaluated on the fly", _typeGreen);
+    END_FUNC;
+}
+
+/**
+ * @brief returns the pencils of the Green's function evaluated on the fly, one per thread of size #_greenStride
+ * 
+ * They are allocated by _init_greenMatrixFree() and only reallocated if the number of threads has increased since.
+ */
+double* Solver::_get_greenBuf() {
+    const int nth = omp_get_max_threads();
+    if (_greenBuf == NULL || nth > _greenBufNth) {
+        if (_greenBuf != NULL) flups_free(_greenBuf);
+        _greenBuf    = (double*)flups_malloc(sizeof(double) * _greenStride * nth);
+        _greenBufNth = nth;
+    }
+    return _greenBuf;
+}
+
 /**
  * @brief scales the Green's function given the #_volfact factor
  * 
@@ -1078,6 +1821,53 @@ void Solver::_scaleGreenFunction(const Topology *topo, opt_double_ptr data, cons
     END_FUNC;
 }
 
+/**
+ * @brief compute the key identifying the Green's function in full spectral space, used for the cache
+ * 
+ * The key gathers everything the Green's function depends on: the type of kernel, the grid spacing, the plans (hence the boundary conditions
+ * and the domain length) and the data decomposition.
+ * As the cache stores the raw memory of each rank, the key also contains a hash of the starting index and the local size of every rank,
+ * in the rank order of the communicator: the key is the same on every rank and changes if the blocks are given to other ranks.
+ * 
+ * @param topo the last topology used for green (in full spectral)
+ * @param planmap the list of successive maps to bring the Green function to full spectral
+ * @return std::string the key
+ */
+std::string Solver::_cmptGreenKey(const Topology *topo, FFTW_plan_dim *planmap[3]) {
+    BEGIN_FUNC;
+    int comm_size;
+    MPI_Comm_size(topo->get_comm(), &comm_size);
+
+    char msg[512];
+    sprintf(msg, "green=%d alpha=%.17g kappa=%.17g h=%.17g %.17g %.17g ndim=%d", _typeGreen, _alphaGreen, _kappaGreen, _hgrid[0], _hgrid[1], _hgrid[2], _ndim);
+    std::string key = msg;
+    for (int ip = 0; ip < _ndim; ip++) {
+        sprintf(msg, " plan%d=%d %d %d %.17g %.17g %.17g", ip, planmap[ip]->dimID(), planmap[ip]->type(), planmap[ip]->isr2c(),
+                planmap[ip]->kfact(), planmap[ip]->koffset(), planmap[ip]->symstart());
+        key += msg;
+    }
+    sprintf(msg, " topo=%d %d %d %d %d %d %d %d nf=%d size=%d align=%d", topo->axis(), topo->nglob(0), topo->nglob(1), topo->nglob(2),
+            topo->nproc(0), topo->nproc(1), topo->nproc(2), topo->isComplex(), topo->nf(), comm_size, _fftwalignment);
+    key += msg;
+
+    // hash the layout of every rank (FNV-1a), the rank-to-block mapping is not given by the number of procs only
+    int layout[6];
+    topo->get_istart_glob(layout);
+    for (int id = 0; id < 3; id++) {
+        layout[3 + id] = topo->nloc(id);
+    }
+    std::vector<int> allLayout(6 * comm_size);
+    MPI_Allgather(layout, 6, MPI_INT, allLayout.data(), 6, MPI_INT, topo->get_comm());
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < allLayout.size(); i++) {
+        hash = (hash ^ (unsigned long long)(unsigned int)allLayout[i]) * 1099511628211ULL;
+    }
+    sprintf(msg, " layout=%016llx", hash);
+    key += msg;
+    END_FUNC;
+    return key;
+}
+
 /**
  * @brief Finalize the Green function, and make sure it is stored according to the same topo as transformed data in full spectral space.
  * This is done to have the correct shiftgreen for the last plan if required.
@@ -1117,6 +1907,90 @@ void Solver::_finalizeGreenFunction(Topology *topo_field, double *green, const T
     END_FUNC;
 }
 
+/**
+ * @brief store the Green's function in its compact form if asked (see #_greenCompact)
+ * 
+ * The Green array is allocated to hold the largest of the Green topologies. In compact mode it is reallocated to the size of the last topology.
+ * Moreover, if the Green's function is complex but its imaginary part vanishes (e.g. for an even kernel in every direction)
+ * only the real part is kept, which halves the memory. The imaginary part is considered to vanish if it is below
+ * 1000 machine epsilon times the maximum of the real part.
+ * 
+ * In any case, #_greenNf and #_greenStride are set to describe the Green's function used by the dothemagic functions:
+ * the pencil io of Green starts at _green + io * _greenStride.
+ * 
+ * @param topo the last topology used for green (in full spectral)
+ * @param green pointer to the green function, may be reallocated
+ */
+void Solver::_compactGreenFunction(const Topology *topo, double **green) {
+    BEGIN_FUNC;
+    const int    ax0     = topo->axis();
+    const int    nf      = topo->nf();
+    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const size_t ondim   = (size_t)topo->nloc((ax0 + 1) % 3) * (size_t)topo->nloc((ax0 + 2) % 3);
+    const size_t inmax   = topo->nloc(ax0);
+
+    // by default, the Green's function follows the layout of the topo
+    _greenNf     = nf;
+    _greenStride = (size_t)nmem[ax0] * (size_t)nf;
+    if (!_greenCompact) {
+        END_FUNC;
+        return;
+    }
+
+    //-------------------------------------------------------------------------
+    /** - check if the imaginary part can be dropped */
+    //-------------------------------------------------------------------------
+    if (nf == 2) {
+        double locmax[2] = {0.0, 0.0};  // max of the real and imaginary parts
+        for (size_t io = 0; io < ondim; io++) {
+            const double *greenloc = (*green) + collapsedIndex(ax0, 0, io, nmem, nf);
+            for (size_t ii = 0; ii < inmax; ii++) {
+                locmax[0] = std::max(locmax[0], std::fabs(greenloc[ii * 2 + 0]));
+                locmax[1] = std::max(locmax[1], std::fabs(greenloc[ii * 2 + 1]));
+            }
+        }
+        double globmax[2];
+        MPI_Allreduce(locmax, globmax, 2, MPI_DOUBLE, MPI_MAX, topo->get_comm());
+
+        if (globmax[1] <= 1000.0 * std::numeric_limits<double>::epsilon() * globmax[0]) {
+            _greenNf = 1;
+            // keep every pencil aligned
+            const size_t pencilSize = inmax * sizeof(double);
+            _greenStride            = (pencilSize % FLUPS_ALIGNMENT == 0) ? inmax : (pencilSize + FLUPS_ALIGNMENT - pencilSize % FLUPS_ALIGNMENT) / sizeof(double);
+            FLUPS_INFO(">> only the real part of the Green's function is stored: max(|real|) = %e vs max(|imag|) = %e", globmax[0], globmax[1]);
+        } else {
+            FLUPS_INFO(">> the Green's function is complex: max(|real|) = %e vs max(|imag|) = %e", globmax[0], globmax[1]);
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    /** - copy the Green's function in an array of the final size */
+    //-------------------------------------------------------------------------
+    const size_t size_tot = std::max(_greenStride * ondim, (size_t)1);
+    double*      newgreen = (double *)flups_malloc(size_tot * sizeof(double));
+    flups_first_touch(newgreen, size_tot);
+    FLUPS_CHECK(FLUPS_ISALIGNED(newgreen), "FFTW alignement not compatible with FLUPS_ALIGNMENT (=%d)", FLUPS_ALIGNMENT, LOCATION);
+
+    const double *oldgreen = *green;
+    const int     greenNf  = _greenNf;
+    const size_t  stride   = _greenStride;
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(ondim, inmax, nmem, nf, ax0, oldgreen, newgreen, greenNf, stride)
+    for (size_t io = 0; io < ondim; io++) {
+        const double *oldloc = oldgreen + collapsedIndex(ax0, 0, io, nmem, nf);
+        double *      newloc = newgreen + io * stride;
+        for (size_t ii = 0; ii < inmax; ii++) {
+            // the real part comes first
+            for (int i0 = 0; i0 < greenNf; i0++) {
+                newloc[ii * greenNf + i0] = oldloc[ii * nf + i0];
+            }
+        }
+    }
+    FLUPS_INFO(">> Green's function stored on %ld doubles", size_tot);
+    flups_free(*green);
+    (*green) = newgreen;
+    END_FUNC;
+}
+
 /**
  * @brief Solve the Poisson equation of the specified type.
  * 
@@ -1125,11 +1999,49 @@ void Solver::_finalizeGreenFunction(Topology *topo_field, double *green, const T
  * @param field pointer to the solution 
  * @param rhs pointer to the field
  * @param type type of solver
+ */
+void Solver::solve(double *field, double *rhs,const FLUPS_SolverType type) {
+    BEGIN_FUNC;
+    if (_splitStage >= 0) {
+        FLUPS_ERROR("a split-phase solve is in progress, call solve_end() first", LOCATION);
+    }
+    FLUPS_CHECK(field != NULL, "field is NULL", LOCATION);
+    FLUPS_CHECK(rhs != NULL, "rhs is NULL", LOCATION);
+    //-------------------------------------------------------------------------
+    /** - get the pointers to every component of the field and the rhs */
+    //-------------------------------------------------------------------------
+    const size_t         memdim = _topo_phys->memdim();
+    std::vector<double*> fieldComp(_lda);
+    std::vector<double*> rhsComp(_lda);
+    for (int lia = 0; lia < _lda; lia++) {
+        fieldComp[lia] = field + lia * memdim;
+        rhsComp[lia]   = rhs + lia * memdim;
+    }
+    //-------------------------------------------------------------------------
+    /** - solve them at once */
+    //-------------------------------------------------------------------------
+    solve_many(fieldComp.data(), rhsComp.data(), _lda, type);
+    END_FUNC;
+}
+
+/**
+ * @brief Solve the Poisson equation of the specified type for n fields stored in separate arrays.
+ * 
+ * This is a loop over the groups of lda fields, each group being solved as the lda components of the solver.
+ * Only the fields of a group share the switches between topologies (with lda times bigger messages): with a scalar solver (lda = 1),
+ * the n fields are solved one after the other, without any batching. To batch k fields, the solver must be created with lda = k.
+ * The solver must have been created on a topology whose lda divides n, usually with the same boundary conditions for every component.
+ * Each field[i] and rhs[i] is a scalar field (lda = 1) following the layout of the physical topology, ghost points included (see Topology::set_ghost()).
+ * 
+ * @param field the n pointers to the solutions
+ * @param rhs the n pointers to the right hand sides
+ * @param n the number of fields, must be a multiple of the lda of the solver
+ * @param type type of solver
  * 
  * -----------------------------------------------
  * We perform the following operations:
  */
-void Solver::solve(double *field, double *rhs,const FLUPS_SolverType type) {
+void Solver::solve_many(double **field, double **rhs, const int n, const FLUPS_SolverType type) {
     BEGIN_FUNC;
     FLUPS_CHECK(!(type == ROT && _odiff == NOD),"If calling the ROT solver, you need to initialize it with orderDiff = SPE or orderDiff = FD2",LOCATION);
     //-------------------------------------------------------------------------
@@ -1137,63 +2049,231 @@ void Solver::solve(double *field, double *rhs,const FLUPS_SolverType type) {
     //-------------------------------------------------------------------------
     FLUPS_CHECK(field != NULL, "field is NULL", LOCATION);
     FLUPS_CHECK(rhs != NULL, "rhs is NULL", LOCATION);
+    if (n <= 0 || n % _lda != 0) {
+        FLUPS_ERROR("the number of fields = %d must be a positive multiple of the solver lda = %d", n, _lda, LOCATION);
+    }
+    for (int lia = 0; lia < n; lia++) {
+        FLUPS_CHECK(field[lia] != NULL, "field[%d] is NULL", lia, LOCATION);
+        FLUPS_CHECK(rhs[lia] != NULL, "rhs[%d] is NULL", lia, LOCATION);
+    }
 
     opt_double_ptr       mydata  = _data;
 
-    if (_prof != NULL) _prof->start("solve");
-
-    //-------------------------------------------------------------------------
-    /** - clean the data memory */
-    //-------------------------------------------------------------------------
-    std::memset(mydata, 0, sizeof(double) * get_allocSize());
+    if (_prof != NULL) _prof->start(_profSolve);
 
-    //-------------------------------------------------------------------------
-    /** - copy the rhs in the correct order */
-    //-------------------------------------------------------------------------
     FLUPS_CHECK(_topo_phys->nf() == 1, "The RHS topology cannot be complex", LOCATION);
 
-    do_copy(_topo_phys, rhs, FLUPS_FORWARD);
+    // the switches access the local points, after the ghost points of the user layout
+    const size_t         memoffset = _topo_phys->memoffset();
+    std::vector<double*> fieldLoc(_lda);
+    std::vector<double*> rhsLoc(_lda);
+
+    for (int ig = 0; ig < n; ig += _lda) {
+        //-------------------------------------------------------------------------
+        /** - for every group of lda fields: */
+        //-------------------------------------------------------------------------
+        for (int lia = 0; lia < _lda; lia++) {
+            fieldLoc[lia] = field[ig + lia] + memoffset;
+            rhsLoc[lia]   = rhs[ig + lia] + memoffset;
+        }
 
 #ifdef DUMP_DBG
-    hdf5_dump(_topo_phys, "rhs", mydata);
+        // the rhs is copied only to be dumped
+        std::memset(mydata, 0, sizeof(double) * get_allocSize());
+        do_copy(_topo_phys, rhs + ig, FLUPS_FORWARD);
+        hdf5_dump(_topo_phys, "rhs", mydata);
 #endif
-    //-------------------------------------------------------------------------
-    /** - go to Fourier */
-    //-------------------------------------------------------------------------
-    do_FFT(mydata, FLUPS_FORWARD);
+        //-------------------------------------------------------------------------
+        /**   - go to Fourier, the first switch reads the rhs directly */
+        //-------------------------------------------------------------------------
+        do_FFT(mydata, rhsLoc.data(), FLUPS_FORWARD);
 
 #ifdef DUMP_DBG
-    hdf5_dump(_topo_hat[_ndim-1], "rhs_h", mydata);
+        hdf5_dump(_topo_hat[_ndim-1], "rhs_h", mydata);
 #endif
-    //-------------------------------------------------------------------------
-    /** - Perform the magic */
-    //-------------------------------------------------------------------------
-    do_mult(mydata,type);
+        //-------------------------------------------------------------------------
+        /**   - Perform the magic */
+        //-------------------------------------------------------------------------
+        do_mult(mydata,type);
 
 #ifdef DUMP_DBG
-    // io if needed
-    hdf5_dump(_topo_hat[_ndim-1], "sol_h", mydata);
+        // io if needed
+        hdf5_dump(_topo_hat[_ndim-1], "sol_h", mydata);
 #endif
+        //-------------------------------------------------------------------------
+        /**   - go back to reals, the first switch writes the solution directly in the field */
+        //-------------------------------------------------------------------------
+        if (type == STD) {
+            do_FFT(mydata, fieldLoc.data(), FLUPS_BACKWARD);
+        } else {
+            do_FFT(mydata, fieldLoc.data(), FLUPS_BACKWARD_DIFF);
+        }
+
+#ifdef DUMP_DBG
+        // io if needed, the solution is copied only to be dumped
+        do_copy(_topo_phys, field + ig, FLUPS_FORWARD);
+        hdf5_dump(_topo_phys, "sol", mydata);
+#endif
+    }
+    // stop the whole timer
+    if (_prof != NULL) _prof->stop(_profSolve);
+    END_FUNC;
+}
+
+/**
+ * @brief Start the solve of the Poisson equation of the specified type, see solve()
+ * 
+ * The solve is split in phases so that the communications overlap with other work:
+ * each call to solve_progress() advances the solve as far as the communications that have arrived allow it,
+ * without blocking, and solve_end() completes the solve.
+ * Only the non-blocking switch (SWITCH_NB) is truly asynchronous, the other switches are executed at once
+ * inside solve_begin() or solve_progress(). The FFTs are never pipelined within the switches (see PIPELINE_FFT).
+ * 
+ * The rhs can be modified once the function returns. The field contains the solution once solve_progress() returns true or solve_end() returns.
+ * The solver must not be used for another solve in the meantime, nor any other solver sharing the communication pool (see BufferPool::lock()).
+ * 
+ * @param field the solution
+ * @param rhs the right hand side
+ * @param type type of solver
+ */
+void Solver::solve_begin(double *field, double *rhs, const FLUPS_SolverType type) {
+    BEGIN_FUNC;
+    FLUPS_CHECK(!(type == ROT && _odiff == NOD),"If calling the ROT solver, you need to initialize it with orderDiff = SPE or orderDiff = FD2",LOCATION);
+    FLUPS_CHECK(field != NULL, "field is NULL", LOCATION);
+    FLUPS_CHECK(rhs != NULL, "rhs is NULL", LOCATION);
+    FLUPS_CHECK(_topo_phys->nf() == 1, "The RHS topology cannot be complex", LOCATION);
+    if (_splitStage >= 0) {
+        FLUPS_ERROR("a split-phase solve is already in progress, call solve_end() first", LOCATION);
+    }
+    _relink_switchTopo();
+    // the buffers of the pool are used by the pending communications until the end of the solve
+    if (_usePool()) BufferPool::lock(_poolId);
+
+    if (_prof != NULL) _prof->start(_profSolve);
     //-------------------------------------------------------------------------
-    /** - go back to reals */
+    /** - get the pointers to every component of the field and the rhs */
     //-------------------------------------------------------------------------
-    if (type == STD) {
-        do_FFT(mydata, FLUPS_BACKWARD);
-    } else {
-        do_FFT(mydata, FLUPS_BACKWARD_DIFF);
+    // the switches access the local points, after the ghost points of the user layout
+    const size_t memdim    = _topo_phys->memdim();
+    const size_t memoffset = _topo_phys->memoffset();
+    double**     rhsComp   = (double**)flups_malloc(sizeof(double*) * _lda);
+    _splitField            = (double**)flups_malloc(sizeof(double*) * _lda);
+    for (int lia = 0; lia < _lda; lia++) {
+        _splitField[lia] = field + lia * memdim + memoffset;
+        rhsComp[lia]     = rhs + lia * memdim + memoffset;
     }
-
     //-------------------------------------------------------------------------
-    /** - copy the solution in the field */
+    /** - start the first switch, which reads the rhs */
     //-------------------------------------------------------------------------
-    do_copy(_topo_phys, field, FLUPS_BACKWARD);
+    _splitType  = type;
+    _splitStage = 0;
+    _switchtopo[0]->execute_begin(_data, FLUPS_FORWARD, rhsComp);
 
-#ifdef DUMP_DBG
-    // io if needed
-    hdf5_dump(_topo_phys, "sol", field);
-#endif
-    // stop the whole timer
-    if (_prof != NULL) _prof->stop("solve");
+    // the rhs has been copied in the buffers
+    flups_free(rhsComp);
+    if (_prof != NULL) _prof->stop(_profSolve);
+    END_FUNC;
+}
+
+/**
+ * @brief Advance the split-phase solve started by solve_begin() without blocking
+ * 
+ * @return true if the solve is completed
+ */
+bool Solver::solve_progress() {
+    BEGIN_FUNC;
+    if (_prof != NULL) _prof->start(_profSolve);
+    while (_splitStage >= 0) {
+        const bool isForward = (_splitStage < _ndim);
+        const int  ip        = (isForward) ? _splitStage : 2 * _ndim - 1 - _splitStage;
+        const int  sign      = (isForward) ? FLUPS_FORWARD : FLUPS_BACKWARD;
+        if (!_switchtopo[ip]->execute_test(_data, sign, (ip == 0) ? _splitField : NULL)) {
+            break;
+        }
+        _split_next();
+    }
+    if (_prof != NULL) _prof->stop(_profSolve);
+    END_FUNC;
+    return (_splitStage < 0);
+}
+
+/**
+ * @brief Complete the split-phase solve started by solve_begin(), the field then contains the solution
+ * 
+ */
+void Solver::solve_end() {
+    BEGIN_FUNC;
+    if (_prof != NULL) _prof->start(_profSolve);
+    while (_splitStage >= 0) {
+        const bool isForward = (_splitStage < _ndim);
+        const int  ip        = (isForward) ? _splitStage : 2 * _ndim - 1 - _splitStage;
+        const int  sign      = (isForward) ? FLUPS_FORWARD : FLUPS_BACKWARD;
+        _switchtopo[ip]->execute_end(_data, sign, (ip == 0) ? _splitField : NULL);
+        _split_next();
+    }
+    if (_prof != NULL) _prof->stop(_profSolve);
+    END_FUNC;
+}
+
+/**
+ * @brief Do the work that follows the completed switch of the split-phase solve and start the next switch
+ * 
+ * The steps are the ones of solve_many(): the switches and FFTs forward, the multiplication with the Green's function,
+ * then the FFTs and switches backward.
+ */
+void Solver::_split_next() {
+    BEGIN_FUNC;
+    opt_double_ptr mydata = _data;
+    //-------------------------------------------------------------------------
+    /** - the last backward switch has written the solution in the field */
+    //-------------------------------------------------------------------------
+    if (_splitStage == 2 * _ndim - 1) {
+        flups_free(_splitField);
+        _splitField = NULL;
+        _splitStage = -1;
+        if (_usePool()) BufferPool::unlock(_poolId);
+        END_FUNC;
+        return;
+    }
+    //-------------------------------------------------------------------------
+    /** - forward: run the FFT in the new topo and the multiplication after the last one */
+    //-------------------------------------------------------------------------
+    if (_splitStage < _ndim) {
+        const int ip = _splitStage;
+        if (_prof != NULL) _prof->start(_profFFTW);
+        int pstart[3], pend[3];
+        _support_box(ip, FLUPS_FORWARD, pstart, pend);
+        _plan_forward[ip]->execute_plan(_topo_hat[ip], mydata, pstart, pend);
+        _plan_forward[ip]->correct_plan(_topo_hat[ip], mydata);
+        if (_prof != NULL) _prof->stop(_profFFTW);
+        if (_plan_forward[ip]->isr2c()) {
+            _topo_hat[ip]->switch2complex();
+        }
+        if (ip < _ndim - 1) {
+            // start the next switch
+            _splitStage++;
+            _switchtopo[ip + 1]->execute_begin(mydata, FLUPS_FORWARD, NULL);
+            END_FUNC;
+            return;
+        }
+        do_mult(mydata, _splitType);
+    }
+    //-------------------------------------------------------------------------
+    /** - backward: run the FFT and start the switch to the previous topo */
+    //-------------------------------------------------------------------------
+    _splitStage++;
+    const int      ip   = 2 * _ndim - 1 - _splitStage;
+    FFTW_plan_dim* plan = (_splitType == STD) ? _plan_backward[ip] : _plan_backward_diff[ip];
+    if (_prof != NULL) _prof->start(_profFFTW);
+    int pstart[3], pend[3];
+    _support_box(ip, FLUPS_BACKWARD, pstart, pend);
+    plan->correct_plan(_topo_hat[ip], mydata);
+    plan->execute_plan(_topo_hat[ip], mydata, pstart, pend);
+    if (_prof != NULL) _prof->stop(_profFFTW);
+    if (_plan_forward[ip]->isr2c()) {
+        _topo_hat[ip]->switch2real();
+    }
+    _switchtopo[ip]->execute_begin(mydata, FLUPS_BACKWARD, (ip == 0) ? _splitField : NULL);
     END_FUNC;
 }
 
@@ -1205,39 +2285,76 @@ void Solver::solve(double *field, double *rhs,const FLUPS_SolverType type) {
  * @param sign 
  */
 void Solver::do_copy(const Topology *topo, double *data, const int sign ){
+    BEGIN_FUNC;
+    FLUPS_CHECK(data != NULL, "data is NULL", LOCATION);
+    // get the pointer to every component
+    const size_t memdim   = topo->memdim();
+    double**     dataComp = (double**)flups_malloc(sizeof(double*) * _lda);
+    for (int lia = 0; lia < _lda; lia++) {
+        dataComp[lia] = data + lia * memdim;
+    }
+    do_copy(topo, dataComp, sign);
+    flups_free(dataComp);
+    END_FUNC;
+}
+
+/**
+ * @brief copy from the components data[lia] to the object owned data or from the object owned data to the components
+ * 
+ * The components follow the memory layout of topo, ghost points included (see Topology::set_ghost()), while the owned data
+ * has the same layout but the local points start at 0.
+ * The access is contiguous along the FRI for both, as they share the axis of topo.
+ * When copying back to the components, the data is written with non-temporal stores if the copy is larger than FLUPS_NT_THRESHOLD,
+ * as the components are not read by the solver afterwards.
+ * 
+ * @param topo the topology of one component, the lda is the number of components
+ * @param data the _lda pointers to the components
+ * @param sign 
+ */
+void Solver::do_copy(const Topology *topo, double **data, const int sign ){
     BEGIN_FUNC;
     FLUPS_CHECK(data != NULL, "data is NULL", LOCATION);
     FLUPS_CHECK(_lda == topo->lda(),"the solver lda = %d must match the topology one = %d",_lda,topo->lda(),LOCATION);
 
-    double* owndata = _data; 
-    double* argdata = data;  
+    double*  owndata = _data; 
+    double** argdata = data;  
 
     if (_prof != NULL) {
-        _prof->start("copy");
+        _prof->start(_profCopy);
     }
 
-    const int    ax0     = topo->axis();
-    const int    ax1     = (ax0 + 1) % 3;
-    const int    ax2     = (ax0 + 2) % 3;
-    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
-    const size_t memdim  = topo->memdim();
-    const size_t ondim   = topo->nloc(ax1) * topo->nloc(ax2);
-    const size_t onmax   = topo->nloc(ax1) * topo->nloc(ax2) * _lda;
-    const size_t inmax   = topo->nloc(ax0);
+    const int    ax0       = topo->axis();
+    const int    ax1       = (ax0 + 1) % 3;
+    const int    ax2       = (ax0 + 2) % 3;
+    const int    nmem[3]   = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const int    nloc1     = topo->nloc(ax1);
+    const size_t memdim    = topo->memdim();
+    const size_t memoffset = topo->memoffset();
+    const size_t ondim     = topo->nloc(ax1) * topo->nloc(ax2);
+    const size_t onmax     = topo->nloc(ax1) * topo->nloc(ax2) * _lda;
+    const size_t inmax     = topo->nloc(ax0);
+    const bool   isNT      = (sizeof(double) * inmax * onmax >= FLUPS_NT_THRESHOLD);
+
+    // the first local point of every pencil must be aligned, ghost points included
+    bool isArgAligned = ((memoffset * sizeof(double)) % FLUPS_ALIGNMENT == 0);
+    for (int lia = 0; lia < _lda; lia++) {
+        isArgAligned = isArgAligned && FLUPS_ISALIGNED(argdata[lia]);
+    }
 
     // if the data is aligned and the FRI is a multiple of the alignment we can go for a full aligned loop
-    if (FLUPS_ISALIGNED(argdata) && (nmem[ax0] * topo->nf() * sizeof(double)) % FLUPS_ALIGNMENT == 0) {
+    if (isArgAligned && (nmem[ax0] * topo->nf() * sizeof(double)) % FLUPS_ALIGNMENT == 0) {
         // do the loop
         if (sign == FLUPS_FORWARD) {
             //Copying from arg to own
-#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, ondim, memdim)
-            for (int id = 0; id < onmax; id++) {
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, nloc1, ondim, memdim, memoffset)
+            for (size_t id = 0; id < onmax; id++) {
                 // get the lia and the io
                 const size_t lia = id / ondim;
                 const size_t io  = id % ondim;
                 // get the pointers
-                opt_double_ptr argloc = argdata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
-                opt_double_ptr ownloc = owndata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
+                const size_t   offset = localIndex(ax0, 0, io % nloc1, io / nloc1, ax0, nmem, 1, 0);
+                opt_double_ptr argloc = argdata[lia] + memoffset + offset;
+                opt_double_ptr ownloc = owndata + lia * memdim + offset;
                 // set the alignment
                 FLUPS_ASSUME_ALIGNED(argloc, FLUPS_ALIGNMENT);
                 FLUPS_ASSUME_ALIGNED(ownloc, FLUPS_ALIGNMENT);
@@ -1247,35 +2364,46 @@ void Solver::do_copy(const Topology *topo, double *data, const int sign ){
             }
         } else {  //FLUPS_BACKWARD
                   //Copying from own to arg
-#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, ondim, memdim)
-            for (int id = 0; id < onmax; id++) {
-                // get the lia and the io
-                const size_t lia = id / ondim;
-                const size_t io  = id % ondim;
-                // get the pointers
-                opt_double_ptr argloc = argdata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
-                opt_double_ptr ownloc = owndata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
-                // set the alignment
-                FLUPS_ASSUME_ALIGNED(argloc, FLUPS_ALIGNMENT);
-                FLUPS_ASSUME_ALIGNED(ownloc, FLUPS_ALIGNMENT);
-                for (size_t ii = 0; ii < inmax; ii++) {
-                    argloc[ii] = ownloc[ii];
+#pragma omp parallel default(none) proc_bind(close) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, nloc1, ondim, memdim, memoffset, isNT)
+            {
+#pragma omp for schedule(static)
+                for (size_t id = 0; id < onmax; id++) {
+                    // get the lia and the io
+                    const size_t lia = id / ondim;
+                    const size_t io  = id % ondim;
+                    // get the pointers
+                    const size_t   offset = localIndex(ax0, 0, io % nloc1, io / nloc1, ax0, nmem, 1, 0);
+                    opt_double_ptr argloc = argdata[lia] + memoffset + offset;
+                    opt_double_ptr ownloc = owndata + lia * memdim + offset;
+                    // set the alignment
+                    FLUPS_ASSUME_ALIGNED(argloc, FLUPS_ALIGNMENT);
+                    FLUPS_ASSUME_ALIGNED(ownloc, FLUPS_ALIGNMENT);
+                    if (isNT) {
+                        flups_stream_copy(argloc, ownloc, inmax);
+                    } else {
+                        for (size_t ii = 0; ii < inmax; ii++) {
+                            argloc[ii] = ownloc[ii];
+                        }
+                    }
                 }
+                // make the non-temporal stores visible
+                flups_stream_fence();
             }
         }
     } else {
         // do the loop
-        FLUPS_WARNING("loop uses unaligned access: alignment(&data[0]) = %d, alignment(data[i]) = %d. Please align your topology using FLUPS_ALIGNEMENT!!", FLUPS_CMPT_ALIGNMENT(argdata), (nmem[ax0] * topo->nf() * sizeof(double)) % FLUPS_ALIGNMENT, LOCATION);
+        FLUPS_WARNING("loop uses unaligned access: alignment(&data[0]) = %d, alignment(data[i]) = %d. Please align your topology using FLUPS_ALIGNEMENT!!", FLUPS_CMPT_ALIGNMENT(argdata[0]), (nmem[ax0] * topo->nf() * sizeof(double)) % FLUPS_ALIGNMENT, LOCATION);
         if (sign == FLUPS_FORWARD) {
             //Copying from arg to own
-#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, ondim, memdim)
-            for (int id = 0; id < onmax; id++) {
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, nloc1, ondim, memdim, memoffset)
+            for (size_t id = 0; id < onmax; id++) {
                 // get the lia and the io
                 const size_t lia = id / ondim;
                 const size_t io  = id % ondim;
                 // get the pointers
-                double *__restrict argloc = argdata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
-                opt_double_ptr ownloc     = owndata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
+                const size_t offset = localIndex(ax0, 0, io % nloc1, io / nloc1, ax0, nmem, 1, 0);
+                double *__restrict argloc = argdata[lia] + memoffset + offset;
+                opt_double_ptr ownloc     = owndata + lia * memdim + offset;
                 FLUPS_ASSUME_ALIGNED(ownloc, FLUPS_ALIGNMENT);
                 for (size_t ii = 0; ii < inmax; ii++) {
                     ownloc[ii] = argloc[ii];
@@ -1283,14 +2411,15 @@ void Solver::do_copy(const Topology *topo, double *data, const int sign ){
             }
         } else {  //FLUPS_BACKWARD
                   //Copying from own to arg
-#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, ondim, memdim)
-            for (int id = 0; id < onmax; id++) {
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, inmax, owndata, argdata, nmem, ax0, nloc1, ondim, memdim, memoffset)
+            for (size_t id = 0; id < onmax; id++) {
                 // get the lia and the io
                 const size_t lia = id / ondim;
                 const size_t io  = id % ondim;
                 // get the pointers
-                double *__restrict argloc = argdata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
-                opt_double_ptr ownloc     = owndata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, 1);
+                const size_t offset = localIndex(ax0, 0, io % nloc1, io / nloc1, ax0, nmem, 1, 0);
+                double *__restrict argloc = argdata[lia] + memoffset + offset;
+                opt_double_ptr ownloc     = owndata + lia * memdim + offset;
                 FLUPS_ASSUME_ALIGNED(ownloc, FLUPS_ALIGNMENT);
                 for (size_t ii = 0; ii < inmax; ii++) {
                     argloc[ii] = ownloc[ii];
@@ -1300,11 +2429,83 @@ void Solver::do_copy(const Topology *topo, double *data, const int sign ){
     }
 
     if (_prof != NULL) {
-        _prof->stop("copy");
+        _prof->stop(_profCopy);
     }
     END_FUNC;
 }
 
+/**
+ * @brief sets the support of the rhs and the region where the solution is needed
+ * 
+ * The rhs is assumed to be zero outside [rhsStart,rhsEnd[ and the solution is only needed in [solStart,solEnd[.
+ * The FFTs then skip the pencils that are known to be zero in the forward transforms and the pencils that
+ * do not contribute to the solution region in the backward ones (see _support_box()).
+ * Outside [solStart,solEnd[ the content of the field after a solve is undefined.
+ * 
+ * The support is used by every solve that runs the FFTs with FFTW_plan_dim::execute_plan(), i.e. when the code is not compiled with PIPELINE_FFT.
+ * 
+ * @param rhsStart the first global index of the non-zero rhs in the topology used at FLUPS init
+ * @param rhsEnd the last global index (excluded) of the non-zero rhs
+ * @param solStart the first global index of the needed solution in the topology used at FLUPS init
+ * @param solEnd the last global index (excluded) of the needed solution
+ */
+void Solver::set_support(const int rhsStart[3], const int rhsEnd[3], const int solStart[3], const int solEnd[3]) {
+    BEGIN_FUNC;
+    _hasSupport = false;
+    for (int id = 0; id < 3; id++) {
+        const int nglob = _topo_phys->nglob(id);
+        if (rhsStart[id] < 0 || rhsEnd[id] > nglob || rhsStart[id] >= rhsEnd[id]) {
+            FLUPS_ERROR("the rhs support [%d,%d[ in dim %d is not valid (nglob = %d)", rhsStart[id], rhsEnd[id], id, nglob, LOCATION);
+        }
+        if (solStart[id] < 0 || solEnd[id] > nglob || solStart[id] >= solEnd[id]) {
+            FLUPS_ERROR("the solution support [%d,%d[ in dim %d is not valid (nglob = %d)", solStart[id], solEnd[id], id, nglob, LOCATION);
+        }
+        _rhsStart[id] = rhsStart[id];
+        _rhsEnd[id]   = rhsEnd[id];
+        _solStart[id] = solStart[id];
+        _solEnd[id]   = solEnd[id];
+        // the support is only useful if it does not cover the whole domain
+        _hasSupport = _hasSupport || (rhsStart[id] > 0) || (rhsEnd[id] < nglob) || (solStart[id] > 0) || (solEnd[id] < nglob);
+    }
+    FLUPS_INFO("rhs support = [%d %d %d] -> [%d %d %d]", _rhsStart[0], _rhsStart[1], _rhsStart[2], _rhsEnd[0], _rhsEnd[1], _rhsEnd[2]);
+    FLUPS_INFO("solution support = [%d %d %d] -> [%d %d %d]", _solStart[0], _solStart[1], _solStart[2], _solEnd[0], _solEnd[1], _solEnd[2]);
+    END_FUNC;
+}
+
+/**
+ * @brief get the local box of the pencils to transform in _topo_hat[ip]
+ * 
+ * The directions that have not been transformed yet before the stage ip (going forward), or that are already
+ * back to the physical space after the stage ip (going backward), are the directions of the plans ip+1 and onward.
+ * In these directions, the global index in _topo_hat[ip] is the one of the physical topology (the #_switchShift only
+ * applies in the direction of the plan) and only the rhs support (forward) or the solution support (backward) is kept.
+ * The other directions are fully transformed.
+ * 
+ * @param ip the stage of the transform
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ * @param start the first local index to transform in each direction
+ * @param end the last local index (excluded) to transform in each direction
+ */
+void Solver::_support_box(const int ip, const int sign, int start[3], int end[3]) const {
+    const Topology* topo = _topo_hat[ip];
+    int istart[3];
+    topo->get_istart_glob(istart);
+    for (int id = 0; id < 3; id++) {
+        start[id] = 0;
+        end[id]   = topo->nloc(id);
+    }
+    if (!_hasSupport) {
+        return;
+    }
+    const int* supStart = (sign == FLUPS_FORWARD) ? _rhsStart : _solStart;
+    const int* supEnd   = (sign == FLUPS_FORWARD) ? _rhsEnd : _solEnd;
+    for (int jp = ip + 1; jp < _ndim; jp++) {
+        const int id = _plan_forward[jp]->dimID();
+        start[id]    = std::max(supStart[id] - istart[id], 0);
+        end[id]      = std::min(supEnd[id] - istart[id], topo->nloc(id));
+    }
+}
+
 /**
  * @brief do the forward or backward fft on data (in place)
  * 
@@ -1314,20 +2515,76 @@ void Solver::do_copy(const Topology *topo, double *data, const int sign ){
  * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
  */
 void Solver::do_FFT(double *data, const int sign){
+    BEGIN_FUNC;
+    do_FFT(data, NULL, sign);
+    END_FUNC;
+}
+
+/**
+ * @brief do the forward or backward fft on data, the physical data being given by field
+ * 
+ * The first switch reads the components of field when filling its buffers (FLUPS_FORWARD) or writes them when reading
+ * its buffers (FLUPS_BACKWARD, FLUPS_BACKWARD_DIFF).
+ * It replaces the copy of field into data (see do_copy()) before the forward FFT and the copy of data into field after the backward one.
+ * 
+ * @param data pointer to data
+ * @param field the _lda components of the field in the topology used at FLUPS init, if NULL the physical data is data
+ * @param sign FLUPS_FORWARD, FLUPS_BACKWARD or FLUPS_BACKWARD_DIFF
+ */
+void Solver::do_FFT(double *data, double **field, const int sign){
     BEGIN_FUNC;
     FLUPS_CHECK(data != NULL, "data is NULL", LOCATION);
+    if (_splitStage >= 0) {
+        FLUPS_ERROR("a split-phase solve is in progress, call solve_end() first", LOCATION);
+    }
+    _relink_switchTopo();
     
     opt_double_ptr  mydata  = data;
 
+#if defined(PIPELINE_FFT)
+    // the FFTs are done inside the switches, as soon as the pencils are available
+    if (sign == FLUPS_FORWARD) {
+        for (int ip = 0; ip < _ndim; ip++) {
+            // go to the correct topo and run the FFT
+            _switchtopo[ip]->execute_pipelined(mydata, FLUPS_FORWARD, _plan_forward[ip], (ip == 0) ? field : NULL);
+            // get if we are now complex
+            if (_plan_forward[ip]->isr2c()) {
+                _topo_hat[ip]->switch2complex();
+            }
+        }
+    }
+    else if (sign == FLUPS_BACKWARD) {  //FLUPS_BACKWARD
+        for (int ip = _ndim-1; ip >= 0; ip--) {
+            // the pencils are given in the real state of the topo
+            if (_plan_forward[ip]->isr2c()) {
+                _topo_hat[ip]->switch2real();
+            }
+            // run the FFT and go back to the previous topo
+            _switchtopo[ip]->execute_pipelined(mydata, FLUPS_BACKWARD, _plan_backward[ip], (ip == 0) ? field : NULL);
+        }
+    }
+    else if (sign == FLUPS_BACKWARD_DIFF) {  //FLUPS_BACKWARD_DIFF
+        for (int ip = _ndim-1; ip >= 0; ip--) {
+            // the pencils are given in the real state of the topo
+            if (_plan_forward[ip]->isr2c()) {
+                _topo_hat[ip]->switch2real();
+            }
+            // run the FFT and go back to the previous topo
+            _switchtopo[ip]->execute_pipelined(mydata, FLUPS_BACKWARD, _plan_backward_diff[ip], (ip == 0) ? field : NULL);
+        }
+    }
+#else
     if (sign == FLUPS_FORWARD) {
         for (int ip = 0; ip < _ndim; ip++) {
             // go to the correct topo
-            _switchtopo[ip]->execute(mydata, FLUPS_FORWARD);
+            _switchtopo[ip]->execute(mydata, FLUPS_FORWARD, (ip == 0) ? field : NULL);
             // run the FFT
-            if (_prof != NULL) _prof->start("fftw");
-            _plan_forward[ip]->execute_plan(_topo_hat[ip], mydata);
+            if (_prof != NULL) _prof->start(_profFFTW);
+            int pstart[3], pend[3];
+            _support_box(ip, FLUPS_FORWARD, pstart, pend);
+            _plan_forward[ip]->execute_plan(_topo_hat[ip], mydata, pstart, pend);
             _plan_forward[ip]->correct_plan(_topo_hat[ip], mydata);
-            if (_prof != NULL) _prof->stop("fftw");
+            if (_prof != NULL) _prof->stop(_profFFTW);
             // get if we are now complex
             if (_plan_forward[ip]->isr2c()) {
                 _topo_hat[ip]->switch2complex();
@@ -1336,30 +2593,35 @@ void Solver::do_FFT(double *data, const int sign){
     } 
     else if (sign == FLUPS_BACKWARD) {  //FLUPS_BACKWARD
         for (int ip = _ndim-1; ip >= 0; ip--) {
-            if (_prof != NULL) _prof->start("fftw");
+            if (_prof != NULL) _prof->start(_profFFTW);
+            int pstart[3], pend[3];
+            _support_box(ip, FLUPS_BACKWARD, pstart, pend);
             _plan_backward[ip]->correct_plan(_topo_hat[ip], mydata);
-            _plan_backward[ip]->execute_plan(_topo_hat[ip], mydata);
-            if (_prof != NULL) _prof->stop("fftw");
+            _plan_backward[ip]->execute_plan(_topo_hat[ip], mydata, pstart, pend);
+            if (_prof != NULL) _prof->stop(_profFFTW);
             // get if we are now complex
             if (_plan_forward[ip]->isr2c()) {
                 _topo_hat[ip]->switch2real();
             }
-            _switchtopo[ip]->execute(mydata, FLUPS_BACKWARD);
+            _switchtopo[ip]->execute(mydata, FLUPS_BACKWARD, (ip == 0) ? field : NULL);
         }
     }
     else if (sign == FLUPS_BACKWARD_DIFF) {  //FLUPS_BACKWARD_DIFF
         for (int ip = _ndim-1; ip >= 0; ip--) {
-            if (_prof != NULL) _prof->start("fftw");
+            if (_prof != NULL) _prof->start(_profFFTW);
+            int pstart[3], pend[3];
+            _support_box(ip, FLUPS_BACKWARD, pstart, pend);
             _plan_backward_diff[ip]->correct_plan(_topo_hat[ip], mydata);
-            _plan_backward_diff[ip]->execute_plan(_topo_hat[ip], mydata);
-            if (_prof != NULL) _prof->stop("fftw");
+            _plan_backward_diff[ip]->execute_plan(_topo_hat[ip], mydata, pstart, pend);
+            if (_prof != NULL) _prof->stop(_profFFTW);
             // get if we are now complex
             if (_plan_forward[ip]->isr2c()) {
                 _topo_hat[ip]->switch2real();
             }
-            _switchtopo[ip]->execute(mydata, FLUPS_BACKWARD);
+            _switchtopo[ip]->execute(mydata, FLUPS_BACKWARD, (ip == 0) ? field : NULL);
         }
     }
+#endif
     END_FUNC;
 }
 
@@ -1374,7 +2636,7 @@ void Solver::do_mult(double *data, const FLUPS_SolverType type) {
     BEGIN_FUNC;
     FLUPS_CHECK(data != NULL, "data is NULL", LOCATION);
 
-    if (_prof != NULL) _prof->start("domagic");
+    if (_prof != NULL) _prof->start(_profDomagic);
 
     // every lda is done at once inside the dothemagic functions
     if (type == STD) {
@@ -1431,10 +2693,45 @@ void Solver::do_mult(double *data, const FLUPS_SolverType type) {
         }
     }
 
-    if (_prof != NULL) _prof->stop("domagic");
+    if (_prof != NULL) _prof->stop(_profDomagic);
     END_FUNC;
 }
 
+/**
+ * @brief calls the user spectral operator on one pencil, see Solver::set_spectralOp()
+ * 
+ * The wave numbers of the pencil are computed in kbuf (3 * n doubles) as in the helpers of flups.h: k = (is + koffset) * kfact,
+ * where is is the symmetrized global index of the point.
+ * 
+ * @param op the user operator
+ * @param ctx the user context
+ * @param ax0 the axis of the topology
+ * @param istart the global starting index of the topology
+ * @param kfact the multiplication factor of the wave numbers
+ * @param koffset the offset of the wave numbers
+ * @param symstart the first symmetrized index
+ * @param n the number of points in the pencil
+ * @param nf the number of doubles per point
+ * @param lia the component
+ * @param i1 the local index of the pencil along ax0 + 1
+ * @param i2 the local index of the pencil along ax0 + 2
+ * @param green the Green's function along the pencil
+ * @param gnf the number of doubles per point of the Green's function
+ * @param data the data along the pencil
+ * @param kbuf a buffer of 3 * n doubles
+ */
+static inline void apply_spectralOp(FLUPS_SpectralOp op, void* ctx, const int ax0, const int istart[3], const double kfact[3], const double koffset[3], const double symstart[3],
+                                    const size_t n, const int nf, const int lia, const int i1, const int i2, const double* green, const int gnf, double* data, double* kbuf) {
+    for (size_t ii = 0; ii < n; ii++) {
+        int is[3];
+        cmpt_symID(ax0, ii, i1, i2, istart, symstart, 0, is);
+        for (int id = 0; id < 3; id++) {
+            kbuf[ii * 3 + id] = (is[id] + koffset[id]) * kfact[id];
+        }
+    }
+    op((int)n, nf, lia, kbuf, green, gnf, data, ctx);
+}
+
 //---------------------------------
 // kind = 0: real to real case
 #define KIND 0
@@ -1462,6 +2759,37 @@ void Solver::do_mult(double *data, const FLUPS_SolverType type) {
 #include "dothemagic_rot.ipp"
 #undef KIND
 
+/**
+ * @brief get the communication counters of the switch to the topology ip, accumulated since the setup or the last reset_commStats()
+ * 
+ * The switches are shared with the solvers created from this one (or from its reference), so are the counters.
+ * 
+ * @param ip the switch, from 0 to ndim-1
+ * @param stats the counters
+ */
+void Solver::get_commStats(const int ip, FLUPS_CommStats* stats) const {
+    BEGIN_FUNC;
+    FLUPS_CHECK(ip >= 0 && ip < _ndim, "the switch %d does not exist, it must be between 0 and %d", ip, _ndim - 1, LOCATION);
+    FLUPS_CHECK(_switchtopo[ip] != NULL, "the solver must be setup first", LOCATION);
+    FLUPS_CHECK(stats != NULL, "stats is NULL", LOCATION);
+    *stats = _switchtopo[ip]->get_commStats();
+    END_FUNC;
+}
+
+/**
+ * @brief reset the communication counters of every switch
+ * 
+ */
+void Solver::reset_commStats() {
+    BEGIN_FUNC;
+    for (int ip = 0; ip < _ndim; ip++) {
+        if (_switchtopo[ip] != NULL) {
+            _switchtopo[ip]->reset_commStats();
+        }
+    }
+    END_FUNC;
+}
+
 /**
  * @brief reorder the MPI-ranks using metis
  * 
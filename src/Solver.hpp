@@ -27,15 +27,21 @@
 #define FFTW_SOLVER_HPP
 
 #include <cstring>
+#include <limits>
 #include <map>
+#include <vector>
 #include "FFTW_plan_dim.hpp"
 #include "defines.hpp"
+#include "dothemagic_kernels.hpp"
 #include "green_functions.hpp"
 #include "hdf5_io.hpp"
 
 #include "SwitchTopo.hpp"
 #include "SwitchTopo_a2a.hpp"
 #include "SwitchTopo_nb.hpp"
+#include "SwitchTopo_node.hpp"
+#include "SwitchTopo_dt.hpp"
+#include "BufferPool.hpp"
 
 #include "Profiler.hpp"
 #include "omp.h"
@@ -74,6 +80,9 @@ class Solver {
     double         _volfact       = 1.0;   /**< @brief volume factor due to the convolution computation */
     double         _hgrid[3]      = {0.0}; /**< @brief grid spacing in the tranposed directions */
     double*        _data          = NULL;  /**< @brief data pointer to the transposed memory */
+    unsigned       _fftwFlag      = FFTW_FLAG; /**< @brief the FFTW planner flag */
+    std::string    _wisdomFile    = "";    /**< @brief the FFTW wisdom file, empty if not used */
+    bool           _wisdomRead    = false; /**< @brief true if the FFTW wisdom has been read from #_wisdomFile, see _import_wisdom() */
 
     /**
      * @name Forward and backward 
@@ -89,24 +98,88 @@ class Solver {
     SwitchTopo*    _switchtopo[3] = {NULL, NULL, NULL}; /**< @brief switcher of topologies for the forward transform (phys->topo[0], topo[0]->topo[1], topo[1]->topo[2]).*/
     opt_double_ptr _sendBuf       = NULL;               /**<@brief The send buffer for _switchtopo */
     opt_double_ptr _recvBuf       = NULL;               /**<@brief The recv buffer for _switchtopo */
+    int            _poolId        = -1;                 /**<@brief my id in the BufferPool */
+    int            _poolGeneration = -1;                /**<@brief the generation of the BufferPool used by _switchtopo, see _relink_switchTopo() */
+    size_t         _bufMemSize    = 0;                  /**<@brief the size of each buffer required by _switchtopo, in doubles */
+    double*        _scratch       = NULL;               /**<@brief the scratch memory given by the user to store the buffers, NULL if not used */
+    size_t         _scratchSize   = 0;                  /**<@brief the number of doubles in _scratch */
+    bool           _useScratch    = false;              /**<@brief true if the buffers are stored in _scratch instead of the BufferPool */
+    int            _switchShift[3][3] = {{0}};           /**<@brief the shift in memory of each _switchtopo */
+    FLUPS_SwitchType _switchType   = SWITCH_DEFAULT;     /**<@brief the requested communication pattern for _switchtopo */
+    bool           _isSlab        = false;              /**<@brief true if _topo_hat[0] and _topo_hat[1] are slabs, see _init_plansAndTopos() */
     /**@} */
 
+    /**
+     * @name Support of the rhs and of the solution, see set_support()
+     * 
+     */
+    /**@{ */
+    bool _hasSupport     = false;                /**< @brief true if a support has been given, every pencil is transformed otherwise */
+    int  _rhsStart[3]    = {0, 0, 0};            /**< @brief the first global index of the non-zero rhs in the physical topology */
+    int  _rhsEnd[3]      = {0, 0, 0};            /**< @brief the last global index (excluded) of the non-zero rhs in the physical topology */
+    int  _solStart[3]    = {0, 0, 0};            /**< @brief the first global index of the solution needed in the physical topology */
+    int  _solEnd[3]      = {0, 0, 0};            /**< @brief the last global index (excluded) of the solution needed in the physical topology */
+    /**@} */
+
+    FLUPS_SpectralOp _spectralOp    = NULL; /**< @brief the user operator called on each pencil in the dothemagic functions, NULL if none */
+    void*            _spectralCtx   = NULL; /**< @brief the user context given to _spectralOp */
+
     /**
      * @name Green's function (and corresponding forward transform) related vars and objects
      * 
      */
     /**@{ */
     double    _alphaGreen = 2.0;    /**< @brief regularization parameter for HEJ_* Green's functions */
+    double    _kappaGreen = 0.0;    /**< @brief screening parameter: the solved equation is (nabla^2 - kappa^2) u = f, kappa = 0 being the Poisson equation */
     double*   _green      = NULL;   /**< @brief data pointer to the transposed memory for Green */
     GreenType _typeGreen  = CHAT_2; /**< @brief the type of Green's function */
+    std::string _greenCache = "";   /**< @brief the file used to store the Green's function in spectral space, empty if not used */
+    bool        _greenCompact = false;  /**< @brief if true, the Green's function is reallocated to its final size and only its real part is kept when possible */
+    int         _greenNf      = 1;      /**< @brief the number of doubles in one element of the Green's function: 1 if only the real part is stored */
+    size_t      _greenStride  = 0;      /**< @brief the memory between two pencils of the Green's function, in doubles */
+    bool        _greenMatrixFree  = false;             /**< @brief if true, the Green's function is evaluated on the fly in the dothemagic functions and not stored */
+    double      _greenKfact[3]    = {0.0, 0.0, 0.0};   /**< @brief the k multiplicative factor of the Green's function, for the matrix-free evaluation */
+    double      _greenKoffset[3]  = {0.0, 0.0, 0.0};   /**< @brief the k additive factor of the Green's function, for the matrix-free evaluation */
+    double      _greenSymstart[3] = {0.0, 0.0, 0.0};   /**< @brief the symmetry index of the Green's function, for the matrix-free evaluation */
+    double*     _greenBuf         = NULL;              /**< @brief one pencil of the Green's function per thread, for the matrix-free evaluation */
+    int         _greenBufNth      = 0;                 /**< @brief the number of threads for which #_greenBuf is allocated */
 
     FFTW_plan_dim* _plan_green[3];                            /**< @brief map containing the plan for the Green's function */
     Topology*      _topo_green[3]       = {NULL, NULL, NULL}; /**< @brief list of topos dedicated to Green's function */
     SwitchTopo*    _switchtopo_green[3] = {NULL, NULL, NULL}; /**< @brief switcher of topos for the Green's forward transform*/
+    bool           _greenSwitchReady    = false;              /**< @brief true once the switches of the Green's function have been setup */
+    bool           _greenPlanned        = false;              /**< @brief true once the plans of the Green's function have been allocated */
+    /**@} */
+
+    /**
+     * @name Sharing with a reference solver, see Solver(Solver* ref, ...)
+     * 
+     */
+    /**@{ */
+    Solver* _ref        = NULL;  /**< @brief the solver this one has been created from, NULL if none */
+    int     _nderived   = 0;     /**< @brief the number of solvers created from this one */
+    bool    _shareTopo  = false; /**< @brief if true, _topo_hat, _switchtopo and _data are the ones of _ref */
+    bool    _sharePlans = false; /**< @brief if true, the plans of the field are the ones of _ref */
+    /**@} */
+
+    static int _nalive; /**< @brief the number of solvers alive in the process, FFTW is cleaned up when the last one is destroyed */
+
+    /**
+     * @name Split-phase solve, see solve_begin()
+     * 
+     */
+    /**@{ */
+    int              _splitStage = -1;   /**< @brief the switch in progress: ip if < _ndim for the forward switches, 2*_ndim-1-ip for the backward ones, -1 if no solve in progress */
+    FLUPS_SolverType _splitType  = STD;  /**< @brief the type of the solve in progress */
+    double**         _splitField = NULL; /**< @brief the pointers to every component of the field of the solve in progress */
     /**@} */
 
     // time the solve
-    Profiler* _prof = NULL;
+    Profiler* _prof        = NULL;
+    int       _profSolve   = -1; /**< @brief handle of the timer "solve" in _prof */
+    int       _profCopy    = -1; /**< @brief handle of the timer "copy" in _prof */
+    int       _profFFTW    = -1; /**< @brief handle of the timer "fftw" in _prof */
+    int       _profDomagic = -1; /**< @brief handle of the timer "domagic" in _prof */
 
    protected:
     /**
@@ -114,6 +187,7 @@ class Solver {
      * 
      * @{
      */
+    void _init(Topology* topo, BoundaryType* rhsbc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, Profiler* prof);
     void _allocate_data(const Topology *const topo[3], const Topology *topo_phys, double **data);
     void _delete_switchtopos(SwitchTopo* switchtopo[3]);
     void _delete_topologies(Topology* topo[3]);
@@ -125,9 +199,13 @@ class Solver {
      * @{
      */
     void _sort_plans(FFTW_plan_dim* plan[3]);
+    void _sort_plans2D(const Topology* topo);
     void _init_plansAndTopos(const Topology* topo, Topology* topomap[3], SwitchTopo* switchtopo[3], FFTW_plan_dim* planmap[3], bool isGreen);
     void _allocate_plans(const Topology* const topo[3], FFTW_plan_dim* planmap[3], double* data);
     void _delete_plans(FFTW_plan_dim* planmap[3]);
+    void _import_wisdom();
+    void _bcast_wisdom();
+    void _export_wisdom();
     /**@} */
 
     /**
@@ -135,8 +213,18 @@ class Solver {
      * 
      * @{
      */
-    void _allocate_switchTopo(const int ntopo, SwitchTopo** switchtopo, opt_double_ptr* send_buff, opt_double_ptr* recv_buff);
+    void _allocate_switchTopo(const int ntopo, SwitchTopo** switchtopo, opt_double_ptr* send_buff, opt_double_ptr* recv_buff, const bool isSetup = false);
     void _deallocate_switchTopo(SwitchTopo** switchtopo, opt_double_ptr* send_buff, opt_double_ptr* recv_buff);
+    void _relink_switchTopo();
+    void _split_next();
+    /**
+     * @brief returns true if the switches use the BufferPool, false if they use the scratch of the user
+     */
+    bool _usePool() const { return (_shareTopo) ? _ref->_usePool() : (!_useScratch && _sendBuf != NULL); }
+    void _support_box(const int ip, const int sign, int start[3], int end[3]) const;
+    SwitchTopo* _new_switchTopo(const Topology* topo_in, const Topology* topo_out, const int shift[3], Profiler* prof, const FLUPS_SwitchType type);
+    void _reset_switchTopo(const FLUPS_SwitchType type, Profiler* prof);
+    void _autotune_switchTopo();
     void _reorder_metis(MPI_Comm comm, int *sources, int *sourcesW, int *dests, int *destsW, int *order);
     /**@} */
 
@@ -162,10 +250,17 @@ class Solver {
     void _cmptGreenSymmetry(const Topology* topo, const int sym_idx, double* data, const bool isComplex);
     void _scaleGreenFunction(const Topology* topo, double* data, bool killModeZero);
     void _finalizeGreenFunction(Topology* topo_field, double* green, const Topology* topo, FFTW_plan_dim* planmap[3]);
+    void _compactGreenFunction(const Topology* topo, double** green);
+    void _setup_green();
+    void _init_greenMatrixFree(FFTW_plan_dim* planmap[3]);
+    double* _get_greenBuf();
+    double _cmptGreenLength() const;
+    std::string _cmptGreenKey(const Topology* topo, FFTW_plan_dim* planmap[3]);
     /**@} */
 
    public:
     Solver(Topology* topo, BoundaryType* rhsbc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, Profiler* prof);
+    Solver(Solver* ref, BoundaryType* rhsbc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, Profiler* prof);
     ~Solver();
 
     double* setup(const bool changeTopoComm);
@@ -186,6 +281,16 @@ class Solver {
         return size_tot;
     };
 
+    /**
+     * @brief Get the number of doubles required in a scratch array to store the communication buffers (see set_commScratch())
+     * 
+     * @return size_t 0 before the setup
+     */
+    size_t get_commScratchSize() const { return (_bufMemSize > 0) ? BufferPool::memsize(_bufMemSize) : 0; }
+
+    void get_commStats(const int ip, FLUPS_CommStats* stats) const;
+    void reset_commStats();
+
     /**
      * @brief Get the spectral information to compute the modes k in full spectral space
      * 
@@ -208,6 +313,10 @@ class Solver {
      * @{
      */
     void solve(double *field, double *rhs,const FLUPS_SolverType type);
+    void solve_many(double **field, double **rhs, const int n, const FLUPS_SolverType type);
+    void solve_begin(double *field, double *rhs, const FLUPS_SolverType type);
+    bool solve_progress();
+    void solve_end();
     /**@} */
 
     /**
@@ -216,8 +325,12 @@ class Solver {
      * @{
      */
     void do_copy(const Topology *topo, double *data, const int sign );
+    void do_copy(const Topology *topo, double **data, const int sign );
     void do_FFT(double *data, const int sign);
+    void do_FFT(double *data, double **field, const int sign);
     void do_mult(double *data,const FLUPS_SolverType type);
+    void set_support(const int rhsStart[3], const int rhsEnd[3], const int solStart[3], const int solEnd[3]);
+    void set_spectralOp(FLUPS_SpectralOp op, void* ctx) { _spectralOp = op; _spectralCtx = ctx; }
     /**@} */
 
     /**
@@ -227,6 +340,23 @@ class Solver {
      */
     void set_GreenType(const GreenType type) { _typeGreen = type; }
     void set_alpha(const double alpha) { _alphaGreen = alpha; }
+    void set_kappa(const double kappa) { _kappaGreen = kappa; }
+    void set_GreenCache(const std::string filename) { _greenCache = filename; }
+    void set_GreenCompact(const bool compact) { _greenCompact = compact; }
+    void set_GreenMatrixFree(const bool matrixFree) { _greenMatrixFree = matrixFree; }
+    void update_green(const GreenType type, const double alpha);
+    void update_kappa(const double kappa);
+    /**@} */
+
+    /**
+     * @name FFTW planner
+     * 
+     * @{
+     */
+    void set_fftwFlag(const unsigned flag) { _fftwFlag = flag; }
+    void set_switchType(const FLUPS_SwitchType type) { _switchType = type; }
+    void set_commScratch(double* scratch, const size_t size) { _scratch = scratch; _scratchSize = (scratch == NULL) ? 0 : size; }
+    void set_wisdomFile(const std::string filename) { _wisdomFile = filename; }
     /**@} */
 };
 
@@ -294,9 +424,11 @@ class Solver {
  * @param comm_size the total communicator size
  * @param id_hint the axis where we allow the proc decomposition to change
  * @param nproc_hint the number of procs in the other decomposition we want to be compatible with
+ * @param ndim the dimension of the problem, in 2D the decomposition is always a slab
+ * @param isSlab true if a slab decomposition is requested (see DECOMP_SLAB), no warning is then issued
  * 
  */
-static inline void pencil_nproc_hint(const int id, int nproc[3], const int comm_size, const int id_hint, const int nproc_hint[3]) {
+static inline void pencil_nproc_hint(const int id, int nproc[3], const int comm_size, const int id_hint, const int nproc_hint[3], const int ndim = 3, const bool isSlab = false) {
     // get the id shared between the hint topo
     int sharedID = 0;
     for (int i = 0; i < 3; i++) {
@@ -312,7 +444,7 @@ static inline void pencil_nproc_hint(const int id, int nproc[3], const int comm_
     FLUPS_INFO("My proc repartition in this topo is %d %d %d",nproc[0],nproc[1],nproc[2]);
     FLUPS_CHECK(nproc[0] * nproc[1] * nproc[2] == comm_size, "the number of proc %d %d %d does not match the comm size %d", nproc[0], nproc[1], nproc[2], comm_size, LOCATION);
 
-    if(comm_size>8 && (nproc[sharedID]==1||nproc[id_hint]==1)){
+    if(ndim == 3 && !isSlab && comm_size>8 && (nproc[sharedID]==1||nproc[id_hint]==1)){
         FLUPS_WARNING("A slab decomposition was used instead of a pencil decomposition in direction %d. This may increase communication time.",id, LOCATION);
     }
 }
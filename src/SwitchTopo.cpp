@@ -30,6 +30,8 @@
 #include "SwitchTopo.hpp"
 #include "Topology.hpp"
 #include <limits>
+#include <algorithm>
+#include <vector>
 
 /**
  * @brief computes nByBlock, the unit block size
@@ -615,10 +617,10 @@ void SwitchTopo::_setup_shuffle(const int bSize[3], const Topology* topo_in, con
     // plan the real or complex plan
     // the nf is driven by the OUT topology ALWAYS
     if (nf == 1) {
-        *shuffle = fftw_plan_guru_r2r(0, NULL, 2, dims, data, data, NULL, FFTW_FLAG);
+        *shuffle = fftw_plan_guru_r2r(0, NULL, 2, dims, data, data, NULL, _fftwFlag);
         FLUPS_CHECK(*shuffle != NULL, "Plan has not been setup", LOCATION);
     } else if (nf == 2) {
-        *shuffle = fftw_plan_guru_dft(0, NULL, 2, dims, (fftw_complex*)data, (fftw_complex*)data, FLUPS_FORWARD, FFTW_FLAG);
+        *shuffle = fftw_plan_guru_dft(0, NULL, 2, dims, (fftw_complex*)data, (fftw_complex*)data, FLUPS_FORWARD, _fftwFlag);
         FLUPS_CHECK(*shuffle != NULL, "Plan has not been setup", LOCATION);
     }
 
@@ -651,4 +653,234 @@ void SwitchTopo::add_toGraph(int* sourcesW, int* destsW) const{
     // between 2 processes have been accounted by both procs. However, the weight
     // is relative so it doesnt matter.
     END_FUNC;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief add one execution of the switch to the communication counters
+ * 
+ * The volumes are computed from the blocks: a block going to another rank is sent, a block staying on the rank is counted in bytesSelf.
+ * 
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ * @param timeComm the time spent in the MPI calls during the execution
+ * @param isPerBlock true if one message is sent for each block (SwitchTopo_nb), false if one message is sent to each rank (all-to-all)
+ */
+void SwitchTopo::_add_commStats(const int sign, const double timeComm, const bool isPerBlock) const {
+    BEGIN_FUNC;
+    int rank;
+    MPI_Comm_rank(_subcomm, &rank);
+
+    const bool        isForward   = (sign == FLUPS_FORWARD);
+    const int         send_nBlock = (isForward) ? _inBlock : _onBlock;
+    const int         recv_nBlock = (isForward) ? _onBlock : _inBlock;
+    const int* const* sendSize    = (isForward) ? _iBlockSize : _oBlockSize;
+    const int* const* recvSize    = (isForward) ? _oBlockSize : _iBlockSize;
+    const int*        sendRank    = (isForward) ? _i2o_destRank : _o2i_destRank;
+    const int*        recvRank    = (isForward) ? _o2i_destRank : _i2o_destRank;
+    const int         nf          = _topo_in->nf();
+    const size_t      lda         = (size_t)_topo_in->lda();
+
+    // the distinct ranks we send to
+    std::vector<int> peers;
+    for (int ib = 0; ib < send_nBlock; ib++) {
+        const size_t bytes = get_blockMemSize(ib, nf, sendSize) * lda * FLUPS_COMM_SIZEOF;
+        if (sendRank[ib] == rank) {
+            _commStats.bytesSelf += bytes;
+        } else {
+            _commStats.bytesSent += bytes;
+            _commStats.msgSent += (isPerBlock) ? 1 : 0;
+            peers.push_back(sendRank[ib]);
+        }
+    }
+    std::sort(peers.begin(), peers.end());
+    const int nSendPeers = (int)(std::unique(peers.begin(), peers.end()) - peers.begin());
+    // the distinct ranks we receive from
+    peers.clear();
+    for (int ib = 0; ib < recv_nBlock; ib++) {
+        if (recvRank[ib] != rank) {
+            _commStats.bytesRecv += get_blockMemSize(ib, nf, recvSize) * lda * FLUPS_COMM_SIZEOF;
+            _commStats.msgRecv += (isPerBlock) ? 1 : 0;
+            peers.push_back(recvRank[ib]);
+        }
+    }
+    std::sort(peers.begin(), peers.end());
+    const int nRecvPeers = (int)(std::unique(peers.begin(), peers.end()) - peers.begin());
+
+    // the all-to-all exchanges one message with each rank
+    if (!isPerBlock) {
+        _commStats.msgSent += nSendPeers;
+        _commStats.msgRecv += nRecvPeers;
+    }
+    _commStats.peers = std::max(_commStats.peers, std::max(nSendPeers, nRecvPeers));
+    _commStats.timeComm += timeComm;
+    _commStats.count++;
+    END_FUNC;
+}
+
+/**
+ * @brief returns true if the blocks cover every local point of the topology
+ * 
+ * @param nBlock the number of blocks
+ * @param blockSize the size of each block
+ * @param topo the topology in which the blocks are defined
+ */
+bool SwitchTopo::_is_fullyCovered(const int nBlock, int* const blockSize[3], const Topology* topo) const {
+    BEGIN_FUNC;
+    size_t ncovered = 0;
+    for (int ib = 0; ib < nBlock; ib++) {
+        ncovered += (size_t)blockSize[0][ib] * (size_t)blockSize[1][ib] * (size_t)blockSize[2][ib];
+    }
+    const size_t nlocal = (size_t)topo->nloc(0) * (size_t)topo->nloc(1) * (size_t)topo->nloc(2);
+    END_FUNC;
+    return (ncovered == nlocal);
+}
+
+/**
+ * @brief set to 0 the local points of the components of field
+ * 
+ * @param topo the topology of field
+ * @param field the topo->lda() components of the field, each one in the memory layout of topo
+ */
+void SwitchTopo::_reset_field(const Topology* topo, double* const* field) const {
+    BEGIN_FUNC;
+    const int    ax0     = topo->axis();
+    const int    nf      = topo->nf();
+    const int    lda     = topo->lda();
+    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const int    nloc1   = topo->nloc((ax0 + 1) % 3);
+    const int    ondim   = nloc1 * topo->nloc((ax0 + 2) % 3);
+    const int    id_max  = ondim * lda;
+    const size_t nmax    = (size_t)topo->nloc(ax0) * (size_t)nf;
+
+#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(field, ax0, nf, nmem, nloc1, ondim, id_max, nmax)
+    for (int id = 0; id < id_max; id++) {
+        const int lia = id / ondim;
+        const int io  = id % ondim;
+        double* __restrict floc = field[lia] + localIndex(ax0, 0, io % nloc1, io / nloc1, ax0, nmem, nf, 0);
+        for (size_t i0 = 0; i0 < nmax; i0++) {
+            floc[i0] = 0.0;
+        }
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief set to 0 the memory of v that will not be covered by the blocks
+ * 
+ * The blocks received by a rank form a box in its local memory, i.e. the intersection of the input topology with the local domain.
+ * They overwrite the memory, so only the points outside the box have to be reset: in an unbounded direction, the zero padding
+ * is the only part written here instead of being written twice. If the blocks do not form a box, the whole memory is reset.
+ * 
+ * @param nBlock the number of blocks
+ * @param blockSize the size of each block
+ * @param blockiStart the starting index of each block in the local memory of topo
+ * @param topo the topology of v
+ * @param v the memory, all the components are stored one after the other
+ */
+void SwitchTopo::_reset_padding(const int nBlock, int* const blockSize[3], int* const blockiStart[3], const Topology* topo, double* v) const {
+    BEGIN_FUNC;
+    // get the box covered by the blocks, empty if there is no block
+    int    lo[3]    = {0, 0, 0};
+    int    hi[3]    = {0, 0, 0};
+    size_t ncovered = 0;
+    for (int ib = 0; ib < nBlock; ib++) {
+        for (int id = 0; id < 3; id++) {
+            lo[id] = (ib == 0) ? blockiStart[id][ib] : std::min(lo[id], blockiStart[id][ib]);
+            hi[id] = (ib == 0) ? blockiStart[id][ib] + blockSize[id][ib] : std::max(hi[id], blockiStart[id][ib] + blockSize[id][ib]);
+        }
+        ncovered += (size_t)blockSize[0][ib] * (size_t)blockSize[1][ib] * (size_t)blockSize[2][ib];
+    }
+    if (ncovered != (size_t)(hi[0] - lo[0]) * (size_t)(hi[1] - lo[1]) * (size_t)(hi[2] - lo[2])) {
+        for (int id = 0; id < 3; id++) {
+            lo[id] = 0;
+            hi[id] = 0;
+        }
+    }
+
+    const int    ax0     = topo->axis();
+    const int    ax1     = (ax0 + 1) % 3;
+    const int    ax2     = (ax0 + 2) % 3;
+    const int    nf      = topo->nf();
+    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const int    nrow    = nmem[ax1] * nmem[ax2];
+    const int    id_max  = nrow * topo->lda();
+    const size_t nmax    = (size_t)nmem[ax0] * (size_t)nf;
+    // the points of a row inside the box, [i0start, i0end)
+    const size_t i0start = (size_t)lo[ax0] * (size_t)nf;
+    const size_t i0end   = (size_t)hi[ax0] * (size_t)nf;
+
+#pragma omp parallel for proc_bind(close) schedule(static) default(none) firstprivate(v, lo, hi, ax0, ax1, ax2, nf, nmem, nrow, id_max, nmax, i0start, i0end)
+    for (int id = 0; id < id_max; id++) {
+        const int lia = id / nrow;
+        const int i1  = (id % nrow) % nmem[ax1];
+        const int i2  = (id % nrow) / nmem[ax1];
+        double* __restrict vloc = v + localIndex(ax0, 0, i1, i2, ax0, nmem, nf, lia);
+        // the row crosses the box: only reset before and after it
+        const bool   isInBox = (lo[ax1] <= i1 && i1 < hi[ax1] && lo[ax2] <= i2 && i2 < hi[ax2]);
+        const size_t iend    = (isInBox) ? i0start : nmax;
+        for (size_t i0 = 0; i0 < iend; i0++) {
+            vloc[i0] = 0.0;
+        }
+        if (isInBox) {
+            for (size_t i0 = i0end; i0 < nmax; i0++) {
+                vloc[i0] = 0.0;
+            }
+        }
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief copy the local points between the memory v and the components of field, both in the memory layout of topo
+ * 
+ * This is used when a switch is skipped while given a field (see SwitchTopo_a2a::execute):
+ * - FLUPS_FORWARD: v is reset to 0 and field is copied in it
+ * - FLUPS_BACKWARD: v is copied in field, with non-temporal stores above FLUPS_NT_THRESHOLD
+ * 
+ * @param topo the topology of v and field
+ * @param v the memory, all the components are stored one after the other
+ * @param field the topo->lda() components of the field
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ */
+void SwitchTopo::_copy_field(const Topology* topo, double* v, double* const* field, const int sign) const {
+    BEGIN_FUNC;
+    const int    ax0     = topo->axis();
+    const int    nf      = topo->nf();
+    const int    lda     = topo->lda();
+    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const int    nloc1   = topo->nloc((ax0 + 1) % 3);
+    const int    ondim   = nloc1 * topo->nloc((ax0 + 2) % 3);
+    const int    id_max  = ondim * lda;
+    const size_t nmax    = (size_t)topo->nloc(ax0) * (size_t)nf;
+
+    // the field is not read by the solver after the backward copy
+    const bool isNT = (sign != FLUPS_FORWARD) && (sizeof(double) * nmax * id_max >= FLUPS_NT_THRESHOLD);
+
+    if (sign == FLUPS_FORWARD) {
+        std::memset(v, 0, sizeof(double) * topo->memsize());
+    }
+#pragma omp parallel proc_bind(close) default(none) firstprivate(v, field, sign, ax0, nf, nmem, nloc1, ondim, id_max, nmax, isNT)
+    {
+#pragma omp for schedule(static)
+        for (int id = 0; id < id_max; id++) {
+            const int lia = id / ondim;
+            const int io  = id % ondim;
+            const size_t       offset = localIndex(ax0, 0, io % nloc1, io / nloc1, ax0, nmem, nf, 0);
+            double* __restrict vloc   = v + localIndex(ax0, 0, io % nloc1, io / nloc1, ax0, nmem, nf, lia);
+            double* __restrict floc   = field[lia] + offset;
+            if (sign == FLUPS_FORWARD) {
+                for (size_t i0 = 0; i0 < nmax; i0++) {
+                    vloc[i0] = floc[i0];
+                }
+            } else if (isNT) {
+                flups_stream_copy(floc, vloc, nmax);
+            } else {
+                for (size_t i0 = 0; i0 < nmax; i0++) {
+                    floc[i0] = vloc[i0];
+                }
+            }
+        }
+        // make the non-temporal stores visible
+        if (isNT) flups_stream_fence();
+    }
+    END_FUNC;
+}
@@ -28,6 +28,7 @@
 
 #include <cstring>
 #include "Topology.hpp"
+#include "FFTW_plan_dim.hpp"
 #include "defines.hpp"
 #include "mpi.h"
 #include "omp.h"
@@ -73,19 +74,73 @@ class SwitchTopo {
 
     fftw_plan* _i2o_shuffle = NULL;
     fftw_plan* _o2i_shuffle = NULL;
+    unsigned   _fftwFlag    = FFTW_FLAG; /**<@brief the FFTW planner flag used for the shuffle plans */
 
 #ifdef PROF
-    Profiler* _prof    = NULL;
+    Profiler* _prof        = NULL;
+    int       _profReorder = -1; /**<@brief handle of the timer "reorder" in _prof, see _init_profHandles() */
+    int       _profSwitch  = -1; /**<@brief handle of the timer "switch" of this switch */
+    int       _profMem2buf = -1; /**<@brief handle of the timer "mem2buf" of this switch */
+    int       _profBuf2mem = -1; /**<@brief handle of the timer "buf2mem" of this switch */
+    int       _profComm    = -1; /**<@brief handle of the timer of the communications of this switch: "waiting" (SwitchTopo_nb) or "all_2_all" */
+    int       _profCommV   = -1; /**<@brief handle of the timer "all_2_all_v" of this switch */
+
+    /**
+     * @brief get the handles of the timers of this switch, once they have been created in _prof
+     * 
+     */
+    void _init_profHandles() {
+        if (_prof != NULL) {
+            const string id = to_string(_iswitch);
+            _profReorder    = _prof->handle("reorder");
+            _profSwitch     = _prof->handle("switch" + id);
+            _profMem2buf    = _prof->handle("mem2buf" + id);
+            _profBuf2mem    = _prof->handle("buf2mem" + id);
+            _profComm       = (_prof->handle("waiting" + id) >= 0) ? _prof->handle("waiting" + id) : _prof->handle("all_2_all" + id);
+            _profCommV      = _prof->handle("all_2_all_v" + id);
+        }
+    }
 #endif 
     int       _iswitch = -1;
 
+    mutable FLUPS_CommStats _commStats = {0, 0, 0, 0, 0, 0, 0, 0.0}; /**<@brief the communication counters, see _add_commStats() */
+
    public:
     virtual ~SwitchTopo() {};
     virtual void setup()                                                                    = 0;
     virtual void setup_buffers(opt_double_ptr sendData, opt_double_ptr recvData)            = 0;
-    virtual void execute(opt_double_ptr v, const int sign) const                            = 0;
+    virtual void execute(opt_double_ptr v, const int sign, double* const* field = NULL) const                            = 0;
+    virtual void execute_pipelined(opt_double_ptr v, const int sign, const FFTW_plan_dim* plan, double* const* field = NULL) const = 0;
     virtual void disp() const                                                               = 0;
 
+    /**
+     * @brief changes the profiler of the switch, whose timers must have been created by the constructor (NULL disables the profiling)
+     */
+    void set_prof(Profiler* prof) {
+#ifdef PROF
+        _prof = prof;
+        _init_profHandles();
+#endif
+    }
+
+    /**
+     * @brief returns true if the switch allocates its own buffers, which are then not part of the buffers of the Solver (see Solver::_allocate_switchTopo())
+     */
+    virtual bool ownBuffers() const { return false; }
+
+    /**
+     * @name Split-phase execution
+     * 
+     * The switch is started by execute_begin(), progresses with execute_test() and is completed by execute_end(), with the same arguments as execute().
+     * The input data can be modified once execute_begin() returns, the output data is available once execute_test() returns true or execute_end() returns.
+     * By default the whole switch is done in execute_begin().
+     * @{
+     */
+    virtual void execute_begin(opt_double_ptr v, const int sign, double* const* field = NULL) const { execute(v, sign, field); }
+    virtual bool execute_test(opt_double_ptr v, const int sign, double* const* field = NULL) const { return true; }
+    virtual void execute_end(opt_double_ptr v, const int sign, double* const* field = NULL) const {}
+    /**@} */
+
     /**
      * @brief Get the memory size of a block padded to ensure alignment
      *
@@ -131,6 +186,22 @@ class SwitchTopo {
 
     void add_toGraph(int* sourcesW, int* destsW) const;
 
+    /**
+     * @brief set the FFTW planner flag used for the shuffle plans, must be called before setup_buffers()
+     * 
+     * @param flag the FFTW planner flag (FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT,...)
+     */
+    inline void set_fftwFlag(const unsigned flag) { _fftwFlag = flag; }
+
+    /**
+     * @name Communication counters
+     * 
+     * @{
+     */
+    inline const FLUPS_CommStats& get_commStats() const { return _commStats; }
+    inline void                   reset_commStats() { _commStats = {0, 0, 0, 0, 0, 0, 0, 0.0}; }
+    /**@} */
+
    protected:
     void _cmpt_nByBlock(int istart[3], int iend[3], int ostart[3], int oend[3],int nByBlock[3]);
     void _cmpt_blockDestRank(const int nBlock[3], const int nByBlock[3], const int shift[3], const int istart[3], const Topology* topo_in, const Topology* topo_out, int* destRank);
@@ -142,12 +213,52 @@ class SwitchTopo {
     void _setup_shuffle(const int bSize[3], const Topology* topo_in, const Topology* topo_out, double* data, fftw_plan* shuffle);
     void _gather_blocks(const Topology* topo, int nByBlock[3], int istart[3],int iend[3], int nBlockv[3], int* blockSize[3], int* blockiStart[3], int* nBlock, int** destRank);
     void _gather_tags(MPI_Comm comm, const int inBlock, const int onBlock, const int* i2o_destRank, const int* o2i_destRank, int** i2o_destTag, int** o2i_destTag);
+
+    void _add_commStats(const int sign, const double timeComm, const bool isPerBlock) const;
+    bool _is_fullyCovered(const int nBlock, int* const blockSize[3], const Topology* topo) const;
+    void _reset_field(const Topology* topo, double* const* field) const;
+    void _reset_padding(const int nBlock, int* const blockSize[3], int* const blockiStart[3], const Topology* topo, double* v) const;
+    void _copy_field(const Topology* topo, double* v, double* const* field, const int sign) const;
 };
 
 static inline int gcd(int a, int b) {
     return (a == 0) ? b : gcd(b % a, a);
 }
 
+/**
+ * @brief convert in place a buffer of n doubles to n floats, stored in the first half of the buffer
+ * 
+ * The conversion is done forward so that a double entry is read before being overwritten.
+ * We use memcpy to write the floats as the memory is also seen as double.
+ * 
+ * @param buf the buffer
+ * @param n the number of doubles in the buffer
+ */
+static inline void buf_double2float(double* buf, const size_t n) {
+    char* fbuf = (char*)buf;
+    for (size_t i = 0; i < n; i++) {
+        const float tmp = (float)buf[i];
+        std::memcpy(fbuf + i * sizeof(float), &tmp, sizeof(float));
+    }
+}
+
+/**
+ * @brief convert in place a buffer of n floats, stored in the first half of the buffer, back to n doubles
+ * 
+ * The conversion is done backward so that a float entry is read before being overwritten.
+ * 
+ * @param buf the buffer
+ * @param n the number of floats in the buffer
+ */
+static inline void buf_float2double(double* buf, const size_t n) {
+    const char* fbuf = (const char*)buf;
+    for (size_t i = n; i > 0; i--) {
+        float tmp;
+        std::memcpy(&tmp, fbuf + (i - 1) * sizeof(float), sizeof(float));
+        buf[i - 1] = (double)tmp;
+    }
+}
+
 /**
  * @brief translate a list of ranks of size size from inComm to outComm
  * 
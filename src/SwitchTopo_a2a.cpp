@@ -121,6 +121,7 @@ SwitchTopo_a2a::SwitchTopo_a2a(const Topology* topo_input, const Topology* topo_
         _prof->create("all_2_all2", "switch2");
         _prof->create("all_2_all_v2", "switch2");
     }
+    _init_profHandles();
 #endif
     END_FUNC;
 }
@@ -246,6 +247,7 @@ void SwitchTopo_a2a::setup() {
         _outComm = outComm;
 
         //reinit the block information
+        _free_buffers();
         _free_blockInfo();
 
         //The input topo may have been reset to real, even if this switchtopo is a complex2complex. 
@@ -397,10 +399,22 @@ SwitchTopo_a2a::~SwitchTopo_a2a() {
     if (_i2o_start != NULL) flups_free(_i2o_start);
     if (_o2i_start != NULL) flups_free(_o2i_start);
 
+    _free_buffers();
+    _free_blockInfo();
+
+    END_FUNC;
+}
+
+/**
+ * @brief free the block buffers and the shuffle plans created by setup_buffers()
+ * 
+ * The raw buffers are not owned by the switch and are not freed.
+ */
+void SwitchTopo_a2a::_free_buffers() {
     if (_sendBuf != NULL) flups_free((double*)_sendBuf);
     if (_recvBuf != NULL) flups_free((double*)_recvBuf);
-
-    _free_blockInfo();
+    _sendBuf = NULL;
+    _recvBuf = NULL;
 
     if (_i2o_shuffle != NULL) {
         for (int ib = 0; ib < _onBlock; ib++) {
@@ -414,8 +428,8 @@ SwitchTopo_a2a::~SwitchTopo_a2a() {
         }
         flups_free(_o2i_shuffle);
     }
-
-    END_FUNC;
+    _i2o_shuffle = NULL;
+    _o2i_shuffle = NULL;
 }
 
 
@@ -426,6 +440,8 @@ SwitchTopo_a2a::~SwitchTopo_a2a() {
  * This way, we can use only #_sendBuf and #_recvBuf for each block without any additional computation inside the execute.
  * Moreover, asking the user to allocate the data reduces the memory footprint as it can be shared among several SwitchTopo
  * 
+ * The function can be called again to move the switch to new buffers, the previous block buffers and shuffle plans are then freed.
+ * 
  * @param sendData the "raw" communication buffer allocated at least at the size returned by get_bufMemSize 
  * @param recvData the "raw" communication buffer allocated at least at the size returned by get_bufMemSize 
  */
@@ -435,6 +451,9 @@ void SwitchTopo_a2a::setup_buffers(opt_double_ptr sendData, opt_double_ptr recvD
     // determine the nf: since topo_in may have change, we take the max to have the correct one
     const int nf = std::max(_topo_in->nf(),_topo_out->nf());
     const int lda = std::max(_topo_in->lda(),_topo_out->lda());
+
+    // free the previous association if any
+    _free_buffers();
     
     // store the buffers
     _sendBufG = sendData;
@@ -529,13 +548,21 @@ void SwitchTopo_a2a::setup_buffers(opt_double_ptr sendData, opt_double_ptr recvD
  * The stride may be computed using the difference of axis between the two topologies.
  * Hence the reading will be a bit slower since the writting due to memory discontinuities
  * 
+ * #### Field given by the user
+ * If field is not NULL, the data in the input topology (#_topo_in) is not read from/written to v but from/to field:
+ * - FLUPS_FORWARD: the buffers are filled directly from field and the result is stored in v
+ * - FLUPS_BACKWARD: the buffers are read from v and copied directly in field
+ * 
+ * This avoids the copy of the user's data into v and back.
+ * 
  * @param v the memory to switch from one topo to another. It has to be large enough to contain both local data's
  * @param sign if the switch is forward (FLUPS_FORWARD) or backward (FLUPS_BACKWARD) w.r.t. the order defined at init.
+ * @param field if not NULL, the lda components of the field in the input topology, each one in the memory layout of #_topo_in
  * 
  * -----------------------------------------------
  * We do the following:
  */
-void SwitchTopo_a2a::execute(double* v, const int sign) const {
+void SwitchTopo_a2a::execute(double* v, const int sign, double* const* field) const {
     BEGIN_FUNC;
 
     FLUPS_CHECK(_topo_in->isComplex() == _topo_out->isComplex(), "both topologies have to be complex or real", LOCATION);
@@ -547,7 +574,7 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
     // MPI_Comm_rank(_subcomm, &rank);
     MPI_Comm_size(_subcomm, &comm_size);
 
-    PROF_START("reorder");
+    PROF_STARTh(_profReorder);
 
     //-------------------------------------------------------------------------
     /** - setup required memory arrays */
@@ -568,9 +595,7 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
     int onmem[3];
 
     int* iBlockSize[3];
-    int* oBlockSize[3];
     int* iBlockiStart[3];
-    int* oBlockiStart[3];
 
     int* send_count;
     int* recv_count;
@@ -579,10 +604,11 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
 
     // const int nByBlock[3] = {_nByBlock[0], _nByBlock[1], _nByBlock[2]};
 
-    fftw_plan* shuffle = NULL;
+    // the field is read when filling the buffers if forward, written when reading them if backward
+    double* const* send_field = (sign == FLUPS_FORWARD) ? field : NULL;
+    double* const* recv_field = (sign == FLUPS_BACKWARD) ? field : NULL;
 
     opt_double_ptr* sendBuf;
-    opt_double_ptr* recvBuf;
     opt_double_ptr sendBufG;
     opt_double_ptr recvBufG;
 
@@ -590,7 +616,6 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
         topo_in  = _topo_in;
         topo_out = _topo_out;
         sendBuf  = _sendBuf;
-        recvBuf  = _recvBuf;
         sendBufG  = _sendBufG;
         recvBufG  = _recvBufG;
 
@@ -602,8 +627,6 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
         send_nBlock = _inBlock;
         recv_nBlock = _onBlock;
 
-        shuffle = _i2o_shuffle;
-
         for (int id = 0; id < 3; id++) {
             // send_nBlock[id] = _inBlock[id];
             // recv_nBlock[id] = _onBlock[id];
@@ -614,15 +637,12 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
             inmem[id]       = _topo_in->nmem(id);
             onmem[id]       = _topo_out->nmem(id);
             iBlockSize[id]  = _iBlockSize[id];
-            oBlockSize[id]  = _oBlockSize[id];
             iBlockiStart[id]  = _iBlockiStart[id];
-            oBlockiStart[id]  = _oBlockiStart[id];
         }
     } else if (sign == FLUPS_BACKWARD) {
         topo_in  = _topo_out;
         topo_out = _topo_in;
         sendBuf  = _recvBuf;
-        recvBuf  = _sendBuf;
         sendBufG  = _recvBufG;
         recvBufG  = _sendBufG;
 
@@ -631,7 +651,6 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
         send_start = _o2i_start;
         recv_start = _i2o_start;
 
-        shuffle     = _o2i_shuffle;
         send_nBlock = _onBlock;
         recv_nBlock = _inBlock;
 
@@ -643,12 +662,10 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
             inmem[id]         = _topo_out->nmem(id);
             onmem[id]         = _topo_in->nmem(id);
             iBlockSize[id]    = _oBlockSize[id];
-            oBlockSize[id]    = _iBlockSize[id];
             iBlockiStart[id]  = _oBlockiStart[id];
-            oBlockiStart[id]  = _iBlockiStart[id];
         }
     } else {
-        FLUPS_CHECK(false, "the sign is not FLUPS_FORWARD nor FLUPS_BACKWARD", LOCATION);
+        FLUPS_ERROR("the sign is not FLUPS_FORWARD nor FLUPS_BACKWARD", LOCATION);
     }
 
     FLUPS_INFO("switch: previous topo: %d,%d,%d axis=%d", topo_in->nglob(0), topo_in->nglob(1), topo_in->nglob(2), topo_in->axis());
@@ -668,11 +685,15 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
         for (int i = 0; i < 3; i++) {
             cond &= (_shift[i] == 0); //no shift in memory
             cond &= (_topo_in->nloc(i) == _topo_out->nloc(i)); //same size of topology
+            cond &= (inmem[i] == onmem[i]); //same size in memory in every direction (alignement in the FRI, ghost points in all of them)
         }
-        cond &= (inmem[topo_in->axis()] == onmem[topo_out->axis()]); //same size in memory in the FRI (also for alignement)
         if(cond){
             FLUPS_INFO("I skip this switch because nothing needs to change.");
-            PROF_STOP("reorder");
+            // the field still has to be copied
+            if (field != NULL) {
+                _copy_field(_topo_in, v, field, sign);
+            }
+            PROF_STOPh(_profReorder);
             return void();
         }
     };
@@ -681,20 +702,17 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
     const int iax0 = topo_in->axis();
     const int iax1 = (iax0 + 1) % 3;
     const int iax2 = (iax0 + 2) % 3;
-    const int oax0 = topo_out->axis();
-    const int oax1 = (oax0 + 1) % 3;
-    const int oax2 = (oax0 + 2) % 3;
     const int nf   = topo_in->nf();
 
-    PROF_STARTi("switch",_iswitch);
-    PROF_STARTi("mem2buf",_iswitch);
+    PROF_STARTh(_profSwitch);
+    PROF_STARTh(_profMem2buf);
 
     //-------------------------------------------------------------------------
     /** - fill the buffers */
     //-------------------------------------------------------------------------
     // const int nblocks_send = send_nBlock[0] * send_nBlock[1] * send_nBlock[2];
 
-#pragma omp parallel proc_bind(close) default(none) firstprivate(send_nBlock, v, sendBuf, iBlockSize,iBlockiStart, nf, inmem, iax0, iax1, iax2, lda)
+#pragma omp parallel proc_bind(close) default(none) firstprivate(send_nBlock, v, send_field, sendBuf, iBlockSize,iBlockiStart, nf, inmem, iax0, iax1, iax2, lda)
     for (int bid = 0; bid < send_nBlock; bid++) {
         for (int lia = 0; lia<lda; lia++){
             // // get the split index
@@ -719,7 +737,8 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
             // the data is aligned if the starting index is aligned AND if the gap between two entries, inmem[iax0] is a multiple of the alignment
             FLUPS_INFO_3("block %d: Moving the pointer by %d %d %d elements", bid, iBlockiStart[0][bid], iBlockiStart[1][bid], iBlockiStart[2][bid]);
             FLUPS_INFO_3("block %d: Tackling a block of size %d %d %d", bid, iBlockSize[0][bid], iBlockSize[1][bid], iBlockSize[2][bid]);
-            double* my_v = v + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, lia);
+            double* my_v = (send_field == NULL) ? v + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, lia)
+                                                : send_field[lia] + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, 0);
 
             const bool isVectorAligned = FLUPS_ISALIGNED(my_v) && inmem[iax0] % FLUPS_ALIGNMENT == 0;
 
@@ -804,58 +823,83 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
         }
     }
     
-    PROF_STOPi("mem2buf",_iswitch);
+    PROF_STOPh(_profMem2buf);
+
+#ifdef COMM_FLOAT
+    //-------------------------------------------------------------------------
+    /** - if needed, convert the buffer to single precision */
+    //-------------------------------------------------------------------------
+    // the blocks are contiguous so the start and count are the same in float
+    size_t send_total = 0;
+    size_t recv_total = 0;
+    for (int ir = 0; ir < comm_size; ir++) {
+        send_total = std::max(send_total, (size_t)(_is_all2all ? send_count[0] * (ir + 1) : send_start[ir] + send_count[ir]));
+        recv_total = std::max(recv_total, (size_t)(_is_all2all ? recv_count[0] * (ir + 1) : recv_start[ir] + recv_count[ir]));
+    }
+    buf_double2float(sendBufG, send_total);
+#endif
 
     //-------------------------------------------------------------------------
     /** - Do the communication */
     //-------------------------------------------------------------------------
-    if (_is_all2all) {
-        PROF_STARTi("all_2_all",_iswitch);
-        MPI_Alltoall(sendBufG, send_count[0], MPI_DOUBLE, recvBufG, recv_count[0], MPI_DOUBLE, _subcomm);
-#ifdef PROF        
-        if (_prof != NULL) {
-            string profName = "all_2_all"+to_string(_iswitch);
-            _prof->stop(profName);
-            int loc_mem = send_count[0] * comm_size;
-            _prof->addMem(profName, loc_mem*sizeof(double));
-        }
+    const double t0 = MPI_Wtime();
+    _all_to_all(sign, sendBufG, send_count, send_start, recvBufG, recv_count, recv_start);
+    _add_commStats(sign, MPI_Wtime() - t0, false);
+
+#ifdef COMM_FLOAT
+    // get back to double precision, the send buffer is not needed anymore
+    buf_float2double(recvBufG, recv_total);
 #endif
 
-    } else {
-        PROF_STARTi("all_2_all_v",_iswitch)
-        MPI_Alltoallv(sendBufG, send_count, send_start, MPI_DOUBLE, recvBufG, recv_count, recv_start, MPI_DOUBLE, _subcomm);
-#ifdef PROF        
-        if (_prof != NULL) {
-            string profName = "all_2_all_v"+to_string(_iswitch);
-            _prof->stop(profName);
-            int loc_mem = 0;
-            for (int ir = 0; ir < comm_size; ir++) {
-                loc_mem += send_count[ir];
-            }
-            _prof->addMem(profName, loc_mem*sizeof(double));
-        }
-#endif        
+    //-------------------------------------------------------------------------
+    /** - reset the memory to 0 and copy the blocks when they have arrived */
+    //-------------------------------------------------------------------------
+    _buf2mem(sign, v, recv_field);
+
+    PROF_STOPh(_profSwitch);
+    PROF_STOPh(_profReorder);
+    END_FUNC;
+}
+
+/**
+ * @brief reset the memory of the output topology and copy the received blocks from the recv buffers, shuffling them if needed
+ * 
+ * @param sign if the switch is forward (FLUPS_FORWARD) or backward (FLUPS_BACKWARD) w.r.t. the order defined at init.
+ * @param v the memory in the output topology
+ * @param recv_field if not NULL, the blocks are copied in the lda components of recv_field instead of v (see execute())
+ */
+void SwitchTopo_a2a::_buf2mem(const int sign, double* v, double* const* recv_field) const {
+    BEGIN_FUNC;
+    const bool      isForward   = (sign == FLUPS_FORWARD);
+    const Topology* topo_out    = (isForward) ? _topo_out : _topo_in;
+    opt_double_ptr* recvBuf     = (isForward) ? _recvBuf : _sendBuf;
+    fftw_plan*      shuffle     = (isForward) ? _i2o_shuffle : _o2i_shuffle;
+    const int       recv_nBlock = (isForward) ? _onBlock : _inBlock;
+
+    int* oBlockSize[3];
+    int* oBlockiStart[3];
+    int  onmem[3];
+    for (int id = 0; id < 3; id++) {
+        oBlockSize[id]   = (isForward) ? _oBlockSize[id] : _iBlockSize[id];
+        oBlockiStart[id] = (isForward) ? _oBlockiStart[id] : _iBlockiStart[id];
+        onmem[id]        = topo_out->nmem(id);
     }
+    const int oax0 = topo_out->axis();
+    const int oax1 = (oax0 + 1) % 3;
+    const int oax2 = (oax0 + 2) % 3;
+    const int nf   = topo_out->nf();
+    const int lda  = topo_out->lda();
 
     //-------------------------------------------------------------------------
     /** - reset the memory to 0 */
     //-------------------------------------------------------------------------
-    // reset the memory to 0
-    const size_t nmax = topo_out->memsize();
-    if (FLUPS_ISALIGNED(v)) {
-        opt_double_ptr my_v = v;
-        // tell the compiler about alignment
-        FLUPS_ASSUME_ALIGNED(my_v, FLUPS_ALIGNMENT);
-#pragma omp parallel for default(none) proc_bind(close) firstprivate(my_v, nmax)
-        for (size_t id = 0; id < nmax; id++) {
-            my_v[id] = 0.0;
+    // reset the memory to 0 where the blocks will not write, in the field only if the blocks do not cover it entirely
+    if (recv_field != NULL) {
+        if (!_is_fullyCovered(recv_nBlock, oBlockSize, topo_out)) {
+            _reset_field(topo_out, recv_field);
         }
     } else {
-        double* __restrict my_v = v;
-#pragma omp parallel for default(none) proc_bind(close) firstprivate(my_v, nmax)
-        for (size_t id = 0; id < nmax; id++) {
-            my_v[id] = 0.0;
-        }
+        _reset_padding(recv_nBlock, oBlockSize, oBlockiStart, topo_out, v);
     }
 
     //-------------------------------------------------------------------------
@@ -864,10 +908,10 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
     // get some counters
     // const int nblocks_recv = recv_nBlock[0] * recv_nBlock[1] * recv_nBlock[2];
     // for each block
-    PROF_STARTi("buf2mem",_iswitch);
+    PROF_STARTh(_profBuf2mem);
 
     
-#pragma omp parallel default(none) proc_bind(close) firstprivate(shuffle, recv_nBlock, v, recvBuf, oBlockSize,oBlockiStart, nf, onmem, oax0, oax1, oax2, lda)
+#pragma omp parallel default(none) proc_bind(close) firstprivate(shuffle, recv_nBlock, v, recv_field, recvBuf, oBlockSize,oBlockiStart, nf, onmem, oax0, oax1, oax2, lda)
     for (int bid = 0; bid < recv_nBlock; bid++) {
         const size_t blockSize = oBlockSize[oax0][bid] * oBlockSize[oax1][bid] * oBlockSize[oax2][bid] * nf;
 
@@ -907,7 +951,8 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
             // the buffer is aligned if the starting id is aligned and if nmax is a multiple of the alignement
             const bool isBuffAligned = FLUPS_ISALIGNED(recvBuf[bid] + lia * blockSize) &&  nmax%FLUPS_ALIGNMENT == 0;
             // the data is aligned if the starting index is aligned AND if the gap between two entries, inmem[iax0] is a multiple of the alignment
-            double*    my_v            = v + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, lia);
+            double*    my_v            = (recv_field == NULL) ? v + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, lia)
+                                                                  : recv_field[lia] + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, 0);
             const bool isVectorAligned = FLUPS_ISALIGNED(my_v) && onmem[oax0] % FLUPS_ALIGNMENT == 0;
 
             //choose the correct loop to improve the efficiency
@@ -986,9 +1031,82 @@ void SwitchTopo_a2a::execute(double* v, const int sign) const {
         }
     }
 
-    PROF_STOPi("buf2mem",_iswitch);
-    PROF_STOPi("switch",_iswitch);
-    PROF_STOP("reorder");
+    PROF_STOPh(_profBuf2mem);
+    END_FUNC;
+}
+
+/**
+ * @brief exchange the buffers among the ranks of #_subcomm
+ * 
+ * The data for the rank ir of #_subcomm is stored in sendBufG at send_start[ir] and is received in recvBufG at recv_start[ir],
+ * both in FLUPS_MPI_COMM_TYPE elements. If #_is_all2all, the start arrays are NULL and only send_count[0] and recv_count[0] are used.
+ * 
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ * @param sendBufG the send buffer
+ * @param send_count the number of elements sent to each rank
+ * @param send_start the starting index in sendBufG of the data for each rank
+ * @param recvBufG the recv buffer
+ * @param recv_count the number of elements received from each rank
+ * @param recv_start the starting index in recvBufG of the data from each rank
+ */
+void SwitchTopo_a2a::_all_to_all(const int sign, opt_double_ptr sendBufG, const int* send_count, const int* send_start, opt_double_ptr recvBufG, const int* recv_count, const int* recv_start) const {
+    BEGIN_FUNC;
+    int comm_size;
+    MPI_Comm_size(_subcomm, &comm_size);
+
+    if (_is_all2all) {
+        PROF_STARTh(_profComm);
+        MPI_Alltoall(sendBufG, send_count[0], FLUPS_MPI_COMM_TYPE, recvBufG, recv_count[0], FLUPS_MPI_COMM_TYPE, _subcomm);
+#ifdef PROF        
+        if (_prof != NULL) {
+            _prof->stop(_profComm);
+            int loc_mem = send_count[0] * comm_size;
+            _prof->addMem(_profComm, loc_mem*FLUPS_COMM_SIZEOF);
+        }
+#endif
+
+    } else {
+        PROF_STARTh(_profCommV)
+        MPI_Alltoallv(sendBufG, send_count, send_start, FLUPS_MPI_COMM_TYPE, recvBufG, recv_count, recv_start, FLUPS_MPI_COMM_TYPE, _subcomm);
+#ifdef PROF        
+        if (_prof != NULL) {
+            _prof->stop(_profCommV);
+            int loc_mem = 0;
+            for (int ir = 0; ir < comm_size; ir++) {
+                loc_mem += send_count[ir];
+            }
+            _prof->addMem(_profCommV, loc_mem*FLUPS_COMM_SIZEOF);
+        }
+#endif        
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief execute the switch and the 1D FFTs on the output topology
+ * 
+ * The all-to-all communication does not allow any overlap: the switch and the FFTs are simply done one after the other.
+ * - FLUPS_FORWARD: the switch is done and then the plan is executed on every pencil of the output topology
+ * - FLUPS_BACKWARD: the plan is executed on every pencil of the output topology and then the switch is done
+ * 
+ * @warning For a R2C/C2R plan, the output topology has to be in its real state (see FFTW_plan_dim::execute_pencil)
+ * 
+ * @param v the memory to switch from one topo to another
+ * @param sign if the switch is forward (FLUPS_FORWARD) or backward (FLUPS_BACKWARD) w.r.t. the order defined at init.
+ * @param plan the plan to execute on the output topology, if NULL only the switch is done
+ * @param field if not NULL, the lda components of the field in the input topology (see execute())
+ */
+void SwitchTopo_a2a::execute_pipelined(double* v, const int sign, const FFTW_plan_dim* plan, double* const* field) const {
+    BEGIN_FUNC;
+    if (sign == FLUPS_FORWARD) {
+        this->execute(v, FLUPS_FORWARD, field);
+    }
+    if (plan != NULL) {
+        plan->execute_pencils(_topo_out, v);
+    }
+    if (sign == FLUPS_BACKWARD) {
+        this->execute(v, FLUPS_BACKWARD, field);
+    }
     END_FUNC;
 }
 
@@ -66,13 +66,17 @@ class SwitchTopo_a2a : public SwitchTopo {
 
     void _init_blockInfo(const Topology* topo_in, const Topology* topo_out);
     void _free_blockInfo();
+    void _free_buffers();
+    void _buf2mem(const int sign, double* v, double* const* recv_field) const;
+    virtual void _all_to_all(const int sign, opt_double_ptr sendBufG, const int* send_count, const int* send_start, opt_double_ptr recvBufG, const int* recv_count, const int* recv_start) const;
 
    public:
     SwitchTopo_a2a(const Topology *topo_input, const Topology *topo_output, const int shift[3], Profiler *prof);
     ~SwitchTopo_a2a();
 
     void setup_buffers(opt_double_ptr sendBuf, opt_double_ptr recvBuf) ;
-    void execute(double* v, const int sign) const;
+    void execute(double* v, const int sign, double* const* field = NULL) const;
+    void execute_pipelined(double* v, const int sign, const FFTW_plan_dim* plan, double* const* field = NULL) const;
     void setup();
     void disp() const;
 };
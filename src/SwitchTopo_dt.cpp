@@ -0,0 +1,379 @@
+/**
+ * @file SwitchTopo_dt.cpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @brief 
+ * @version
+ * 
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+#include "SwitchTopo_dt.hpp"
+
+/**
+ * @brief Construct a Switch Topo object based on MPI derived datatypes
+ * 
+ * The blocks are computed as in SwitchTopo_a2a, the datatypes are created at the first execution.
+ * 
+ * @param topo_input the input topology
+ * @param topo_output the output topology 
+ * @param shift the shift is the position of the (0,0,0) of topo_input in the topo_output indexing (in XYZ-indexing)
+ * @param prof the profiler to use to profile the execution of the SwitchTopo
+ */
+SwitchTopo_dt::SwitchTopo_dt(const Topology* topo_input, const Topology* topo_output, const int shift[3], Profiler* prof) : SwitchTopo_a2a(topo_input, topo_output, shift, prof) {
+    BEGIN_FUNC;
+    END_FUNC;
+}
+
+/**
+ * @brief Destroy the Switch Topo and its datatypes
+ * 
+ */
+SwitchTopo_dt::~SwitchTopo_dt() {
+    BEGIN_FUNC;
+    _free_types();
+    if (_typeDispl != NULL) flups_free(_typeDispl);
+    END_FUNC;
+}
+
+/**
+ * @brief setup the switchtopo as in SwitchTopo_a2a
+ * 
+ */
+void SwitchTopo_dt::setup() {
+    BEGIN_FUNC;
+    _free_types();
+    SwitchTopo_a2a::setup();
+
+    int subsize;
+    MPI_Comm_size(_subcomm, &subsize);
+    if (_typeDispl != NULL) flups_free(_typeDispl);
+    _typeDispl = (int*)flups_malloc(subsize * sizeof(int));
+    std::memset(_typeDispl, 0, subsize * sizeof(int));
+    END_FUNC;
+}
+
+/**
+ * @brief setup the buffers as in SwitchTopo_a2a, the datatypes for the recv buffers will be recomputed
+ * 
+ * @param sendData the "raw" communication buffer allocated at least at the size returned by get_bufMemSize 
+ * @param recvData the "raw" communication buffer allocated at least at the size returned by get_bufMemSize 
+ */
+void SwitchTopo_dt::setup_buffers(opt_double_ptr sendData, opt_double_ptr recvData) {
+    BEGIN_FUNC;
+    _free_types();
+    SwitchTopo_a2a::setup_buffers(sendData, recvData);
+    END_FUNC;
+}
+
+/**
+ * @brief free the datatypes of both directions
+ * 
+ */
+void SwitchTopo_dt::_free_types() const {
+    for (int k = 0; k < 2; k++) {
+        for (int j = 0; j < 3; j++) {
+            if (_typeList[k][j] != NULL) {
+                int subsize;
+                MPI_Comm_size(_subcomm, &subsize);
+                for (int ir = 0; ir < subsize; ir++) {
+                    if (_typeCount[k][j][ir] > 0) MPI_Type_free(&_typeList[k][j][ir]);
+                }
+                flups_free(_typeList[k][j]);
+                flups_free(_typeCount[k][j]);
+            }
+            _typeList[k][j]  = NULL;
+            _typeCount[k][j] = NULL;
+        }
+        _typeNf[k] = 0;
+    }
+}
+
+/**
+ * @brief create the datatypes of the direction k for the current state of the topologies
+ * 
+ * For every rank of #_subcomm, the blocks exchanged with it are listed in the same order on both sides, the lda components of a block being contiguous in the message.
+ * The elements of a block are sent in the order of the fast rotating index of the sender:
+ * - send (j = 0): a subarray of the memory of the sender for every block and every component;
+ * - recv in the buffers (j = 1): the contiguous memory of the block in the recv buffer, as in SwitchTopo_a2a::setup_buffers();
+ * - recv in the memory (j = 2): the block in the memory of the receiver. As the fast rotating index may change, the datatype
+ * is built with nested hvectors following the axes of the sender and the strides of the receiver.
+ * 
+ * @param k the direction, 0 = input to output (FLUPS_FORWARD), 1 = output to input (FLUPS_BACKWARD)
+ * @param nf the number of doubles in one element
+ */
+void SwitchTopo_dt::_init_types(const int k, const int nf) const {
+    BEGIN_FUNC;
+    int subsize;
+    MPI_Comm_size(_subcomm, &subsize);
+
+    // free the types of this direction if they exist
+    for (int j = 0; j < 3; j++) {
+        if (_typeList[k][j] != NULL) {
+            for (int ir = 0; ir < subsize; ir++) {
+                if (_typeCount[k][j][ir] > 0) MPI_Type_free(&_typeList[k][j][ir]);
+            }
+            flups_free(_typeList[k][j]);
+            flups_free(_typeCount[k][j]);
+        }
+        _typeList[k][j]  = (MPI_Datatype*)flups_malloc(subsize * sizeof(MPI_Datatype));
+        _typeCount[k][j] = (int*)flups_malloc(subsize * sizeof(int));
+    }
+
+    // get the sender and receiver information
+    const bool            isForward   = (k == 0);
+    const Topology*       topo_send   = (isForward) ? _topo_in : _topo_out;
+    const Topology*       topo_recv   = (isForward) ? _topo_out : _topo_in;
+    const int             send_nBlock = (isForward) ? _inBlock : _onBlock;
+    const int             recv_nBlock = (isForward) ? _onBlock : _inBlock;
+    const int*            send_rank   = (isForward) ? _i2o_destRank : _o2i_destRank;
+    const int*            recv_rank   = (isForward) ? _o2i_destRank : _i2o_destRank;
+    opt_double_ptr const* recvBuf     = (isForward) ? _recvBuf : _sendBuf;
+    const double*         recvBufG    = (isForward) ? _recvBufG : _sendBufG;
+    const int             lda         = _topo_in->lda();
+
+    const int* sBlockSize[3];
+    const int* sBlockiStart[3];
+    const int* rBlockSize[3];
+    const int* rBlockiStart[3];
+    int        snmem[3];
+    int        rnmem[3];
+    for (int id = 0; id < 3; id++) {
+        sBlockSize[id]   = (isForward) ? _iBlockSize[id] : _oBlockSize[id];
+        sBlockiStart[id] = (isForward) ? _iBlockiStart[id] : _oBlockiStart[id];
+        rBlockSize[id]   = (isForward) ? _oBlockSize[id] : _iBlockSize[id];
+        rBlockiStart[id] = (isForward) ? _oBlockiStart[id] : _iBlockiStart[id];
+        snmem[id]        = topo_send->nmem(id);
+        rnmem[id]        = topo_recv->nmem(id);
+    }
+    const int sax[3] = {topo_send->axis(), (topo_send->axis() + 1) % 3, (topo_send->axis() + 2) % 3};
+    const int rax[3] = {topo_recv->axis(), (topo_recv->axis() + 1) % 3, (topo_recv->axis() + 2) % 3};
+
+    // the stride in bytes of each direction in the memory of the receiver
+    MPI_Aint rstride[3];
+    rstride[rax[0]] = (MPI_Aint)(nf * sizeof(double));
+    rstride[rax[1]] = rstride[rax[0]] * rnmem[rax[0]];
+    rstride[rax[2]] = rstride[rax[1]] * rnmem[rax[1]];
+
+    // the type of one element
+    MPI_Datatype elemType;
+    MPI_Type_contiguous(nf, MPI_DOUBLE, &elemType);
+
+    const int     nmax     = std::max(send_nBlock, recv_nBlock) * lda;
+    int*          blocklen = (int*)flups_malloc(nmax * sizeof(int));
+    MPI_Aint*     displ    = (MPI_Aint*)flups_malloc(nmax * sizeof(MPI_Aint));
+    MPI_Datatype* types    = (MPI_Datatype*)flups_malloc(nmax * sizeof(MPI_Datatype));
+
+    for (int ir = 0; ir < subsize; ir++) {
+        //-------------------------------------------------------------------------
+        /** - send: a subarray for each block and each component */
+        //-------------------------------------------------------------------------
+        int n = 0;
+        for (int ib = 0; ib < send_nBlock; ib++) {
+            if (send_rank[ib] != ir) continue;
+            const int sizes[3]    = {snmem[sax[2]], snmem[sax[1]], snmem[sax[0]] * nf};
+            const int subsizes[3] = {sBlockSize[sax[2]][ib], sBlockSize[sax[1]][ib], sBlockSize[sax[0]][ib] * nf};
+            const int starts[3]   = {sBlockiStart[sax[2]][ib], sBlockiStart[sax[1]][ib], sBlockiStart[sax[0]][ib] * nf};
+            MPI_Datatype blockType;
+            MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &blockType);
+            for (int lia = 0; lia < lda; lia++) {
+                blocklen[n] = 1;
+                displ[n]    = (MPI_Aint)(localIndex(sax[0], 0, 0, 0, sax[0], snmem, nf, lia) * sizeof(double));
+                types[n]    = blockType;
+                n++;
+            }
+        }
+        _typeCount[k][0][ir] = (n > 0) ? 1 : 0;
+        _typeList[k][0][ir]  = MPI_DOUBLE;
+        if (n > 0) {
+            MPI_Type_create_struct(n, blocklen, displ, types, &_typeList[k][0][ir]);
+            MPI_Type_commit(&_typeList[k][0][ir]);
+            for (int in = 0; in < n; in += lda) {
+                MPI_Type_free(&types[in]);
+            }
+        }
+
+        //-------------------------------------------------------------------------
+        /** - recv in the buffers: the contiguous memory of each block and each component */
+        //-------------------------------------------------------------------------
+        n = 0;
+        for (int ib = 0; ib < recv_nBlock; ib++) {
+            if (recv_rank[ib] != ir) continue;
+            const size_t blockSize = (size_t)rBlockSize[0][ib] * (size_t)rBlockSize[1][ib] * (size_t)rBlockSize[2][ib] * (size_t)nf;
+            for (int lia = 0; lia < lda; lia++) {
+                blocklen[n] = (int)blockSize;
+                displ[n]    = (MPI_Aint)(((size_t)(recvBuf[ib] - recvBufG) + lia * blockSize) * sizeof(double));
+                types[n]    = MPI_DOUBLE;
+                n++;
+            }
+        }
+        _typeCount[k][1][ir] = (n > 0) ? 1 : 0;
+        _typeList[k][1][ir]  = MPI_DOUBLE;
+        if (n > 0) {
+            MPI_Type_create_struct(n, blocklen, displ, types, &_typeList[k][1][ir]);
+            MPI_Type_commit(&_typeList[k][1][ir]);
+        }
+
+        //-------------------------------------------------------------------------
+        /** - recv in the memory: the block in the axes of the sender with the strides of the receiver */
+        //-------------------------------------------------------------------------
+        n = 0;
+        for (int ib = 0; ib < recv_nBlock; ib++) {
+            if (recv_rank[ib] != ir) continue;
+            MPI_Datatype t0, t1, blockType;
+            MPI_Type_create_hvector(rBlockSize[sax[0]][ib], 1, rstride[sax[0]], elemType, &t0);
+            MPI_Type_create_hvector(rBlockSize[sax[1]][ib], 1, rstride[sax[1]], t0, &t1);
+            MPI_Type_create_hvector(rBlockSize[sax[2]][ib], 1, rstride[sax[2]], t1, &blockType);
+            MPI_Type_free(&t0);
+            MPI_Type_free(&t1);
+            for (int lia = 0; lia < lda; lia++) {
+                blocklen[n] = 1;
+                displ[n]    = (MPI_Aint)(localIndex(rax[0], rBlockiStart[rax[0]][ib], rBlockiStart[rax[1]][ib], rBlockiStart[rax[2]][ib], rax[0], rnmem, nf, lia) * sizeof(double));
+                types[n]    = blockType;
+                n++;
+            }
+        }
+        _typeCount[k][2][ir] = (n > 0) ? 1 : 0;
+        _typeList[k][2][ir]  = MPI_DOUBLE;
+        if (n > 0) {
+            MPI_Type_create_struct(n, blocklen, displ, types, &_typeList[k][2][ir]);
+            MPI_Type_commit(&_typeList[k][2][ir]);
+            for (int in = 0; in < n; in += lda) {
+                MPI_Type_free(&types[in]);
+            }
+        }
+    }
+    MPI_Type_free(&elemType);
+    flups_free(blocklen);
+    flups_free(displ);
+    flups_free(types);
+
+    _typeNf[k] = nf;
+    END_FUNC;
+}
+
+/**
+ * @brief execute the switch from one topo to another, sending the data directly from the memory
+ * 
+ * See SwitchTopo_a2a::execute for the meaning of the arguments. If field is given with lda = 1, it is read (FLUPS_FORWARD)
+ * or written (FLUPS_BACKWARD) directly by MPI, without any copy. Otherwise, the blocks are received in the recv buffers and
+ * copied in the memory.
+ * 
+ * @param v the memory to switch from one topo to another. It has to be large enough to contain both local data's
+ * @param sign if the switch is forward (FLUPS_FORWARD) or backward (FLUPS_BACKWARD) w.r.t. the order defined at init.
+ * @param field if not NULL, the lda components of the field in the input topology, each one in the memory layout of #_topo_in
+ */
+void SwitchTopo_dt::execute(double* v, const int sign, double* const* field) const {
+    BEGIN_FUNC;
+
+    FLUPS_CHECK(_topo_in->isComplex() == _topo_out->isComplex(), "both topologies have to be complex or real", LOCATION);
+    FLUPS_CHECK(_topo_in->lda() == _topo_out->lda(), "both topologies must have the same lda", LOCATION);
+    FLUPS_CHECK(_topo_in->nf() <= 2, "the value of nf is not supported", LOCATION);
+    FLUPS_CHECK(_sendBuf != NULL && _recvBuf != NULL, "both buffers have to be non NULL", LOCATION);
+    FLUPS_CHECK(sign == FLUPS_FORWARD || sign == FLUPS_BACKWARD, "the sign is not FLUPS_FORWARD nor FLUPS_BACKWARD", LOCATION);
+
+    PROF_STARTh(_profReorder);
+
+    const bool      isForward   = (sign == FLUPS_FORWARD);
+    const int       k           = (isForward) ? 0 : 1;
+    const Topology* topo_in     = (isForward) ? _topo_in : _topo_out;
+    const Topology* topo_out    = (isForward) ? _topo_out : _topo_in;
+    const int       send_nBlock = (isForward) ? _inBlock : _onBlock;
+    const int       recv_nBlock = (isForward) ? _onBlock : _inBlock;
+    const int       lda         = _topo_in->lda();
+    const int       nf          = topo_in->nf();
+
+    // check if we can return already, because the switchtopo would be useless
+    {
+        int rank;
+        MPI_Comm_rank(_subcomm, &rank);
+
+        bool cond = (_topo_in->axis() == _topo_out->axis());  //same axis
+        cond &= (send_nBlock == 1);                           //only one block on this proc
+        cond &= (recv_nBlock == 1);
+        cond &= (_i2o_destRank[0] == rank);  //the only block will stay with me
+        cond &= (_o2i_destRank[0] == rank);
+        for (int i = 0; i < 3; i++) {
+            cond &= (_shift[i] == 0);                           //no shift in memory
+            cond &= (_topo_in->nloc(i) == _topo_out->nloc(i));  //same size of topology
+            cond &= (topo_in->nmem(i) == topo_out->nmem(i));    //same size in memory in every direction (alignement in the FRI, ghost points in all of them)
+        }
+        if (cond) {
+            FLUPS_INFO("I skip this switch because nothing needs to change.");
+            // the field still has to be copied
+            if (field != NULL) {
+                _copy_field(_topo_in, v, field, sign);
+            }
+            PROF_STOPh(_profReorder);
+            return void();
+        }
+    };
+
+    // create the datatypes for the current state of the topologies
+    if (_typeNf[k] != nf) {
+        _init_types(k, nf);
+    }
+
+    PROF_STARTh(_profSwitch);
+
+    // the field can be used directly by MPI if it is given as one memory
+    const bool isDirect = (field != NULL) && (lda == 1);
+    if (field != NULL && !isDirect && isForward) {
+        _copy_field(_topo_in, v, field, sign);
+    }
+
+    PROF_STARTh(_profCommV);
+    const double t0 = MPI_Wtime();
+    if (isDirect) {
+        double* send = (isForward) ? field[0] : v;
+        double* recv = (isForward) ? v : field[0];
+        // reset the memory that will not be covered by the blocks
+        if (isForward) {
+            _reset_padding(recv_nBlock, _oBlockSize, _oBlockiStart, topo_out, v);
+        } else if (!_is_fullyCovered(recv_nBlock, _iBlockSize, topo_out)) {
+            _reset_field(topo_out, field);
+        }
+        MPI_Alltoallw(send, _typeCount[k][0], _typeDispl, _typeList[k][0], recv, _typeCount[k][2], _typeDispl, _typeList[k][2], _subcomm);
+    } else {
+        opt_double_ptr recvBufG = (isForward) ? _recvBufG : _sendBufG;
+        MPI_Alltoallw(v, _typeCount[k][0], _typeDispl, _typeList[k][0], recvBufG, _typeCount[k][1], _typeDispl, _typeList[k][1], _subcomm);
+    }
+    _add_commStats(sign, MPI_Wtime() - t0, false);
+    PROF_STOPh(_profCommV);
+
+    //-------------------------------------------------------------------------
+    /** - copy the blocks from the recv buffers if they have not been received in place */
+    //-------------------------------------------------------------------------
+    if (!isDirect) {
+        _buf2mem(sign, v, (isForward) ? NULL : field);
+    }
+
+    PROF_STOPh(_profSwitch);
+    PROF_STOPh(_profReorder);
+    END_FUNC;
+}
+
+void SwitchTopo_dt::disp() const {
+    BEGIN_FUNC;
+    SwitchTopo_a2a::disp();
+    FLUPS_INFO("## using MPI derived datatypes");
+    FLUPS_INFO("------------------------------------------");
+}
@@ -0,0 +1,75 @@
+/**
+ * @file SwitchTopo_dt.hpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @brief 
+ * @version
+ * 
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+#ifndef SWITCHTOPO_DT_HPP
+#define SWITCHTOPO_DT_HPP
+
+#include <cstring>
+#include "defines.hpp"
+#include "mpi.h"
+#include "Topology.hpp"
+#include "Profiler.hpp"
+#include "SwitchTopo.hpp"
+#include "SwitchTopo_a2a.hpp"
+
+/**
+ * @brief Switch between two different topologies using MPI derived datatypes, without packing the send buffer
+ * 
+ * The blocks are the same as in SwitchTopo_a2a, but each block is described in the memory by an MPI subarray and the
+ * blocks for one rank are gathered in an MPI struct. The data is then sent directly from the memory with MPI_Alltoallw:
+ * - by default, the blocks are received in the recv buffers and copied (and shuffled) in the memory as in SwitchTopo_a2a;
+ * - if the field is given (see SwitchTopo::execute) with lda = 1, the data is received directly in its final location
+ * as the source and the destination are different memories. The change of fast rotating index is then done by the datatype.
+ * 
+ * The datatypes depend on the state (real or complex) of the topologies and are created at the first execution in each direction.
+ * 
+ * @warning the data is always sent in double precision, even with COMM_FLOAT, as the conversion would require the packing step.
+ * 
+ */
+class SwitchTopo_dt : public SwitchTopo_a2a {
+   protected:
+    // the datatypes for each direction k (0 = input to output, 1 = output to input) and each usage j (0 = send, 1 = recv in the buffers, 2 = recv in the memory)
+    mutable int           _typeNf[2]       = {0, 0};                                      /**<@brief the nf for which the datatypes of each direction are created, 0 if not created */
+    mutable MPI_Datatype* _typeList[2][3]  = {{NULL, NULL, NULL}, {NULL, NULL, NULL}};    /**<@brief the datatype for each rank of #_subcomm */
+    mutable int*          _typeCount[2][3] = {{NULL, NULL, NULL}, {NULL, NULL, NULL}};    /**<@brief 1 if some data is exchanged with the rank, 0 otherwise */
+    int*                  _typeDispl       = NULL;                                        /**<@brief the displacements of MPI_Alltoallw, always 0 as they are included in the datatypes */
+
+    void _init_types(const int k, const int nf) const;
+    void _free_types() const;
+
+   public:
+    SwitchTopo_dt(const Topology* topo_input, const Topology* topo_output, const int shift[3], Profiler* prof);
+    ~SwitchTopo_dt();
+
+    void setup_buffers(opt_double_ptr sendBuf, opt_double_ptr recvBuf);
+    void execute(double* v, const int sign, double* const* field = NULL) const;
+    void setup();
+    void disp() const;
+};
+
+#endif
@@ -117,6 +117,7 @@ SwitchTopo_nb::SwitchTopo_nb(const Topology* topo_input, const Topology* topo_ou
         _prof->create("buf2mem2", "switch2");
         _prof->create("waiting2", "switch2");
     }
+    _init_profHandles();
 #endif
     END_FUNC;
 }
@@ -194,17 +195,157 @@ void SwitchTopo_nb::_init_blockInfo(const Topology* topo_in, const Topology* top
     END_FUNC;
 }
 
+/**
+ * @brief move the block information to the new ranks if the communicators have only been reordered (e.g. by REORDER_RANKS)
+ * 
+ * The blocks of a rank only depend on its position in the topologies, which is given by its rank in the communicator of the topology.
+ * If the new communicators contain the same processes as the old ones, the block information of a position is the one computed by
+ * the process which had that rank before: it is sent to the process which has it now (see _exchange_blockInfo()), instead of
+ * recomputing the blocks with collective communications.
+ * The destination ranks towards the output topology are then expressed in the new input communicator with translate_ranks(), the tags are unchanged.
+ * 
+ * This is only possible if the input and output communicators were the same when the blocks were computed.
+ * The destination ranks must be the ones in _inComm, not the ones in _subcomm set by _setup_subComm() (see #_i2o_commRank).
+ * 
+ * @param inComm the new communicator of the input topology
+ * @param outComm the new communicator of the output topology
+ * @return true if the block information has been moved, false if it has to be recomputed
+ */
+bool SwitchTopo_nb::_permute_blockInfo(MPI_Comm inComm, MPI_Comm outComm) {
+    BEGIN_FUNC;
+    int compOld, compIn, compOut;
+    MPI_Comm_compare(_inComm, _outComm, &compOld);
+    MPI_Comm_compare(inComm, _inComm, &compIn);
+    MPI_Comm_compare(outComm, _outComm, &compOut);
+    // the old comms must give the same positions and the new ones must hold the same processes
+    if ((compOld != MPI_IDENT && compOld != MPI_CONGRUENT) || compIn == MPI_UNEQUAL || compOut == MPI_UNEQUAL) {
+        END_FUNC;
+        return false;
+    }
+    const MPI_Comm oldComm = _inComm;
+
+    //-------------------------------------------------------------------------
+    /** - get the blocks of the position we now have in each of the topologies that have been reordered */
+    //-------------------------------------------------------------------------
+    if (compIn == MPI_SIMILAR) {
+        _exchange_blockInfo(oldComm, inComm, &_inBlock, _iBlockSize, _iBlockiStart, &_i2o_destRank, &_i2o_destTag);
+    }
+    if (compOut == MPI_SIMILAR) {
+        _exchange_blockInfo(oldComm, outComm, &_onBlock, _oBlockSize, _oBlockiStart, &_o2i_destRank, &_o2i_destTag);
+    }
+
+    //-------------------------------------------------------------------------
+    /** - the destination ranks were positions in the other topology, get the rank in the new input comm of the process at that position */
+    //-------------------------------------------------------------------------
+    // the ranks of the input topology give its positions, the ranks towards it stay the same
+    if (_inBlock > 0) {
+        translate_ranks(_inBlock, _i2o_destRank, outComm, inComm);
+    }
+
+    //-------------------------------------------------------------------------
+    /** - allocate the requests for the new number of blocks */
+    //-------------------------------------------------------------------------
+    flups_free(_i2o_sendRequest);
+    flups_free(_i2o_recvRequest);
+    flups_free(_o2i_sendRequest);
+    flups_free(_o2i_recvRequest);
+    _i2o_sendRequest = (MPI_Request*)flups_malloc(_inBlock * sizeof(MPI_Request));
+    _i2o_recvRequest = (MPI_Request*)flups_malloc(_onBlock * sizeof(MPI_Request));
+    _o2i_sendRequest = (MPI_Request*)flups_malloc(_onBlock * sizeof(MPI_Request));
+    _o2i_recvRequest = (MPI_Request*)flups_malloc(_inBlock * sizeof(MPI_Request));
+
+    FLUPS_INFO("switch nb: the block information has been moved to the reordered ranks");
+    END_FUNC;
+    return true;
+}
+
+/**
+ * @brief send the block information of one side of the switch to the process which has my rank in the new communicator, and get the one of my new rank
+ * 
+ * One point-to-point message, in oldComm, replaces the computation of the blocks.
+ * 
+ * @param oldComm the communicator used to compute the blocks
+ * @param newComm the new communicator of the topology, with the same processes
+ * @param nBlock the number of blocks, replaced
+ * @param blockSize the size of each block, reallocated
+ * @param blockiStart the starting index of each block, reallocated
+ * @param destRank the destination rank of each block, reallocated
+ * @param destTag the destination tag of each block, reallocated
+ */
+void SwitchTopo_nb::_exchange_blockInfo(MPI_Comm oldComm, MPI_Comm newComm, int* nBlock, int* blockSize[3], int* blockiStart[3], int** destRank, int** destTag) {
+    BEGIN_FUNC;
+    // the position of rank r is now held by the process with the new rank r
+    int oldRank, newRank;
+    MPI_Comm_rank(oldComm, &oldRank);
+    MPI_Comm_rank(newComm, &newRank);
+    int dest = oldRank;
+    int src  = newRank;
+    translate_ranks(1, &dest, newComm, oldComm);
+
+    //-------------------------------------------------------------------------
+    /** - pack: the blocks sizes, starting indexes, ranks and tags */
+    //-------------------------------------------------------------------------
+    const int n        = *nBlock;
+    int*      sendInfo = (int*)flups_malloc(std::max(8 * n, 1) * sizeof(int));
+    for (int ib = 0; ib < n; ib++) {
+        for (int id = 0; id < 3; id++) {
+            sendInfo[id * n + ib]       = blockSize[id][ib];
+            sendInfo[(3 + id) * n + ib] = blockiStart[id][ib];
+        }
+        sendInfo[6 * n + ib] = (*destRank)[ib];
+        sendInfo[7 * n + ib] = (*destTag)[ib];
+    }
+
+    //-------------------------------------------------------------------------
+    /** - exchange the number of blocks and the information */
+    //-------------------------------------------------------------------------
+    int m = 0;
+    MPI_Sendrecv(&n, 1, MPI_INT, dest, 0, &m, 1, MPI_INT, src, 0, oldComm, MPI_STATUS_IGNORE);
+    int* recvInfo = (int*)flups_malloc(std::max(8 * m, 1) * sizeof(int));
+    MPI_Sendrecv(sendInfo, 8 * n, MPI_INT, dest, 1, recvInfo, 8 * m, MPI_INT, src, 1, oldComm, MPI_STATUS_IGNORE);
+    flups_free(sendInfo);
+
+    //-------------------------------------------------------------------------
+    /** - unpack in new arrays */
+    //-------------------------------------------------------------------------
+    for (int id = 0; id < 3; id++) {
+        flups_free(blockSize[id]);
+        flups_free(blockiStart[id]);
+        blockSize[id]   = (int*)flups_malloc(m * sizeof(int));
+        blockiStart[id] = (int*)flups_malloc(m * sizeof(int));
+    }
+    flups_free(*destRank);
+    flups_free(*destTag);
+    (*destRank) = (int*)flups_malloc(m * sizeof(int));
+    (*destTag)  = (int*)flups_malloc(m * sizeof(int));
+    for (int ib = 0; ib < m; ib++) {
+        for (int id = 0; id < 3; id++) {
+            blockSize[id][ib]   = recvInfo[id * m + ib];
+            blockiStart[id][ib] = recvInfo[(3 + id) * m + ib];
+        }
+        (*destRank)[ib] = recvInfo[6 * m + ib];
+        (*destTag)[ib]  = recvInfo[7 * m + ib];
+    }
+    (*nBlock) = m;
+    flups_free(recvInfo);
+    END_FUNC;
+}
+
 void SwitchTopo_nb::_free_blockInfo(){
 
     if (_i2o_destRank != NULL) flups_free(_i2o_destRank);
     if (_o2i_destRank != NULL) flups_free(_o2i_destRank);
     if (_i2o_destTag != NULL) flups_free(_i2o_destTag);
     if (_o2i_destTag != NULL) flups_free(_o2i_destTag);
+    if (_i2o_commRank != NULL) flups_free(_i2o_commRank);
+    if (_o2i_commRank != NULL) flups_free(_o2i_commRank);
 
     _i2o_destRank = NULL;
     _o2i_destRank = NULL;
     _i2o_destTag  = NULL;
     _o2i_destTag  = NULL;
+    _i2o_commRank = NULL;
+    _o2i_commRank = NULL;
 
     for (int id = 0; id < 3; id++) {
         if (_iBlockSize[id] != NULL) flups_free(_iBlockSize[id]);
@@ -243,16 +384,45 @@ void SwitchTopo_nb::setup(){
     MPI_Comm_rank(inComm, &rank);
     MPI_Comm_size(inComm, &comm_size);
 
+    //-------------------------------------------------------------------------
+    /** - If already setup, release the requests, get back the destination ranks in _inComm and release the subcomm and the self blocks */
+    //-------------------------------------------------------------------------
+    // the requests use the subcomm, setup_buffers() has to be called again
+    _free_buffers();
+    if (_i2o_commRank != NULL) {
+        memcpy(_i2o_destRank, _i2o_commRank, _inBlock * sizeof(int));
+    }
+    if (_o2i_commRank != NULL) {
+        memcpy(_o2i_destRank, _o2i_commRank, _onBlock * sizeof(int));
+    }
+    if (_subcomm != NULL) {
+        int compSub;
+        MPI_Comm_compare(_subcomm, _inComm, &compSub);
+        if (compSub != MPI_IDENT) {
+            MPI_Comm_free(&_subcomm);
+        }
+        _subcomm = NULL;
+    }
+    if (_iselfBlockID != NULL) flups_free(_iselfBlockID);
+    if (_oselfBlockID != NULL) flups_free(_oselfBlockID);
+    _iselfBlockID = NULL;
+    _oselfBlockID = NULL;
+
     //Ensure that comms have not changed since init. Otherwise recompute the source/destination of blocks.
     int compIn, compOut;
     MPI_Comm_compare(inComm, _inComm, &compIn);
     MPI_Comm_compare(outComm, _outComm, &compOut);
     //if the graph communicator has the same numbering as the old commn we will skip the following
-    if( compIn != MPI_CONGRUENT || compOut != MPI_CONGRUENT){
+    const bool sameIn  = (compIn == MPI_IDENT || compIn == MPI_CONGRUENT);
+    const bool sameOut = (compOut == MPI_IDENT || compOut == MPI_CONGRUENT);
+    if ((!sameIn || !sameOut) && _permute_blockInfo(inComm, outComm)) {
+        // the ranks have only been reordered: the block information has been moved to the new ranks
+        _inComm  = inComm;
+        _outComm = outComm;
+    } else if (!sameIn || !sameOut) {
         if (rank == 0){
             FLUPS_WARNING("The inComm and/or outComm have changed since this switchtopo was created. I will recompute the communication scheme.",LOCATION);
         }
-
         _inComm = inComm;
         _outComm = outComm;
 
@@ -277,6 +447,16 @@ void SwitchTopo_nb::setup(){
         delete(topo_in_tmp);
     }
 
+    //-------------------------------------------------------------------------
+    /** - Keep the destination ranks in _inComm for the next setup */
+    //-------------------------------------------------------------------------
+    if (_i2o_commRank != NULL) flups_free(_i2o_commRank);
+    if (_o2i_commRank != NULL) flups_free(_o2i_commRank);
+    _i2o_commRank = (int*)flups_malloc(_inBlock * sizeof(int));
+    _o2i_commRank = (int*)flups_malloc(_onBlock * sizeof(int));
+    memcpy(_i2o_commRank, _i2o_destRank, _inBlock * sizeof(int));
+    memcpy(_o2i_commRank, _o2i_destRank, _onBlock * sizeof(int));
+
     //-------------------------------------------------------------------------
     /** - Setup subcomm */
     //-------------------------------------------------------------------------
@@ -306,6 +486,14 @@ void SwitchTopo_nb::setup(){
     FLUPS_CHECK(temp == _selfBlockN, "the number of selfBlocks has to be the same in both TOPO!", LOCATION);
     _iselfBlockID = (int*)flups_malloc(_selfBlockN * sizeof(int));
     _oselfBlockID = (int*)flups_malloc(_selfBlockN * sizeof(int));
+
+    //-------------------------------------------------------------------------
+    /** - Let every thread communicate if MPI provides MPI_THREAD_MULTIPLE */
+    //-------------------------------------------------------------------------
+    int provided;
+    MPI_Query_thread(&provided);
+    _threadMultiple = (provided == MPI_THREAD_MULTIPLE) && (omp_get_max_threads() > 1);
+    FLUPS_INFO("switch nb: threaded exchange = %d", _threadMultiple);
     //-------------------------------------------------------------------------
     /** - Display performance information if asked */
     //-------------------------------------------------------------------------
@@ -362,6 +550,10 @@ void SwitchTopo_nb::setup_buffers(opt_double_ptr sendData,opt_double_ptr recvDat
 
     int newrank;
     MPI_Comm_rank(_subcomm, &newrank);
+
+    // free the previous association if any
+    _free_buffers();
+
     // allocate the second layer of buffers
     _sendBuf = (double**)flups_malloc(_inBlock * sizeof(double*));
     _recvBuf = (double**)flups_malloc(_onBlock * sizeof(double*));
@@ -400,9 +592,9 @@ void SwitchTopo_nb::setup_buffers(opt_double_ptr sendData,opt_double_ptr recvDat
             selfcount++;
         } else {
             // get the send size without padding
-            MPI_Send_init(_sendBuf[bid], sendSize, MPI_DOUBLE, _i2o_destRank[bid], _i2o_destTag[bid], _subcomm, &(_i2o_sendRequest[bid]));
+            MPI_Send_init(_sendBuf[bid], sendSize, FLUPS_MPI_COMM_TYPE, _i2o_destRank[bid], _i2o_destTag[bid], _subcomm, &(_i2o_sendRequest[bid]));
             // for the send when doing output 2 input: send to rank o2i with tag o2i
-            MPI_Recv_init(_sendBuf[bid], sendSize, MPI_DOUBLE, _i2o_destRank[bid], bid, _subcomm, &(_o2i_recvRequest[bid]));
+            MPI_Recv_init(_sendBuf[bid], sendSize, FLUPS_MPI_COMM_TYPE, _i2o_destRank[bid], bid, _subcomm, &(_o2i_recvRequest[bid]));
         }
 
         // setup the suffle plan for the out 2 in transformation if needed
@@ -433,9 +625,9 @@ void SwitchTopo_nb::setup_buffers(opt_double_ptr sendData,opt_double_ptr recvDat
             selfcount++;
         } else {
             // for the reception when doing input 2 output: receive from the rank o2i with tag bid
-            MPI_Recv_init(_recvBuf[bid], recvSize, MPI_DOUBLE, _o2i_destRank[bid], bid, _subcomm, &(_i2o_recvRequest[bid]));
+            MPI_Recv_init(_recvBuf[bid], recvSize, FLUPS_MPI_COMM_TYPE, _o2i_destRank[bid], bid, _subcomm, &(_i2o_recvRequest[bid]));
             // for the send when doing output 2 input: send to rank o2i with tag o2i
-            MPI_Send_init(_recvBuf[bid], recvSize, MPI_DOUBLE, _o2i_destRank[bid], _o2i_destTag[bid], _subcomm, &(_o2i_sendRequest[bid]));
+            MPI_Send_init(_recvBuf[bid], recvSize, FLUPS_MPI_COMM_TYPE, _o2i_destRank[bid], _o2i_destTag[bid], _subcomm, &(_o2i_sendRequest[bid]));
         }
 
         // setup the suffle plan for the in 2 out transformation
@@ -464,21 +656,37 @@ SwitchTopo_nb::~SwitchTopo_nb() {
         MPI_Comm_free(&_subcomm);
     }
 
-    for(int ib=0; ib< _inBlock; ib++){
-        // if (_sendBuf[ib] != NULL) flups_free(_sendBuf[ib]);
-        if (_i2o_sendRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_i2o_sendRequest[ib]));
-        if (_o2i_recvRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_o2i_recvRequest[ib]));
-    }
-    for(int ib=0; ib< _onBlock; ib++){
-        // if (_recvBuf[ib] != NULL) flups_free(_recvBuf[ib]);
-        if (_i2o_recvRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_i2o_recvRequest[ib]));
-        if (_o2i_sendRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_o2i_sendRequest[ib]));
-    }
-
+    _free_buffers();
     _free_blockInfo();
 
     if (_iselfBlockID != NULL) flups_free(_iselfBlockID);
     if (_oselfBlockID != NULL) flups_free(_oselfBlockID);
+    END_FUNC;
+}
+
+/**
+ * @brief free the persistent requests, the block buffers and the shuffle plans created by setup_buffers()
+ * 
+ * The raw buffers are not owned by the switch and are not freed.
+ */
+void SwitchTopo_nb::_free_buffers() {
+    // the requests are only created once the buffers are set
+    if (_sendBuf != NULL) {
+        for (int ib = 0; ib < _inBlock; ib++) {
+            if (_i2o_sendRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_i2o_sendRequest[ib]));
+            if (_o2i_recvRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_o2i_recvRequest[ib]));
+        }
+        flups_free((double*)_sendBuf);
+    }
+    if (_recvBuf != NULL) {
+        for (int ib = 0; ib < _onBlock; ib++) {
+            if (_i2o_recvRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_i2o_recvRequest[ib]));
+            if (_o2i_sendRequest[ib] != MPI_REQUEST_NULL) MPI_Request_free(&(_o2i_sendRequest[ib]));
+        }
+        flups_free((double*)_recvBuf);
+    }
+    _sendBuf = NULL;
+    _recvBuf = NULL;
 
     if (_i2o_shuffle != NULL) {
         for (int ib = 0; ib < _onBlock; ib++) {
@@ -492,10 +700,8 @@ SwitchTopo_nb::~SwitchTopo_nb() {
         }
         flups_free(_o2i_shuffle);
     }
-
-    flups_free((double*)_sendBuf);
-    flups_free((double*)_recvBuf);
-    END_FUNC;
+    _i2o_shuffle = NULL;
+    _o2i_shuffle = NULL;
 }
 
 /**
@@ -520,13 +726,64 @@ SwitchTopo_nb::~SwitchTopo_nb() {
  * The stride may be computed using the difference of axis between the two topologies.
  * Hence the reading will be a bit slower since the writting due to memory discontinuities
  * 
+ * #### Field given by the user
+ * If field is not NULL, the data in the input topology (#_topo_in) is not read from/written to v but from/to field (see SwitchTopo_a2a::execute).
+ * 
  * @param v the memory to switch from one topo to another. It has to be large enough to contain both local data's
  * @param sign if the switch is forward (FLUPS_FORWARD) or backward (FLUPS_BACKWARD) w.r.t. the order defined at init.
+ * @param field if not NULL, the lda components of the field in the input topology, each one in the memory layout of #_topo_in
+ */
+/**
+ * @brief returns true if the switch does not change anything, i.e. there is a single block that stays on the rank with the same layout in memory
+ * 
+ */
+bool SwitchTopo_nb::_is_identity() const {
+    int rank;
+    MPI_Comm_rank(_subcomm, &rank);
+
+    bool cond = (_topo_in->axis() == _topo_out->axis()); //same axis
+    cond &= (_inBlock == 1); //only one block on this proc
+    cond &= (_onBlock == 1);
+    cond &= (_i2o_destRank[0] == rank) ; //the only block will stay with me
+    cond &= (_o2i_destRank[0] == rank) ;
+    for (int i = 0; i < 3; i++) {
+        cond &= (_shift[i] == 0); //no shift in memory
+        cond &= (_topo_in->nloc(i) == _topo_out->nloc(i)); //same size of topology
+        cond &= (_topo_in->nmem(i) == _topo_out->nmem(i)); //same size in memory in every direction (alignement in the FRI, ghost points in all of them)
+    }
+    return cond;
+}
+
+void SwitchTopo_nb::execute(double* v, const int sign, double* const* field) const {
+    BEGIN_FUNC;
+    execute_pipelined(v, sign, NULL, field);
+    END_FUNC;
+}
+
+/**
+ * @brief execute the switch from one topo to another and overlap the 1D FFTs of the output topology with the communications
+ * 
+ * The switch is done as in execute() but a pencil is transformed as soon as it is available:
+ * - FLUPS_FORWARD: once a block has been copied to the memory, we transform every pencil that has been completely received,
+ * i.e. the pencils for which all the blocks covering it are in the memory.
+ * The other blocks are still being received in the meantime.
+ * - FLUPS_BACKWARD: before a block is copied to the buffer, we transform every pencil it covers that has not been transformed yet.
+ * The block is then sent while we transform the pencils of the next block.
+ * 
+ * The pencils that are not covered by any block are not transformed: they only contain zeros in the forward case
+ * and they are never sent in the backward case.
+ * 
+ * @warning For a R2C/C2R plan, the output topology has to be in its real state (see FFTW_plan_dim::execute_pencil)
+ * 
+ * @param v the memory to switch from one topo to another. It has to be large enough to contain both local data's
+ * @param sign if the switch is forward (FLUPS_FORWARD) or backward (FLUPS_BACKWARD) w.r.t. the order defined at init.
+ * @param plan the plan to execute on the output topology (#_topo_out), if NULL only the switch is done
+ * @param field if not NULL, the lda components of the field in the input topology (see execute())
  * 
  * -----------------------------------------------
  * We do the following:
  */
-void SwitchTopo_nb::execute(double* v, const int sign) const {
+void SwitchTopo_nb::execute_pipelined(double* v, const int sign, const FFTW_plan_dim* plan, double* const* field) const {
     BEGIN_FUNC;
 
     FLUPS_CHECK(_topo_in->isComplex() == _topo_out->isComplex(),"both topologies have to be complex or real", LOCATION);
@@ -534,8 +791,7 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
     FLUPS_CHECK(_topo_in->nf() <= 2, "the value of nf is not supported", LOCATION);
     FLUPS_CHECK(_sendBuf!=NULL && _recvBuf != NULL, "both buffers have to be non NULL",LOCATION);
 
-    PROF_START("reorder");
-    int iswitch = _iswitch;
+    PROF_STARTh(_profReorder);
 
     //-------------------------------------------------------------------------
     /** - setup required memory arrays */
@@ -573,6 +829,13 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
 
     fftw_plan* shuffle = NULL;
 
+    // the plan is executed on the output topology: after the reception if forward, before the send if backward
+    const FFTW_plan_dim* recv_plan = (sign == FLUPS_FORWARD) ? plan : NULL;
+    const FFTW_plan_dim* send_plan = (sign == FLUPS_BACKWARD) ? plan : NULL;
+    // the field is read when filling the buffers if forward, written when reading them if backward
+    double* const* send_field = (sign == FLUPS_FORWARD) ? field : NULL;
+    double* const* recv_field = (sign == FLUPS_BACKWARD) ? field : NULL;
+
     if (sign == FLUPS_FORWARD) {
         topo_in     = _topo_in;
         topo_out    = _topo_out;
@@ -635,7 +898,7 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
             
         }
     } else {
-        FLUPS_CHECK(false, "the sign is not FLUPS_FORWARD nor FLUPS_BACKWARD", LOCATION);
+        FLUPS_ERROR("the sign is not FLUPS_FORWARD nor FLUPS_BACKWARD", LOCATION);
     }
 
     FLUPS_INFO("switch nb: previous topo: %d,%d,%d axis=%d", topo_in->nglob(0), topo_in->nglob(1), topo_in->nglob(2), topo_in->axis());
@@ -644,26 +907,33 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
 
     // check if we can return already, because the switchtopo would be useless
     {
-        int rank;
-        MPI_Comm_rank(_subcomm, &rank);
-
-        bool cond = (_topo_in->axis() == _topo_out->axis()); //same axis
-        cond &= (send_nBlock == 1); //only one block on this proc
-        cond &= (recv_nBlock == 1);   
-        cond &= (_i2o_destRank[0] == rank) ; //the only block will stay with me
-        cond &= (_o2i_destRank[0] == rank) ;
-        for (int i = 0; i < 3; i++) {
-            cond &= (_shift[i] == 0); //no shift in memory
-            cond &= (_topo_in->nloc(i) == _topo_out->nloc(i)); //same size of topology
-        }
-        cond &= (inmem[topo_in->axis()] == onmem[topo_out->axis()]); //same size in memory in the FRI (also for alignement)
-        if(cond){
+        if (_is_identity()) {
             FLUPS_INFO("I skip this switch because nothing needs to change.");
-            PROF_STOP("reorder");
+            PROF_STOPh(_profReorder);
+            // the field is needed before the plan if forward
+            if (send_field != NULL) {
+                _copy_field(_topo_in, v, send_field, FLUPS_FORWARD);
+            }
+            // the plan still has to be executed on every pencil
+            if (plan != NULL) {
+                plan->execute_pencils(_topo_out, v);
+            }
+            // the field is copied after the plan if backward
+            if (recv_field != NULL) {
+                _copy_field(_topo_in, v, recv_field, FLUPS_BACKWARD);
+            }
             return void();
         }
     };
 
+    // every thread communicates if MPI allows it
+    if (_threadMultiple) {
+        _execute_threaded(v, sign, plan, field);
+        PROF_STOPh(_profReorder);
+        END_FUNC;
+        return;
+    }
+
     // define important constants
     const int iax0 = topo_in->axis();
     const int iax1 = (iax0 + 1) % 3;
@@ -673,6 +943,33 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
     const int oax2 = (oax0 + 2) % 3;
     const int nf   = topo_in->nf();
 
+    //-------------------------------------------------------------------------
+    /** - if needed, get the pencil counters of the plan (see FFTW_plan_dim::pencilCount()), used to know when a pencil can be transformed */
+    //-------------------------------------------------------------------------
+    // forward:  the number of blocks that still have to be received for each pencil of topo_out
+    // backward: wether the pencil of topo_in has already been transformed (0) or not (1)
+    int* pencilCount = NULL;
+    if (recv_plan != NULL) {
+        const size_t npencil = (size_t)onmem[oax1] * (size_t)onmem[oax2];
+        FLUPS_CHECK(npencil <= recv_plan->npencil(), "the plan has %zu pencil counters, %zu are needed", recv_plan->npencil(), npencil, LOCATION);
+        pencilCount          = recv_plan->pencilCount();
+        std::memset(pencilCount, 0, npencil * sizeof(int));
+        for (int bid = 0; bid < recv_nBlock; bid++) {
+            for (int i2 = 0; i2 < oBlockSize[oax2][bid]; i2++) {
+                for (int i1 = 0; i1 < oBlockSize[oax1][bid]; i1++) {
+                    pencilCount[(oBlockiStart[oax1][bid] + i1) + onmem[oax1] * (oBlockiStart[oax2][bid] + i2)] += 1;
+                }
+            }
+        }
+    } else if (send_plan != NULL) {
+        const size_t npencil = (size_t)inmem[iax1] * (size_t)inmem[iax2];
+        FLUPS_CHECK(npencil <= send_plan->npencil(), "the plan has %zu pencil counters, %zu are needed", send_plan->npencil(), npencil, LOCATION);
+        pencilCount          = send_plan->pencilCount();
+        for (size_t id = 0; id < npencil; id++) {
+            pencilCount[id] = 1;
+        }
+    }
+
     //-------------------------------------------------------------------------
     /** - start the reception requests so we are ready to receive */
     //-------------------------------------------------------------------------
@@ -682,8 +979,8 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
         }
     }
 
-    PROF_STARTi("switch",iswitch);
-    PROF_STARTi("mem2buf",iswitch);
+    PROF_STARTh(_profSwitch);
+    PROF_STARTh(_profMem2buf);
     //-------------------------------------------------------------------------
     /** - fill the buffers */
     //-------------------------------------------------------------------------
@@ -691,11 +988,26 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
 
 #if defined(__INTEL_COMPILER)
 //possible need to add ```shared(ompi_request_null)``` depending on the compiler version
-#pragma omp parallel proc_bind(close) default(none) firstprivate(send_nBlock, v, sendBuf, recvBuf, destTag, iBlockSize,iBlockiStart, nf, inmem, iax0, iax1,iax2,sendRequest, lda)
+#pragma omp parallel proc_bind(close) default(none) firstprivate(send_nBlock, v, send_field, sendBuf, recvBuf, destTag, iBlockSize,iBlockiStart, nf, inmem, iax0, iax1,iax2,sendRequest, lda, send_plan, topo_in, pencilCount)
 #elif defined(__GNUC__)
-#pragma omp parallel proc_bind(close) default(none) shared(ompi_request_null) firstprivate(send_nBlock, v, sendBuf, recvBuf, destTag,iBlockSize,iBlockiStart, nf, inmem, iax0, iax1,iax2,sendRequest, lda)
+#pragma omp parallel proc_bind(close) default(none) shared(ompi_request_null) firstprivate(send_nBlock, v, send_field, sendBuf, recvBuf, destTag,iBlockSize,iBlockiStart, nf, inmem, iax0, iax1,iax2,sendRequest, lda, send_plan, topo_in, pencilCount)
 #endif
     for (int bid = 0; bid < send_nBlock; bid++) {
+        // transform the pencils of the block that have not been done yet
+        if (send_plan != NULL) {
+            const int id_max = iBlockSize[iax1][bid] * iBlockSize[iax2][bid];
+#pragma omp for schedule(static)
+            for (int id = 0; id < id_max; id++) {
+                const int    i2 = id / iBlockSize[iax1][bid];
+                const int    i1 = id % iBlockSize[iax1][bid];
+                const size_t io = (iBlockiStart[iax1][bid] + i1) + inmem[iax1] * (iBlockiStart[iax2][bid] + i2);
+                // a pencil is only treated by one thread inside a block and the blocks are done one after the other
+                if (pencilCount[io] > 0) {
+                    send_plan->execute_pencil(topo_in, v, io);
+                    pencilCount[io] = 0;
+                }
+            }
+        }
         for (int lia = 0; lia < lda ; lia++){
             // // get the split index
             // int ib[3];
@@ -726,7 +1038,8 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
             // the buffer is aligned if the starting id is aligned and if nmax is a multiple of the alignement
             const bool isBuffAligned = FLUPS_ISALIGNED(data) &&  nmax%FLUPS_ALIGNMENT == 0;
             // the data is aligned if the starting index is aligned AND if the gap between two entries, inmem[iax0] is a multiple of the alignment
-            double*    my_v            = v + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, lia);
+            double*    my_v            = (send_field == NULL) ? v + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, lia)
+                                                                  : send_field[lia] + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, 0);
             const bool isVectorAligned = FLUPS_ISALIGNED(my_v) && inmem[iax0] % FLUPS_ALIGNMENT == 0;
 
             // we choose the best loop depending on the alignement
@@ -810,31 +1123,27 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
 #pragma omp master
         {
             if (sendRequest[bid] != MPI_REQUEST_NULL) {
+#ifdef COMM_FLOAT
+                // the block is sent in single precision
+                buf_double2float(sendBuf[bid], get_blockMemSize(bid, nf, iBlockSize) * lda);
+#endif
                 MPI_Start(&(sendRequest[bid]));
             }
         }
     }
 
-    PROF_STOPi("mem2buf",iswitch);
+    PROF_STOPh(_profMem2buf);
 
     //-------------------------------------------------------------------------
     /** - reset the memory to 0 */
     //-------------------------------------------------------------------------
-    // reset the memory to 0
-    const size_t nmax = topo_out->memsize();
-    if (FLUPS_ISALIGNED(v)) {
-        opt_double_ptr my_v = v;
-        FLUPS_ASSUME_ALIGNED(my_v,FLUPS_ALIGNMENT);
-#pragma omp parallel for default(none) proc_bind(close) firstprivate(my_v, nmax)
-        for (size_t id = 0; id < nmax; id++) {
-            my_v[id] = 0.0;
+    // reset the memory to 0 where the blocks will not write, in the field only if the blocks do not cover it entirely
+    if (recv_field != NULL) {
+        if (!_is_fullyCovered(recv_nBlock, oBlockSize, topo_out)) {
+            _reset_field(topo_out, recv_field);
         }
     } else {
-        double* __restrict my_v = v;
-#pragma omp parallel for default(none) proc_bind(close) firstprivate(my_v, nmax)
-        for (size_t id = 0; id < nmax; id++) {
-            my_v[id] = 0.0;
-        }
+        _reset_padding(recv_nBlock, oBlockSize, oBlockiStart, topo_out, v);
     }
     
     //-------------------------------------------------------------------------
@@ -845,8 +1154,10 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
 
     // create the status as a shared variable
     MPI_Status status;
+    // time spent in the MPI calls, see _add_commStats()
+    double timeComm = 0.0;
 
-#pragma omp parallel default(none) proc_bind(close) shared(status) firstprivate(recv_nBlock, oselfBlockID, v, recvBuf, oBlockSize, oBlockiStart, nf, onmem, oax0, oax1, oax2, recvRequest, iswitch, shuffle, lda)
+#pragma omp parallel default(none) proc_bind(close) shared(status, timeComm) firstprivate(recv_nBlock, oselfBlockID, v, recv_field, recvBuf, oBlockSize, oBlockiStart, nf, onmem, oax0, oax1, oax2, recvRequest, shuffle, lda, recv_plan, topo_out, pencilCount)
     for (int count = 0; count < recv_nBlock; count++) {
         // only the master receive the call
         int bid = -1;
@@ -859,7 +1170,7 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
             const size_t blockSize = oBlockSize[oax0][bid] * oBlockSize[oax1][bid] * oBlockSize[oax2][bid] * nf;
 #pragma omp master
             {
-                PROF_STARTi("buf2mem",iswitch);
+                PROF_STARTh(_profBuf2mem);
                 // only the master call the fftw_execute which is executed in multithreading
                 if (shuffle != NULL) {
                     for (int lia = 0; lia < lda; lia++){
@@ -876,16 +1187,22 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
         } else {
 #pragma omp master
             {
-                PROF_STARTi("waiting",iswitch);
+                PROF_STARTh(_profComm);
                 int request_index;
+                const double t0 = MPI_Wtime();
                 MPI_Waitany(recv_nBlock, recvRequest, &request_index, &status);
-                PROF_STOPi("waiting",iswitch);
-                PROF_STARTi("buf2mem",iswitch);
+                timeComm += MPI_Wtime() - t0;
+                PROF_STOPh(_profComm);
+                PROF_STARTh(_profBuf2mem);
                 
                 // bid is set for the master
                 bid = status.MPI_TAG;
                 // total size of a block, 1 component
                 const size_t blockSize = oBlockSize[oax0][bid] * oBlockSize[oax1][bid] * oBlockSize[oax2][bid] * nf;
+#ifdef COMM_FLOAT
+                // the block has been received in single precision
+                buf_float2double(recvBuf[bid], get_blockMemSize(bid, nf, oBlockSize) * lda);
+#endif
 
                 // only the master call the fftw_execute which is executed in multithreading                
                 if (shuffle != NULL) {
@@ -910,7 +1227,7 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
         {
 #ifdef PROF            
             if (_prof != NULL) {
-                _prof->addMem("waiting"+to_string(iswitch), get_blockMemSize(bid,nf,oBlockSize)*lda*sizeof(double));
+                _prof->addMem(_profComm, get_blockMemSize(bid,nf,oBlockSize)*lda*FLUPS_COMM_SIZEOF);
             }
 #endif
         }
@@ -937,7 +1254,8 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
             const bool isBuffAligned = FLUPS_ISALIGNED(recvBuf[bid] + lia * blockSize) &&  nmax%FLUPS_ALIGNMENT == 0;
             // the data is aligned if the starting index is aligned AND if the gap between two entries, inmem[iax0] is a multiple of the alignment
             // double*    my_v            = v + localIndex(oax0, oBlockiStart[0][bid], oBlockiStart[1][bid], oBlockiStart[2][bid], oax0, onmem, nf);
-            double*    my_v            = v + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, lia);
+            double*    my_v            = (recv_field == NULL) ? v + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, lia)
+                                                                  : recv_field[lia] + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, 0);
             const bool isVectorAligned = FLUPS_ISALIGNED(my_v) && onmem[oax0] % FLUPS_ALIGNMENT == 0;
 
             //choose the correct loop to improve the efficiency
@@ -1016,19 +1334,538 @@ void SwitchTopo_nb::execute(double* v, const int sign) const {
             }
         }
 
+        // transform the pencils that have been completed by this block
+        if (recv_plan != NULL) {
+            const int id_max = oBlockSize[oax1][bid] * oBlockSize[oax2][bid];
+#pragma omp for schedule(static)
+            for (int id = 0; id < id_max; id++) {
+                const int    i2 = id / oBlockSize[oax1][bid];
+                const int    i1 = id % oBlockSize[oax1][bid];
+                const size_t io = (oBlockiStart[oax1][bid] + i1) + onmem[oax1] * (oBlockiStart[oax2][bid] + i2);
+                // a pencil is only treated by one thread inside a block and the blocks are done one after the other
+                pencilCount[io] -= 1;
+                if (pencilCount[io] == 0) {
+                    recv_plan->execute_pencil(topo_out, v, io);
+                }
+            }
+        }
+
 #pragma omp master
         {
-            PROF_STOPi("buf2mem",iswitch);
+            PROF_STOPh(_profBuf2mem);
         }
     }
     // now that we have received everything, close the send requests
+    const double t0 = MPI_Wtime();
     MPI_Waitall(send_nBlock, sendRequest,MPI_STATUSES_IGNORE);
+    _add_commStats(sign, timeComm + MPI_Wtime() - t0, true);
+
+
+    PROF_STOPh(_profSwitch);
+    PROF_STOPh(_profReorder);
+    END_FUNC;
+}
+
+/**
+ * @brief execute the switch with every thread communicating, used by execute_pipelined() when MPI provides MPI_THREAD_MULTIPLE
+ * 
+ * Instead of having the master thread starting the sends and waiting for the receptions while the other threads copy the blocks:
+ * - the blocks to send are dynamically distributed among the threads, each thread (transforms the pencils,) copies and starts the send of its own blocks,
+ * - each thread owns a contiguous range of the reception requests, tests them with MPI_Testsome and queues its blocks as they arrive,
+ * - the threads copy (and transform) the queued blocks, no matter which thread has received them, until every block is done.
+ * 
+ * A thread whose blocks have all arrived keeps copying the blocks received by the others, so that the work is balanced when the blocks arrive out of order.
+ * 
+ * @param v the memory to switch from one topo to another, see execute_pipelined()
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ * @param plan the plan to execute on the output topology (see execute_pipelined()), if NULL only the switch is done
+ * @param field if not NULL, the lda components of the field in the input topology (see execute())
+ */
+void SwitchTopo_nb::_execute_threaded(double* v, const int sign, const FFTW_plan_dim* plan, double* const* field) const {
+    BEGIN_FUNC;
+    const bool           isForward    = (sign == FLUPS_FORWARD);
+    const Topology*      topo_in      = (isForward) ? _topo_in : _topo_out;
+    const Topology*      topo_out     = (isForward) ? _topo_out : _topo_in;
+    MPI_Request*         sendRequest  = (isForward) ? _i2o_sendRequest : _o2i_sendRequest;
+    MPI_Request*         recvRequest  = (isForward) ? _i2o_recvRequest : _o2i_recvRequest;
+    const int*           selfBlockID  = (isForward) ? _oselfBlockID : _iselfBlockID;
+    int* const*          iBlockSize   = (isForward) ? _iBlockSize : _oBlockSize;
+    int* const*          oBlockSize   = (isForward) ? _oBlockSize : _iBlockSize;
+    int* const*          iBlockiStart = (isForward) ? _iBlockiStart : _oBlockiStart;
+    int* const*          oBlockiStart = (isForward) ? _oBlockiStart : _iBlockiStart;
+    const int            send_nBlock  = (isForward) ? _inBlock : _onBlock;
+    const int            recv_nBlock  = (isForward) ? _onBlock : _inBlock;
+    double* const*       recv_field   = (isForward) ? NULL : field;
+    const FFTW_plan_dim* recv_plan    = (isForward) ? plan : NULL;
+    const FFTW_plan_dim* send_plan    = (isForward) ? NULL : plan;
+
+    const int iax0     = topo_in->axis();
+    const int iax1     = (iax0 + 1) % 3;
+    const int iax2     = (iax0 + 2) % 3;
+    const int oax0     = topo_out->axis();
+    const int oax1     = (oax0 + 1) % 3;
+    const int oax2     = (oax0 + 2) % 3;
+    const int inmem[3] = {topo_in->nmem(0), topo_in->nmem(1), topo_in->nmem(2)};
+    const int onmem[3] = {topo_out->nmem(0), topo_out->nmem(1), topo_out->nmem(2)};
+
+    //-------------------------------------------------------------------------
+    /** - if needed, get the pencil counters of the plan (see FFTW_plan_dim::pencilCount()), used to know when a pencil can be transformed */
+    //-------------------------------------------------------------------------
+    // forward:  the number of blocks that still have to be received for each pencil of topo_out
+    // backward: the state of each pencil of topo_in: 0 if not transformed yet, > 0 if being transformed, < 0 once transformed
+    int* pencilCount = NULL;
+    if (recv_plan != NULL) {
+        const size_t npencil = (size_t)onmem[oax1] * (size_t)onmem[oax2];
+        FLUPS_CHECK(npencil <= recv_plan->npencil(), "the plan has %zu pencil counters, %zu are needed", recv_plan->npencil(), npencil, LOCATION);
+        pencilCount          = recv_plan->pencilCount();
+        std::memset(pencilCount, 0, npencil * sizeof(int));
+        for (int bid = 0; bid < recv_nBlock; bid++) {
+            for (int i2 = 0; i2 < oBlockSize[oax2][bid]; i2++) {
+                for (int i1 = 0; i1 < oBlockSize[oax1][bid]; i1++) {
+                    pencilCount[(oBlockiStart[oax1][bid] + i1) + onmem[oax1] * (oBlockiStart[oax2][bid] + i2)] += 1;
+                }
+            }
+        }
+    } else if (send_plan != NULL) {
+        const size_t npencil = (size_t)inmem[iax1] * (size_t)inmem[iax2];
+        FLUPS_CHECK(npencil <= send_plan->npencil(), "the plan has %zu pencil counters, %zu are needed", send_plan->npencil(), npencil, LOCATION);
+        pencilCount          = send_plan->pencilCount();
+        std::memset(pencilCount, 0, npencil * sizeof(int));
+    }
+    // the value of a transformed pencil, it stays negative whatever the number of blocks that still claim it
+    const int pencilDone = -send_nBlock - 1;
+
+    //-------------------------------------------------------------------------
+    /** - start the reception requests so we are ready to receive */
+    //-------------------------------------------------------------------------
+    for (int bid = 0; bid < recv_nBlock; bid++) {
+        if (recvRequest[bid] != MPI_REQUEST_NULL) {
+            MPI_Start(&(recvRequest[bid]));
+        }
+    }
+
+    // the blocks ready to be copied, in their order of arrival, starting with the self blocks
+    int* queue     = (int*)flups_malloc(std::max(recv_nBlock, 1) * sizeof(int));
+    int  queueHead = 0;
+    int  queueTail = 0;
+    for (int count = 0; count < _selfBlockN; count++) {
+        queue[queueTail++] = selfBlockID[count];
+    }
+    // the number of blocks that have not arrived yet
+    int nPending = recv_nBlock - _selfBlockN;
+    // time spent in the MPI calls by the master thread, see _add_commStats()
+    double timeComm = 0.0;
+
+    // reset the field now if needed, it is not read during the send
+    if (recv_field != NULL && !_is_fullyCovered(recv_nBlock, oBlockSize, topo_out)) {
+        _reset_field(topo_out, recv_field);
+    }
+
+    PROF_STARTh(_profSwitch);
+    PROF_STARTh(_profMem2buf);
+    //-------------------------------------------------------------------------
+    /** - fill the buffers and start the send, block by block */
+    //-------------------------------------------------------------------------
+#pragma omp parallel for default(none) proc_bind(close) schedule(dynamic, 1) firstprivate(v, sign, field, send_plan, topo_in, pencilCount, pencilDone, send_nBlock, iBlockSize, iBlockiStart, inmem, iax1, iax2)
+    for (int bid = 0; bid < send_nBlock; bid++) {
+        // transform the pencils of the block, a pencil is shared by the blocks along the axis
+        if (send_plan != NULL) {
+            const int id_max = iBlockSize[iax1][bid] * iBlockSize[iax2][bid];
+            for (int id = 0; id < id_max; id++) {
+                const size_t io = (iBlockiStart[iax1][bid] + id % iBlockSize[iax1][bid]) + inmem[iax1] * (iBlockiStart[iax2][bid] + id / iBlockSize[iax1][bid]);
+                int state;
+#pragma omp atomic capture seq_cst
+                state = pencilCount[io]++;
+                if (state == 0) {
+                    send_plan->execute_pencil(topo_in, v, io);
+#pragma omp atomic write seq_cst
+                    pencilCount[io] = pencilDone;
+                } else {
+                    // wait for the thread that transforms the pencil
+                    while (state >= 0) {
+#pragma omp atomic read seq_cst
+                        state = pencilCount[io];
+                    }
+                }
+            }
+        }
+        _send_block(bid, v, sign, field);
+    }
+    PROF_STOPh(_profMem2buf);
+
+    //-------------------------------------------------------------------------
+    /** - reset the memory to 0 where the blocks will not write, it is not read anymore */
+    //-------------------------------------------------------------------------
+    if (recv_field == NULL) {
+        _reset_padding(recv_nBlock, oBlockSize, oBlockiStart, topo_out, v);
+    }
+
+    PROF_STARTh(_profBuf2mem);
+#pragma omp parallel default(none) proc_bind(close) shared(queue, queueHead, queueTail, nPending, timeComm) firstprivate(v, sign, field, recv_plan, topo_out, pencilCount, recv_nBlock, recvRequest, oBlockSize, oBlockiStart, onmem, oax1, oax2)
+    {
+        //---------------------------------------------------------------------
+        /** - test the requests of the thread and copy the blocks as they arrive */
+        //---------------------------------------------------------------------
+        const int tid     = omp_get_thread_num();
+        const int nthread = omp_get_num_threads();
+        const int rb0     = (int)(((long)recv_nBlock * tid) / nthread);
+        const int rb1     = (int)(((long)recv_nBlock * (tid + 1)) / nthread);
+        // MPI_Testsome returns MPI_UNDEFINED once none of the requests is active anymore
+        bool   isActive = (rb1 > rb0);
+        int*   arrived  = (int*)flups_malloc(std::max(rb1 - rb0, 1) * sizeof(int));
+        double myTime   = 0.0;
+
+        while (true) {
+            if (isActive) {
+                int          nArrived;
+                const double t0 = MPI_Wtime();
+                MPI_Testsome(rb1 - rb0, recvRequest + rb0, &nArrived, arrived, MPI_STATUSES_IGNORE);
+                myTime += MPI_Wtime() - t0;
+                if (nArrived == MPI_UNDEFINED) {
+                    isActive = false;
+                } else if (nArrived > 0) {
+#pragma omp critical(SwitchTopo_nb_queue)
+                    {
+                        for (int i = 0; i < nArrived; i++) {
+                            queue[queueTail++] = rb0 + arrived[i];
+                        }
+                        nPending -= nArrived;
+                    }
+                }
+            }
+            // take the oldest block ready, whoever has received it
+            int  bid    = -1;
+            bool isDone = false;
+#pragma omp critical(SwitchTopo_nb_queue)
+            {
+                if (queueHead < queueTail) {
+                    bid = queue[queueHead++];
+                } else {
+                    isDone = (nPending == 0);
+                }
+            }
+            if (bid >= 0) {
+                _recv_block(bid, v, sign, field);
+                // transform the pencils that have been completed by this block
+                if (recv_plan != NULL) {
+                    const int id_max = oBlockSize[oax1][bid] * oBlockSize[oax2][bid];
+                    for (int id = 0; id < id_max; id++) {
+                        const size_t io = (oBlockiStart[oax1][bid] + id % oBlockSize[oax1][bid]) + onmem[oax1] * (oBlockiStart[oax2][bid] + id / oBlockSize[oax1][bid]);
+                        int left;
+#pragma omp atomic capture seq_cst
+                        left = --pencilCount[io];
+                        if (left == 0) {
+                            recv_plan->execute_pencil(topo_out, v, io);
+                        }
+                    }
+                }
+            } else if (isDone) {
+                break;
+            }
+        }
+        flups_free(arrived);
 
-    PROF_STOPi("switch",iswitch);
-    PROF_STOP("reorder");
+#pragma omp master
+        {
+            timeComm = myTime;
+        }
+    }
+    PROF_STOPh(_profBuf2mem);
+    // now that we have received everything, close the send requests
+    const double t0 = MPI_Wtime();
+    MPI_Waitall(send_nBlock, sendRequest, MPI_STATUSES_IGNORE);
+    _add_commStats(sign, timeComm + MPI_Wtime() - t0, true);
+
+    flups_free(queue);
+    PROF_STOPh(_profSwitch);
     END_FUNC;
 }
 
+/**
+ * @brief start the switch from one topo to another, the communications then progress in execute_test() and are completed in execute_end()
+ * 
+ * The receptions are started, the buffers are filled and sent, the memory is reset and the self blocks are copied.
+ * The input data (v, or field if FLUPS_FORWARD) can therefore be modified once the function returns.
+ * 
+ * @param v the memory to switch from one topo to another. It has to be large enough to contain both local data's
+ * @param sign if the switch is forward (FLUPS_FORWARD) or backward (FLUPS_BACKWARD) w.r.t. the order defined at init.
+ * @param field if not NULL, the lda components of the field in the input topology (see execute())
+ */
+void SwitchTopo_nb::execute_begin(double* v, const int sign, double* const* field) const {
+    BEGIN_FUNC;
+    FLUPS_CHECK(_topo_in->isComplex() == _topo_out->isComplex(),"both topologies have to be complex or real", LOCATION);
+    FLUPS_CHECK(_topo_in->lda() == _topo_out->lda(), "both topologies must have the same lda", LOCATION);
+    FLUPS_CHECK(sign == FLUPS_FORWARD || sign == FLUPS_BACKWARD, "the sign is not FLUPS_FORWARD nor FLUPS_BACKWARD", LOCATION);
+    if (_splitCount >= 0) {
+        FLUPS_ERROR("the previous split-phase switch has not been completed", LOCATION);
+    }
+
+    // nothing to overlap if the switch does not change anything
+    if (_is_identity()) {
+        execute(v, sign, field);
+        END_FUNC;
+        return;
+    }
+
+    const bool      isForward   = (sign == FLUPS_FORWARD);
+    const Topology* topo_out    = (isForward) ? _topo_out : _topo_in;
+    MPI_Request*    recvRequest = (isForward) ? _i2o_recvRequest : _o2i_recvRequest;
+    const int*      selfBlockID = (isForward) ? _oselfBlockID : _iselfBlockID;
+    int* const*     oBlockSize  = (isForward) ? _oBlockSize : _iBlockSize;
+    int* const*     oBlockiStart = (isForward) ? _oBlockiStart : _iBlockiStart;
+    const int       send_nBlock = (isForward) ? _inBlock : _onBlock;
+    const int       recv_nBlock = (isForward) ? _onBlock : _inBlock;
+    double* const*  recv_field  = (isForward) ? NULL : field;
+
+    //-------------------------------------------------------------------------
+    /** - start the reception requests so we are ready to receive */
+    //-------------------------------------------------------------------------
+    for (int bid = 0; bid < recv_nBlock; bid++) {
+        if (recvRequest[bid] != MPI_REQUEST_NULL) {
+            MPI_Start(&(recvRequest[bid]));
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    /** - fill the buffers and start the send of each block */
+    //-------------------------------------------------------------------------
+    PROF_STARTh(_profMem2buf);
+    for (int bid = 0; bid < send_nBlock; bid++) {
+        _send_block(bid, v, sign, field);
+    }
+    PROF_STOPh(_profMem2buf);
+
+    //-------------------------------------------------------------------------
+    /** - reset the memory to 0, in the field only if the blocks do not cover it entirely */
+    //-------------------------------------------------------------------------
+    if (recv_field != NULL) {
+        if (!_is_fullyCovered(recv_nBlock, oBlockSize, topo_out)) {
+            _reset_field(topo_out, recv_field);
+        }
+    } else {
+        _reset_padding(recv_nBlock, oBlockSize, oBlockiStart, topo_out, v);
+    }
+
+    //-------------------------------------------------------------------------
+    /** - copy the self blocks, the other ones are copied as they arrive */
+    //-------------------------------------------------------------------------
+    PROF_STARTh(_profBuf2mem);
+    for (int count = 0; count < _selfBlockN; count++) {
+        _recv_block(selfBlockID[count], v, sign, field);
+    }
+    PROF_STOPh(_profBuf2mem);
+    _splitCount = _selfBlockN;
+    // the time is added in execute_test() and execute_end()
+    _add_commStats(sign, 0.0, true);
+    END_FUNC;
+}
+
+/**
+ * @brief copy the blocks that have arrived since the last call, without waiting for the others
+ * 
+ * @param v the memory to switch from one topo to another, see execute_begin()
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD, see execute_begin()
+ * @param field the field given to execute_begin()
+ * @return true if the switch is completed
+ */
+bool SwitchTopo_nb::execute_test(double* v, const int sign, double* const* field) const {
+    BEGIN_FUNC;
+    if (_splitCount < 0) {
+        END_FUNC;
+        return true;
+    }
+    const bool   isForward   = (sign == FLUPS_FORWARD);
+    MPI_Request* sendRequest = (isForward) ? _i2o_sendRequest : _o2i_sendRequest;
+    MPI_Request* recvRequest = (isForward) ? _i2o_recvRequest : _o2i_recvRequest;
+    const int    send_nBlock = (isForward) ? _inBlock : _onBlock;
+    const int    recv_nBlock = (isForward) ? _onBlock : _inBlock;
+
+    // copy every block that has arrived, the index of a request is the block id
+    while (_splitCount < recv_nBlock) {
+        int flag, bid;
+        const double t0 = MPI_Wtime();
+        MPI_Testany(recv_nBlock, recvRequest, &bid, &flag, MPI_STATUS_IGNORE);
+        _commStats.timeComm += MPI_Wtime() - t0;
+        if (!flag || bid == MPI_UNDEFINED) {
+            break;
+        }
+        PROF_STARTh(_profBuf2mem);
+        _recv_block(bid, v, sign, field);
+        PROF_STOPh(_profBuf2mem);
+        _splitCount++;
+    }
+    if (_splitCount < recv_nBlock) {
+        END_FUNC;
+        return false;
+    }
+    // everything has been received, check the sends
+    int flag;
+    const double t0 = MPI_Wtime();
+    MPI_Testall(send_nBlock, sendRequest, &flag, MPI_STATUSES_IGNORE);
+    _commStats.timeComm += MPI_Wtime() - t0;
+    if (flag) {
+        _splitCount = -1;
+    }
+    END_FUNC;
+    return flag;
+}
+
+/**
+ * @brief wait for the remaining blocks and complete the switch started by execute_begin()
+ * 
+ * @param v the memory to switch from one topo to another, see execute_begin()
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD, see execute_begin()
+ * @param field the field given to execute_begin()
+ */
+void SwitchTopo_nb::execute_end(double* v, const int sign, double* const* field) const {
+    BEGIN_FUNC;
+    if (_splitCount < 0) {
+        END_FUNC;
+        return;
+    }
+    const bool   isForward   = (sign == FLUPS_FORWARD);
+    MPI_Request* sendRequest = (isForward) ? _i2o_sendRequest : _o2i_sendRequest;
+    MPI_Request* recvRequest = (isForward) ? _i2o_recvRequest : _o2i_recvRequest;
+    const int    send_nBlock = (isForward) ? _inBlock : _onBlock;
+    const int    recv_nBlock = (isForward) ? _onBlock : _inBlock;
+
+    PROF_STARTh(_profComm);
+    while (_splitCount < recv_nBlock) {
+        int bid;
+        const double t0 = MPI_Wtime();
+        MPI_Waitany(recv_nBlock, recvRequest, &bid, MPI_STATUS_IGNORE);
+        _commStats.timeComm += MPI_Wtime() - t0;
+        PROF_STARTh(_profBuf2mem);
+        _recv_block(bid, v, sign, field);
+        PROF_STOPh(_profBuf2mem);
+        _splitCount++;
+    }
+    const double t0 = MPI_Wtime();
+    MPI_Waitall(send_nBlock, sendRequest, MPI_STATUSES_IGNORE);
+    _commStats.timeComm += MPI_Wtime() - t0;
+    PROF_STOPh(_profComm);
+    _splitCount = -1;
+    END_FUNC;
+}
+
+/**
+ * @brief copy a block to its buffer (or to the receive buffer if it is a self block) and start its send
+ * 
+ * The copy is done by the team of threads, or by the calling thread only if it is already in a parallel region (see _execute_threaded()).
+ * 
+ * @param bid the block id in the input topology
+ * @param v the memory
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ * @param field if not NULL and FLUPS_FORWARD, the field to read instead of v (see execute())
+ */
+void SwitchTopo_nb::_send_block(const int bid, double* v, const int sign, double* const* field) const {
+    const bool      isForward    = (sign == FLUPS_FORWARD);
+    const Topology* topo_in      = (isForward) ? _topo_in : _topo_out;
+    MPI_Request*    sendRequest  = (isForward) ? _i2o_sendRequest : _o2i_sendRequest;
+    opt_double_ptr* sendBuf      = (isForward) ? _sendBuf : _recvBuf;
+    opt_double_ptr* recvBuf      = (isForward) ? _recvBuf : _sendBuf;
+    const int*      destTag      = (isForward) ? _i2o_destTag : _o2i_destTag;
+    int* const*     iBlockSize   = (isForward) ? _iBlockSize : _oBlockSize;
+    int* const*     iBlockiStart = (isForward) ? _iBlockiStart : _oBlockiStart;
+    double* const*  send_field   = (isForward) ? field : NULL;
+
+    const int lda  = topo_in->lda();
+    const int nf   = topo_in->nf();
+    const int iax0 = topo_in->axis();
+    const int iax1 = (iax0 + 1) % 3;
+    const int iax2 = (iax0 + 2) % 3;
+    const int inmem[3] = {topo_in->nmem(0), topo_in->nmem(1), topo_in->nmem(2)};
+
+    // the self blocks are directly copied in the recv buffer
+    double* const buf       = (sendRequest[bid] == MPI_REQUEST_NULL) ? recvBuf[destTag[bid]] : sendBuf[bid];
+    const size_t  blockSize = (size_t)iBlockSize[iax0][bid] * (size_t)iBlockSize[iax1][bid] * (size_t)iBlockSize[iax2][bid] * nf;
+    const int     nb1       = iBlockSize[iax1][bid];
+    const int     id_max    = iBlockSize[iax1][bid] * iBlockSize[iax2][bid];
+    const size_t  nmax      = (size_t)iBlockSize[iax0][bid] * nf;
+    for (int lia = 0; lia < lda; lia++) {
+        const double* my_v = (send_field == NULL) ? v + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, lia)
+                                                  : send_field[lia] + localIndex(iax0, iBlockiStart[iax0][bid], iBlockiStart[iax1][bid], iBlockiStart[iax2][bid], iax0, inmem, nf, 0);
+        double* const data = buf + lia * blockSize;
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(my_v, data, id_max, nb1, nmax, iax0, inmem, nf) if (!omp_in_parallel())
+        for (int id = 0; id < id_max; id++) {
+            const double* __restrict vloc    = my_v + localIndex(iax0, 0, id % nb1, id / nb1, iax0, inmem, nf, 0);
+            double* __restrict       dataloc = data + id * nmax;
+            for (size_t i0 = 0; i0 < nmax; i0++) {
+                dataloc[i0] = vloc[i0];
+            }
+        }
+    }
+    if (sendRequest[bid] != MPI_REQUEST_NULL) {
+#ifdef COMM_FLOAT
+        // the block is sent in single precision
+        buf_double2float(sendBuf[bid], get_blockMemSize(bid, nf, iBlockSize) * lda);
+#endif
+        MPI_Start(&(sendRequest[bid]));
+    }
+}
+
+/**
+ * @brief shuffle a received block and copy it to the memory (or to the field if FLUPS_BACKWARD)
+ * 
+ * As for _send_block(), the copy is done by the calling thread only if it is already in a parallel region.
+ * 
+ * @param bid the block id in the output topology
+ * @param v the memory
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ * @param field the field given to execute_begin()
+ */
+void SwitchTopo_nb::_recv_block(const int bid, double* v, const int sign, double* const* field) const {
+    const bool       isForward    = (sign == FLUPS_FORWARD);
+    const Topology*  topo_out     = (isForward) ? _topo_out : _topo_in;
+    opt_double_ptr*  recvBuf      = (isForward) ? _recvBuf : _sendBuf;
+    int* const*      oBlockSize   = (isForward) ? _oBlockSize : _iBlockSize;
+    int* const*      oBlockiStart = (isForward) ? _oBlockiStart : _iBlockiStart;
+    const fftw_plan* shuffle      = (isForward) ? _i2o_shuffle : _o2i_shuffle;
+    double* const*   recv_field   = (isForward) ? NULL : field;
+
+    const int lda  = topo_out->lda();
+    const int nf   = topo_out->nf();
+    const int oax0 = topo_out->axis();
+    const int oax1 = (oax0 + 1) % 3;
+    const int oax2 = (oax0 + 2) % 3;
+    const int onmem[3] = {topo_out->nmem(0), topo_out->nmem(1), topo_out->nmem(2)};
+
+    const size_t blockSize = (size_t)oBlockSize[oax0][bid] * (size_t)oBlockSize[oax1][bid] * (size_t)oBlockSize[oax2][bid] * nf;
+#ifdef COMM_FLOAT
+    // the block has been received in single precision, the self blocks have not been sent
+    const MPI_Request* recvRequest = (isForward) ? _i2o_recvRequest : _o2i_recvRequest;
+    if (recvRequest[bid] != MPI_REQUEST_NULL) {
+        buf_float2double(recvBuf[bid], get_blockMemSize(bid, nf, oBlockSize) * lda);
+    }
+#endif
+    if (shuffle != NULL) {
+        for (int lia = 0; lia < lda; lia++) {
+            if (nf == 1) {
+                fftw_execute_r2r(shuffle[bid], recvBuf[bid] + lia * blockSize, recvBuf[bid] + lia * blockSize);
+            } else {
+                fftw_execute_dft(shuffle[bid], (opt_complex_ptr)(recvBuf[bid] + lia * blockSize), (opt_complex_ptr)(recvBuf[bid] + lia * blockSize));
+            }
+        }
+    }
+
+    const int    nb1    = oBlockSize[oax1][bid];
+    const int    id_max = oBlockSize[oax1][bid] * oBlockSize[oax2][bid];
+    const size_t nmax   = (size_t)oBlockSize[oax0][bid] * nf;
+    for (int lia = 0; lia < lda; lia++) {
+        double* const my_v = (recv_field == NULL) ? v + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, lia)
+                                                  : recv_field[lia] + localIndex(oax0, oBlockiStart[oax0][bid], oBlockiStart[oax1][bid], oBlockiStart[oax2][bid], oax0, onmem, nf, 0);
+        const double* data = recvBuf[bid] + lia * blockSize;
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(my_v, data, id_max, nb1, nmax, oax0, onmem, nf) if (!omp_in_parallel())
+        for (int id = 0; id < id_max; id++) {
+            double* __restrict       vloc    = my_v + localIndex(oax0, 0, id % nb1, id / nb1, oax0, onmem, nf, 0);
+            const double* __restrict dataloc = data + id * nmax;
+            for (size_t i0 = 0; i0 < nmax; i0++) {
+                vloc[i0] = dataloc[i0];
+            }
+        }
+    }
+}
+
 void SwitchTopo_nb::disp() const {
     BEGIN_FUNC;
     FLUPS_INFO("------------------------------------------");
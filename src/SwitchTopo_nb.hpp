@@ -61,20 +61,38 @@ class SwitchTopo_nb : public SwitchTopo {
     int* _i2o_destTag = NULL; /**<@brief The destination rank in the output topo of each block */
     int* _o2i_destTag = NULL; /**<@brief The destination rank in the output topo of each block */
 
+    int* _i2o_commRank = NULL; /**<@brief The destination ranks of _i2o_destRank in _inComm, kept since _setup_subComm() translates them to _subcomm */
+    int* _o2i_commRank = NULL; /**<@brief The destination ranks of _o2i_destRank in _inComm, kept since _setup_subComm() translates them to _subcomm */
+
     MPI_Request *_i2o_sendRequest = NULL; /**<@brief The MPI Request generated on the send */
     MPI_Request *_i2o_recvRequest = NULL; /**<@brief The MPI Request generated on the recv */
     MPI_Request *_o2i_sendRequest = NULL; /**<@brief The MPI Request generated on the send */
     MPI_Request *_o2i_recvRequest = NULL; /**<@brief The MPI Request generated on the recv */
 
+    bool _threadMultiple = false; /**<@brief true if MPI provides MPI_THREAD_MULTIPLE and several threads are available, every thread then sends and receives its own blocks (see _execute_threaded()) */
+
+    mutable int _splitCount = -1; /**<@brief the number of blocks received by the split-phase switch in progress, -1 if none (see execute_begin()) */
+
     void _init_blockInfo(const Topology* topo_in, const Topology* topo_out);
     void _free_blockInfo();
+    bool _permute_blockInfo(MPI_Comm inComm, MPI_Comm outComm);
+    void _exchange_blockInfo(MPI_Comm oldComm, MPI_Comm newComm, int* nBlock, int* blockSize[3], int* blockiStart[3], int** destRank, int** destTag);
+    void _free_buffers();
+    bool _is_identity() const;
+    void _send_block(const int bid, double* v, const int sign, double* const* field) const;
+    void _recv_block(const int bid, double* v, const int sign, double* const* field) const;
+    void _execute_threaded(double* v, const int sign, const FFTW_plan_dim* plan, double* const* field) const;
 
    public:
     SwitchTopo_nb(const Topology *topo_input, const Topology *topo_output, const int shift[3],Profiler* prof);
     ~SwitchTopo_nb();
 
     void setup_buffers(opt_double_ptr _sendBuf,opt_double_ptr _recvBuf);
-    void execute(double* v, const int sign) const;
+    void execute(double* v, const int sign, double* const* field = NULL) const;
+    void execute_pipelined(double* v, const int sign, const FFTW_plan_dim* plan, double* const* field = NULL) const;
+    void execute_begin(double* v, const int sign, double* const* field = NULL) const;
+    bool execute_test(double* v, const int sign, double* const* field = NULL) const;
+    void execute_end(double* v, const int sign, double* const* field = NULL) const;
     void setup() ;
     void disp() const;
 };
@@ -0,0 +1,439 @@
+/**
+ * @file SwitchTopo_node.cpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @brief 
+ * @version
+ * 
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+#include "SwitchTopo_node.hpp"
+
+/**
+ * @brief Construct a node-aware Switch Topo object
+ * 
+ * The blocks are computed as in SwitchTopo_a2a, the node information is computed in setup().
+ * 
+ * @param topo_input the input topology
+ * @param topo_output the output topology 
+ * @param shift the shift is the position of the (0,0,0) of topo_input in the topo_output indexing (in XYZ-indexing)
+ * @param prof the profiler to use to profile the execution of the SwitchTopo
+ */
+SwitchTopo_node::SwitchTopo_node(const Topology* topo_input, const Topology* topo_output, const int shift[3], Profiler* prof) : SwitchTopo_a2a(topo_input, topo_output, shift, prof) {
+    BEGIN_FUNC;
+    END_FUNC;
+}
+
+/**
+ * @brief Destroy the node-aware Switch Topo, the shared windows and the node communicators
+ * 
+ */
+SwitchTopo_node::~SwitchTopo_node() {
+    BEGIN_FUNC;
+    _free_windows();
+    _free_nodeInfo();
+    END_FUNC;
+}
+
+/**
+ * @brief setup the switchtopo as in SwitchTopo_a2a and compute the node information
+ * 
+ */
+void SwitchTopo_node::setup() {
+    BEGIN_FUNC;
+    // the windows are linked to the former node communicator
+    _free_windows();
+    _free_nodeInfo();
+
+    SwitchTopo_a2a::setup();
+    _init_nodeInfo();
+    END_FUNC;
+}
+
+/**
+ * @brief compute the node communicators and the counts/starts needed for the two levels of the exchange
+ * 
+ * The ranks of #_nodecomm are ordered as in #_subcomm so that the ranks of a node are always listed in the same order.
+ * 
+ */
+void SwitchTopo_node::_init_nodeInfo() {
+    BEGIN_FUNC;
+    int rank, subsize;
+    MPI_Comm_rank(_subcomm, &rank);
+    MPI_Comm_size(_subcomm, &subsize);
+
+    //-------------------------------------------------------------------------
+    /** - create the node communicator and the leader communicator */
+    //-------------------------------------------------------------------------
+    MPI_Comm_split_type(_subcomm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &_nodecomm);
+    MPI_Comm_rank(_nodecomm, &_noderank);
+    MPI_Comm_size(_nodecomm, &_nodesize);
+    MPI_Comm_split(_subcomm, (_noderank == 0) ? 0 : MPI_UNDEFINED, rank, &_leadercomm);
+
+    // get the node id and the number of nodes from the leader
+    int nodeinfo[2] = {0, 0};
+    if (_leadercomm != MPI_COMM_NULL) {
+        MPI_Comm_rank(_leadercomm, &nodeinfo[0]);
+        MPI_Comm_size(_leadercomm, &nodeinfo[1]);
+    }
+    MPI_Bcast(nodeinfo, 2, MPI_INT, 0, _nodecomm);
+    _mynode = nodeinfo[0];
+    _nnode  = nodeinfo[1];
+
+    // get the rank in the subcomm of the ranks on my node
+    _peerRank = (int*)flups_malloc(_nodesize * sizeof(int));
+    MPI_Allgather(&rank, 1, MPI_INT, _peerRank, 1, MPI_INT, _nodecomm);
+
+    //-------------------------------------------------------------------------
+    /** - get the counts and starts for every rank, also if we are all to all */
+    //-------------------------------------------------------------------------
+    int* count[2];
+    int* start[2];
+    const int* mycount[2] = {_i2o_count, _o2i_count};
+    const int* mystart[2] = {_i2o_start, _o2i_start};
+    for (int k = 0; k < 2; k++) {
+        count[k] = (int*)flups_malloc(subsize * sizeof(int));
+        start[k] = (int*)flups_malloc(subsize * sizeof(int));
+        for (int ir = 0; ir < subsize; ir++) {
+            count[k][ir] = (_is_all2all) ? mycount[k][0] : mycount[k][ir];
+            start[k][ir] = (_is_all2all) ? mycount[k][0] * ir : mystart[k][ir];
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    /** - get where the data for me starts in the send buffers of my node */
+    //-------------------------------------------------------------------------
+    int* peerstart = (int*)flups_malloc(_nodesize * sizeof(int));
+    for (int k = 0; k < 2; k++) {
+        for (int ip = 0; ip < _nodesize; ip++) {
+            peerstart[ip] = start[k][_peerRank[ip]];
+        }
+        _peerStart[k] = (int*)flups_malloc(_nodesize * sizeof(int));
+        MPI_Alltoall(peerstart, 1, MPI_INT, _peerStart[k], 1, MPI_INT, _nodecomm);
+    }
+    flups_free(peerstart);
+
+    //-------------------------------------------------------------------------
+    /** - gather the counts and starts of the node on the leader */
+    //-------------------------------------------------------------------------
+    int* rankNode = (int*)flups_malloc(subsize * sizeof(int));
+    MPI_Allgather(&_mynode, 1, MPI_INT, rankNode, 1, MPI_INT, _subcomm);
+
+    const bool isLeader = (_leadercomm != MPI_COMM_NULL);
+    for (int k = 0; k < 2; k++) {
+        if (isLeader) {
+            _nodeCount[k] = (int*)flups_malloc((size_t)_nodesize * subsize * sizeof(int));
+            _nodeStart[k] = (int*)flups_malloc((size_t)_nodesize * subsize * sizeof(int));
+        }
+        MPI_Gather(count[k], subsize, MPI_INT, _nodeCount[k], subsize, MPI_INT, 0, _nodecomm);
+        MPI_Gather(start[k], subsize, MPI_INT, _nodeStart[k], subsize, MPI_INT, 0, _nodecomm);
+        flups_free(count[k]);
+        flups_free(start[k]);
+    }
+
+    if (isLeader) {
+        // sort the ranks by node, keeping the increasing order of the ranks inside a node
+        _nodeRankStart = (int*)flups_malloc((_nnode + 1) * sizeof(int));
+        _nodeRankList  = (int*)flups_malloc(subsize * sizeof(int));
+        std::memset(_nodeRankStart, 0, (_nnode + 1) * sizeof(int));
+        for (int ir = 0; ir < subsize; ir++) {
+            _nodeRankStart[rankNode[ir] + 1] += 1;
+        }
+        for (int im = 0; im < _nnode; im++) {
+            _nodeRankStart[im + 1] += _nodeRankStart[im];
+        }
+        int* nodeFill = (int*)flups_malloc(_nnode * sizeof(int));
+        std::memcpy(nodeFill, _nodeRankStart, _nnode * sizeof(int));
+        for (int ir = 0; ir < subsize; ir++) {
+            _nodeRankList[nodeFill[rankNode[ir]]++] = ir;
+        }
+        flups_free(nodeFill);
+
+        // the counts between the leaders are the sum of the counts between the ranks of both nodes, we do not send to ourselves
+        size_t bufsize = 0;
+        for (int k = 0; k < 2; k++) {
+            _leaderCount[k] = (int*)flups_malloc(_nnode * sizeof(int));
+            _leaderStart[k] = (int*)flups_malloc(_nnode * sizeof(int));
+            size_t total    = 0;
+            for (int im = 0; im < _nnode; im++) {
+                int nodecount = 0;
+                if (im != _mynode) {
+                    for (int ip = 0; ip < _nodesize; ip++) {
+                        for (int j = _nodeRankStart[im]; j < _nodeRankStart[im + 1]; j++) {
+                            nodecount += _nodeCount[k][(size_t)ip * subsize + _nodeRankList[j]];
+                        }
+                    }
+                }
+                _leaderCount[k][im] = nodecount;
+                _leaderStart[k][im] = (int)total;
+                total += (size_t)nodecount;
+            }
+            bufsize = std::max(bufsize, total);
+        }
+        _leaderSendBuf = (char*)flups_malloc(std::max(bufsize, (size_t)1) * FLUPS_COMM_SIZEOF);
+        _leaderRecvBuf = (char*)flups_malloc(std::max(bufsize, (size_t)1) * FLUPS_COMM_SIZEOF);
+    }
+    flups_free(rankNode);
+
+    FLUPS_INFO("node-aware switch: %d nodes with %d ranks on mine", _nnode, _nodesize);
+    END_FUNC;
+}
+
+/**
+ * @brief free the node communicators and the arrays computed in _init_nodeInfo()
+ * 
+ */
+void SwitchTopo_node::_free_nodeInfo() {
+    BEGIN_FUNC;
+    if (_leadercomm != MPI_COMM_NULL) MPI_Comm_free(&_leadercomm);
+    if (_nodecomm != MPI_COMM_NULL) MPI_Comm_free(&_nodecomm);
+    _leadercomm = MPI_COMM_NULL;
+    _nodecomm   = MPI_COMM_NULL;
+
+    if (_peerRank != NULL) flups_free(_peerRank);
+    if (_nodeRankStart != NULL) flups_free(_nodeRankStart);
+    if (_nodeRankList != NULL) flups_free(_nodeRankList);
+    if (_leaderSendBuf != NULL) flups_free(_leaderSendBuf);
+    if (_leaderRecvBuf != NULL) flups_free(_leaderRecvBuf);
+    _peerRank      = NULL;
+    _nodeRankStart = NULL;
+    _nodeRankList  = NULL;
+    _leaderSendBuf = NULL;
+    _leaderRecvBuf = NULL;
+
+    for (int k = 0; k < 2; k++) {
+        if (_peerStart[k] != NULL) flups_free(_peerStart[k]);
+        if (_nodeCount[k] != NULL) flups_free(_nodeCount[k]);
+        if (_nodeStart[k] != NULL) flups_free(_nodeStart[k]);
+        if (_leaderCount[k] != NULL) flups_free(_leaderCount[k]);
+        if (_leaderStart[k] != NULL) flups_free(_leaderStart[k]);
+        _peerStart[k]   = NULL;
+        _nodeCount[k]   = NULL;
+        _nodeStart[k]   = NULL;
+        _leaderCount[k] = NULL;
+        _leaderStart[k] = NULL;
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief free the shared windows, and hence the send and recv buffers
+ * 
+ */
+void SwitchTopo_node::_free_windows() {
+    BEGIN_FUNC;
+    if (_sendWin != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(_sendWin);
+        MPI_Win_free(&_sendWin);
+    }
+    if (_recvWin != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(_recvWin);
+        MPI_Win_free(&_recvWin);
+    }
+    _sendWin = MPI_WIN_NULL;
+    _recvWin = MPI_WIN_NULL;
+
+    if (_peerSendBuf != NULL) flups_free(_peerSendBuf);
+    if (_peerRecvBuf != NULL) flups_free(_peerRecvBuf);
+    _peerSendBuf = NULL;
+    _peerRecvBuf = NULL;
+    END_FUNC;
+}
+
+/**
+ * @brief allocate the send and recv buffers in shared windows and setup the blocks as in SwitchTopo_a2a::setup_buffers()
+ * 
+ * The windows remain in a passive epoch (MPI_Win_lock_all) until they are freed, the synchronization is done in _node_sync().
+ * As the windows do not depend on the given buffers, a new call keeps the existing windows, which avoids a collective call on the node
+ * when the Solver moves its other switches to new buffers.
+ * 
+ * The given buffers are not used (see ownBuffers()): the send and recv buffers are allocated in shared windows.
+ */
+void SwitchTopo_node::setup_buffers(opt_double_ptr, opt_double_ptr) {
+    BEGIN_FUNC;
+    FLUPS_CHECK(_nodecomm != MPI_COMM_NULL, "the switch must be setup before its buffers", LOCATION);
+    if (_sendWin != MPI_WIN_NULL) {
+        END_FUNC;
+        return;
+    }
+
+    const size_t memsize = get_bufMemSize();
+
+    // allocate the windows, the memory of each rank is allocated close to it
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    double* sendW = NULL;
+    double* recvW = NULL;
+    MPI_Win_allocate_shared((MPI_Aint)(memsize * sizeof(double)), sizeof(double), info, _nodecomm, &sendW, &_sendWin);
+    MPI_Win_allocate_shared((MPI_Aint)(memsize * sizeof(double)), sizeof(double), info, _nodecomm, &recvW, &_recvWin);
+    MPI_Info_free(&info);
+    std::memset(sendW, 0, memsize * sizeof(double));
+    std::memset(recvW, 0, memsize * sizeof(double));
+
+    // get the buffers of the ranks on my node
+    _peerSendBuf = (double**)flups_malloc(_nodesize * sizeof(double*));
+    _peerRecvBuf = (double**)flups_malloc(_nodesize * sizeof(double*));
+    for (int ip = 0; ip < _nodesize; ip++) {
+        MPI_Aint size;
+        int      disp;
+        MPI_Win_shared_query(_sendWin, ip, &size, &disp, &_peerSendBuf[ip]);
+        MPI_Win_shared_query(_recvWin, ip, &size, &disp, &_peerRecvBuf[ip]);
+    }
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, _sendWin);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, _recvWin);
+
+    SwitchTopo_a2a::setup_buffers(sendW, recvW);
+    END_FUNC;
+}
+
+/**
+ * @brief synchronize the shared windows among the ranks of the node
+ * 
+ */
+void SwitchTopo_node::_node_sync() const {
+    MPI_Win_sync(_sendWin);
+    MPI_Win_sync(_recvWin);
+    MPI_Barrier(_nodecomm);
+    MPI_Win_sync(_sendWin);
+    MPI_Win_sync(_recvWin);
+}
+
+/**
+ * @brief exchange the buffers in two levels: direct copies inside the node and aggregated messages between the node leaders
+ * 
+ * The arguments are the same as SwitchTopo_a2a::_all_to_all() and refer to the shared buffers of the calling rank.
+ * The leader of the node packs the data of all its ranks for every other node, in the order (source rank, destination rank),
+ * and unpacks the received data directly in the recv buffers of its ranks.
+ * 
+ * @param sign FLUPS_FORWARD or FLUPS_BACKWARD
+ * @param sendBufG not used, the send buffers of the node are accessed through the shared window
+ * @param send_count the number of elements sent to each rank
+ * @param send_start the starting index in sendBufG of the data for each rank
+ * @param recvBufG the recv buffer
+ * @param recv_count the number of elements received from each rank
+ * @param recv_start the starting index in recvBufG of the data from each rank
+ */
+void SwitchTopo_node::_all_to_all(const int sign, opt_double_ptr, const int* send_count, const int* send_start, opt_double_ptr recvBufG, const int* recv_count, const int* recv_start) const {
+    BEGIN_FUNC;
+    int subsize;
+    MPI_Comm_size(_subcomm, &subsize);
+
+    // the send side is k, the recv side is 1-k
+    const int       k         = (sign == FLUPS_FORWARD) ? 0 : 1;
+    double* const*  peerSend  = (sign == FLUPS_FORWARD) ? _peerSendBuf : _peerRecvBuf;
+    double* const*  peerRecv  = (sign == FLUPS_FORWARD) ? _peerRecvBuf : _peerSendBuf;
+    const size_t    esize     = FLUPS_COMM_SIZEOF;
+    const bool      isA2A     = _is_all2all;
+    const int       nodesize  = _nodesize;
+    const int*      peerRank  = _peerRank;
+    const int*      peerStart = _peerStart[k];
+    char*           recvc     = (char*)recvBufG;
+
+    PROF_STARTh(_profCommV);
+
+    // the send buffers of the node are ready
+    _node_sync();
+
+    //-------------------------------------------------------------------------
+    /** - copy the data from the ranks of my node */
+    //-------------------------------------------------------------------------
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(nodesize, peerRank, peerStart, peerSend, recvc, recv_count, recv_start, isA2A, esize)
+    for (int ip = 0; ip < nodesize; ip++) {
+        const int    ir    = peerRank[ip];
+        const size_t count = (isA2A) ? recv_count[0] : recv_count[ir];
+        const size_t start = (isA2A) ? (size_t)recv_count[0] * ir : recv_start[ir];
+        std::memcpy(recvc + start * esize, ((const char*)peerSend[ip]) + (size_t)peerStart[ip] * esize, count * esize);
+    }
+
+    //-------------------------------------------------------------------------
+    /** - the leaders exchange the data between the nodes */
+    //-------------------------------------------------------------------------
+    if (_leadercomm != MPI_COMM_NULL && _nnode > 1) {
+        const int  nnode         = _nnode;
+        const int  mynode        = _mynode;
+        const int* nodeRankStart = _nodeRankStart;
+        const int* nodeRankList  = _nodeRankList;
+        const int* sendCount     = _nodeCount[k];
+        const int* sendStart     = _nodeStart[k];
+        const int* recvCount     = _nodeCount[1 - k];
+        const int* recvStart     = _nodeStart[1 - k];
+        const int* lsendStart    = _leaderStart[k];
+        const int* lrecvStart    = _leaderStart[1 - k];
+        char*      lsendBuf      = _leaderSendBuf;
+        char*      lrecvBuf      = _leaderRecvBuf;
+
+        // pack: for every node, the data of all my ranks for all its ranks
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(nnode, mynode, nodesize, subsize, nodeRankStart, nodeRankList, sendCount, sendStart, lsendStart, lsendBuf, peerSend, esize)
+        for (int im = 0; im < nnode; im++) {
+            if (im == mynode) continue;
+            char* buf = lsendBuf + (size_t)lsendStart[im] * esize;
+            for (int ip = 0; ip < nodesize; ip++) {
+                for (int j = nodeRankStart[im]; j < nodeRankStart[im + 1]; j++) {
+                    const size_t id    = (size_t)ip * subsize + nodeRankList[j];
+                    const size_t count = (size_t)sendCount[id] * esize;
+                    std::memcpy(buf, ((const char*)peerSend[ip]) + (size_t)sendStart[id] * esize, count);
+                    buf += count;
+                }
+            }
+        }
+
+        MPI_Alltoallv(lsendBuf, _leaderCount[k], lsendStart, FLUPS_MPI_COMM_TYPE, lrecvBuf, _leaderCount[1 - k], lrecvStart, FLUPS_MPI_COMM_TYPE, _leadercomm);
+
+        // unpack: from every node, the data of all its ranks for all my ranks
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(nnode, mynode, nodesize, subsize, nodeRankStart, nodeRankList, recvCount, recvStart, lrecvStart, lrecvBuf, peerRecv, esize)
+        for (int im = 0; im < nnode; im++) {
+            if (im == mynode) continue;
+            const char* buf = lrecvBuf + (size_t)lrecvStart[im] * esize;
+            for (int j = nodeRankStart[im]; j < nodeRankStart[im + 1]; j++) {
+                for (int ip = 0; ip < nodesize; ip++) {
+                    const size_t id    = (size_t)ip * subsize + nodeRankList[j];
+                    const size_t count = (size_t)recvCount[id] * esize;
+                    std::memcpy(((char*)peerRecv[ip]) + (size_t)recvStart[id] * esize, buf, count);
+                    buf += count;
+                }
+            }
+        }
+    }
+
+    // the recv buffers of the node are complete
+    _node_sync();
+
+#ifdef PROF
+    if (_prof != NULL) {
+        _prof->stop(_profCommV);
+        int loc_mem = 0;
+        for (int ir = 0; ir < subsize; ir++) {
+            loc_mem += (isA2A) ? send_count[0] : send_count[ir];
+        }
+        _prof->addMem(_profCommV, loc_mem * FLUPS_COMM_SIZEOF);
+    }
+#endif
+    END_FUNC;
+}
+
+void SwitchTopo_node::disp() const {
+    BEGIN_FUNC;
+    SwitchTopo_a2a::disp();
+    FLUPS_INFO("## node-aware: %d nodes, %d ranks on my node (rank %d)", _nnode, _nodesize, _noderank);
+    FLUPS_INFO("------------------------------------------");
+}
@@ -0,0 +1,101 @@
+/**
+ * @file SwitchTopo_node.hpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @brief 
+ * @version
+ * 
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+#ifndef SWITCHTOPO_NODE_HPP
+#define SWITCHTOPO_NODE_HPP
+
+#include <cstring>
+#include "defines.hpp"
+#include "mpi.h"
+#include "Topology.hpp"
+#include "Profiler.hpp"
+#include "SwitchTopo.hpp"
+#include "SwitchTopo_a2a.hpp"
+
+/**
+ * @brief Switch between two different topologies with a node-aware (two-level) communication
+ * 
+ * The blocks are packed in the buffers exactly as in SwitchTopo_a2a, but the buffers are allocated in a shared memory window among the ranks
+ * of the same node (see MPI_Comm_split_type with MPI_COMM_TYPE_SHARED). The exchange is then done in two levels:
+ * - the data between two ranks of the same node is directly copied from the send buffer of the source to the recv buffer of the destination;
+ * - the data going to another node is gathered by the node leader (the rank 0 of the node), which sends one message per node to the other leaders
+ * and scatters the data received directly in the recv buffers of its node.
+ * 
+ * The number of messages between the nodes is then the number of nodes instead of the number of ranks, which is beneficial when a lot of ranks
+ * share the same node.
+ * 
+ * @warning the buffers given to setup_buffers() are not used: the switch allocates its own shared buffers of the size get_bufMemSize().
+ * The node switches are then not pooled: ownBuffers() is true and their size is not included in the buffers of the Solver, neither in its scratch
+ * nor in the BufferPool.
+ * 
+ */
+class SwitchTopo_node : public SwitchTopo_a2a {
+   protected:
+    MPI_Comm _nodecomm   = MPI_COMM_NULL; /**<@brief the ranks of #_subcomm sharing the same node */
+    MPI_Comm _leadercomm = MPI_COMM_NULL; /**<@brief the node leaders of #_subcomm, MPI_COMM_NULL if I am not a leader */
+
+    int _nodesize = 0; /**<@brief the number of ranks in #_nodecomm */
+    int _noderank = 0; /**<@brief my rank in #_nodecomm */
+    int _nnode    = 0; /**<@brief the number of nodes in #_subcomm */
+    int _mynode   = 0; /**<@brief my node id, i.e. the rank of my leader in #_leadercomm */
+
+    int* _peerRank     = NULL;         /**<@brief the rank in #_subcomm of every rank of #_nodecomm */
+    int* _peerStart[2] = {NULL, NULL}; /**<@brief the starting index of the data for me in the send buffer of every rank of #_nodecomm (0 = input to output, 1 = output to input) */
+
+    int* _nodeRankStart  = NULL;         /**<@brief leader only: the ranks of node m are _nodeRankList[_nodeRankStart[m]] to _nodeRankList[_nodeRankStart[m+1]-1] */
+    int* _nodeRankList   = NULL;         /**<@brief leader only: the ranks of #_subcomm sorted by node */
+    int* _nodeCount[2]   = {NULL, NULL}; /**<@brief leader only: _nodeCount[k][ip * subsize + ir] is the count of the rank ip of #_nodecomm for the rank ir of #_subcomm */
+    int* _nodeStart[2]   = {NULL, NULL}; /**<@brief leader only: the corresponding start in the buffer of the rank ip */
+    int* _leaderCount[2] = {NULL, NULL}; /**<@brief leader only: the count for each node, as the sum of the counts of the ranks of both nodes */
+    int* _leaderStart[2] = {NULL, NULL}; /**<@brief leader only: the start for each node in the aggregated buffers */
+
+    char* _leaderSendBuf = NULL; /**<@brief leader only: the aggregated send buffer */
+    char* _leaderRecvBuf = NULL; /**<@brief leader only: the aggregated recv buffer */
+
+    MPI_Win  _sendWin     = MPI_WIN_NULL; /**<@brief the shared window of the send buffers */
+    MPI_Win  _recvWin     = MPI_WIN_NULL; /**<@brief the shared window of the recv buffers */
+    double** _peerSendBuf = NULL;         /**<@brief the send buffer of every rank of #_nodecomm */
+    double** _peerRecvBuf = NULL;         /**<@brief the recv buffer of every rank of #_nodecomm */
+
+    void _init_nodeInfo();
+    void _free_nodeInfo();
+    void _free_windows();
+    void _node_sync() const;
+    void _all_to_all(const int sign, opt_double_ptr sendBufG, const int* send_count, const int* send_start, opt_double_ptr recvBufG, const int* recv_count, const int* recv_start) const;
+
+   public:
+    SwitchTopo_node(const Topology* topo_input, const Topology* topo_output, const int shift[3], Profiler* prof);
+    ~SwitchTopo_node();
+
+    void setup_buffers(opt_double_ptr sendBuf, opt_double_ptr recvBuf);
+    void setup();
+    bool ownBuffers() const { return true; }
+    void disp() const;
+};
+
+#endif
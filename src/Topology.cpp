@@ -73,7 +73,10 @@ Topology::Topology(const int axis, const int lda, const int nglob[3], const int
         _nproc[id] = nproc[id];
         // store the proc axis, used to split the rank
         _axproc[id] = (axproc == NULL) ? id : axproc[id];
+        // no ghost points by default
+        _nghost[id] = 0;
     }
+    _decompType = DECOMP_PENCIL;
 
     //-------------------------------------------------------------------------
     /** - split the rank and get rankd  */
@@ -92,7 +95,7 @@ Topology::Topology(const int axis, const int lda, const int nglob[3], const int
 /**
  * @brief compute the nloc and nmem sizes using _rankd, _nglob, _nproc, _nloc
  * 
- * This function padds the size of the domain if needed
+ * This function padds the size of the domain if needed, the memory includes the ghost points on both sides
  * 
  */
 void Topology::cmpt_sizes() {
@@ -100,12 +103,12 @@ void Topology::cmpt_sizes() {
     for (int id = 0; id < 3; id++) {
         // we get the max between the nglob and
         _nloc[id] = cmpt_nbyproc(id);
-        _nmem[id] = _nloc[id];
+        _nmem[id] = _nloc[id] + 2 * _nghost[id];
         // if we are in the axis and the last proc, we pad to ensure that every pencil is ok with alignment
         // if (id == _axis && _rankd[id] == (_nproc[id] - 1)) {
         if (id == _axis) {
             // compute by how many we are not aligned: the global size in double = nglob * nf
-            const int modulo = (_nloc[id] * _nf * sizeof(double)) % _alignment;
+            const int modulo = (_nmem[id] * _nf * sizeof(double)) % _alignment;
             // compute the number of points to add (in double indexing)
             const int delta = (_alignment - modulo) / sizeof(double);
             _nmem[id] += (modulo == 0) ? 0 : delta / _nf;
@@ -114,6 +117,27 @@ void Topology::cmpt_sizes() {
     END_FUNC;
 }
 
+/**
+ * @brief Add ghost points around the local domain in the memory layout of the topology
+ * 
+ * The memory of one component then has nmem = nloc + 2 * nghost points per dim (+ the padding along the #axis)
+ * and its first local point is at memoffset().
+ * A user field with ghost points can then be passed to the solver without copying its local points in a separate array.
+ * 
+ * @warning must be done before the topology is used to create a solver
+ * 
+ * @param nghost the number of ghost points on each side, per dim
+ */
+void Topology::set_ghost(const int nghost[3]) {
+    BEGIN_FUNC;
+    for (int id = 0; id < 3; id++) {
+        FLUPS_CHECK(nghost[id] >= 0, "the number of ghost points must be >= 0", LOCATION);
+        _nghost[id] = nghost[id];
+    }
+    cmpt_sizes();
+    END_FUNC;
+}
+
 /**
  * @brief Set a new communicator for the topology
  * 
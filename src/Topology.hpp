@@ -54,6 +54,8 @@ class Topology {
     int       _rankd[3];   /**<@brief rank of the current process per dim (012-indexing)  */
     int       _nglob[3];   /**<@brief number of unknows per dim, global (012-indexing)  */
     int       _lda;        /**<@brief leading dimension of array=the number of components (eg scalar=1, vector=3) */
+    int       _nghost[3];  /**<@brief number of ghost points on each side of the local domain, per dim, included in _nmem (012-indexing) */
+    FLUPS_DecompType _decompType; /**<@brief the decomposition of the topologies created by the solvers on this topology */
     // int       _nbyproc[3]; /**<@brief mean number of unkows per dim = nloc except for the last one (012-indexing)  */
     const int _alignment;
     MPI_Comm  _comm; /**<@brief the comm associated with the topo, with ranks potentially optimized for switchtopos */
@@ -73,6 +75,8 @@ class Topology {
      * @{
      */
     void change_comm(MPI_Comm comm);
+    void set_ghost(const int nghost[3]);
+    void set_decompType(const FLUPS_DecompType type) { _decompType = type; }
     /**@} */
 
     /**
@@ -89,6 +93,8 @@ class Topology {
     inline int nloc(const int dim) const { return _nloc[dim]; }
     inline int nmem(const int dim) const { return _nmem[dim]; }
     inline int nproc(const int dim) const { return _nproc[dim]; }
+    inline int nghost(const int dim) const { return _nghost[dim]; }
+    inline FLUPS_DecompType decompType() const { return _decompType; }
     inline int rankd(const int dim) const { return _rankd[dim]; }
     // inline int nbyproc(const int dim) const { return _nbyproc[dim]; }
     inline int      axproc(const int dim) const { return _axproc[dim]; }
@@ -164,6 +170,18 @@ class Topology {
      */
     inline size_t memsize() const { return (size_t)_nmem[0] * (size_t)_nmem[1] * (size_t)_nmem[2] * (size_t)_nf * (size_t)_lda; }
 
+    /**
+     * @brief returns the offset of the first local point (after the ghost points) from the start of the memory of one component
+     * 
+     * @return size_t 
+     */
+    inline size_t memoffset() const {
+        const int ax0 = _axis;
+        const int ax1 = (ax0 + 1) % 3;
+        const int ax2 = (ax0 + 2) % 3;
+        return ((size_t)_nghost[ax0] + (size_t)_nmem[ax0] * ((size_t)_nghost[ax1] + (size_t)_nmem[ax1] * (size_t)_nghost[ax2])) * (size_t)_nf;
+    }
+
     /**
      * @brief returns the starting global index on the current proc
      * 
@@ -24,6 +24,7 @@
  */
 
 #include <cmath>
+#include <cstddef>
 // References:
 //   - Abramowitz and Stegun, "Handbook of Mathematical Functions with Formulas, Graphs, and Mathematical Tables", 1964; §9.4 "Bessel functions"
 //   - Press et al., "Numerical Recipes", 3rd edition, Cambridge University Press, 2007; §6.5.1 "Modified Bessel Functions of Integer Order", pp. 279
@@ -102,4 +103,36 @@ static inline double besselk1(const double x) {
         double const z = 1.0 / x;
         return exp(-x) * poly(c_k1pp, 7, z) / (poly(c_k1qq, 7, z) * sqrt(x));
     }
-}
\ No newline at end of file
+}
+
+//Batched version of besselk0: y[i] = besselk0(x[i]) for i < n
+//both expressions are evaluated and the relevant one is selected, so that the loop can be vectorized
+static inline void besselk0_n(const double *x, double *y, const size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const bool   nr = (x[i] <= 1.0);
+        // make sure that the expression not used is evaluated for a valid argument
+        const double xn = nr ? x[i] : 1.0;
+        const double xf = nr ? 1.0 : x[i];
+        const double zn = xn * xn;
+        const double zf = 1. / xf;
+        const double vn = poly(c_k0p, 4, zn) / poly(c_k0q, 2, 1. - zn) - poly(c_k0pi, 4, zn) * log(xn) / poly(c_k0qi, 2, 1. - zn);
+        const double vf = exp(-xf) * poly(c_k0pp, 7, zf) / (poly(c_k0qq, 7, zf) * sqrt(xf));
+        y[i] = nr ? vn : vf;
+    }
+}
+
+//Batched version of besselk1: y[i] = besselk1(x[i]) for i < n
+//both expressions are evaluated and the relevant one is selected, so that the loop can be vectorized
+static inline void besselk1_n(const double *x, double *y, const size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const bool   nr = (x[i] <= 1.0);
+        // make sure that the expression not used is evaluated for a valid argument
+        const double xn = nr ? x[i] : 1.0;
+        const double xf = nr ? 1.0 : x[i];
+        const double zn = xn * xn;
+        const double zf = 1. / xf;
+        const double vn = xn * (poly(c_k1p, 4, zn) / poly(c_k1q, 2, 1. - zn) + poly(c_k1pi, 4, zn) * log(xn) / poly(c_k1qi, 2, 1. - zn)) + 1. / xn;
+        const double vf = exp(-xf) * poly(c_k1pp, 7, zf) / (poly(c_k1qq, 7, zf) * sqrt(xf));
+        y[i] = nr ? vn : vf;
+    }
+}
@@ -31,6 +31,12 @@
 #include <iostream>
 
 #include <execinfo.h>
+#if defined(FLUPS_HUGEPAGE)
+#include <sys/mman.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "fftw3.h"
 #include "mpi.h"
 #include "flups.h"
@@ -441,11 +447,55 @@ typedef int* __restrict __attribute__((aligned(FLUPS_ALIGNMENT))) opt_int_ptr;
 typedef double* __restrict __attribute__((aligned(FLUPS_ALIGNMENT))) opt_double_ptr;
 typedef fftw_complex* __restrict __attribute__((aligned(FLUPS_ALIGNMENT))) opt_complex_ptr;
 
+/**
+ * @brief MPI datatype used to send the data during the switches between topologies
+ * 
+ * With COMM_FLOAT, the data is sent in single precision while the FFTs and the Green's function multiplication are done in double precision.
+ */
+#ifdef COMM_FLOAT
+#define FLUPS_MPI_COMM_TYPE MPI_FLOAT
+#define FLUPS_COMM_SIZEOF sizeof(float)
+#else
+#define FLUPS_MPI_COMM_TYPE MPI_DOUBLE
+#define FLUPS_COMM_SIZEOF sizeof(double)
+#endif
+
 
 //=============================================================================
 // MEMORY ALLOCATION AND FREE
 //=============================================================================
+/**
+ * @brief size in bytes of the huge pages, the allocations larger than this are aligned on it when compiled with FLUPS_HUGEPAGE (2MB by default)
+ * 
+ * It can be changed at compilation time, e.g. `-DFLUPS_HUGEPAGE_SIZE=1073741824` for 1GB pages.
+ */
+#ifndef FLUPS_HUGEPAGE_SIZE
+#define FLUPS_HUGEPAGE_SIZE 2097152
+#endif
+
 static inline void* flups_mem_malloc(size_t size) {
+#if defined(FLUPS_HUGEPAGE)
+    // the large arrays start on a huge page and the kernel is asked to back them with transparent huge pages
+    if (size >= FLUPS_HUGEPAGE_SIZE) {
+#if defined(__INTEL_COMPILER)
+        void* data = _mm_malloc(size, FLUPS_HUGEPAGE_SIZE);
+#else
+        void*     data = NULL;
+        const int err  = posix_memalign(&data, FLUPS_HUGEPAGE_SIZE, size);
+        if (err != 0) {
+            data = NULL;
+        }
+#endif
+        if (data != NULL) {
+#if defined(MADV_HUGEPAGE)
+            madvise(data, size, MADV_HUGEPAGE);
+#endif
+            return data;
+        }
+        // fall back on the usual alignment
+        FLUPS_WARNING("unable to allocate %zu bytes aligned on a huge page, the usual alignment is used", size, LOCATION);
+    }
+#endif
 #if defined(__INTEL_COMPILER)
     return _mm_malloc(size, FLUPS_ALIGNMENT);
 #elif defined(__GNUC__)
@@ -463,14 +513,72 @@ static inline void flups_mem_free(void* data) {
 #endif
 }
 
+/**
+ * @brief sets n doubles of data to 0 with every OpenMP thread (first touch)
+ * 
+ * Each thread zeroes a contiguous chunk, as in the static schedule of the loops on the pencils.
+ * The pages of a new array are then placed on the NUMA node of the threads which use them, instead of the node of the master thread.
+ */
+static inline void flups_first_touch(double* data, const size_t n) {
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(data, n)
+    for (size_t i = 0; i < n; i++) {
+        data[i] = 0.0;
+    }
+}
+
 #if defined(__INTEL_COMPILER)
     #define FLUPS_ASSUME_ALIGNED(a,b) __assume_aligned(a,b)
 #elif defined(__GNUC__)
     #define FLUPS_ASSUME_ALIGNED(a,b) __builtin_assume_aligned(a,b)
 #endif
 
+/**
+ * @brief size in bytes above which a copy to memory that is not read again soon uses non-temporal stores (see @ref flups_stream_copy)
+ * 
+ * It can be changed at compilation time, e.g. `-DFLUPS_NT_THRESHOLD=0` to always use them.
+ */
+#ifndef FLUPS_NT_THRESHOLD
+#define FLUPS_NT_THRESHOLD 8388608
+#endif
+
+/**
+ * @brief copy n doubles from src to dst with non-temporal stores, which bypass the cache
+ * 
+ * Without SSE2, or if dst is not aligned on a double, it is a regular copy.
+ * 
+ * @warning the stores are only visible to the other threads after @ref flups_stream_fence
+ */
+static inline void flups_stream_copy(double* __restrict dst, const double* __restrict src, const size_t n) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    if (((uintptr_t)dst) % sizeof(double) == 0) {
+        // reach the 16 bytes alignment of dst
+        if (((uintptr_t)dst) % 16 != 0 && n > 0) {
+            dst[0] = src[0];
+            i      = 1;
+        }
+        for (; i + 2 <= n; i += 2) {
+            _mm_stream_pd(dst + i, _mm_loadu_pd(src + i));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = src[i];
+    }
+}
+
+/**
+ * @brief makes the non-temporal stores of the calling thread visible, see @ref flups_stream_copy
+ */
+static inline void flups_stream_fence() {
+#if defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
 typedef enum FLUPS_BoundaryType BoundaryType;
 typedef enum FLUPS_GreenType    GreenType;
+typedef enum FLUPS_LGFLoad      LGFLoad;
 
 static const double c_1opi     = 1.0 / (1.0 * M_PI);
 static const double c_1o2pi    = 1.0 / (2.0 * M_PI);
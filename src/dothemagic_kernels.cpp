@@ -0,0 +1,267 @@
+/**
+ * @file dothemagic_kernels.cpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+
+#include "dothemagic_kernels.hpp"
+
+// the explicit SIMD kernels are selected at runtime, depending on the instruction set of the CPU
+#if (defined(__x86_64__) && defined(__GNUC__) && !defined(__INTEL_COMPILER) && !defined(NO_SIMD_DISPATCH))
+#define MAGIC_DISPATCH
+#include <immintrin.h>
+
+// use aligned loads when FLUPS_ALIGNMENT allows it, see the alignment checks in dothemagic
+#if (FLUPS_ALIGNMENT % 64 == 0)
+#define MAGIC_LOAD512(a) _mm512_load_pd(a)
+#define MAGIC_STORE512(a, b) _mm512_store_pd(a, b)
+#else
+#define MAGIC_LOAD512(a) _mm512_loadu_pd(a)
+#define MAGIC_STORE512(a, b) _mm512_storeu_pd(a, b)
+#endif
+#if (FLUPS_ALIGNMENT % 32 == 0)
+#define MAGIC_LOAD256(a) _mm256_load_pd(a)
+#define MAGIC_STORE256(a, b) _mm256_store_pd(a, b)
+#else
+#define MAGIC_LOAD256(a) _mm256_loadu_pd(a)
+#define MAGIC_STORE256(a, b) _mm256_storeu_pd(a, b)
+#endif
+#endif
+
+//==============================================================================
+// scalar kernels
+//==============================================================================
+/**
+ * @brief real data, real Green's function
+ */
+static void _real_scalar(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    for (size_t ii = 0; ii < n; ii++) {
+        data[ii] *= normfact * green[ii];
+    }
+}
+/**
+ * @brief complex data, real Green's function (see Solver::_compactGreenFunction)
+ */
+static void _complex_realGreen_scalar(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    for (size_t ii = 0; ii < n; ii++) {
+        const double c = normfact * green[ii];
+        data[ii * 2 + 0] *= c;
+        data[ii * 2 + 1] *= c;
+    }
+}
+/**
+ * @brief complex data, complex Green's function
+ */
+static void _complex_scalar(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    for (size_t ii = 0; ii < n; ii++) {
+        const double a = data[ii * 2 + 0];
+        const double b = data[ii * 2 + 1];
+        const double c = green[ii * 2 + 0];
+        const double d = green[ii * 2 + 1];
+        // update the values
+        data[ii * 2 + 0] = normfact * (a * c - b * d);
+        data[ii * 2 + 1] = normfact * (a * d + b * c);
+    }
+}
+
+#ifdef MAGIC_DISPATCH
+//==============================================================================
+// AVX2 kernels: 4 doubles per register, the remaining elements are done by the scalar kernels
+//==============================================================================
+__attribute__((target("avx2,fma"))) static void _real_avx2(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    const __m256d nf = _mm256_set1_pd(normfact);
+    size_t        ii = 0;
+    for (; ii + 4 <= n; ii += 4) {
+        const __m256d g = MAGIC_LOAD256(green + ii);
+        const __m256d d = MAGIC_LOAD256(data + ii);
+        MAGIC_STORE256(data + ii, _mm256_mul_pd(d, _mm256_mul_pd(nf, g)));
+    }
+    _real_scalar(n - ii, normfact, green + ii, data + ii);
+}
+__attribute__((target("avx2,fma"))) static void _complex_realGreen_avx2(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    const __m256d nf = _mm256_set1_pd(normfact);
+    size_t        ii = 0;
+    for (; ii + 2 <= n; ii += 2) {
+        // (g0, g1) -> (g0, g0, g1, g1)
+        const __m128d g2 = _mm_loadu_pd(green + ii);
+        const __m256d g  = _mm256_permute4x64_pd(_mm256_castpd128_pd256(g2), 0x50);
+        const __m256d d  = MAGIC_LOAD256(data + 2 * ii);
+        MAGIC_STORE256(data + 2 * ii, _mm256_mul_pd(d, _mm256_mul_pd(nf, g)));
+    }
+    _complex_realGreen_scalar(n - ii, normfact, green + ii, data + 2 * ii);
+}
+__attribute__((target("avx2,fma"))) static void _complex_avx2(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    const __m256d nf = _mm256_set1_pd(normfact);
+    size_t        ii = 0;
+    for (; ii + 2 <= n; ii += 2) {
+        const __m256d d  = MAGIC_LOAD256(data + 2 * ii);
+        const __m256d g  = MAGIC_LOAD256(green + 2 * ii);
+        const __m256d gr = _mm256_movedup_pd(g);         // (c, c)
+        const __m256d gi = _mm256_permute_pd(g, 0xF);    // (d, d)
+        const __m256d ds = _mm256_permute_pd(d, 0x5);    // (b, a)
+        // (a * c - b * d, b * c + a * d)
+        const __m256d r = _mm256_fmaddsub_pd(d, gr, _mm256_mul_pd(ds, gi));
+        MAGIC_STORE256(data + 2 * ii, _mm256_mul_pd(nf, r));
+    }
+    _complex_scalar(n - ii, normfact, green + 2 * ii, data + 2 * ii);
+}
+
+//==============================================================================
+// AVX-512 kernels: 8 doubles per register, the remaining elements are done by the scalar kernels
+//==============================================================================
+__attribute__((target("avx512f"))) static void _real_avx512(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    const __m512d nf = _mm512_set1_pd(normfact);
+    size_t        ii = 0;
+    for (; ii + 8 <= n; ii += 8) {
+        const __m512d g = MAGIC_LOAD512(green + ii);
+        const __m512d d = MAGIC_LOAD512(data + ii);
+        MAGIC_STORE512(data + ii, _mm512_mul_pd(d, _mm512_mul_pd(nf, g)));
+    }
+    _real_scalar(n - ii, normfact, green + ii, data + ii);
+}
+__attribute__((target("avx512f"))) static void _complex_realGreen_avx512(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    const __m512d nf  = _mm512_set1_pd(normfact);
+    const __m512i idx = _mm512_set_epi64(3, 3, 2, 2, 1, 1, 0, 0);
+    size_t        ii  = 0;
+    for (; ii + 4 <= n; ii += 4) {
+        // (g0, g1, g2, g3) -> (g0, g0, g1, g1, g2, g2, g3, g3)
+        const __m256d g4 = MAGIC_LOAD256(green + ii);
+        const __m512d g  = _mm512_permutexvar_pd(idx, _mm512_zextpd256_pd512(g4));
+        const __m512d d  = MAGIC_LOAD512(data + 2 * ii);
+        MAGIC_STORE512(data + 2 * ii, _mm512_mul_pd(d, _mm512_mul_pd(nf, g)));
+    }
+    _complex_realGreen_scalar(n - ii, normfact, green + ii, data + 2 * ii);
+}
+__attribute__((target("avx512f"))) static void _complex_avx512(const size_t n, const double normfact, const double* __restrict green, double* __restrict data) {
+    const __m512d nf = _mm512_set1_pd(normfact);
+    size_t        ii = 0;
+    for (; ii + 4 <= n; ii += 4) {
+        const __m512d d  = MAGIC_LOAD512(data + 2 * ii);
+        const __m512d g  = MAGIC_LOAD512(green + 2 * ii);
+        const __m512d gr = _mm512_movedup_pd(g);         // (c, c)
+        const __m512d gi = _mm512_permute_pd(g, 0xFF);   // (d, d)
+        const __m512d ds = _mm512_permute_pd(d, 0x55);   // (b, a)
+        // (a * c - b * d, b * c + a * d)
+        const __m512d r = _mm512_fmaddsub_pd(d, gr, _mm512_mul_pd(ds, gi));
+        MAGIC_STORE512(data + 2 * ii, _mm512_mul_pd(nf, r));
+    }
+    _complex_scalar(n - ii, normfact, green + 2 * ii, data + 2 * ii);
+}
+#endif
+
+//==============================================================================
+// runtime dispatch
+//==============================================================================
+/**
+ * @brief instruction sets supported by the kernels
+ */
+typedef enum { MAGIC_SCALAR = 0, MAGIC_AVX2 = 1, MAGIC_AVX512 = 2 } MagicISA;
+
+/**
+ * @brief detects the best instruction set available on the CPU
+ */
+static MagicISA _magic_detect() {
+#ifdef MAGIC_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return MAGIC_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return MAGIC_AVX2;
+    }
+#endif
+    return MAGIC_SCALAR;
+}
+
+/**
+ * @brief returns the instruction set used by the kernels, detected once
+ */
+static MagicISA _magic_isa() {
+    static const MagicISA isa = _magic_detect();
+    return isa;
+}
+
+/**
+ * @brief returns the kernel for real data and a real Green's function
+ */
+MagicKernel magic_kernel_real() {
+#ifdef MAGIC_DISPATCH
+    switch (_magic_isa()) {
+        case MAGIC_AVX512:
+            return &_real_avx512;
+        case MAGIC_AVX2:
+            return &_real_avx2;
+        default:
+            break;
+    }
+#endif
+    return &_real_scalar;
+}
+
+/**
+ * @brief returns the kernel for complex data and a real Green's function
+ */
+MagicKernel magic_kernel_complex_realGreen() {
+#ifdef MAGIC_DISPATCH
+    switch (_magic_isa()) {
+        case MAGIC_AVX512:
+            return &_complex_realGreen_avx512;
+        case MAGIC_AVX2:
+            return &_complex_realGreen_avx2;
+        default:
+            break;
+    }
+#endif
+    return &_complex_realGreen_scalar;
+}
+
+/**
+ * @brief returns the kernel for complex data and a complex Green's function
+ */
+MagicKernel magic_kernel_complex() {
+#ifdef MAGIC_DISPATCH
+    switch (_magic_isa()) {
+        case MAGIC_AVX512:
+            return &_complex_avx512;
+        case MAGIC_AVX2:
+            return &_complex_avx2;
+        default:
+            break;
+    }
+#endif
+    return &_complex_scalar;
+}
+
+/**
+ * @brief returns the name of the instruction set used by the kernels
+ */
+const char* magic_kernel_isa() {
+    switch (_magic_isa()) {
+        case MAGIC_AVX512:
+            return "AVX-512";
+        case MAGIC_AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
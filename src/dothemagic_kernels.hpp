@@ -0,0 +1,44 @@
+/**
+ * @file dothemagic_kernels.hpp
+ * @author Thomas Gillis and Denis-Gabriel Caprace
+ * @copyright Copyright © UCLouvain 2020
+ * 
+ * FLUPS is a Fourier-based Library of Unbounded Poisson Solvers.
+ * 
+ * Copyright <2020> <Université catholique de Louvain (UCLouvain), Belgique>
+ * 
+ * List of the contributors to the development of FLUPS, Description and complete License: see LICENSE and NOTICE files.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * 
+ */
+
+
+#ifndef DOTHEMAGIC_KERNELS_HPP
+#define DOTHEMAGIC_KERNELS_HPP
+
+#include "defines.hpp"
+
+/**
+ * @brief generic type for the pencil kernels of the dothemagic functions: data = normfact * green * data for one pencil of n elements
+ * 
+ * The pointers are aligned on FLUPS_ALIGNMENT. For the complex kernels, n is the number of complex numbers and the data is interleaved (real, imag).
+ */
+typedef void (*MagicKernel)(const size_t n, const double normfact, const double* __restrict green, double* __restrict data);
+
+MagicKernel magic_kernel_real();
+MagicKernel magic_kernel_complex_realGreen();
+MagicKernel magic_kernel_complex();
+const char* magic_kernel_isa();
+
+#endif
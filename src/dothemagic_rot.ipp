@@ -71,9 +71,25 @@ void Solver::dothemagic_rot_complex_o2(double *data,const double koffset[3],cons
     int istart[3];
     _topo_hat[cdim]->get_istart_glob(istart);
 
+    // get the Green's function layout, see _compactGreenFunction
+    const int    gnf      = _greenNf;
+    const size_t gstride  = _greenStride;
+    // if the Green's function is evaluated on the fly, each thread uses its own pencil
+    const bool   isMatrixFree = _greenMatrixFree;
+    double*      greenbuf     = (isMatrixFree) ? _get_greenBuf() : NULL;
+    const Topology* topo     = _topo_hat[cdim];
+    const double    ghgrid   = _hgrid[0];
+    const double    volfact  = _volfact;
+    const double*   gkfact   = _greenKfact;
+    const double*   gkoffset = _greenKoffset;
+    const double*   gsymstart = _greenSymstart;
+    const GreenType typeG    = _typeGreen;
+    const double    length   = (isMatrixFree) ? _cmptGreenLength() : 0.0;
+    const double    kappa    = _kappaGreen;
+
     // get the adresses
     opt_double_ptr       mydata   = data;
-    const opt_double_ptr mygreen  = _green;
+    const opt_double_ptr mygreen  = (isMatrixFree) ? greenbuf : _green;
 
     // get the number of pencils for the field and green
     const size_t ondim = _topo_hat[cdim]->nloc(ax1) * _topo_hat[cdim]->nloc(ax2);
@@ -83,21 +99,68 @@ void Solver::dothemagic_rot_complex_o2(double *data,const double koffset[3],cons
     const int    nmem[3]  = {_topo_hat[cdim]->nmem(0), _topo_hat[cdim]->nmem(1), _topo_hat[cdim]->nmem(2)};
     const size_t nloc_ax1 = _topo_hat[cdim]->nloc(ax1);
 
+    // get the user spectral operator, see set_spectralOp(): every thread computes the wave numbers of its pencil in its own part of kbuf
+    const FLUPS_SpectralOp op  = _spectralOp;
+    void* const            ctx = _spectralCtx;
+    double                 skfact[3], skoffset[3], ssymstart[3];
+    get_spectralInfo(skfact, skoffset, ssymstart);
+    double* kbuf = NULL;
+    if (op != NULL) {
+        kbuf = (double*)flups_malloc(sizeof(double) * 3 * inmax * omp_get_max_threads());
+    }
+
     // check the alignment
-    FLUPS_CHECK(FLUPS_ISALIGNED(mygreen) && (nmem[ax0] * _topo_hat[cdim]->nf() * sizeof(double)) % FLUPS_ALIGNMENT == 0, "please use FLUPS_ALIGNMENT to align the memory", LOCATION);
+    FLUPS_CHECK(FLUPS_ISALIGNED(mygreen) && (gstride * sizeof(double)) % FLUPS_ALIGNMENT == 0, "please use FLUPS_ALIGNMENT to align the memory", LOCATION);
     FLUPS_CHECK(FLUPS_ISALIGNED(mydata) && (nmem[ax0] * _topo_hat[cdim]->nf() * sizeof(double)) % FLUPS_ALIGNMENT == 0, "please use FLUPS_ALIGNMENT to align the memory", LOCATION);
     FLUPS_ASSUME_ALIGNED(mydata, FLUPS_ALIGNMENT);
     FLUPS_ASSUME_ALIGNED(mygreen, FLUPS_ALIGNMENT);
     
+    // get the pencil kernel, see dothemagic_kernels.hpp
+#if (KIND == 01 || KIND == 02)
+    const MagicKernel magic = magic_kernel_real();
+#else
+    const MagicKernel magic = (gnf == 1) ? magic_kernel_complex_realGreen() : magic_kernel_complex();
+#endif
+
+    // derivative in the direction d of the component c (real part r = 0, imaginary part r = 1) for the wave index w
+#if (KIND == 01)
+#define ROT_K(w, d, c, r) ((w) * (kfact[d][c][0] + kfact[d][c][1]))
+#elif (KIND == 11)
+#define ROT_K(w, d, c, r) ((w) * kfact[d][c][r])
+#elif (KIND == 02)
+#define ROT_K(w, d, c, r) (sin((w) * (kfact[d][c][0] + kfact[d][c][1]) * hgrid[d]) / hgrid[d])
+#elif (KIND == 12)
+#define ROT_K(w, d, c, r) (sin((w) * kfact[d][c][r] * hgrid[d]) / hgrid[d])
+#endif
+
+    // the derivatives in the direction ax0 only depend on the index along the pencil: we compute them once for all the pencils
+    // kax0[ii * 6 + c * 2 + r] is the derivative of the component c, real (r = 0) and imaginary (r = 1) part
+    double* kax0 = (double*)flups_malloc(sizeof(double) * inmax * 6);
+    for (size_t ii = 0; ii < inmax; ii++) {
+        int is[3];
+        cmpt_symID(ax0, ii, 0, 0, istart, symstart, 0, is);
+        const double w = is[ax0] + koffset[ax0];
+        for (int ic = 0; ic < 3; ic++) {
+            kax0[ii * 6 + ic * 2 + 0] = ROT_K(w, ax0, ic, 0);
+            kax0[ii * 6 + ic * 2 + 1] = ROT_K(w, ax0, ic, 1);
+        }
+    }
+
     // do the loop
 #if (KIND == 01 || KIND == 11)
-#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(ondim, inmax, memdim, nmem, mydata, mygreen, normfact, ax0, nf, nloc_ax1,kfact,koffset,symstart,istart)
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(ondim, inmax, memdim, nmem, mydata, mygreen, normfact, ax0, nf, magic, gstride, nloc_ax1, kfact, koffset, symstart, istart, kax0, isMatrixFree, topo, ghgrid, volfact, gkfact, gkoffset, gsymstart, typeG, length, kappa, op, ctx, skfact, skoffset, ssymstart, kbuf, gnf)
 #elif (KIND == 02 || KIND == 12)
-#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(ondim, inmax, memdim, nmem, mydata, mygreen, normfact, ax0, nf, nloc_ax1,kfact,koffset,symstart,istart,hgrid)
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(ondim, inmax, memdim, nmem, mydata, mygreen, normfact, ax0, nf, magic, gstride, nloc_ax1, kfact, koffset, symstart, istart, kax0, hgrid, isMatrixFree, topo, ghgrid, volfact, gkfact, gkoffset, gsymstart, typeG, length, kappa, op, ctx, skfact, skoffset, ssymstart, kbuf, gnf)
 #endif
     for (size_t io = 0; io < ondim; io++) {
         // get the starting pointer
-        opt_double_ptr greenloc = mygreen + collapsedIndex(ax0, 0, io, nmem, nf);  //lda of Green is only 1
+        opt_double_ptr greenloc;
+        if (isMatrixFree) {
+            greenloc = mygreen + omp_get_thread_num() * gstride;
+            cmpt_Green_0dirunbounded_pencil(topo, io % nloc_ax1, io / nloc_ax1, ghgrid, gkfact, gkoffset, gsymstart, volfact, greenloc, typeG, length, kappa);
+        } else {
+            greenloc = mygreen + io * gstride;  //lda of Green is only 1
+        }
         opt_double_ptr dataloc0 = mydata + 0 * memdim + collapsedIndex(ax0, 0, io, nmem, nf);
         opt_double_ptr dataloc1 = mydata + 1 * memdim + collapsedIndex(ax0, 0, io, nmem, nf);
         opt_double_ptr dataloc2 = mydata + 2 * memdim + collapsedIndex(ax0, 0, io, nmem, nf);
@@ -107,39 +170,37 @@ void Solver::dothemagic_rot_complex_o2(double *data,const double koffset[3],cons
         FLUPS_ASSUME_ALIGNED(dataloc1, FLUPS_ALIGNMENT);
         FLUPS_ASSUME_ALIGNED(dataloc2, FLUPS_ALIGNMENT);
 
-        // do the actual convolution
-        for (size_t ii = 0; ii < inmax; ii++) {
-            int is[3];
-            cmpt_symID(ax0, ii, io % nloc_ax1, io / nloc_ax1, istart, symstart, 0, is);
+        // the derivatives in the two other directions are constant along the pencil
+        // kt[d][c * 2 + r] is the derivative in the direction d of the component c, real (r = 0) and imaginary (r = 1) part
+        int is[3];
+        cmpt_symID(ax0, 0, io % nloc_ax1, io / nloc_ax1, istart, symstart, 0, is);
+        double kt[3][6];
+        for (int id = 0; id < 3; id++) {
+            const double w = is[id] + koffset[id];
+            for (int ic = 0; ic < 3; ic++) {
+                kt[id][ic * 2 + 0] = ROT_K(w, id, ic, 0);
+                kt[id][ic * 2 + 1] = ROT_K(w, id, ic, 1);
+            }
+        }
 
+        // compute the rotational, the branches on ax0 are loop-invariant so that the loop is vectorized
+        for (size_t ii = 0; ii < inmax; ii++) {
+            const double* kx = kax0 + ii * 6;
+            // kicj = derivative in the direction i for the component j
+            // derivative in the direction 0 - component 1 and 2
+            const double k0c1r = (ax0 == 0) ? kx[2] : kt[0][2];
+            const double k0c2r = (ax0 == 0) ? kx[4] : kt[0][4];
+            // derivative in the direction 1 - component 0 and 2
+            const double k1c0r = (ax0 == 1) ? kx[0] : kt[1][0];
+            const double k1c2r = (ax0 == 1) ? kx[4] : kt[1][4];
+            // derivative in the direction 2 - component 0 and 1
+            const double k2c0r = (ax0 == 2) ? kx[0] : kt[2][0];
+            const double k2c1r = (ax0 == 2) ? kx[2] : kt[2][2];
 #if (KIND == 01 || KIND == 02)
             // data
             const double f0r = dataloc0[ii];
             const double f1r = dataloc1[ii];
             const double f2r = dataloc2[ii];
-            // green function
-            const double gr = greenloc[ii];
-#if (KIND == 01)
-            // derivative in the direction 0 - component 1 and 2
-            const double k0c1r = (is[0] + koffset[0]) * (kfact[0][1][0] + kfact[0][1][1]);
-            const double k0c2r = (is[0] + koffset[0]) * (kfact[0][2][0] + kfact[0][2][1]);
-            // derivative in the direction 1 - component 0 and 2
-            const double k1c0r = (is[1] + koffset[1]) * (kfact[1][0][0] + kfact[1][0][1]);
-            const double k1c2r = (is[1] + koffset[1]) * (kfact[1][2][0] + kfact[1][2][1]);
-            // derivative in the direction 2 - component 0 and 1
-            const double k2c0r = (is[2] + koffset[2]) * (kfact[2][0][0] + kfact[2][0][1]);
-            const double k2c1r = (is[2] + koffset[2]) * (kfact[2][1][0] + kfact[2][1][1]);
-#elif (KIND == 02)
-            // derivative in the direction 0 - component 1 and 2
-            const double k0c1r = sin((is[0] + koffset[0]) * (kfact[0][1][0] + kfact[0][1][1]) * hgrid[0]) / hgrid[0];
-            const double k0c2r = sin((is[0] + koffset[0]) * (kfact[0][2][0] + kfact[0][2][1]) * hgrid[0]) / hgrid[0];
-            // derivative in the direction 1 - component 0 and 2
-            const double k1c0r = sin((is[1] + koffset[1]) * (kfact[1][0][0] + kfact[1][0][1]) * hgrid[1]) / hgrid[1];
-            const double k1c2r = sin((is[1] + koffset[1]) * (kfact[1][2][0] + kfact[1][2][1]) * hgrid[1]) / hgrid[1];
-            // derivative in the direction 2 - component 0 and 1
-            const double k2c0r = sin((is[2] + koffset[2]) * (kfact[2][0][0] + kfact[2][0][1]) * hgrid[2]) / hgrid[2];
-            const double k2c1r = sin((is[2] + koffset[2]) * (kfact[2][1][0] + kfact[2][1][1]) * hgrid[2]) / hgrid[2];
-#endif
             // d(f0)/d1
             const double df0d1r = f0r * k1c0r;
             // d(f0)/d2
@@ -153,14 +214,16 @@ void Solver::dothemagic_rot_complex_o2(double *data,const double koffset[3],cons
             // d(f2)/d1
             const double df2d1r = f2r * k1c2r;
             // rotational
-            const double rot0r = df2d1r - df1d2r;
-            const double rot1r = df0d2r - df2d0r;
-            const double rot2r = df1d0r - df0d1r;
-            // convolution
-            dataloc0[ii] = normfact * rot0r * gr;
-            dataloc1[ii] = normfact * rot1r * gr;
-            dataloc2[ii] = normfact * rot2r * gr;
+            dataloc0[ii] = df2d1r - df1d2r;
+            dataloc1[ii] = df0d2r - df2d0r;
+            dataloc2[ii] = df1d0r - df0d1r;
 #elif (KIND == 11 || KIND == 12)
+            const double k0c1c = (ax0 == 0) ? kx[3] : kt[0][3];
+            const double k0c2c = (ax0 == 0) ? kx[5] : kt[0][5];
+            const double k1c0c = (ax0 == 1) ? kx[1] : kt[1][1];
+            const double k1c2c = (ax0 == 1) ? kx[5] : kt[1][5];
+            const double k2c0c = (ax0 == 2) ? kx[1] : kt[2][1];
+            const double k2c1c = (ax0 == 2) ? kx[3] : kt[2][3];
             // data
             const double f0r = dataloc0[ii * 2 + 0];
             const double f1r = dataloc1[ii * 2 + 0];
@@ -168,42 +231,6 @@ void Solver::dothemagic_rot_complex_o2(double *data,const double koffset[3],cons
             const double f0c = dataloc0[ii * 2 + 1];
             const double f1c = dataloc1[ii * 2 + 1];
             const double f2c = dataloc2[ii * 2 + 1];
-            // green function
-            const double gr = greenloc[ii * 2 + 0];
-            const double gc = greenloc[ii * 2 + 1];
-            // kicj = derivative in the direction i for the component j
-            // derivative in the direction 0 - component 1 and 2
-#if (KIND == 11)
-            const double k0c1r = (is[0] + koffset[0]) * kfact[0][1][0];
-            const double k0c1c = (is[0] + koffset[0]) * kfact[0][1][1];
-            const double k0c2r = (is[0] + koffset[0]) * kfact[0][2][0];
-            const double k0c2c = (is[0] + koffset[0]) * kfact[0][2][1];
-            // derivative in the direction 1 - component 0 and 2
-            const double k1c0r = (is[1] + koffset[1]) * kfact[1][0][0];
-            const double k1c0c = (is[1] + koffset[1]) * kfact[1][0][1];
-            const double k1c2r = (is[1] + koffset[1]) * kfact[1][2][0];
-            const double k1c2c = (is[1] + koffset[1]) * kfact[1][2][1];
-            // derivative in the direction 2 - component 0 and 1
-            const double k2c0r = (is[2] + koffset[2]) * kfact[2][0][0];
-            const double k2c0c = (is[2] + koffset[2]) * kfact[2][0][1];
-            const double k2c1r = (is[2] + koffset[2]) * kfact[2][1][0];
-            const double k2c1c = (is[2] + koffset[2]) * kfact[2][1][1];
-#elif (KIND == 12)
-            const double k0c1r = sin((is[0] + koffset[0]) * kfact[0][1][0] * hgrid[0]) / hgrid[0];
-            const double k0c1c = sin((is[0] + koffset[0]) * kfact[0][1][1] * hgrid[0]) / hgrid[0];
-            const double k0c2r = sin((is[0] + koffset[0]) * kfact[0][2][0] * hgrid[0]) / hgrid[0];
-            const double k0c2c = sin((is[0] + koffset[0]) * kfact[0][2][1] * hgrid[0]) / hgrid[0];
-            // derivative in the direction 1 - component 0 and 2
-            const double k1c0r = sin((is[1] + koffset[1]) * kfact[1][0][0] * hgrid[1]) / hgrid[1];
-            const double k1c0c = sin((is[1] + koffset[1]) * kfact[1][0][1] * hgrid[1]) / hgrid[1];
-            const double k1c2r = sin((is[1] + koffset[1]) * kfact[1][2][0] * hgrid[1]) / hgrid[1];
-            const double k1c2c = sin((is[1] + koffset[1]) * kfact[1][2][1] * hgrid[1]) / hgrid[1];
-            // derivative in the direction 2 - component 0 and 1
-            const double k2c0r = sin((is[2] + koffset[2]) * kfact[2][0][0] * hgrid[2]) / hgrid[2];
-            const double k2c0c = sin((is[2] + koffset[2]) * kfact[2][0][1] * hgrid[2]) / hgrid[2];
-            const double k2c1r = sin((is[2] + koffset[2]) * kfact[2][1][0] * hgrid[2]) / hgrid[2];
-            const double k2c1c = sin((is[2] + koffset[2]) * kfact[2][1][1] * hgrid[2]) / hgrid[2];
-#endif
             // d(f0)/d1
             const double df0d1r = f0r * k1c0r - f0c * k1c0c;
             const double df0d1c = f0r * k1c0c + f0c * k1c0r;
@@ -223,22 +250,32 @@ void Solver::dothemagic_rot_complex_o2(double *data,const double koffset[3],cons
             const double df2d1r = f2r * k1c2r - f2c * k1c2c;
             const double df2d1c = f2r * k1c2c + f2c * k1c2r;
             // rotational
-            const double rot0r = df2d1r - df1d2r;
-            const double rot0c = df2d1c - df1d2c;
-            const double rot1r = df0d2r - df2d0r;
-            const double rot1c = df0d2c - df2d0c;
-            const double rot2r = df1d0r - df0d1r;
-            const double rot2c = df1d0c - df0d1c;
-            // convolution
-            dataloc0[ii * 2 + 0] = normfact * (rot0r * gr - rot0c * gc);
-            dataloc0[ii * 2 + 1] = normfact * (rot0r * gc + rot0c * gr);
-            dataloc1[ii * 2 + 0] = normfact * (rot1r * gr - rot1c * gc);
-            dataloc1[ii * 2 + 1] = normfact * (rot1r * gc + rot1c * gr);
-            dataloc2[ii * 2 + 0] = normfact * (rot2r * gr - rot2c * gc);
-            dataloc2[ii * 2 + 1] = normfact * (rot2r * gc + rot2c * gr);
+            dataloc0[ii * 2 + 0] = df2d1r - df1d2r;
+            dataloc0[ii * 2 + 1] = df2d1c - df1d2c;
+            dataloc1[ii * 2 + 0] = df0d2r - df2d0r;
+            dataloc1[ii * 2 + 1] = df0d2c - df2d0c;
+            dataloc2[ii * 2 + 0] = df1d0r - df0d1r;
+            dataloc2[ii * 2 + 1] = df1d0c - df0d1c;
 #endif
         }
+        // convolution of each component with the Green's function
+        magic(inmax, normfact, greenloc, dataloc0);
+        magic(inmax, normfact, greenloc, dataloc1);
+        magic(inmax, normfact, greenloc, dataloc2);
+
+        // apply the user operator while the pencils are in cache
+        if (op != NULL) {
+            double* kloc = kbuf + omp_get_thread_num() * inmax * 3;
+            apply_spectralOp(op, ctx, ax0, istart, skfact, skoffset, ssymstart, inmax, nf, 0, io % nloc_ax1, io / nloc_ax1, greenloc, gnf, dataloc0, kloc);
+            apply_spectralOp(op, ctx, ax0, istart, skfact, skoffset, ssymstart, inmax, nf, 1, io % nloc_ax1, io / nloc_ax1, greenloc, gnf, dataloc1, kloc);
+            apply_spectralOp(op, ctx, ax0, istart, skfact, skoffset, ssymstart, inmax, nf, 2, io % nloc_ax1, io / nloc_ax1, greenloc, gnf, dataloc2, kloc);
+        }
     }
+#undef ROT_K
 
+    flups_free(kax0);
+    if (kbuf != NULL) {
+        flups_free(kbuf);
+    }
     END_FUNC;
 }
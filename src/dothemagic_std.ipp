@@ -55,53 +55,89 @@ void Solver::dothemagic_std_complex(double *data) {
     // get the norm factor
     const double         normfact = _normfact;
 
+    // get the Green's function layout, see _compactGreenFunction
+    const int    gnf     = _greenNf;
+    const size_t gstride = _greenStride;
+    // if the Green's function is evaluated on the fly, each thread uses its own pencil
+    const bool   isMatrixFree = _greenMatrixFree;
+    double*      greenbuf     = (isMatrixFree) ? _get_greenBuf() : NULL;
+    const Topology* topo     = _topo_hat[cdim];
+    const double    hgrid    = _hgrid[0];
+    const double    volfact  = _volfact;
+    const double*   kfact    = _greenKfact;
+    const double*   koffset  = _greenKoffset;
+    const double*   symstart = _greenSymstart;
+    const GreenType typeG    = _typeGreen;
+    const double    length   = (isMatrixFree) ? _cmptGreenLength() : 0.0;
+    const double    kappa    = _kappaGreen;
+
     // get the adresses
     opt_double_ptr       mydata   = data;
-    const opt_double_ptr mygreen  = _green;
+    const opt_double_ptr mygreen  = (isMatrixFree) ? greenbuf : _green;
 
     // get the number of pencils for the field and green
-    const size_t onmax = _topo_hat[cdim]->nloc(ax1) * _topo_hat[cdim]->nloc(ax2) * _topo_hat[cdim]->lda();
+    const int    lda   = _topo_hat[cdim]->lda();
     const size_t ondim = _topo_hat[cdim]->nloc(ax1) * _topo_hat[cdim]->nloc(ax2);
     const size_t inmax = _topo_hat[cdim]->nloc(ax0);
     // get the memory details
     const size_t memdim  = _topo_hat[cdim]->memdim();
     const int    nmem[3] = {_topo_hat[cdim]->nmem(0), _topo_hat[cdim]->nmem(1), _topo_hat[cdim]->nmem(2)};
+    const int    nloc1   = _topo_hat[cdim]->nloc(ax1);
+    int          istart[3];
+    _topo_hat[cdim]->get_istart_glob(istart);
+
+    // get the user spectral operator, see set_spectralOp(): every thread computes the wave numbers of its pencil in its own part of kbuf
+    const FLUPS_SpectralOp op  = _spectralOp;
+    void* const            ctx = _spectralCtx;
+    double                 skfact[3], skoffset[3], ssymstart[3];
+    get_spectralInfo(skfact, skoffset, ssymstart);
+    double* kbuf = NULL;
+    if (op != NULL) {
+        kbuf = (double*)flups_malloc(sizeof(double) * 3 * inmax * omp_get_max_threads());
+    }
+
+    // get the pencil kernel, see dothemagic_kernels.hpp
+#if (KIND == 0)
+    const MagicKernel magic = magic_kernel_real();
+#elif (KIND == 1)
+    const MagicKernel magic = (gnf == 1) ? magic_kernel_complex_realGreen() : magic_kernel_complex();
+#endif
 
     // check the alignment
-    FLUPS_CHECK(FLUPS_ISALIGNED(mygreen) && (nmem[ax0] * _topo_hat[cdim]->nf() * sizeof(double)) % FLUPS_ALIGNMENT == 0, "please use FLUPS_ALIGNMENT to align the memory", LOCATION);
+    FLUPS_CHECK(FLUPS_ISALIGNED(mygreen) && (gstride * sizeof(double)) % FLUPS_ALIGNMENT == 0, "please use FLUPS_ALIGNMENT to align the memory", LOCATION);
     FLUPS_CHECK(FLUPS_ISALIGNED(mydata) && (nmem[ax0] * _topo_hat[cdim]->nf() * sizeof(double)) % FLUPS_ALIGNMENT == 0, "please use FLUPS_ALIGNMENT to align the memory", LOCATION);
     FLUPS_ASSUME_ALIGNED(mydata, FLUPS_ALIGNMENT);
     FLUPS_ASSUME_ALIGNED(mygreen, FLUPS_ALIGNMENT);
     
-    // do the loop
-#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, ondim, inmax, memdim, nmem, mydata, mygreen, normfact, ax0, nf)
-    for (size_t id = 0; id < onmax; id++) {
-        // get the lia and the io index
-        const size_t lia = id / ondim;
-        const size_t io  = id % ondim;
-
+    // do the loop, the pencil of Green is the same for every component
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(lda, ondim, inmax, memdim, nmem, mydata, mygreen, normfact, ax0, nf, magic, gstride, isMatrixFree, topo, nloc1, hgrid, volfact, kfact, koffset, symstart, typeG, length, kappa, op, ctx, istart, skfact, skoffset, ssymstart, kbuf, gnf)
+    for (size_t io = 0; io < ondim; io++) {
         // get the starting pointer
-        opt_double_ptr greenloc = mygreen + collapsedIndex(ax0, 0, io, nmem, nf);  //lda of Green is only 1
-        opt_double_ptr dataloc  = mydata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, nf);
-
-        FLUPS_ASSUME_ALIGNED(dataloc, FLUPS_ALIGNMENT);
+        opt_double_ptr greenloc;
+        if (isMatrixFree) {
+            greenloc = mygreen + omp_get_thread_num() * gstride;
+            cmpt_Green_0dirunbounded_pencil(topo, io % nloc1, io / nloc1, hgrid, kfact, koffset, symstart, volfact, greenloc, typeG, length, kappa);
+        } else {
+            greenloc = mygreen + io * gstride;  //lda of Green is only 1
+        }
         FLUPS_ASSUME_ALIGNED(greenloc, FLUPS_ALIGNMENT);
 
-        // do the actual convolution
-        for (size_t ii = 0; ii < inmax; ii++) {
-#if (KIND == 0)
-            dataloc[ii] *= normfact * greenloc[ii];
-#elif (KIND == 1)
-            const double a = dataloc[ii * 2 + 0];
-            const double b = dataloc[ii * 2 + 1];
-            const double c = greenloc[ii * 2 + 0];
-            const double d = greenloc[ii * 2 + 1];
-            // update the values
-            dataloc[ii * 2 + 0] = normfact * (a * c - b * d);
-            dataloc[ii * 2 + 1] = normfact * (a * d + b * c);
-#endif
+        for (int lia = 0; lia < lda; lia++) {
+            opt_double_ptr dataloc = mydata + lia * memdim + collapsedIndex(ax0, 0, io, nmem, nf);
+            FLUPS_ASSUME_ALIGNED(dataloc, FLUPS_ALIGNMENT);
+
+            // do the actual convolution
+            magic(inmax, normfact, greenloc, dataloc);
+
+            // apply the user operator while the pencil is in cache
+            if (op != NULL) {
+                apply_spectralOp(op, ctx, ax0, istart, skfact, skoffset, ssymstart, inmax, nf, lia, io % nloc1, io / nloc1, greenloc, gnf, dataloc, kbuf + omp_get_thread_num() * inmax * 3);
+            }
         }
     }
 
+    if (kbuf != NULL) {
+        flups_free(kbuf);
+    }
     END_FUNC;
 }
@@ -15,9 +15,59 @@
 /**********************************************************************/
 
 #include <math.h>
+#include <stddef.h>
 
 static const double c_gamma = 0.5772156649015328606;
 
+/* Coefficients of the Chebyshev expansions of expint1() and expint2(), */
+/* also used by the batched version expint_ei_n().                      */
+static const double c_expint1[23] = {7.8737715392882774,
+                                     -8.0314874286705335,
+                                     3.8797325768522250,
+                                     -1.6042971072992259,
+                                     0.5630905453891458,
+                                     -0.1704423017433357,
+                                     0.0452099390015415,
+                                     -0.0106538986439085,
+                                     0.0022562638123478,
+                                     -0.0004335700473221,
+                                     0.0000762166811878,
+                                     -0.0000123417443064,
+                                     0.0000018519745698,
+                                     -0.0000002588698662,
+                                     0.0000000338604319,
+                                     -0.0000000041611418,
+                                     0.0000000004821606,
+                                     -0.0000000000528465,
+                                     0.0000000000054945,
+                                     -0.0000000000005433,
+                                     0.0000000000000512,
+                                     -0.0000000000000046,
+                                     0.0000000000000004};
+static const double c_expint2[23] = {0.2155283776715125,
+                                     0.1028106215227030,
+                                     -0.0045526707131788,
+                                     0.0003571613122851,
+                                     -0.0000379341616932,
+                                     0.0000049143944914,
+                                     -0.0000007355024922,
+                                     0.0000001230603606,
+                                     -0.0000000225236907,
+                                     0.0000000044412375,
+                                     -0.0000000009328509,
+                                     0.0000000002069297,
+                                     -0.0000000000481502,
+                                     0.0000000000116891,
+                                     -0.0000000000029474,
+                                     0.0000000000007691,
+                                     -0.0000000000002070,
+                                     0.0000000000000573,
+                                     -0.0000000000000163,
+                                     0.0000000000000047,
+                                     -0.0000000000000014,
+                                     0.0000000000000004,
+                                     -0.0000000000000001};
+
 static double expint1(double x);
 static double expint2(double x);
 
@@ -52,29 +102,7 @@ static double expint1(double x)
 {
     static int MAX = 23; /* The number of coefficients in a[].   */
 
-    static double a[23] = {7.8737715392882774,
-                           -8.0314874286705335,
-                           3.8797325768522250,
-                           -1.6042971072992259,
-                           0.5630905453891458,
-                           -0.1704423017433357,
-                           0.0452099390015415,
-                           -0.0106538986439085,
-                           0.0022562638123478,
-                           -0.0004335700473221,
-                           0.0000762166811878,
-                           -0.0000123417443064,
-                           0.0000018519745698,
-                           -0.0000002588698662,
-                           0.0000000338604319,
-                           -0.0000000041611418,
-                           0.0000000004821606,
-                           -0.0000000000528465,
-                           0.0000000000054945,
-                           -0.0000000000005433,
-                           0.0000000000000512,
-                           -0.0000000000000046,
-                           0.0000000000000004};
+    const double* a = c_expint1;
 
     int    k;
     double arg, t, value, b0, b1, b2;
@@ -116,29 +144,7 @@ static double expint2(double x)
 {
     static int MAX = 23; /* The number of coefficients in a[].   */
 
-    static double a[23] = {0.2155283776715125,
-                           0.1028106215227030,
-                           -0.0045526707131788,
-                           0.0003571613122851,
-                           -0.0000379341616932,
-                           0.0000049143944914,
-                           -0.0000007355024922,
-                           0.0000001230603606,
-                           -0.0000000225236907,
-                           0.0000000044412375,
-                           -0.0000000009328509,
-                           0.0000000002069297,
-                           -0.0000000000481502,
-                           0.0000000000116891,
-                           -0.0000000000029474,
-                           0.0000000000007691,
-                           -0.0000000000002070,
-                           0.0000000000000573,
-                           -0.0000000000000163,
-                           0.0000000000000047,
-                           -0.0000000000000014,
-                           0.0000000000000004,
-                           -0.0000000000000001};
+    const double* a = c_expint2;
 
     int    k;
     double arg, t, value, b0, b1, b2;
@@ -164,4 +170,46 @@ static double expint2(double x)
 
 }
 
+/**********************************************************************/
+/*                                                                    */
+/*                      void expint_ei_n()                            */
+/*                                                                    */
+/**********************************************************************/
+/*                                                                    */
+/*  DESCRIPTION:                                                      */
+/*  Batched version of expint_ei(): y[i] = expint_ei(x[i]), i < n.    */
+/*  Both Chebyshev expansions have the same number of coefficients,   */
+/*  so they are evaluated with the same branch-free recurrence, the   */
+/*  coefficients being selected per point. The loop can thus be       */
+/*  vectorized by the compiler, with the accuracy of expint_ei().     */
+/*                                                                    */
+/**********************************************************************/
+
+static inline void expint_ei_n(const double* x, double* y, const size_t n)
+{
+    const int MAX = 23; /* The number of coefficients in c_expint*. */
+
+    for (size_t i = 0; i < n; i++) {
+        const double xi = x[i];
+        const bool   lo = (xi <= 4.);
+        /* avoid the 4/x of expint2 when the point is not concerned. */
+        const double xs = lo ? 4. : xi;
+        const double t  = lo ? (.5 * xi) : (2. * (2. * (4. / xs) - 1.));
+
+        double b2 = 0.;
+        double b1 = 0.;
+        double b0 = lo ? c_expint1[MAX - 1] : c_expint2[MAX - 1];
+        for (int k = MAX - 2; k >= 0; k--) {
+            b2 = b1;
+            b1 = b0;
+            b0 = t * b1 - b2 + (lo ? c_expint1[k] : c_expint2[k]);
+        }
+        const double value = .5 * (b0 - b2);
+
+        const double v1 = -(value + log(fabs(xi)));
+        const double v2 = value * exp(-xs);
+        y[i] = (xi < -4.) ? 0. : (lo ? v1 : v2);
+    }
+}
+
 #endif
\ No newline at end of file
@@ -34,14 +34,33 @@
 
 extern "C" {
 
+// the user allocator, see flups_set_allocator
+static FLUPS_MallocFunc flups_userMalloc = NULL;
+static FLUPS_FreeFunc   flups_userFree   = NULL;
+
 void * flups_malloc(size_t size){
+    if (flups_userMalloc != NULL) {
+        return flups_userMalloc(size);
+    }
     return flups_mem_malloc(size);
 }
 
 void flups_free(void* data){
+    if (flups_userFree != NULL) {
+        flups_userFree(data);
+        return;
+    }
     flups_mem_free(data);
 }
 
+void flups_set_allocator(FLUPS_MallocFunc mallocFunc, FLUPS_FreeFunc freeFunc){
+    if ((mallocFunc == NULL) != (freeFunc == NULL)) {
+        FLUPS_ERROR("the allocator and the deallocator must be given together", LOCATION);
+    }
+    flups_userMalloc = mallocFunc;
+    flups_userFree   = freeFunc;
+}
+
 //***********************************************************************
 // * TOPOLOGIES
 // **********************************************************************/
@@ -54,6 +73,14 @@ void flups_topo_free(const FLUPS_Topology* t) {
     delete t;
 }
 
+void flups_topo_set_ghost(FLUPS_Topology* t, const int nghost[3]) {
+    t->set_ghost(nghost);
+}
+
+void flups_topo_set_decompType(FLUPS_Topology* t, const FLUPS_DecompType type) {
+    t->set_decompType(type);
+}
+
 bool flups_topo_get_isComplex(const FLUPS_Topology* t) {
     return t->isComplex();
 }
@@ -111,6 +138,18 @@ FLUPS_Solver* flups_init_timed(FLUPS_Topology* t, FLUPS_BoundaryType* bc[3][2],
 #endif
     return s;
 }
+FLUPS_Solver* flups_init_from(FLUPS_Solver* ref, FLUPS_BoundaryType* bc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff) {
+    Solver* s = new Solver(ref, bc, h, L, orderDiff, NULL);
+    return s;
+}
+FLUPS_Solver* flups_init_from_timed(FLUPS_Solver* ref, FLUPS_BoundaryType* bc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, Profiler* prof) {
+#ifndef PROF
+    Solver* s = new Solver(ref, bc, h, L, orderDiff, NULL);
+#else
+    Solver* s = new Solver(ref, bc, h, L, orderDiff, prof);
+#endif
+    return s;
+}
 
 // destroy the solver
 void flups_cleanup(FLUPS_Solver* s){
@@ -131,6 +170,22 @@ void flups_solve(FLUPS_Solver* s, double* field, double* rhs, const FLUPS_Solver
     s->solve(field, rhs, type);
 }
 
+void flups_solve_many(FLUPS_Solver* s, double** field, double** rhs, const int n, const FLUPS_SolverType type) {
+    s->solve_many(field, rhs, n, type);
+}
+
+void flups_solve_begin(FLUPS_Solver* s, double* field, double* rhs, const FLUPS_SolverType type) {
+    s->solve_begin(field, rhs, type);
+}
+
+int flups_solve_progress(FLUPS_Solver* s) {
+    return (int)s->solve_progress();
+}
+
+void flups_solve_end(FLUPS_Solver* s) {
+    s->solve_end();
+}
+
 
 // -- ADVANCED FEATURES --
 
@@ -138,14 +193,74 @@ size_t flups_get_allocSize(FLUPS_Solver* s){
     return(size_t) s->get_allocSize();
 }
 
+size_t flups_get_commScratchSize(FLUPS_Solver* s){
+    return s->get_commScratchSize();
+}
+
+void flups_get_commStats(FLUPS_Solver* s, const int ip, FLUPS_CommStats* stats) {
+    s->get_commStats(ip, stats);
+}
+
+void flups_reset_commStats(FLUPS_Solver* s) {
+    s->reset_commStats();
+}
+
 void flups_get_spectralInfo(FLUPS_Solver* s, double kfact[3], double koffset[3], double symstart[3]){
     s->get_spectralInfo(kfact,koffset,symstart);
 }
 
+void flups_set_switchType(FLUPS_Solver* s, const FLUPS_SwitchType type){
+    s->set_switchType(type);
+}
+
+void flups_set_commScratch(FLUPS_Solver* s, double* scratch, const size_t size){
+    s->set_commScratch(scratch, size);
+}
+
+void flups_set_fftwFlag(FLUPS_Solver* s, const unsigned flag){
+    s->set_fftwFlag(flag);
+}
+
+void flups_set_fftwWisdom(FLUPS_Solver* s, const char* filename){
+    s->set_wisdomFile(filename);
+}
+
+void flups_set_greenCache(FLUPS_Solver* s, const char* filename){
+    s->set_GreenCache(filename);
+}
+
+void flups_set_greenCompact(FLUPS_Solver* s, const bool compact){
+    s->set_GreenCompact(compact);
+}
+
+void flups_set_greenMatrixFree(FLUPS_Solver* s, const bool matrixFree){
+    s->set_GreenMatrixFree(matrixFree);
+}
+
+void flups_set_spectralOp(FLUPS_Solver* s, FLUPS_SpectralOp op, void* ctx){
+    s->set_spectralOp(op, ctx);
+}
+
+void flups_set_support(FLUPS_Solver* s, const int rhsStart[3], const int rhsEnd[3], const int solStart[3], const int solEnd[3]){
+    s->set_support(rhsStart, rhsEnd, solStart, solEnd);
+}
+
+void flups_update_green(FLUPS_Solver* s, const FLUPS_GreenType type, const double alpha){
+    s->update_green(type, alpha);
+}
+
 void flups_set_alpha(FLUPS_Solver* s, const double alpha){
     s->set_alpha(alpha);   
 }
 
+void flups_set_kappa(FLUPS_Solver* s, const double kappa){
+    s->set_kappa(kappa);
+}
+
+void flups_update_kappa(FLUPS_Solver* s, const double kappa){
+    s->update_kappa(kappa);
+}
+
 const FLUPS_Topology* flups_get_innerTopo_physical(FLUPS_Solver* s){
     return s->get_innerTopo_physical();
 }
@@ -193,13 +308,52 @@ void flups_profiler_disp(FLUPS_Profiler* p, const char* name) {
     p->disp(myname);
 }
 
+void flups_profiler_set_trace(FLUPS_Profiler* p, const int isTraced) {
+    p->set_trace(isTraced != 0);
+}
+
+void flups_profiler_write_trace(FLUPS_Profiler* p) {
+    p->write_trace();
+}
+
+double flups_profiler_get_time(FLUPS_Profiler* p, const char name[]) {
+    const std::string myname(name);
+    return p->get_timeAcc(myname);
+}
+
 //**********************************************************************
 //  HDF5
 //**********************************************************************
 
 void flups_hdf5_dump(const FLUPS_Topology *topo, const char filename[], const double *data){
     const std::string fn(filename);
-    hdf5_dump(topo,fn, data);
+    // only the local points are written, after the ghost points
+    hdf5_dump(topo,fn, data + topo->memoffset());
+}
+
+void flups_hdf5_set_aggregators(const int naggr){
+    hdf5_set_aggregators(naggr);
+}
+
+void flups_hdf5_set_filter(const int filterID, const int nparam, const unsigned int param[]){
+    hdf5_set_filter(filterID, nparam, param);
+}
+
+void flups_hdf5_wait(){
+    hdf5_wait();
+}
+
+//**********************************************************************
+//  LGF kernel
+//**********************************************************************
+
+void flups_lgf_set_path(const char path[]){
+    const std::string mypath(path);
+    lgf_set_path(mypath);
+}
+
+void flups_lgf_set_load(const FLUPS_LGFLoad mode){
+    lgf_set_load(mode);
 }
 
 
@@ -100,6 +100,38 @@ enum FLUPS_DiffType {
     FD2 = 2 /**< @brief Spectral equivalent of 2nd order finite difference, \f$ \hat{K} = i \, \sin(k) \, \hat{G} \f$ */
 };
 
+/**
+ * @brief The communication pattern used to switch between topologies
+ * 
+ */
+enum FLUPS_SwitchType {
+    SWITCH_DEFAULT = 0, /**< @brief the pattern chosen at compilation: non-blocking if compiled with COMM_NONBLOCK, all-to-all otherwise */
+    SWITCH_A2A     = 1, /**< @brief the all-to-all pattern */
+    SWITCH_NB      = 2, /**< @brief the non-blocking pattern */
+    SWITCH_AUTO    = 3, /**< @brief the patterns are timed during the setup and the fastest one is kept */
+    SWITCH_NODE    = 4, /**< @brief the node-aware all-to-all pattern: direct copies inside a node and aggregated messages between the nodes */
+    SWITCH_DT      = 5  /**< @brief the all-to-all pattern with MPI derived datatypes: the data is sent without packing it in a buffer */
+};
+
+/**
+ * @brief The decomposition among the ranks of the topologies in which the 1D transforms are done, see @ref flups_topo_set_decompType
+ * 
+ */
+enum FLUPS_DecompType {
+    DECOMP_PENCIL = 0, /**< @brief pencils: each transform is done in a topology distributed in the two other directions */
+    DECOMP_SLAB   = 1  /**< @brief slabs: the first two transforms are done in topologies distributed in the last direction only, the switch between them stays on the rank */
+};
+
+/**
+ * @brief The way the precomputed LGF kernel is loaded from its file, see @ref flups_lgf_set_load
+ * 
+ */
+enum FLUPS_LGFLoad {
+    LGF_LOAD_EACH   = 0, /**< @brief every rank reads the file */
+    LGF_LOAD_BCAST  = 1, /**< @brief rank 0 reads the file and broadcasts it to every rank */
+    LGF_LOAD_SHARED = 2  /**< @brief rank 0 reads the file and broadcasts it to one rank per node, which stores it in a window shared by the node */
+};
+
 /**
  * @brief to be used as "sign" for all of the FORWARD tranform
  * 
@@ -121,11 +153,15 @@ enum FLUPS_DiffType {
 /**
  * @brief Memory alignment in bytes.
  * 
+ * It can be changed at compilation time with `-DFLUPS_ALIGNMENT=64`, e.g. to use aligned AVX-512 loads.
+ * The same value must be used to compile the library and the application.
  */
+#ifndef FLUPS_ALIGNMENT
 #define FLUPS_ALIGNMENT 16
+#endif
 
 /**
- * @brief FFTW planner flag
+ * @brief default FFTW planner flag, see @ref flups_set_fftwFlag to change it at runtime
  * 
  */
 #define FFTW_FLAG FFTW_PATIENT
@@ -138,6 +174,42 @@ typedef enum FLUPS_BoundaryType FLUPS_BoundaryType;
 typedef enum FLUPS_GreenType    FLUPS_GreenType;
 typedef enum FLUPS_SolverType   FLUPS_SolverType;
 typedef enum FLUPS_DiffType     FLUPS_DiffType;
+typedef enum FLUPS_SwitchType   FLUPS_SwitchType;
+typedef enum FLUPS_DecompType   FLUPS_DecompType;
+typedef enum FLUPS_LGFLoad      FLUPS_LGFLoad;
+
+/**
+ * @brief Communication counters of a switch between two topologies, accumulated over its executions (see @ref flups_get_commStats)
+ * 
+ * The effective bandwidth is given by (bytesSent + bytesRecv) / timeComm.
+ */
+typedef struct {
+    int    count;     /**< @brief the number of executions of the switch */
+    size_t bytesSent; /**< @brief the bytes sent to other ranks */
+    size_t bytesRecv; /**< @brief the bytes received from other ranks */
+    size_t bytesSelf; /**< @brief the bytes that stayed on the rank */
+    size_t msgSent;   /**< @brief the number of messages sent */
+    size_t msgRecv;   /**< @brief the number of messages received */
+    int    peers;     /**< @brief the number of other ranks this rank exchanges with in one execution */
+    double timeComm;  /**< @brief the time spent in the MPI communication calls (MPI_Waitany, MPI_Waitall or MPI_Alltoall(v/w)) [s] */
+} FLUPS_CommStats;
+
+/**
+ * @brief user operator called on each pencil of the spectral solution during the convolution (see @ref flups_set_spectralOp)
+ * 
+ * The operator is called from inside the OpenMP loop of the convolution, once per pencil and per component, right after the multiplication
+ * by the Green's function, while the pencil is still in cache. It must be thread-safe.
+ * 
+ * @param n the number of points in the pencil
+ * @param nf the number of doubles per point: 1 if the data is real, 2 if it is complex (real and imaginary parts interleaved)
+ * @param lia the component of the field
+ * @param k the wave numbers of the points: k[3 * i + d] is the wave number in the direction d of the point i (see @ref flups_get_spectralInfo)
+ * @param green the Green's function along the pencil
+ * @param gnf the number of doubles per point of the Green's function: 1 if only its real part is stored, 2 otherwise
+ * @param data the solution in spectral space along the pencil (normalized), it can be modified in place
+ * @param ctx the user context given to @ref flups_set_spectralOp
+ */
+typedef void (*FLUPS_SpectralOp)(const int n, const int nf, const int lia, const double* k, const double* green, const int gnf, double* data, void* ctx);
 
 /**@} */
 
@@ -166,6 +238,28 @@ void* flups_malloc(size_t size);
  */
 void flups_free(void* data);
 
+/**
+ * @brief user allocator given to @ref flups_set_allocator, it must return memory aligned on FLUPS_ALIGNMENT
+ */
+typedef void* (*FLUPS_MallocFunc)(size_t size);
+
+/**
+ * @brief user deallocator given to @ref flups_set_allocator
+ */
+typedef void (*FLUPS_FreeFunc)(void* data);
+
+/**
+ * @brief replaces the allocator used by @ref flups_malloc and @ref flups_free, e.g. to use the memory pool of the application or explicit huge pages
+ * 
+ * Every array of the library (data, Green's function, communication buffers, ...) is then allocated with mallocFunc and freed with freeFunc.
+ * 
+ * @warning must be done before any allocation by the library (i.e. before the first @ref flups_topo_new) and kept until the last @ref flups_free
+ * 
+ * @param mallocFunc the allocator, NULL to get back to the default one
+ * @param freeFunc the deallocator, NULL to get back to the default one
+ */
+void flups_set_allocator(FLUPS_MallocFunc mallocFunc, FLUPS_FreeFunc freeFunc);
+
 /**
  * @brief compute the memory local index for a point (i0,i1,i2) in axsrc-indexing in a memory.
  * The returned value is in the axtrg-indexing
@@ -314,6 +408,36 @@ FLUPS_Topology* flups_topo_new(const int axis, const int lda, const int nglob[3]
  */
 void flups_topo_free(const FLUPS_Topology* t);
 
+/**
+ * @brief adds ghost points around the local domain in the memory layout of the topology
+ * 
+ * The memory of each component then has nmem = nloc + 2 * nghost points in each direction (see @ref flups_topo_get_nmem),
+ * and the first local point follows the ghost points. A field with ghost points is then passed as such to @ref flups_solve,
+ * @ref flups_do_copy or @ref flups_hdf5_dump, which only access its local points.
+ * 
+ * @warning must be done before @ref flups_init
+ * 
+ * @param t the topology
+ * @param nghost the number of ghost points on each side, in each direction
+ */
+void flups_topo_set_ghost(FLUPS_Topology* t, const int nghost[3]);
+
+/**
+ * @brief sets the decomposition of the topologies created by the solvers on this physical topology (DECOMP_PENCIL by default)
+ * 
+ * In 3D, a pencil decomposition needs two global transposes between the three transforms.
+ * With DECOMP_SLAB, the two first directions are local to the ranks and only the last transpose is global,
+ * the switch between the two first topologies staying on each rank. It is usually faster up to about a thousand ranks,
+ * as long as the number of points in the two last directions of the transforms is larger than the number of ranks.
+ * If not, the pencils are used instead.
+ * 
+ * @warning must be done before @ref flups_init
+ * 
+ * @param t the physical topology
+ * @param type the decomposition
+ */
+void flups_topo_set_decompType(FLUPS_Topology* t, const FLUPS_DecompType type);
+
 /**
  * @brief Determines if the topo works on real or complex numbers
  * 
@@ -432,6 +556,32 @@ FLUPS_Solver* flups_init(FLUPS_Topology* t, FLUPS_BoundaryType* bc[3][2], const
  */
 FLUPS_Solver* flups_init_timed(FLUPS_Topology* t, FLUPS_BoundaryType* bc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, FLUPS_Profiler* prof);
 
+/**
+ * @brief Creates a solver on the same topology as ref, reusing what does not depend on the Green's function.
+ * 
+ * If the boundary conditions lead to the same data layout as ref (e.g. changing a symmetric condition from even to odd), the topologies,
+ * the communication schemes and the data of ref are reused. If the boundary conditions, h, L and orderDiff are the same as ref (e.g. to change
+ * only the Green's function type), the FFTW plans of ref are reused as well.
+ * Only the Green's function is then computed during @ref flups_setup.
+ * 
+ * @warning ref must be setup before the new solver, and cleaned after it
+ * @warning the two solvers may share their data (returned by @ref flups_setup) and must not be used at the same time
+ * 
+ * @param ref the reference solver
+ * @param bc boundary conditions of the domain for the right hand side
+ * @param h physical space increment in each direction
+ * @param L physical length of the domain in each direction
+ * @param orderDiff order of the derivatives for ROT solver, see @ref flups_init
+ * @return FLUPS_Solver* the new solver
+ */
+FLUPS_Solver* flups_init_from(FLUPS_Solver* ref, FLUPS_BoundaryType* bc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff);
+/**
+ * @brief Same as @ref flups_init_from, with a profiler for the timing of the code (if compiled with PROF, if not, it will not use the profiler).
+ * 
+ * @param prof 
+ */
+FLUPS_Solver* flups_init_from_timed(FLUPS_Solver* ref, FLUPS_BoundaryType* bc[3][2], const double h[3], const double L[3], const FLUPS_DiffType orderDiff, FLUPS_Profiler* prof);
+
 /**
  * @brief must be called before execution terminates as it frees the memory used by the solver
  * 
@@ -449,6 +599,132 @@ void flups_cleanup(FLUPS_Solver* s);
  */
 void    flups_set_greenType(FLUPS_Solver* s, const FLUPS_GreenType type);
 
+/**
+ * @brief sets the communication pattern used to switch between the topologies of the field (SWITCH_DEFAULT by default)
+ * 
+ * With SWITCH_AUTO, the all-to-all, the non-blocking, the node-aware and the derived datatypes patterns are set up and timed on a few dummy FFTs during @ref flups_setup.
+ * The fastest one is kept.
+ * 
+ * SWITCH_NODE is recommended when a lot of ranks share the same node: the data exchanged inside a node is directly copied through shared memory,
+ * and the node leaders send one aggregated message per node.
+ * SWITCH_DT skips the packing of the send buffers, and also the unpacking in the first switch when the field is given as one component
+ * to @ref flups_solve. The data is then always sent in double precision, even with COMM_FLOAT.
+ * 
+ * @warning must be done before @ref flups_setup
+ * 
+ * @param s 
+ * @param type the communication pattern
+ */
+void    flups_set_switchType(FLUPS_Solver* s, const FLUPS_SwitchType type);
+
+/**
+ * @brief gives a scratch array used to store the send and recv communication buffers of the solver
+ * 
+ * By default, the communication buffers are stored in a pool shared by all the solvers of the process,
+ * sized to the largest requirement among them and reallocated when it changes.
+ * If the scratch is aligned on FLUPS_ALIGNMENT and holds at least @ref flups_get_commScratchSize doubles, it is used instead of the pool.
+ * The scratch can be any memory that is not used by the application during the calls to FLUPS (e.g. a temporary array of the same size as the field).
+ * 
+ * @warning must be done before @ref flups_setup, and the scratch must remain allocated until the solver is destroyed
+ * @warning the solvers sharing the pool (or the same scratch) must not execute concurrently
+ * 
+ * @param s 
+ * @param scratch the scratch array, NULL to use the pool
+ * @param size the number of doubles in scratch
+ */
+void    flups_set_commScratch(FLUPS_Solver* s, double* scratch, const size_t size);
+
+/**
+ * @brief sets the FFTW planner flag used to create the plans (FFTW_FLAG by default)
+ * 
+ * @warning must be done before @ref flups_setup
+ * 
+ * @param s 
+ * @param flag the FFTW planner flag: FFTW_ESTIMATE, FFTW_MEASURE, FFTW_PATIENT or FFTW_EXHAUSTIVE (possibly combined with FFTW_WISDOM_ONLY)
+ */
+void    flups_set_fftwFlag(FLUPS_Solver* s, const unsigned flag);
+
+/**
+ * @brief sets the file used to store the FFTW wisdom
+ * 
+ * During @ref flups_setup, rank 0 imports the wisdom from the file (if it exists) and broadcasts it to every rank.
+ * At the end of the setup, the wisdom of every rank is gathered on rank 0 and written to the file.
+ * 
+ * @warning must be done before @ref flups_setup
+ * 
+ * @param s 
+ * @param filename the name of the wisdom file
+ */
+void    flups_set_fftwWisdom(FLUPS_Solver* s, const char* filename);
+
+/**
+ * @brief sets the hdf5 file used to store the Green's function in spectral space
+ * 
+ * During @ref flups_setup, the Green's function is read from the file if it matches the current solver
+ * (grid size, h, boundary conditions, Green's type, alpha, kappa and data decomposition). Otherwise it is computed and written to the file.
+ * 
+ * @warning must be done before @ref flups_setup
+ * 
+ * @param s 
+ * @param filename the name of the cache file (with its extension)
+ */
+void    flups_set_greenCache(FLUPS_Solver* s, const char* filename);
+
+/**
+ * @brief sets the compact storage of the Green's function in spectral space (false by default)
+ * 
+ * If true, the Green's function is reallocated to the size of the last topology at the end of @ref flups_setup.
+ * If its imaginary part vanishes (e.g. for 3 unbounded directions), only its real part is kept.
+ * 
+ * @warning must be done before @ref flups_setup
+ * 
+ * @param s 
+ * @param compact true to use the compact storage
+ */
+void    flups_set_greenCompact(FLUPS_Solver* s, const bool compact);
+
+/**
+ * @brief sets the on the fly evaluation of the Green's function in spectral space (false by default)
+ * 
+ * If true and if every direction is spectral (e.g. a fully periodic domain), the Green's function is not stored
+ * but evaluated in the convolution from its closed form expression. Otherwise, the Green's function is stored as usual.
+ * 
+ * @warning must be done before @ref flups_setup
+ * 
+ * @param s 
+ * @param matrixFree true to evaluate the Green's function on the fly
+ */
+void    flups_set_greenMatrixFree(FLUPS_Solver* s, const bool matrixFree);
+
+/**
+ * @brief sets an operator applied on the spectral solution during the convolution (none by default)
+ * 
+ * The operator is fused in the loop of the convolution (see @ref FLUPS_SpectralOp), so that a filter, a dealiasing or a spectral
+ * diagnostic (e.g. an energy spectrum accumulated in ctx) does not need an additional pass on the spectral memory.
+ * 
+ * @param s 
+ * @param op the operator, NULL to remove it
+ * @param ctx the user context given to op
+ */
+void    flups_set_spectralOp(FLUPS_Solver* s, FLUPS_SpectralOp op, void* ctx);
+
+/**
+ * @brief sets the support of the rhs and the region where the solution is needed (the whole domain by default)
+ * 
+ * The rhs must be zero outside [rhsStart,rhsEnd[ and the solution is only computed in [solStart,solEnd[, the content of the field being undefined elsewhere.
+ * The indexes are global indexes in the topology used at @ref flups_init. The FFTs then skip the pencils that are zero (forward)
+ * or that do not contribute to the solution region (backward), which is useful when the rhs only covers a small part of the domain.
+ * 
+ * @warning only used when the code is not compiled with PIPELINE_FFT
+ * 
+ * @param s 
+ * @param rhsStart the first global index of the non-zero rhs
+ * @param rhsEnd the last global index (excluded) of the non-zero rhs
+ * @param solStart the first global index of the solution region
+ * @param solEnd the last global index (excluded) of the solution region
+ */
+void    flups_set_support(FLUPS_Solver* s, const int rhsStart[3], const int rhsEnd[3], const int solStart[3], const int solEnd[3]);
+
 /**
  * @brief setup the solver and do the memory allocation
  * 
@@ -462,6 +738,32 @@ void    flups_set_greenType(FLUPS_Solver* s, const FLUPS_GreenType type);
  */
 double* flups_setup(FLUPS_Solver* s,const bool changeComm);
 
+/**
+ * @brief changes the Green's function of a solver which has been setup, e.g. to adapt the regularization parameter during a run
+ * 
+ * Only the Green's function is computed again: the topologies, the communication schemes and the FFTW plans are reused.
+ * 
+ * @warning must be done after @ref flups_setup and not during a split-phase solve (see @ref flups_solve_begin)
+ * 
+ * @param s 
+ * @param type the new type of Green's function
+ * @param alpha the new regularization parameter (see @ref flups_set_alpha)
+ */
+void flups_update_green(FLUPS_Solver* s, const FLUPS_GreenType type, const double alpha);
+
+/**
+ * @brief changes the screening parameter of a solver which has been setup (see @ref flups_set_kappa), e.g. once per stage of an implicit diffusion step
+ * 
+ * As for @ref flups_update_green, only the Green's function is computed again. Nothing is computed if it is evaluated on the fly
+ * (see @ref flups_set_greenMatrixFree).
+ * 
+ * @warning must be done after @ref flups_setup and not during a split-phase solve (see @ref flups_solve_begin)
+ * 
+ * @param s 
+ * @param kappa the new screening parameter
+ */
+void flups_update_kappa(FLUPS_Solver* s, const double kappa);
+
 /**
  * @brief solve the Poisson equation on rhs, and returns the solution in field (can be done in-place)
  * 
@@ -473,6 +775,54 @@ double* flups_setup(FLUPS_Solver* s,const bool changeComm);
  */
 void flups_solve(FLUPS_Solver* s, double* field, double* rhs, const FLUPS_SolverType type);
 
+/**
+ * @brief solve the Poisson equation on n right hand sides stored in separate arrays, and returns the solutions in field (can be done in-place)
+ * 
+ * The n fields are solved by groups of lda, the leading dimension of the solver: every switch between topologies is done once
+ * per group, with lda times bigger messages. With a scalar solver (lda = 1) this is a plain loop over the fields, to batch k fields
+ * the solver must be created with lda = k.
+ * 
+ * @warning the solver must have been initialized on a topology whose lda divides n (see @ref flups_topo_new), an error is raised otherwise.
+ * Each field[i] and rhs[i] is a scalar array following the layout of that topology (i.e. one component).
+ * 
+ * @param s 
+ * @param field the n solutions
+ * @param rhs the n right hand sides
+ * @param n the number of fields, a multiple of the lda of the solver
+ */
+void flups_solve_many(FLUPS_Solver* s, double** field, double** rhs, const int n, const FLUPS_SolverType type);
+
+/**
+ * @brief start the solve of the Poisson equation on rhs, to be completed by @ref flups_solve_progress or @ref flups_solve_end
+ * 
+ * This split-phase solve allows the user to overlap the communications of the solver with his own work.
+ * The rhs can be modified as soon as the function returns, the field contains the solution once
+ * @ref flups_solve_progress returns 1 or @ref flups_solve_end returns.
+ * 
+ * @warning only the non-blocking switch (SWITCH_NB, see @ref flups_set_switchType) progresses in the background,
+ * the other switches are done at once inside the calls. No other solve can be done with s before the end of this one.
+ * 
+ * @param s 
+ * @param field 
+ * @param rhs 
+ */
+void flups_solve_begin(FLUPS_Solver* s, double* field, double* rhs, const FLUPS_SolverType type);
+
+/**
+ * @brief advance the solve started by @ref flups_solve_begin, without waiting for the communications
+ * 
+ * @param s 
+ * @return int 1 if the solve is completed, 0 otherwise
+ */
+int flups_solve_progress(FLUPS_Solver* s);
+
+/**
+ * @brief wait for the end of the solve started by @ref flups_solve_begin
+ * 
+ * @param s 
+ */
+void flups_solve_end(FLUPS_Solver* s);
+
 /**@} */
 
 //=============================================================================
@@ -494,6 +844,33 @@ void flups_solve(FLUPS_Solver* s, double* field, double* rhs, const FLUPS_Solver
  */
 size_t flups_get_allocSize(FLUPS_Solver* s);
 
+/**
+ * @brief get the number of doubles required in a scratch array to store the communication buffers, see @ref flups_set_commScratch
+ * 
+ * @param s 
+ * @return size_t 0 before @ref flups_setup
+ */
+size_t flups_get_commScratchSize(FLUPS_Solver* s);
+
+/**
+ * @brief get the communication counters of the switch to the i-th topology (from 0 to ndim-1) on this rank, accumulated since @ref flups_setup or the last @ref flups_reset_commStats
+ * 
+ * The volumes are the ones exchanged between the ranks, even if SWITCH_NODE aggregates them between the nodes.
+ * Comparing the effective bandwidth (bytesSent + bytesRecv) / timeComm among the ranks and over time allows to detect a degraded network.
+ * 
+ * @param s 
+ * @param ip the switch
+ * @param stats the counters
+ */
+void flups_get_commStats(FLUPS_Solver* s, const int ip, FLUPS_CommStats* stats);
+
+/**
+ * @brief reset the communication counters of every switch of the solver
+ * 
+ * @param s 
+ */
+void flups_reset_commStats(FLUPS_Solver* s);
+
 /**
  * @brief get information required to compute the spectral mode associated with each spectral field entry
  * 
@@ -515,6 +892,18 @@ void flups_get_spectralInfo(FLUPS_Solver* s, double kfact[3], double koffset[3],
  */
 void flups_set_alpha(FLUPS_Solver* s, const double alpha);   //must be done before setup
 
+/**
+ * @brief solve the screened Poisson equation (nabla^2 - kappa^2) u = f instead of the Poisson equation
+ * Notice: this parameter can be used with the CHAT_2 kernel, and with the HEJ_0 and LGF_2 kernels if every direction is spectral
+ * 
+ * With an unbounded direction, the Green's function becomes -exp(-kappa r)/(4 pi r) in 3D and -K0(kappa r)/(2 pi) in 2D,
+ * and the wave number k of a spectral direction is replaced by sqrt(k^2 + kappa^2).
+ * 
+ * @param s 
+ * @param kappa the screening parameter, positive (default value is 0.0, i.e. the Poisson equation)
+ */
+void flups_set_kappa(FLUPS_Solver* s, const double kappa);   //must be done before setup, see flups_update_kappa afterwards
+
 // /**
 //  * @brief sets the order of derivative while using divergence or rotational formulation
 //  * 
@@ -605,6 +994,29 @@ void            flups_profiler_disp_root(FLUPS_Profiler* p);
  * @param name 
  */
 void            flups_profiler_disp(FLUPS_Profiler* p,const char name[]);
+/**
+ * @brief record the start and end time of every call of every timer (1) or stop the recording (0), to be written by @ref flups_profiler_write_trace
+ * 
+ * @param p 
+ * @param isTraced 
+ */
+void            flups_profiler_set_trace(FLUPS_Profiler* p, const int isTraced);
+/**
+ * @brief write the recorded calls in the Chrome trace format (chrome://tracing), in one file ./prof/<name>_trace<rank>.json per rank
+ * 
+ * @param p 
+ */
+void            flups_profiler_write_trace(FLUPS_Profiler* p);
+/**
+ * @brief get the time accumulated by the timer "name", averaged among the processors (0 if the timer does not exist)
+ * 
+ * @warning this call is collective on MPI_COMM_WORLD
+ * 
+ * @param p the profiler
+ * @param name the name of the timer
+ * @return double the mean accumulated time [s]
+ */
+double          flups_profiler_get_time(FLUPS_Profiler* p, const char name[]);
 
 /**@} */
 
@@ -623,6 +1035,58 @@ void            flups_profiler_disp(FLUPS_Profiler* p,const char name[]);
  */
 void flups_hdf5_dump(const FLUPS_Topology *topo, const char filename[], const double *data);
 
+/**
+ * @brief sets the number of aggregator ranks of the collective buffering used by @ref flups_hdf5_dump (0 = MPI-IO default)
+ * 
+ * @param naggr the number of aggregators
+ */
+void flups_hdf5_set_aggregators(const int naggr);
+
+/**
+ * @brief sets the filter applied to the chunks written by @ref flups_hdf5_dump
+ * 
+ * The filter is 1 for gzip (`param[0]` is the level from 1 to 9) or the ID of a filter plugin (e.g. 32013 for ZFP, 32017 for SZ),
+ * available in the `HDF5_PLUGIN_PATH`, which receives the parameters as is. Use 0 to remove the filter.
+ * 
+ * @param filterID 
+ * @param nparam the number of parameters
+ * @param param the parameters
+ */
+void flups_hdf5_set_filter(const int filterID, const int nparam, const unsigned int param[]);
+
+/**
+ * @brief waits for the completion of the last @ref flups_hdf5_dump (asynchronous only if compiled with HAVE_HDF5_ASYNC)
+ * 
+ */
+void flups_hdf5_wait();
+
+/**@} */
+
+//=============================================================================
+/**
+ * @name LGF kernel
+ * @{
+ */
+
+/**
+ * @brief sets the folder containing the LGF kernel files (the install directory KERNEL_PATH by default)
+ * 
+ * In the folder, the file `LGF_<d>d_sym_acc<a>_<N>.ker` with the largest N is used for a <d>-dimensional kernel,
+ * which allows to add larger precomputed tables for a better accuracy.
+ * 
+ * @warning must be done before @ref flups_setup
+ * 
+ * @param path the folder
+ */
+void flups_lgf_set_path(const char path[]);
+
+/**
+ * @brief sets how the LGF kernel file is loaded during @ref flups_setup (LGF_LOAD_SHARED by default)
+ * 
+ * @param mode 
+ */
+void flups_lgf_set_load(const FLUPS_LGFLoad mode);
+
 /**@} */
 
 #ifdef __cplusplus
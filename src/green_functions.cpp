@@ -27,12 +27,285 @@
 #include "green_kernels.hpp"
 #include "ji0.hpp"
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------------------------
+// loading of the LGF kernel, see the setters below
+static std::string _lgfPath = STR(KERNEL_PATH);  //!< the folder containing the LGF kernel files
+static LGFLoad     _lgfLoad = LGF_LOAD_SHARED;  //!< how the file is loaded
+
+/**
+ * @brief sets the folder in which @ref _lgf_readfile looks for the LGF kernel files
+ * 
+ * @param path the folder
+ */
+void lgf_set_path(const std::string path) {
+    BEGIN_FUNC;
+    _lgfPath = path;
+    END_FUNC;
+}
+
+/**
+ * @brief sets how @ref _lgf_readfile loads the LGF kernel file
+ * 
+ * @param mode 
+ */
+void lgf_set_load(const LGFLoad mode) {
+    BEGIN_FUNC;
+    _lgfLoad = mode;
+    END_FUNC;
+}
+
+/**
+ * @brief the kernel data read by @ref _lgf_readfile, either allocated or stored in a window shared by the node
+ */
+typedef struct {
+    int      N;         //!< the size above which we switch to the approximation, i.e. the size of the pre-stored kernel is N^greendim
+    double*  data;      //!< the kernel
+    MPI_Win  win;       //!< the shared window storing the kernel (LGF_LOAD_SHARED) or MPI_WIN_NULL
+    MPI_Comm nodecomm;  //!< the communicator of the window (LGF_LOAD_SHARED) or MPI_COMM_NULL
+} LGFData;
+
+/**
+ * @brief find the kernel file with the largest N in the LGF folder, to be called on one rank only
+ * 
+ * @param [in] greendim the dimension of the Green function to use, 2D or 3D
+ * @param [out] N the size of the table, 0 if no file has been found
+ * @return std::string the full name of the file
+ */
+static std::string _lgf_findfile(const int greendim, int* N) {
+    BEGIN_FUNC;
+    std::string lgfname;
+    (*N) = 0;
+
+    DIR* dir = opendir(_lgfPath.c_str());
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            int  fdim, facc, fN;
+            char fext[8];
+            if (sscanf(entry->d_name, "LGF_%dd_sym_acc%d_%d.%7s", &fdim, &facc, &fN, fext) == 4 && fdim == greendim && strcmp(fext, "ker") == 0 && fN > (*N)) {
+                (*N)    = fN;
+                lgfname = _lgfPath + "/" + entry->d_name;
+            }
+        }
+        closedir(dir);
+    }
+    END_FUNC;
+    return lgfname;
+}
+
+/**
+ * @brief copy the kernel file into data using a memory map
+ * 
+ * @param lgfname the file
+ * @param size the number of doubles to read
+ * @param data the destination
+ */
+static void _lgf_mapfile(const std::string lgfname, const size_t size, double* data) {
+    BEGIN_FUNC;
+    const int fd = open(lgfname.c_str(), O_RDONLY);
+    if (fd < 0) FLUPS_ERROR("unable to read file %s", lgfname.c_str(), LOCATION);
+    struct stat st;
+    fstat(fd, &st);
+    if ((size_t)st.st_size < size * sizeof(double)) FLUPS_ERROR("the file %s is too small: %ld bytes instead of %ld", lgfname.c_str(), (long)st.st_size, (long)(size * sizeof(double)), LOCATION);
+
+    void* map = mmap(NULL, size * sizeof(double), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) FLUPS_ERROR("unable to map the file %s", lgfname.c_str(), LOCATION);
+    std::memcpy(data, map, size * sizeof(double));
+    munmap(map, size * sizeof(double));
+    close(fd);
+    END_FUNC;
+}
+
+/**
+ * @brief read the LGF file with the largest N in the LGF folder, see @ref lgf_set_path and @ref lgf_set_load
+ * 
+ * With LGF_LOAD_EACH, every rank finds and reads the file. Otherwise, only rank 0 accesses the file system and the kernel is broadcasted,
+ * either to every rank (LGF_LOAD_BCAST) or to the first rank of each node which stores it in a shared window (LGF_LOAD_SHARED).
+ * 
+ * @warning collective on comm, the data must be freed with @ref _lgf_freedata
+ * 
+ * @param [in] greendim the dimension of the Green function to use, 2D or 3D
+ * @param [in] comm the communicator of the ranks that need the kernel
+ * @param [out] lgf the kernel
+ */
+static void _lgf_readfile(const int greendim, MPI_Comm comm, LGFData* lgf) {
+    BEGIN_FUNC;
+    FLUPS_CHECK(greendim == 2 || greendim == 3, "Greendim = %d is not available in this version", greendim, LOCATION);
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    lgf->data     = NULL;
+    lgf->win      = MPI_WIN_NULL;
+    lgf->nodecomm = MPI_COMM_NULL;
+
+    //-------------------------------------------------------------------------
+    /** - find the file: on every rank or on rank 0 only */
+    //-------------------------------------------------------------------------
+    std::string lgfname;
+    if (_lgfLoad == LGF_LOAD_EACH || rank == 0) {
+        lgfname = _lgf_findfile(greendim, &lgf->N);
+        if (lgf->N == 0) FLUPS_ERROR("unable to find a %dD LGF kernel in %s", greendim, _lgfPath.c_str(), LOCATION);
+        // display the information to the user
+        FLUPS_INFO_1("loading the LGF kernel function %s", lgfname.c_str());
+    }
+    if (_lgfLoad != LGF_LOAD_EACH) {
+        MPI_Bcast(&lgf->N, 1, MPI_INT, 0, comm);
+    }
+    size_t size = 1;
+    for (int id = 0; id < greendim; id++) {
+        size *= lgf->N;
+    }
+
+    //-------------------------------------------------------------------------
+    /** - read the file */
+    //-------------------------------------------------------------------------
+    if (_lgfLoad == LGF_LOAD_EACH) {
+        lgf->data = (double*)flups_malloc(sizeof(double) * size);
+        _lgf_mapfile(lgfname, size, lgf->data);
+
+    } else if (_lgfLoad == LGF_LOAD_BCAST) {
+        lgf->data = (double*)flups_malloc(sizeof(double) * size);
+        if (rank == 0) _lgf_mapfile(lgfname, size, lgf->data);
+        MPI_Bcast(lgf->data, (int)size, MPI_DOUBLE, 0, comm);
+
+    } else {
+        // one window per node, allocated by its first rank (the rank 0 of comm is the first one of its node)
+        int noderank;
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &lgf->nodecomm);
+        MPI_Comm_rank(lgf->nodecomm, &noderank);
+
+        double*  dataptr;
+        MPI_Aint winsize = (noderank == 0) ? (MPI_Aint)(size * sizeof(double)) : 0;
+        MPI_Win_allocate_shared(winsize, sizeof(double), MPI_INFO_NULL, lgf->nodecomm, &dataptr, &lgf->win);
+        int dispunit;
+        MPI_Win_shared_query(lgf->win, 0, &winsize, &dispunit, &lgf->data);
+
+        // the first ranks of the nodes get the kernel from rank 0
+        MPI_Comm leadcomm;
+        MPI_Comm_split(comm, (noderank == 0) ? 0 : MPI_UNDEFINED, rank, &leadcomm);
+        MPI_Win_fence(0, lgf->win);
+        if (noderank == 0) {
+            if (rank == 0) _lgf_mapfile(lgfname, size, lgf->data);
+            MPI_Bcast(lgf->data, (int)size, MPI_DOUBLE, 0, leadcomm);
+            MPI_Comm_free(&leadcomm);
+        }
+        MPI_Win_fence(0, lgf->win);
+    }
+    END_FUNC;
+}
+
+/**
+ * @brief free the kernel read by @ref _lgf_readfile
+ * 
+ * @warning collective on the communicator given to @ref _lgf_readfile
+ * 
+ * @param lgf 
+ */
+static void _lgf_freedata(LGFData* lgf) {
+    BEGIN_FUNC;
+    if (lgf->win != MPI_WIN_NULL) {
+        MPI_Win_free(&lgf->win);
+        MPI_Comm_free(&lgf->nodecomm);
+    } else if (lgf->data != NULL) {
+        flups_free(lgf->data);
+    }
+    lgf->data = NULL;
+    END_FUNC;
+}
+
 /**
  * @brief generic type for Green kernel, takes a table of parameters that can be used depending on the kernel
  * 
  */
 typedef double (*GreenKernel)(const void*,const double*);
 
+/**
+ * @brief generic type for batched Green kernels, evaluates n <= GREEN_BATCH points with parameters stored every GREEN_NPARAM, see green_kernels.hpp
+ * 
+ */
+typedef void (*GreenKernelN)(const int, const double*, const double*, double*);
+
+/**
+ * @brief batched version of a Green kernel G which has no dedicated batched implementation
+ */
+template <GreenKernel G>
+static inline void _green_batch(const int n, const double *params, const double *data, double *green) {
+    for (int i = 0; i < n; i++) {
+        green[i] = G(params + i * GREEN_NPARAM, data);
+    }
+}
+
+/**
+ * @brief loop on the points of the topology for cmpt_Green_3dirunbounded
+ * 
+ * The kernel is given as a template argument so that it is inlined in the loop.
+ * The points of a pencil are evaluated by batches of GREEN_BATCH points, so that the special functions can be evaluated in batch.
+ */
+template <GreenKernelN G>
+static void _cmpt_Green_3dirunbounded(const Topology *topo, const double hfact[3], const double symstart[3], double *green, const double length, const double kappa, const int GN, const double *Gdata) {
+    int istart[3];
+    topo->get_istart_glob(istart);
+
+    const int    nf      = topo->nf();
+    const int    ax0     = topo->axis();
+    const int    ax1     = (ax0 + 1) % 3;
+    const int    ax2     = (ax0 + 2) % 3;
+    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const int    n0      = topo->nloc(ax0);
+    const int    n1      = topo->nloc(ax1);
+    const size_t onmax   = (size_t)n1 * (size_t)topo->nloc(ax2);
+
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, n0, n1, nf, ax0, ax1, ax2, nmem, istart, hfact, symstart, green, length, kappa, GN, Gdata)
+    for (size_t io = 0; io < onmax; io++) {
+        const int i1 = io % n1;
+        const int i2 = io / n1;
+        //local indexes start
+        const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
+
+        for (int ib = 0; ib < n0; ib += GREEN_BATCH) {
+            const int nb = std::min(GREEN_BATCH, n0 - ib);
+
+            double params[GREEN_BATCH * GREEN_NPARAM];
+            double value[GREEN_BATCH];
+
+            for (int ii = 0; ii < nb; ii++) {
+                int is[3];
+                cmpt_symID(ax0, ib + ii, i1, i2, istart, symstart, 0, is);
+
+                // symmetrized position
+                const double x0 = (is[ax0]) * hfact[ax0];
+                const double x1 = (is[ax1]) * hfact[ax1];
+                const double x2 = (is[ax2]) * hfact[ax2];
+
+                // the first two arguments are used in standard kernels, the third one by the screened kernel, the zero is for compatibility
+                // with the 2dirunbounded function, and the others 5 ones are aimed for LGFs only
+                // the symmetrized indexes will be negative!!
+                double *tmp = params + ii * GREEN_NPARAM;
+                tmp[0]      = sqrt(x0 * x0 + x1 * x1 + x2 * x2);
+                tmp[1]      = length;
+                tmp[2]      = kappa;
+                tmp[3]      = 0.0;
+                tmp[4]      = std::abs(is[ax0]);
+                tmp[5]      = std::abs(is[ax1]);
+                tmp[6]      = std::abs(is[ax2]);
+                tmp[7]      = GN;
+                tmp[8]      = hfact[ax0];
+            }
+            // green function value
+            G(nb, params, Gdata, value);
+            for (int ii = 0; ii < nb; ii++) {
+                green[id + (ib + ii) * nf] = value[ii];
+            }
+        }
+    }
+}
+
 /**
  * @brief Compute the Green function for 0 dir spectral (i.e. 3 dir unbounded or 2 dirunbounded)
  * 
@@ -42,61 +315,79 @@ typedef double (*GreenKernel)(const void*,const double*);
  * @param green the Green function array
  * @param typeGreen the type of Green function 
  * @param length the characteristic length (only used for HEJ kernels = epsilon)
+ * @param kappa the screening parameter of the equation (nabla^2 - kappa^2) u = f, 0 for the Poisson equation (only CHAT_2 otherwise)
  */
-void cmpt_Green_3dirunbounded(const Topology *topo, const double hfact[3], const double symstart[3], double *green, GreenType typeGreen, const double length){
+void cmpt_Green_3dirunbounded(const Topology *topo, const double hfact[3], const double symstart[3], double *green, GreenType typeGreen, const double length, const double kappa){
     BEGIN_FUNC;
     // assert that the green spacing is not 0.0 everywhere
     FLUPS_CHECK(hfact[0] != 0.0, "hfact[0] cannot be 0", LOCATION);
     FLUPS_CHECK(hfact[1] != 0.0, "hfact[1] cannot be 0", LOCATION);
     FLUPS_CHECK(hfact[2] != 0.0, "hfact[2] cannot be 0", LOCATION);
+    if (kappa != 0.0 && typeGreen != CHAT_2) {
+        FLUPS_ERROR("The screened Poisson equation is only available with CHAT_2 kernels when there are unbounded directions.", LOCATION);
+    }
 
     // FLUPS_INFO("K_OFFSET : %lf,%lf,%lf \n",koffset[0],koffset[1],koffset[2]);
     // FLUPS_INFO("KFAC= %lf %lf %lf", kfact[0],kfact[1],kfact[2]);
     // FLUPS_INFO("HFAC= %lf %lf %lf", hfact[0],hfact[1],hfact[2]);
     
-    GreenKernel G;
-
     double  G0;  //value of G in 0
     int     GN    = 0;
     double *Gdata = NULL;
+    LGFData lgf;
 
     //==========================    3D  =================================
     switch (typeGreen) {
         case HEJ_2:
-            G  = &_hej_2_3unb0spe;
             G0 = - M_SQRT2 / (4.0 * length * sqrt(M_PI * M_PI * M_PI));
+            _cmpt_Green_3dirunbounded<&_green_batch<&_hej_2_3unb0spe> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_4:
-            G  = &_hej_4_3unb0spe;
             G0 = - 3.0 * M_SQRT2 / (8.0 * length * sqrt(M_PI * M_PI * M_PI));
+            _cmpt_Green_3dirunbounded<&_green_batch<&_hej_4_3unb0spe> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_6:
-            G  = &_hej_6_3unb0spe;
             G0 = - 15.0 * M_SQRT2 / (32.0 * length * sqrt(M_PI * M_PI * M_PI));
+            _cmpt_Green_3dirunbounded<&_green_batch<&_hej_6_3unb0spe> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_8:
-            G  = &_hej_8_3unb0spe;
             G0 = - 35.0 * M_SQRT2 / (64.0 * length * sqrt(M_PI * M_PI * M_PI));
+            _cmpt_Green_3dirunbounded<&_green_batch<&_hej_8_3unb0spe> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_10:
-            G  = &_hej_10_3unb0spe;
             G0 = - 315.0 * M_SQRT2 / (512.0 * length * sqrt(M_PI * M_PI * M_PI));
+            _cmpt_Green_3dirunbounded<&_green_batch<&_hej_10_3unb0spe> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_0:
-            G  = &_hej_0_3unb0spe;
             G0 = - 1.0/(2.0*M_PI*M_PI*length);
+            _cmpt_Green_3dirunbounded<&_hej_0_3unb0spe_n>(topo, hfact, symstart, green, length, kappa, GN, Gdata);
             break;
         case CHAT_2:
-            G  = &_chat_2_3unb0spe;
-            G0 = - 0.5 * pow(1.5 * c_1o2pi * hfact[0] * hfact[1] * hfact[2], 2. / 3.);
+            if (kappa == 0.0) {
+                G0 = - 0.5 * pow(1.5 * c_1o2pi * hfact[0] * hfact[1] * hfact[2], 2. / 3.);
+                _cmpt_Green_3dirunbounded<&_green_batch<&_chat_2_3unb0spe> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
+            } else {
+                // same integration on the sphere of volume h^3 as for the Poisson kernel, which is retrieved when kappa -> 0
+                // for small kappa * r_eq, the series expansion avoids the cancellation
+                const double r_eq = pow(1.5 * c_1o2pi * hfact[0] * hfact[1] * hfact[2], 1. / 3.);
+                const double x    = kappa * r_eq;
+                if (x < 1.0e-2) {
+                    G0 = - r_eq * r_eq * (0.5 - x / 3.0 + x * x / 8.0 - x * x * x / 30.0);
+                } else {
+                    G0 = - (1.0 - (1.0 + x) * exp(-x)) / (kappa * kappa);
+                }
+                _cmpt_Green_3dirunbounded<&_green_batch<&_chat_2_3unb0spe_kappa> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
+            }
             break;
         case LGF_2:
             FLUPS_CHECK(hfact[0] == hfact[1], "the grid has to be isotropic to use the LGFs", LOCATION);
             FLUPS_CHECK(hfact[1] == hfact[2], "the grid has to be isotropic to use the LGFs", LOCATION);
             // read the LGF data and store it
-            _lgf_readfile(3,&GN, &Gdata);
+            _lgf_readfile(3, topo->get_comm(), &lgf);
+            GN    = lgf.N;
+            Gdata = lgf.data;
             // associate the Green's function
-            G = &_lgf_2_3unb0spe;
+            _cmpt_Green_3dirunbounded<&_green_batch<&_lgf_2_3unb0spe> >(topo, hfact, symstart, green, length, kappa, GN, Gdata);
             break;
         default:
             FLUPS_ERROR("Green Function type unknow.", LOCATION);
@@ -104,45 +395,17 @@ void cmpt_Green_3dirunbounded(const Topology *topo, const double hfact[3], const
 
     int istart[3];
     topo->get_istart_glob(istart);
-
-    const int nf = topo->nf();
     const int ax0 = topo->axis();
     const int ax1 = (ax0 + 1) % 3;
     const int ax2 = (ax0 + 2) % 3;
-    const int nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
-    for (int i2 = 0; i2 < topo->nloc(ax2); i2++) {
-        for (int i1 = 0; i1 < topo->nloc(ax1); i1++) {
-            //local indexes start
-            const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
-
-            for (int i0 = 0; i0 < topo->nloc(ax0); i0++) {
-                int is[3];
-                cmpt_symID(ax0, i0, i1, i2, istart, symstart, 0, is);
 
-                // symmetrized position
-                const double x0 = (is[ax0]) * hfact[ax0];
-                const double x1 = (is[ax1]) * hfact[ax1];
-                const double x2 = (is[ax2]) * hfact[ax2];
-
-                // green function value
-                const double r2 = x0 * x0 + x1 * x1 + x2 * x2;
-                const double r  = sqrt(r2);
-
-                // the first two arguments are used in standard kernels, the two zeros are for compatibility with the 2dirunbounded function,
-                // and the others 5 ones are aimed for LGFs only
-                // the symmetrized indexes will be negative!!
-                const double tmp[9] = {r, length, 0, 0, std::abs(is[ax0]), std::abs(is[ax1]), std::abs(is[ax2]), GN, hfact[ax0]};
-                green[id + i0 * nf] = G(tmp,Gdata);
-            }
-        }
-    }
     // reset the value in 0.0 but not for LGF's since we have already pre-computed its value
     if (typeGreen != LGF_2 && istart[ax0] == 0 && istart[ax1] == 0 && istart[ax2] == 0) {
         green[0] = G0;
     }
     // free Gdata if needed
     if (Gdata != NULL) {
-        flups_free(Gdata);
+        _lgf_freedata(&lgf);
     }
 
     END_FUNC;
@@ -150,6 +413,107 @@ void cmpt_Green_3dirunbounded(const Topology *topo, const double hfact[3], const
 
 
 
+/**
+ * @brief loop on the points of the topology for cmpt_Green_2dirunbounded
+ * 
+ * The kernels are given as template arguments so that they are inlined in the loop.
+ * G is the general expression in the whole domain, Gk0 is the particular expression in k=0 and Gr0 the particular expression in r=0.
+ * The points of a pencil are sorted by batches of at most GREEN_BATCH points, one for each expression, so that the special functions can be evaluated in batch.
+ */
+template <GreenKernelN G, GreenKernelN Gk0, GreenKernelN Gr0>
+static void _cmpt_Green_2dirunbounded(const Topology *topo, const double hfact[3], const double kfact[3], const double koffset[3], const double symstart[3], double *green, const double length, const double kappa, const int GN, const double *Gdata) {
+    int istart[3];
+    topo->get_istart_glob(istart);
+
+    const int    nf      = topo->nf();
+    const int    ax0     = topo->axis();
+    const int    ax1     = (ax0 + 1) % 3;
+    const int    ax2     = (ax0 + 2) % 3;
+    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const int    n0      = topo->nloc(ax0);
+    const int    n1      = topo->nloc(ax1);
+    const size_t onmax   = (size_t)n1 * (size_t)topo->nloc(ax2);
+    const double r_eq2D  = c_1osqrtpi * sqrt(hfact[ax0] * hfact[ax1] + hfact[ax1] * hfact[ax2] + hfact[ax2] * hfact[ax0]);
+    const double r_lim   = (hfact[ax0] + hfact[ax1] + hfact[ax2]) * .2;
+    const double k_lim   = (kfact[ax0] + kfact[ax1] + kfact[ax2]) * 0.2;
+
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, n0, n1, nf, ax0, ax1, ax2, nmem, istart, hfact, kfact, koffset, symstart, green, length, kappa, r_eq2D, r_lim, k_lim, GN, Gdata)
+    for (size_t io = 0; io < onmax; io++) {
+        const int i1 = io % n1;
+        const int i2 = io / n1;
+        //local indexes start
+        const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
+
+        for (int ib = 0; ib < n0; ib += GREEN_BATCH) {
+            const int nb = std::min(GREEN_BATCH, n0 - ib);
+
+            // the points are sorted by expression: 0 = in r=0, 1 = in k=0, 2 = general
+            int    ncount[3] = {0, 0, 0};
+            int    index[3][GREEN_BATCH];
+            double params[3][GREEN_BATCH * GREEN_NPARAM];
+            double value[GREEN_BATCH];
+
+            for (int ii = 0; ii < nb; ii++) {
+                // global indexes
+                int is[3];
+                cmpt_symID(ax0, ib + ii, i1, i2, istart, symstart, 0, is);
+
+                // (symmetrized) wave number : only one kfact is non-zero
+                // the screening acts as an additional wave number which is never zero
+                const double k0 = (is[ax0] + koffset[ax0]) * kfact[ax0];
+                const double k1 = (is[ax1] + koffset[ax1]) * kfact[ax1];
+                const double k2 = (is[ax2] + koffset[ax2]) * kfact[ax2];
+                const double k  = (kappa == 0.0) ? (k0 + k1 + k2) : sqrt((k0 + k1 + k2) * (k0 + k1 + k2) + kappa * kappa);
+
+                //(symmetrized) position : only one hfact is zero
+                const double x0 = (is[ax0]) * hfact[ax0];
+                const double x1 = (is[ax1]) * hfact[ax1];
+                const double x2 = (is[ax2]) * hfact[ax2];
+                const double r  = sqrt(x0 * x0 + x1 * x1 + x2 * x2);
+
+                // we should enter the r=0 case for 2d and 3d cases,
+                // the k=0 case always for 2d case and sometimes for 3d cases
+                const int ie = (r <= r_lim) ? 0 : ((kappa == 0.0 && k <= k_lim) ? 1 : 2);
+
+                // the symmetrized indexes will be negative!!
+                double *tmp = params[ie] + ncount[ie] * GREEN_NPARAM;
+                tmp[0]      = r;
+                tmp[1]      = k;
+                tmp[2]      = length;
+                tmp[3]      = r_eq2D;
+                tmp[4]      = std::abs(is[ax0]);
+                tmp[5]      = std::abs(is[ax1]);
+                tmp[6]      = std::abs(is[ax2]);
+                tmp[7]      = GN;
+                tmp[8]      = hfact[ax0];
+
+                index[ie][ncount[ie]] = ib + ii;
+                ncount[ie]++;
+            }
+
+            // green function value
+            if (ncount[0] > 0) {
+                Gr0(ncount[0], params[0], Gdata, value);
+                for (int ii = 0; ii < ncount[0]; ii++) {
+                    green[id + index[0][ii] * nf] = value[ii];
+                }
+            }
+            if (ncount[1] > 0) {
+                Gk0(ncount[1], params[1], Gdata, value);
+                for (int ii = 0; ii < ncount[1]; ii++) {
+                    green[id + index[1][ii] * nf] = value[ii];
+                }
+            }
+            if (ncount[2] > 0) {
+                G(ncount[2], params[2], Gdata, value);
+                for (int ii = 0; ii < ncount[2]; ii++) {
+                    green[id + index[2][ii] * nf] = value[ii];
+                }
+            }
+        }
+    }
+}
+
 /**
  * @brief Compute the Green function for 2dirunbounded and 1dirspectral
  * 
@@ -163,6 +527,7 @@ void cmpt_Green_3dirunbounded(const Topology *topo, const double hfact[3], const
  * @param green the Green function array
  * @param typeGreen the type of Green function 
  * @param length the characteristic length (only used for HEJ kernels = epsilon)
+ * @param kappa the screening parameter of the equation (nabla^2 - kappa^2) u = f, 0 for the Poisson equation (only CHAT_2 otherwise)
  * 
  * @warning For 3D kernels: According to [Spietz2018], we can obtain the **approximate** Green kernel by using the 2D unbounded kernel 
             for mode 0 in the spectral direction, and the rest of the Green kernel is the same as in full spectral.
@@ -171,8 +536,11 @@ void cmpt_Green_3dirunbounded(const Topology *topo, const double hfact[3], const
             full spectral part afterwards, while going through Solver::_cmptGreenFunction.
  * 
  */
-void cmpt_Green_2dirunbounded(const Topology *topo, const double hfact[3], const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length) {
+void cmpt_Green_2dirunbounded(const Topology *topo, const double hfact[3], const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length, const double kappa) {
     BEGIN_FUNC;
+    if (kappa != 0.0 && typeGreen != CHAT_2) {
+        FLUPS_ERROR("The screened Poisson equation is only available with CHAT_2 kernels when there are unbounded directions.", LOCATION);
+    }
     
     // assert that the green spacing and dk is not 0.0 - this is also a way to check that ax0 will be spectral, and the others are still to be transformed
     FLUPS_CHECK(kfact[0] != hfact[0], "grid spacing[0] cannot be = to dk[0]", LOCATION);
@@ -180,78 +548,90 @@ void cmpt_Green_2dirunbounded(const Topology *topo, const double hfact[3], const
     // check that if hfact or kfact != 0, they are not the same
     FLUPS_CHECK(!(kfact[2] == hfact[2] && (kfact[2]!= 0.0 || hfact[2] != 0.0)), "grid spacing[2] cannot be = to dk[2]", LOCATION);
 
-    // @Todo For Helmolz, we need Green to be complex 
+    // @Todo For Helmolz, we need Green to be complex (the screened Poisson equation, kappa != 0, has a real Green function)
     // FLUPS_CHECK(topo->isComplex(), "I can't fill a non complex topo with a complex green function.", LOCATION);
     // opt_double_ptr mygreen = green; //casting of the Green function to be able to access real and complex part
     //Implementation note: if you want to do Helmolz, you need Hankel functions (3rd order Bessel) which are not implemented in stdC. Consider the use of boost lib.
     //notice that bessel_k has been introduced in c++17
 
-    GreenKernel G;    // the Green kernel (general expression in the whole domain)
-    GreenKernel Gk0;  // the Green kernel (particular expression in k=0)
-    GreenKernel Gr0;  // the Green kernel (particular expression in r=0)
-
     int     GN    = 0;
     double *Gdata = NULL;
+    LGFData lgf;
 
     switch (typeGreen) {
         case HEJ_2:
             FLUPS_WARNING("HEJ kernels in 2dirunbounded 1dirspectral entail an approximation in 3D.", LOCATION);
             // see warning in the function description
-            G   = &_zero;
-            Gk0 = &_hej_2_2unb1spe_k0;
-            Gr0 = &_hej_2_2unb1spe_r0;
+            _cmpt_Green_2dirunbounded<&_green_batch<&_zero>, &_hej_2_2unb1spe_k0_n, &_green_batch<&_hej_2_2unb1spe_r0> >(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_4:
             FLUPS_WARNING("HEJ kernels in 2dirunbounded 1dirspectral entail an approximation in 3D.", LOCATION);
-            G   = &_zero;
-            Gk0 = &_hej_4_2unb1spe_k0;
-            Gr0 = &_hej_4_2unb1spe_r0;
+            _cmpt_Green_2dirunbounded<&_green_batch<&_zero>, &_hej_4_2unb1spe_k0_n, &_green_batch<&_hej_4_2unb1spe_r0> >(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_6:
             FLUPS_WARNING("HEJ kernels in 2dirunbounded 1dirspectral entail an approximation in 3D.", LOCATION);
-            G   = &_zero;
-            Gk0 = &_hej_6_2unb1spe_k0;
-            Gr0 = &_hej_6_2unb1spe_r0;
+            _cmpt_Green_2dirunbounded<&_green_batch<&_zero>, &_hej_6_2unb1spe_k0_n, &_green_batch<&_hej_6_2unb1spe_r0> >(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_8:
             FLUPS_WARNING("HEJ kernels in 2dirunbounded 1dirspectral entail an approximation in 3D.", LOCATION);
-            G   = &_zero;
-            Gk0 = &_hej_8_2unb1spe_k0;
-            Gr0 = &_hej_8_2unb1spe_r0;
+            _cmpt_Green_2dirunbounded<&_green_batch<&_zero>, &_hej_8_2unb1spe_k0_n, &_green_batch<&_hej_8_2unb1spe_r0> >(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;
         case HEJ_10:
             FLUPS_WARNING("HEJ kernels in 2dirunbounded 1dirspectral entail an approximation in 3D.", LOCATION);
-            G   = &_zero;
-            Gk0 = &_hej_10_2unb1spe_k0;
-            Gr0 = &_hej_10_2unb1spe_r0;
+            _cmpt_Green_2dirunbounded<&_green_batch<&_zero>, &_hej_10_2unb1spe_k0_n, &_green_batch<&_hej_10_2unb1spe_r0> >(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;        
         case HEJ_0:
             FLUPS_WARNING("HEJ0 (theoretically spectral) kernel for 2D unbounded entails an approximation greatly affecting accuracy.", LOCATION);
             init_Ji0();
-            G   = &_zero;
-            Gk0 = &_hej_0_2unb1spe_k0;
-            Gr0 = &_hej_0_2unb1spe_k0;
+            _cmpt_Green_2dirunbounded<&_green_batch<&_zero>, &_hej_0_2unb1spe_k0_n, &_hej_0_2unb1spe_k0_n>(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;        
         case CHAT_2:
-            G   = &_chat_2_2unb1spe;
-            Gk0 = &_chat_2_2unb1spe_k0;
-            Gr0 = &_chat_2_2unb1spe_r0;
             // caution: the value of G in k=r=0 is specified at the end of this routine
+            _cmpt_Green_2dirunbounded<&_chat_2_2unb1spe_n, &_green_batch<&_chat_2_2unb1spe_k0>, &_chat_2_2unb1spe_r0_n>(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;
         case LGF_2:
             FLUPS_CHECK(hfact[3] < 1.0e-14, "This LGF cannot be called in a 3D problem -> h[3] = %e",hfact[3],LOCATION);
             FLUPS_CHECK(hfact[0] == hfact[1], "the grid has to be isotropic to use the LGFs", LOCATION);
             // read the LGF data and store it
-            _lgf_readfile(2,&GN, &Gdata);
+            _lgf_readfile(2, topo->get_comm(), &lgf);
+            GN    = lgf.N;
+            Gdata = lgf.data;
             // associate the Green's function
-            G   = &_zero;
-            Gk0 = &_lgf_2_2unb0spe;
-            Gr0 = &_lgf_2_2unb0spe;
+            _cmpt_Green_2dirunbounded<&_green_batch<&_zero>, &_green_batch<&_lgf_2_2unb0spe>, &_green_batch<&_lgf_2_2unb0spe> >(topo, hfact, kfact, koffset, symstart, green, length, kappa, GN, Gdata);
             break;
         default:
             FLUPS_ERROR("Green Function type unknow.", LOCATION);
     }
 
+    int istart[3];
+    topo->get_istart_glob(istart);
+    const int    ax0    = topo->axis();
+    const int    ax1    = (ax0 + 1) % 3;
+    const int    ax2    = (ax0 + 2) % 3;
+    const double r_eq2D = c_1osqrtpi * sqrt(hfact[ax0] * hfact[ax1] + hfact[ax1] * hfact[ax2] + hfact[ax2] * hfact[ax0]);
+
+    // reset the value in x=y=0.0 and k=0 for singular expressions, the screened one is not singular
+    if ((typeGreen == CHAT_2) && kappa == 0.0 && istart[ax0] == 0 && istart[ax1] == 0 && istart[ax2] == 0) {
+        // green[0] = -2.0 * log(1 + sqrt(2)) * c_1opiE3o2 / r_eq2D;
+        green[0] = - 0.25 * c_1o2pi * (M_PI - 6.0 + 2.0 * log(0.5 * M_PI * r_eq2D));  //caution: mistake in [Chatelain2010]
+    }
+    // free Gdata if needed
+    if (Gdata != NULL) {
+        _lgf_freedata(&lgf);
+    }
+    END_FUNC;
+}
+
+
+
+/**
+ * @brief loop on the points of the topology for cmpt_Green_1dirunbounded
+ * 
+ * The kernels are given as template arguments so that they are inlined in the loop.
+ * G is the general expression in the whole domain and G0 the particular expression in k=0.
+ */
+template <GreenKernel G, GreenKernel G0>
+static void _cmpt_Green_1dirunbounded(const Topology *topo, const double hfact[3], const double kfact[3], const double koffset[3], const double symstart[3], double *green, const double length, const double kappa) {
     int istart[3];
     topo->get_istart_glob(istart);
 
@@ -260,59 +640,49 @@ void cmpt_Green_2dirunbounded(const Topology *topo, const double hfact[3], const
     const int    ax1     = (ax0 + 1) % 3;
     const int    ax2     = (ax0 + 2) % 3;
     const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
-    const double r_eq2D  = c_1osqrtpi * sqrt(hfact[ax0] * hfact[ax1] + hfact[ax1] * hfact[ax2] + hfact[ax2] * hfact[ax0]);
-
-    for (int i2 = 0; i2 < topo->nloc(ax2); i2++) {
-        for (int i1 = 0; i1 < topo->nloc(ax1); i1++) {
-            //local indexes start
-            const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
-
-            for (int i0 = 0; i0 < topo->nloc(ax0); i0++) {
-                // global indexes
-                int is[3];
-                cmpt_symID(ax0, i0, i1, i2, istart, symstart, 0, is);
-
-                // (symmetrized) wave number : only one kfact is non-zero
-                const double k0 = (is[ax0] + koffset[ax0]) * kfact[ax0];
-                const double k1 = (is[ax1] + koffset[ax1]) * kfact[ax1];
-                const double k2 = (is[ax2] + koffset[ax2]) * kfact[ax2];
-                const double k  = k0 + k1 + k2;
-
-                //(symmetrized) position : only one hfact is zero
-                const double x0 = (is[ax0]) * hfact[ax0];
-                const double x1 = (is[ax1]) * hfact[ax1];
-                const double x2 = (is[ax2]) * hfact[ax2];
-                const double r  = sqrt(x0 * x0 + x1 * x1 + x2 * x2);
-
-                // the symmetrized indexes will be negative!!
-                const double tmp[9] = {r, k, length, r_eq2D, std::abs(is[ax0]), std::abs(is[ax1]), std::abs(is[ax2]), GN, hfact[ax0]};
-
-                // green function value
-                // Implementation note: having a 'if' in a loop is highly discouraged... however, this is the init so we prefer having a
-                // this routine with a high readability and lower efficency than the opposite.
-                if (r <= (hfact[ax0] + hfact[ax1] + hfact[ax2]) * .2) {
-                    // we should enter this case for 2d and 3d cases
-                    green[id + i0 * topo->nf()] = Gr0(tmp, Gdata);
-                } else if (k <= (kfact[ax0] + kfact[ax1] + kfact[ax2]) * 0.2) {
-                    // we should always enter this routine for 2d case and sometimes for 3d cases
-                    green[id + i0 * topo->nf()] = Gk0(tmp, Gdata);
-                } else {
-                    green[id + i0 * topo->nf()] = G(tmp, Gdata);
-                }
+    const int    n0      = topo->nloc(ax0);
+    const int    n1      = topo->nloc(ax1);
+    const size_t onmax   = (size_t)n1 * (size_t)topo->nloc(ax2);
+    const double k_lim   = (kfact[ax0] + kfact[ax1] + kfact[ax2]) * 0.2;
+
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, n0, n1, nf, ax0, ax1, ax2, nmem, istart, hfact, kfact, koffset, symstart, green, length, kappa, k_lim)
+    for (size_t io = 0; io < onmax; io++) {
+        const int i1 = io % n1;
+        const int i2 = io / n1;
+        //local indexes start
+        const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
+
+        for (int i0 = 0; i0 < n0; i0++) {
+            int is[3];
+            cmpt_symID(ax0, i0, i1, i2, istart, symstart, 0, is);
+
+            // (symmetrized) wave number : only 1 kfact is zero
+            // the screening acts as an additional wave number which is never zero
+            const double k0 = (is[ax0] + koffset[ax0]) * kfact[ax0];
+            const double k1 = (is[ax1] + koffset[ax1]) * kfact[ax1];
+            const double k2 = (is[ax2] + koffset[ax2]) * kfact[ax2];
+            const double k  = sqrt(k0 * k0 + k1 * k1 + k2 * k2 + kappa * kappa);
+
+            //(symmetrized) position : only 1 hfact is non-zero
+            const double x0 = (is[ax0]) * hfact[ax0];
+            const double x1 = (is[ax1]) * hfact[ax1];
+            const double x2 = (is[ax2]) * hfact[ax2];
+            const double r  = sqrt(x0 * x0 + x1 * x1 + x2 * x2);
+
+            const double tmp[3] = {r, k, length};
+
+            // green function value
+            // Implementation note: having a 'if' in a loop is highly discouraged... however, this is the init so we prefer having a
+            // this routine with a high readability and lower efficency than the opposite.
+            if (kappa == 0.0 && k <= k_lim) {
+                green[id + i0 * nf] = G0(tmp, NULL);
+            } else {
+                green[id + i0 * nf] = G(tmp, NULL);
             }
         }
     }
-    
-    // reset the value in x=y=0.0 and k=0 for singular expressions
-    if ((typeGreen == CHAT_2) && istart[ax0] == 0 && istart[ax1] == 0 && istart[ax2] == 0) {
-        // green[0] = -2.0 * log(1 + sqrt(2)) * c_1opiE3o2 / r_eq2D;
-        green[0] = - 0.25 * c_1o2pi * (M_PI - 6.0 + 2.0 * log(0.5 * M_PI * r_eq2D));  //caution: mistake in [Chatelain2010]
-    }
-    END_FUNC;
 }
 
-
-
 /**
  * @brief Compute the Green function for 1dirunbounded and 2dirspectral
  * 
@@ -326,9 +696,13 @@ void cmpt_Green_2dirunbounded(const Topology *topo, const double hfact[3], const
  * @param green the Green function array
  * @param typeGreen the type of Green function 
  * @param length the characteristic length (only used for HEJ kernels = epsilon)
+ * @param kappa the screening parameter of the equation (nabla^2 - kappa^2) u = f, 0 for the Poisson equation (only CHAT_2 otherwise)
  */
-void cmpt_Green_1dirunbounded(const Topology *topo, const double hfact[3], const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length) {
+void cmpt_Green_1dirunbounded(const Topology *topo, const double hfact[3], const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length, const double kappa) {
     BEGIN_FUNC;
+    if (kappa != 0.0 && typeGreen != CHAT_2) {
+        FLUPS_ERROR("The screened Poisson equation is only available with CHAT_2 kernels when there are unbounded directions.", LOCATION);
+    }
 
     // assert that the green spacing and dk is not 0.0 - this is also a way to check that ax0 will be spectral, and the others are still to be transformed
     FLUPS_CHECK(kfact[0] != hfact[0], "grid spacing[0] cannot be = to dk[0]", LOCATION);
@@ -336,40 +710,31 @@ void cmpt_Green_1dirunbounded(const Topology *topo, const double hfact[3], const
     // check that if hfact or kfact != 0, they are not the same
     FLUPS_CHECK(!(kfact[2] == hfact[2] && (kfact[2]!= 0.0 || hfact[2] != 0.0)), "grid spacing[2] cannot be = to dk[2]", LOCATION);
 
-    // @Todo For Helmolz, we need Green to be complex 
+    // @Todo For Helmolz, we need Green to be complex (the screened Poisson equation, kappa != 0, has a real Green function)
     // FLUPS_CHECK(topo->isComplex(), "I can't fill a non complex topo with a complex green function.", LOCATION);
     // double* mygreen = green; //casting of the Green function to be able to access real and complex part
 
-    GreenKernel G;   // the Green kernel (general expression in the whole domain)
-    GreenKernel G0;  // the Green kernel (particular expression in k=0)
-
     switch (typeGreen) {
         case HEJ_2:
-            G  = &_hej_2_1unb2spe;
-            G0 = &_hej_2_1unb2spe_k0;
+            _cmpt_Green_1dirunbounded<&_hej_2_1unb2spe, &_hej_2_1unb2spe_k0>(topo, hfact, kfact, koffset, symstart, green, length, kappa);
             break;
         case HEJ_4:
-            G  = &_hej_4_1unb2spe;
-            G0 = &_hej_4_1unb2spe_k0;
+            _cmpt_Green_1dirunbounded<&_hej_4_1unb2spe, &_hej_4_1unb2spe_k0>(topo, hfact, kfact, koffset, symstart, green, length, kappa);
             break;
         case HEJ_6:
-            G  = &_hej_6_1unb2spe;
-            G0 = &_hej_6_1unb2spe_k0;
+            _cmpt_Green_1dirunbounded<&_hej_6_1unb2spe, &_hej_6_1unb2spe_k0>(topo, hfact, kfact, koffset, symstart, green, length, kappa);
             break;
         case HEJ_8:
-            G  = &_hej_8_1unb2spe;
-            G0 = &_hej_8_1unb2spe_k0;
+            _cmpt_Green_1dirunbounded<&_hej_8_1unb2spe, &_hej_8_1unb2spe_k0>(topo, hfact, kfact, koffset, symstart, green, length, kappa);
             break;
         case HEJ_10:
-            G  = &_hej_10_1unb2spe;
-            G0 = &_hej_10_1unb2spe_k0;
+            _cmpt_Green_1dirunbounded<&_hej_10_1unb2spe, &_hej_10_1unb2spe_k0>(topo, hfact, kfact, koffset, symstart, green, length, kappa);
             break;        
         case HEJ_0:
             FLUPS_ERROR("HEJ0 kernel not available for 1D unbounded problems.", LOCATION);
             break;        
         case CHAT_2:
-            G  = &_chat_2_1unb2spe;
-            G0 = &_chat_2_1unb2spe_k0;
+            _cmpt_Green_1dirunbounded<&_chat_2_1unb2spe, &_chat_2_1unb2spe_k0>(topo, hfact, kfact, koffset, symstart, green, length, kappa);
             break;
         case LGF_2:
             FLUPS_ERROR("Lattice Green Function not implemented yet.", LOCATION);
@@ -378,52 +743,6 @@ void cmpt_Green_1dirunbounded(const Topology *topo, const double hfact[3], const
             FLUPS_ERROR("Green Function type unknow.", LOCATION);
     }
 
-    int istart[3];
-    topo->get_istart_glob(istart);
-
-    const int nf      = topo->nf();
-    const int ax0     = topo->axis();
-    const int ax1     = (ax0 + 1) % 3;
-    const int ax2     = (ax0 + 2) % 3;
-    const int nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
-    // FLUPS_INFO("KFAC= %lf %lf %lf", kfact[0],kfact[1],kfact[2]);
-    // FLUPS_INFO("Koff= %lf %lf %lf", koffset[0],koffset[1],koffset[2]);
-    // FLUPS_INFO("HFAC= %lf %lf %lf", hfact[0],hfact[1],hfact[2]);
-    for (int i2 = 0; i2 < topo->nloc(ax2); i2++) {
-        for (int i1 = 0; i1 < topo->nloc(ax1); i1++) {
-            //local indexes start
-            const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
-
-            for (int i0 = 0; i0 < topo->nloc(ax0); i0++) {
-                int is[3];
-                cmpt_symID(ax0,i0,i1,i2,istart,symstart,0,is);
-
-                // (symmetrized) wave number : only 1 kfact is zero
-                const double k0 = (is[ax0] + koffset[ax0]) * kfact[ax0];
-                const double k1 = (is[ax1] + koffset[ax1]) * kfact[ax1];
-                const double k2 = (is[ax2] + koffset[ax2]) * kfact[ax2];
-                const double k  = sqrt(k0 * k0 + k1 * k1 + k2 * k2);
-
-                //(symmetrized) position : only 1 hfact is non-zero
-                const double x0 = (is[ax0]) * hfact[ax0];
-                const double x1 = (is[ax1]) * hfact[ax1];
-                const double x2 = (is[ax2]) * hfact[ax2];
-                const double r  = sqrt(x0 * x0 + x1 * x1 + x2 * x2);
-
-                const double tmp[3] = {r, k, length};
-
-                // green function value
-                // Implementation note: having a 'if' in a loop is highly discouraged... however, this is the init so we prefer having a
-                // this routine with a high readability and lower efficency than the opposite.
-                if (k <= (kfact[ax0] + kfact[ax1] + kfact[ax2]) * 0.2) {
-                    green[id + i0 * nf] = G0(tmp,NULL);
-                }
-                else{
-                    green[id + i0 * nf] = G(tmp,NULL);
-                }
-            }
-        }
-    }
     END_FUNC;
 }
 
@@ -446,9 +765,57 @@ void cmpt_Green_1dirunbounded(const Topology *topo, const double hfact[3], const
  * @param green the Green function array
  * @param typeGreen the type of Green function 
  * @param length the characteristic length (only used for HEJ kernels = epsilon)
+ * @param kappa the screening parameter of the equation (nabla^2 - kappa^2) u = f, 0 for the Poisson equation (not available with the HEJ_2 to HEJ_10 kernels)
  */
-void cmpt_Green_0dirunbounded(const Topology *topo, const double hgrid, const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length) {
-    cmpt_Green_0dirunbounded(topo, hgrid, kfact, koffset, symstart, green, typeGreen, length, NULL, NULL);
+void cmpt_Green_0dirunbounded(const Topology *topo, const double hgrid, const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length, const double kappa) {
+    cmpt_Green_0dirunbounded(topo, hgrid, kfact, koffset, symstart, green, typeGreen, length, kappa, NULL, NULL);
+}
+
+/**
+ * @brief loop on the points [is,ie[ of the topology for cmpt_Green_0dirunbounded
+ * 
+ * The kernel is given as a template argument so that it is inlined in the loop.
+ */
+template <GreenKernel G>
+static void _cmpt_Green_0dirunbounded(const Topology *topo, const int istart[3], const int is[3], const int ie[3], const double hgrid, const double kfact[3], const double koffset[3], const double symstart[3], double *green, const double length, const double kappa) {
+    const int    nf      = topo->nf();
+    const int    ax0     = topo->axis();
+    const int    ax1     = (ax0 + 1) % 3;
+    const int    ax2     = (ax0 + 2) % 3;
+    const int    nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
+    const int    is0     = is[ax0];
+    const int    ie0     = ie[ax0];
+    const int    is1     = is[ax1];
+    const int    is2     = is[ax2];
+    const int    n1      = ie[ax1] - is[ax1];
+    const int    n2      = ie[ax2] - is[ax2];
+    const size_t onmax   = (n1 > 0 && n2 > 0) ? (size_t)n1 * (size_t)n2 : 0;
+
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(onmax, is0, ie0, is1, is2, n1, nf, ax0, ax1, ax2, nmem, istart, hgrid, kfact, koffset, symstart, green, length, kappa)
+    for (size_t io = 0; io < onmax; io++) {
+        const int i1 = is1 + io % n1;
+        const int i2 = is2 + io / n1;
+        //local indexes start
+        const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
+        for (int i0 = is0; i0 < ie0; i0++) {
+            int il[3];
+            cmpt_symID(ax0, i0, i1, i2, istart, symstart, 0, il);
+            //the previous call works with koffset below because there is never a shiftgreen AND a symstart together
+
+            // (symmetrized) wave number
+            const double k0 = (il[ax0] + koffset[ax0]) * kfact[ax0];
+            const double k1 = (il[ax1] + koffset[ax1]) * kfact[ax1];
+            const double k2 = (il[ax2] + koffset[ax2]) * kfact[ax2];
+
+            // green function value
+            const double ksqr = k0 * k0 + k1 * k1 + k2 * k2;
+
+            // const double tmp[2] = {ksqr, eps};
+            const double tmp[7] = {ksqr, length, k0, k1, k2, hgrid, kappa};
+
+            green[id + i0 * nf] = G(tmp, NULL);
+        }
+    }
 }
 
 /**
@@ -466,50 +833,21 @@ void cmpt_Green_0dirunbounded(const Topology *topo, const double hgrid, const do
  * @param green the Green function array
  * @param typeGreen the type of Green function 
  * @param length the characteristic length (only used for HEJ kernels = epsilon)
+ * @param kappa the screening parameter of the equation (nabla^2 - kappa^2) u = f, 0 for the Poisson equation (not available with the HEJ_2 to HEJ_10 kernels)
  * @param istart_custom global index where we start to fill data, in each dir. If NULL, we start at the beginning of the spectral space.
  * @param iend_custom global index where we end to fill data, in each dir. If NULL, we end at the end of the spectral space.
  */
-void cmpt_Green_0dirunbounded(const Topology *topo, const double hgrid, const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length, const int istart_custom[3], const int iend_custom[3]) {
+void cmpt_Green_0dirunbounded(const Topology *topo, const double hgrid, const double kfact[3], const double koffset[3], const double symstart[3], double *green, GreenType typeGreen, const double length, const double kappa, const int istart_custom[3], const int iend_custom[3]) {
     BEGIN_FUNC;
+    if (kappa != 0.0 && (typeGreen == HEJ_2 || typeGreen == HEJ_4 || typeGreen == HEJ_6 || typeGreen == HEJ_8 || typeGreen == HEJ_10)) {
+        FLUPS_ERROR("The screened Poisson equation is not available with the HEJ_2 to HEJ_10 kernels.", LOCATION);
+    }
 
     // assert that the green spacing is not 0.0 everywhere
     FLUPS_CHECK(kfact[0] != 0.0, "dk cannot be 0", LOCATION);
     FLUPS_CHECK(kfact[1] != 0.0, "dk cannot be 0", LOCATION);
     // FLUPS_CHECK(kfact[2] != 0.0, "dk cannot be 0", LOCATION);
 
-    GreenKernel G;   // the Green kernel (general expression in the whole domain)
-
-    switch (typeGreen) {
-        case HEJ_2:
-            G = &_hej_2_0unb3spe;
-            break;
-        case HEJ_4:
-            G = &_hej_4_0unb3spe;
-            break;
-        case HEJ_6:
-            G = &_hej_6_0unb3spe;
-            break;
-        case HEJ_8:
-            G = &_hej_8_0unb3spe;
-            break;
-        case HEJ_10:
-            G = &_hej_10_0unb3spe;
-            break; 
-        case HEJ_0:
-            //spectral solution is here given by 1/k^2, i.e. same 
-            //as CHAT_2 kernel
-            G = &_chat_2_0unb3spe;
-            break;                           
-        case CHAT_2:
-            G = &_chat_2_0unb3spe;
-            break;
-        case LGF_2:
-            G = &_lgf_2_0unb3spe;
-            break;
-        default:
-            FLUPS_ERROR("Green Function type unknow.", LOCATION);
-    }
-
     int istart[3];
     topo->get_istart_glob(istart);
 
@@ -539,40 +877,132 @@ void cmpt_Green_0dirunbounded(const Topology *topo, const double hgrid, const do
     // FLUPS_INFO("HFAC= %lf %lf %lf", hfact[0],hfact[1],hfact[2]);
     // printf("IEND : %d,%d,%d \n",topo->nloc(0),topo->nloc(1),topo->nloc(2));
 
-    const int nf      = topo->nf();
-    const int ax0     = topo->axis();
-    const int ax1     = (ax0 + 1) % 3;
-    const int ax2     = (ax0 + 2) % 3;
-    const int nmem[3] = {topo->nmem(0), topo->nmem(1), topo->nmem(2)};
-    for (int i2 = is[ax2]; i2 < ie[ax2]; i2++) {
-        for (int i1 = is[ax1]; i1 < ie[ax1]; i1++) {
-            //local indexes start
-            const size_t id = localIndex(ax0, 0, i1, i2, ax0, nmem, nf, 0);
-            for (int i0 = is[ax0]; i0 < ie[ax0]; i0++) {
-                int il[3];
-                cmpt_symID(ax0, i0, i1, i2, istart, symstart, 0, il);
-                //the previous call works with koffset below because there is never a shiftgreen AND a symstart together
-
-                // (symmetrized) wave number
-                const double k0 = (il[ax0] + koffset[ax0]) * kfact[ax0];
-                const double k1 = (il[ax1] + koffset[ax1]) * kfact[ax1];
-                const double k2 = (il[ax2] + koffset[ax2]) * kfact[ax2];
-
-                // green function value
-                const double ksqr = k0 * k0 + k1 * k1 + k2 * k2;
-
-                // const double tmp[2] = {ksqr, eps};
-                const double tmp[6] = {ksqr, length, k0, k1, k2, hgrid};
+    const int ax0 = topo->axis();
+    const int ax1 = (ax0 + 1) % 3;
+    const int ax2 = (ax0 + 2) % 3;
 
-                green[id + i0 * nf] = G(tmp, NULL);
-            }
-        }
+    switch (typeGreen) {
+        case HEJ_2:
+            _cmpt_Green_0dirunbounded<&_hej_2_0unb3spe>(topo, istart, is, ie, hgrid, kfact, koffset, symstart, green, length, kappa);
+            break;
+        case HEJ_4:
+            _cmpt_Green_0dirunbounded<&_hej_4_0unb3spe>(topo, istart, is, ie, hgrid, kfact, koffset, symstart, green, length, kappa);
+            break;
+        case HEJ_6:
+            _cmpt_Green_0dirunbounded<&_hej_6_0unb3spe>(topo, istart, is, ie, hgrid, kfact, koffset, symstart, green, length, kappa);
+            break;
+        case HEJ_8:
+            _cmpt_Green_0dirunbounded<&_hej_8_0unb3spe>(topo, istart, is, ie, hgrid, kfact, koffset, symstart, green, length, kappa);
+            break;
+        case HEJ_10:
+            _cmpt_Green_0dirunbounded<&_hej_10_0unb3spe>(topo, istart, is, ie, hgrid, kfact, koffset, symstart, green, length, kappa);
+            break; 
+        case HEJ_0:
+            //spectral solution is here given by 1/k^2, i.e. same 
+            //as CHAT_2 kernel
+        case CHAT_2:
+            _cmpt_Green_0dirunbounded<&_chat_2_0unb3spe>(topo, istart, is, ie, hgrid, kfact, koffset, symstart, green, length, kappa);
+            break;
+        case LGF_2:
+            _cmpt_Green_0dirunbounded<&_lgf_2_0unb3spe>(topo, istart, is, ie, hgrid, kfact, koffset, symstart, green, length, kappa);
+            break;
+        default:
+            FLUPS_ERROR("Green Function type unknow.", LOCATION);
     }
-    // reset the value in 0.0
-    if (istart[ax0] == 0 && istart[ax1] == 0 && istart[ax2] == 0 \
+    // reset the value in 0.0, the screened Green's function is defined in k=0
+    if (kappa == 0.0 && istart[ax0] == 0 && istart[ax1] == 0 && istart[ax2] == 0 \
         && koffset[0]+koffset[1]+koffset[2]<0.2 ) {
         green[0] = 0.0;
     }
     END_FUNC;
 }
 
+/**
+ * @brief evaluates the Green kernel G on one pencil for 3dirspectral, see cmpt_Green_0dirunbounded_pencil
+ * 
+ * The kernel is given as a template argument so that it is inlined in the loop.
+ */
+template <GreenKernel G>
+static inline void _cmpt_Green_0dirunbounded_pencil(const int ax0, const int n0, const int i1, const int i2, const int istart[3], const double hgrid, const double kfact[3], const double koffset[3], const double symstart[3], const double scale, double *green, const double length, const double kappa) {
+    const int ax1 = (ax0 + 1) % 3;
+    const int ax2 = (ax0 + 2) % 3;
+    for (int i0 = 0; i0 < n0; i0++) {
+        int il[3];
+        cmpt_symID(ax0, i0, i1, i2, istart, symstart, 0, il);
+
+        // (symmetrized) wave number
+        const double k0 = (il[ax0] + koffset[ax0]) * kfact[ax0];
+        const double k1 = (il[ax1] + koffset[ax1]) * kfact[ax1];
+        const double k2 = (il[ax2] + koffset[ax2]) * kfact[ax2];
+
+        // green function value
+        const double ksqr   = k0 * k0 + k1 * k1 + k2 * k2;
+        const double tmp[7] = {ksqr, length, k0, k1, k2, hgrid, kappa};
+
+        green[i0] = scale * G(tmp, NULL);
+    }
+}
+
+/**
+ * @brief Compute the Green function for 3dirspectral on one pencil of the topology
+ * 
+ * The values are the same as the ones of cmpt_Green_0dirunbounded, multiplied by scale. They are stored contiguously, one real per element.
+ * This allows to evaluate the Green's function on the fly instead of storing it.
+ * 
+ * @param topo the topology associated to the Green's function
+ * @param i1 the local index of the pencil in the (axis+1)%3 direction
+ * @param i2 the local index of the pencil in the (axis+2)%3 direction
+ * @param hgrid the grid spacing (used for the LGF kernel)
+ * @param kfact the k multiplicative factor
+ * @param koffset the k additive factor
+ * @param symstart index of the symmetry in each direction
+ * @param scale the factor applied to the Green's function (e.g. the volume factor)
+ * @param green the pencil of the Green function, of size topo->nloc(topo->axis())
+ * @param typeGreen the type of Green function 
+ * @param length the characteristic length (only used for HEJ kernels = epsilon)
+ * @param kappa the screening parameter of the equation (nabla^2 - kappa^2) u = f, 0 for the Poisson equation (not checked here, see cmpt_Green_0dirunbounded)
+ */
+void cmpt_Green_0dirunbounded_pencil(const Topology *topo, const int i1, const int i2, const double hgrid, const double kfact[3], const double koffset[3], const double symstart[3], const double scale, double *green, GreenType typeGreen, const double length, const double kappa) {
+    BEGIN_FUNC;
+    const int ax0 = topo->axis();
+    const int n0  = topo->nloc(ax0);
+
+    int istart[3];
+    topo->get_istart_glob(istart);
+
+    switch (typeGreen) {
+        case HEJ_2:
+            _cmpt_Green_0dirunbounded_pencil<&_hej_2_0unb3spe>(ax0, n0, i1, i2, istart, hgrid, kfact, koffset, symstart, scale, green, length, kappa);
+            break;
+        case HEJ_4:
+            _cmpt_Green_0dirunbounded_pencil<&_hej_4_0unb3spe>(ax0, n0, i1, i2, istart, hgrid, kfact, koffset, symstart, scale, green, length, kappa);
+            break;
+        case HEJ_6:
+            _cmpt_Green_0dirunbounded_pencil<&_hej_6_0unb3spe>(ax0, n0, i1, i2, istart, hgrid, kfact, koffset, symstart, scale, green, length, kappa);
+            break;
+        case HEJ_8:
+            _cmpt_Green_0dirunbounded_pencil<&_hej_8_0unb3spe>(ax0, n0, i1, i2, istart, hgrid, kfact, koffset, symstart, scale, green, length, kappa);
+            break;
+        case HEJ_10:
+            _cmpt_Green_0dirunbounded_pencil<&_hej_10_0unb3spe>(ax0, n0, i1, i2, istart, hgrid, kfact, koffset, symstart, scale, green, length, kappa);
+            break;
+        case HEJ_0:
+            //spectral solution is here given by 1/k^2, i.e. same
+            //as CHAT_2 kernel
+        case CHAT_2:
+            _cmpt_Green_0dirunbounded_pencil<&_chat_2_0unb3spe>(ax0, n0, i1, i2, istart, hgrid, kfact, koffset, symstart, scale, green, length, kappa);
+            break;
+        case LGF_2:
+            _cmpt_Green_0dirunbounded_pencil<&_lgf_2_0unb3spe>(ax0, n0, i1, i2, istart, hgrid, kfact, koffset, symstart, scale, green, length, kappa);
+            break;
+        default:
+            FLUPS_ERROR("Green Function type unknow.", LOCATION);
+    }
+
+    // reset the value in 0.0, the screened Green's function is defined in k=0
+    if (kappa == 0.0 && istart[ax0] == 0 && istart[(ax0 + 1) % 3] + i1 == 0 && istart[(ax0 + 2) % 3] + i2 == 0 \
+        && koffset[0] + koffset[1] + koffset[2] < 0.2) {
+        green[0] = 0.0;
+    }
+    END_FUNC;
+}
@@ -31,13 +31,25 @@
 #include "si.hpp"
 #include "ji0.hpp"
 
+/**
+ * @brief number of parameters of a point for the batched kernels (the `_n` kernels)
+ * 
+ * The batched kernels evaluate n <= GREEN_BATCH points at once, the parameters of the i-th point being stored in params[i * GREEN_NPARAM ...],
+ * as for the scalar kernels. This allows to evaluate the special functions in batch.
+ */
+#define GREEN_NPARAM 9
+/**
+ * @brief maximum number of points evaluated at once by the batched kernels
+ */
+#define GREEN_BATCH 64
+
 /**
  * @name 3 directions unbounded - 0 direction spectral
  * 
  * @{
  */
 // ----------------------------------------------------------- 3D - KERNELS ----------------------------------------------------------
-//notice that these function will likely not be inlined as we have a pointer to them...
+//notice that these functions are given as template arguments to the loops of green_functions.cpp, so that they can be inlined
 static inline double _hej_2_3unb0spe(const void* params,const double* data) {
     double r   = ((double*)params) [0];
     double eps = ((double*)params) [1];
@@ -74,10 +86,27 @@ static inline double _hej_0_3unb0spe(const void* params,const double* data) {
     double rho     = r * c_1osig;
     return -c_1o2pi2 * c_1osig * Si(rho)/rho;
 }
+static inline void _hej_0_3unb0spe_n(const int n, const double* params, const double* data, double* green) {
+    double rho[GREEN_BATCH];
+    double si[GREEN_BATCH];
+    for (int i = 0; i < n; i++) {
+        rho[i] = params[i * GREEN_NPARAM] / params[i * GREEN_NPARAM + 1];
+    }
+    Si_n(rho, si, n);
+    for (int i = 0; i < n; i++) {
+        const double c_1osig = 1.0 / params[i * GREEN_NPARAM + 1];
+        green[i] = -c_1o2pi2 * c_1osig * si[i] / rho[i];
+    }
+}
 static inline double _chat_2_3unb0spe(const void* params,const double* data) {
     double r   = ((double*)params) [0];
     return -c_1o4pi / r ;
 }
+static inline double _chat_2_3unb0spe_kappa(const void* params,const double* data) {
+    double r     = ((double*)params) [0];
+    double kappa = ((double*)params) [2];
+    return -c_1o4pi * exp(-kappa * r) / r ;
+}
 
 /**
  * @brief LGF 3D
@@ -280,6 +309,55 @@ static inline double _hej_0_2unb1spe_k0(const void* params,const double* data) {
     return (rho<30.0) ? tmp : c_1o2pi * log(r); 
 }
 
+/**
+ * @brief batched evaluation of the HEJ kernels in k=0: c_1o2pi * (log(r) - (c0 + c1 rho2 + c2 rho2^2 + c3 rho2^3) * exp(-rho2/2) + 0.5 * expint_ei(rho2/2))
+ */
+static inline void _hej_2unb1spe_k0_n(const int n, const double* params, double* green, const double c0, const double c1, const double c2, const double c3) {
+    double x[GREEN_BATCH];
+    double ei[GREEN_BATCH];
+    for (int i = 0; i < n; i++) {
+        const double rho = params[i * GREEN_NPARAM] / params[i * GREEN_NPARAM + 2];
+        x[i]             = rho * rho * 0.5;
+    }
+    expint_ei_n(x, ei, n);
+    for (int i = 0; i < n; i++) {
+        const double r    = params[i * GREEN_NPARAM];
+        const double rho2 = 2.0 * x[i];
+        green[i] = c_1o2pi * (log(r) - (c0 + rho2 * (c1 + rho2 * (c2 + rho2 * c3))) * exp(-x[i]) + 0.5 * ei[i]);
+    }
+}
+static inline void _hej_2_2unb1spe_k0_n(const int n, const double* params, const double* data, double* green) {
+    _hej_2unb1spe_k0_n(n, params, green, 0.0, 0.0, 0.0, 0.0);
+}
+static inline void _hej_4_2unb1spe_k0_n(const int n, const double* params, const double* data, double* green) {
+    _hej_2unb1spe_k0_n(n, params, green, 0.5, 0.0, 0.0, 0.0);
+}
+static inline void _hej_6_2unb1spe_k0_n(const int n, const double* params, const double* data, double* green) {
+    _hej_2unb1spe_k0_n(n, params, green, 0.75, -0.125, 0.0, 0.0);
+}
+static inline void _hej_8_2unb1spe_k0_n(const int n, const double* params, const double* data, double* green) {
+    _hej_2unb1spe_k0_n(n, params, green, c_11o12, -c_7o24, c_1o48, 0.0);
+}
+static inline void _hej_10_2unb1spe_k0_n(const int n, const double* params, const double* data, double* green) {
+    _hej_2unb1spe_k0_n(n, params, green, c_25o24, -c_23o48, c_13o192, -c_1o384);
+}
+static inline void _hej_0_2unb1spe_k0_n(const int n, const double* params, const double* data, double* green) {
+    //works as well for r0
+    double rho[GREEN_BATCH];
+    double ji[GREEN_BATCH];
+    for (int i = 0; i < n; i++) {
+        // the series is not evaluated beyond rho = 30, see _hej_0_2unb1spe_k0
+        rho[i] = fmin(params[i * GREEN_NPARAM] / params[i * GREEN_NPARAM + 2], 30.0);
+    }
+    Ji0c_n(rho, ji, n);
+    for (int i = 0; i < n; i++) {
+        const double r     = params[i * GREEN_NPARAM];
+        const double sigma = params[i * GREEN_NPARAM + 2];
+        const double tmp   = c_1o2pi * (ji[i] + log(2 * sigma) - c_gamma);
+        green[i] = (r / sigma < 30.0) ? tmp : c_1o2pi * log(r);
+    }
+}
+
 static inline double _zero(const void* params,const double* data) {   
     return 0.0;
 }
@@ -296,6 +374,28 @@ static inline double _chat_2_2unb1spe_r0(const void* params,const double* data)
 
     return -(1.0 - k * r_eq2D * besselk1(k * r_eq2D)) * c_1opi / ((k * r_eq2D) * (k * r_eq2D));
 }
+static inline void _chat_2_2unb1spe_n(const int n, const double* params, const double* data, double* green) {
+    double x[GREEN_BATCH];
+    double k0[GREEN_BATCH];
+    for (int i = 0; i < n; i++) {
+        x[i] = fabs(params[i * GREEN_NPARAM + 1]) * params[i * GREEN_NPARAM];
+    }
+    besselk0_n(x, k0, n);
+    for (int i = 0; i < n; i++) {
+        green[i] = -c_1o2pi * k0[i];
+    }
+}
+static inline void _chat_2_2unb1spe_r0_n(const int n, const double* params, const double* data, double* green) {
+    double x[GREEN_BATCH];
+    double k1[GREEN_BATCH];
+    for (int i = 0; i < n; i++) {
+        x[i] = params[i * GREEN_NPARAM + 1] * params[i * GREEN_NPARAM + 3];
+    }
+    besselk1_n(x, k1, n);
+    for (int i = 0; i < n; i++) {
+        green[i] = -(1.0 - x[i] * k1[i]) * c_1opi / (x[i] * x[i]);
+    }
+}
 static inline double _chat_2_2unb1spe_k0(const void* params,const double* data) {
     const double r      = ((double*)params) [0];
     // const double sig = ((double*)params)[2];
@@ -479,15 +579,17 @@ static inline double _hej_10_0unb3spe(const void* params,const double* data) {
 
 static inline double _chat_2_0unb3spe(const void* params,const double* data) {
     const double ksqr   = ((double*)params) [0];
+    const double kappa  = ((double*)params) [6];
 
-    return - 1.0 / ksqr;
+    return - 1.0 / (ksqr + kappa * kappa);
 }
 static inline double _lgf_2_0unb3spe(const void* params, const double* data) {
-    const double kx = ((double*)params)[2];
-    const double ky = ((double*)params)[3];
-    const double kz = ((double*)params)[4];
-    const double h  = ((double*)params)[5];
+    const double kx    = ((double*)params)[2];
+    const double ky    = ((double*)params)[3];
+    const double kz    = ((double*)params)[4];
+    const double h     = ((double*)params)[5];
+    const double kappa = ((double*)params)[6];
 
-    return - h * h / (4.0 * pow(sin(kx * h / 2.0), 2.0) + 4.0 * pow(sin(ky * h / 2.0), 2.0) + 4.0 * pow(sin(kz * h / 2.0), 2.0));
+    return - h * h / (4.0 * pow(sin(kx * h / 2.0), 2.0) + 4.0 * pow(sin(ky * h / 2.0), 2.0) + 4.0 * pow(sin(kz * h / 2.0), 2.0) + (kappa * h) * (kappa * h));
 }
 /**@} */
\ No newline at end of file
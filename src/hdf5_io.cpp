@@ -32,6 +32,71 @@ void hdf5_dump(const Topology *topo, const string filename, const double *data)
     END_FUNC;
 }
 
+//-----------------------------------------------------------------------------
+// options of hdf5_write, see the setters below
+static int                  _h5Aggregators = 0;  //!< the number of aggregator ranks of the collective buffering (0 = MPI-IO default)
+static int                  _h5FilterID    = 0;  //!< the HDF5 filter applied to the chunks (0 = no filter)
+static vector<unsigned int> _h5FilterParam;      //!< the parameters (cd_values) of the filter
+#ifdef HAVE_HDF5_ASYNC
+static hid_t  _h5EventSet = H5I_INVALID_HID;  //!< the event set of the pending asynchronous write
+static float* _h5Staging  = NULL;             //!< the staging buffer of the pending asynchronous write
+#endif
+
+/**
+ * @brief sets the number of aggregator ranks used by the collective buffering of @ref hdf5_write (`cb_nodes` MPI-IO hint)
+ * 
+ * @param naggr the number of aggregators, 0 to let MPI-IO choose
+ */
+void hdf5_set_aggregators(const int naggr) {
+    BEGIN_FUNC;
+    FLUPS_CHECK(naggr >= 0, "the number of aggregators must be >= 0", LOCATION);
+    _h5Aggregators = naggr;
+    END_FUNC;
+}
+
+/**
+ * @brief sets the filter applied to the chunks of the datasets written by @ref hdf5_write
+ * 
+ * The filter is either H5Z_FILTER_DEFLATE (= 1, gzip, `param[0]` is the level from 1 to 9) or
+ * the ID of a filter registered as an HDF5 plugin (e.g. 32013 for ZFP, 32017 for SZ), which receives the parameters as is.
+ * If the filter is not available at the time of the write, the data is written uncompressed.
+ * 
+ * @param filterID the filter ID, 0 to disable the filter
+ * @param nparam the number of parameters
+ * @param param the parameters of the filter
+ */
+void hdf5_set_filter(const int filterID, const int nparam, const unsigned int *param) {
+    BEGIN_FUNC;
+    FLUPS_CHECK(filterID >= 0 && nparam >= 0, "wrong filter %d with %d parameters", filterID, nparam, LOCATION);
+    _h5FilterID = filterID;
+    _h5FilterParam.assign(param, param + nparam);
+    END_FUNC;
+}
+
+/**
+ * @brief waits for the completion of the pending write of @ref hdf5_write (asynchronous if compiled with HAVE_HDF5_ASYNC)
+ * 
+ * Without HAVE_HDF5_ASYNC, the writes are always completed on return of @ref hdf5_write and this function does nothing.
+ */
+void hdf5_wait() {
+    BEGIN_FUNC;
+#ifdef HAVE_HDF5_ASYNC
+    if (_h5EventSet != H5I_INVALID_HID) {
+        size_t  nInProgress;
+        hbool_t hasFailed;
+        herr_t  status = H5ESwait(_h5EventSet, H5ES_WAIT_FOREVER, &nInProgress, &hasFailed);
+        FLUPS_CHECK(status >= 0 && !hasFailed, "the asynchronous write has failed", LOCATION);
+        H5ESclose(_h5EventSet);
+        _h5EventSet = H5I_INVALID_HID;
+    }
+    if (_h5Staging != NULL) {
+        flups_free(_h5Staging);
+        _h5Staging = NULL;
+    }
+#endif
+    END_FUNC;
+}
+
 /**
  * @brief writes the hdf5 file referenced in an xmf file
  * 
@@ -54,16 +119,20 @@ void hdf5_dump(const Topology *topo, const string filename, const double *data)
  * - the fastest rotating index is located at the last positions in the hdf5 C convention: `(axis+2 , axis+1 , axis)`
  * - the stride in the hyperslabs functions is the stride of 2 successive blocks!!
  * 
- * **Compression:**
- * The compression used is GNU gzip. The compression is characterize by the level of compression:
- * 
- * - `0`: No compression
- * - `1`: Best compression speed, least compression ratio
- * - `2` to `8`: compression speed degrades, compression ratio improves
- * - `9`: Slowest compression speed, best compression ratio
+ * **Layout:**
+ * The data is first converted to single precision in a contiguous staging buffer (one block per component and real/imaginary part),
+ * so that HDF5 does not have to convert the data nor to gather strided memory.
+ * The chunks of the datasets match the pencils of the topology (they are halved if larger than 1GB): every rank writes about one chunk
+ * per component, which is required by the filters and avoids the locking of the chunks shared among ranks.
+ * The file is written collectively, with `cb_nodes` aggregators if set by @ref hdf5_set_aggregators.
  * 
+ * **Compression:**
+ * The filter set by @ref hdf5_set_filter (gzip or a plugin such as ZFP or SZ) is applied to each chunk, which requires HDF5 >= 1.10.2.
  * 
- * @todo for the moment no compression is set since it fails when changing the type from double to float
+ * **Asynchronous writes:**
+ * If compiled with HAVE_HDF5_ASYNC (HDF5 >= 1.13 with the async VOL connector), the function returns once the data is staged
+ * and the write progresses in the background, e.g. during the next solve. It is completed by @ref hdf5_wait, or by the next call to this function.
+ * The data can be modified as soon as the function returns.
  * 
  * We do the following steps:
  * 
@@ -71,26 +140,32 @@ void hdf5_dump(const Topology *topo, const string filename, const double *data)
 void hdf5_write(const Topology *topo, const string filename, const string attribute, const double *data) {
     BEGIN_FUNC;
 
+    // only one write is pending at a time
+    hdf5_wait();
+
     int mpi_size, mpi_rank;
     MPI_Comm comm = topo->get_comm();
     MPI_Comm_size(comm, &mpi_size);
     MPI_Comm_rank(comm, &mpi_rank);
 
     hid_t  file_id;                         // file id
-    hid_t  filespace_real, filespace_imag;  //dataspaces
-    hid_t  fileset_real, fileset_imag;      // datasets
+    hid_t  fileset[2];                      // datasets, real and imaginary parts
+    hid_t  filespace;                       //dataspaces
     hid_t  memspace;
     hid_t  plist_id; /* property list identifier */
     herr_t status;   // error code
 
     string extFilename = "data/" + filename + ".h5";
 
-    // compression level
-    // int complevel = 0;
-
     const int ax0 = topo->axis();
     const int ax1 = (ax0 + 1) % 3;
     const int ax2 = (ax0 + 2) % 3;
+    const int nf  = topo->nf();
+    const int lda = topo->lda();
+
+#ifdef HAVE_HDF5_ASYNC
+    _h5EventSet = H5EScreate();
+#endif
 
     //-------------------------------------------------------------------------
     /** - Create a new file collectively  */
@@ -106,12 +181,20 @@ void hdf5_write(const Topology *topo, const string filename, const string attrib
     MPI_Info_set(FILE_INFO_TEMPLATE, "collective_buffering", "true");
     MPI_Info_set(FILE_INFO_TEMPLATE, "cb_block_size", "1048576");
     MPI_Info_set(FILE_INFO_TEMPLATE, "cb_buffer_size", "4194304");
+    if (_h5Aggregators > 0) {
+        const string naggr = to_string(std::min(_h5Aggregators, mpi_size));
+        MPI_Info_set(FILE_INFO_TEMPLATE, "romio_cb_write", "enable");
+        MPI_Info_set(FILE_INFO_TEMPLATE, "cb_nodes", naggr.c_str());
+    }
     // do some magic
-    // H5Pset_fapl_mpio(plist_id, comm, MPI_INFO_NULL);
     H5Pset_fapl_mpio(plist_id, comm, FILE_INFO_TEMPLATE);
     MPI_Info_free(&FILE_INFO_TEMPLATE);
     // create the file ID
+#ifdef HAVE_HDF5_ASYNC
+    file_id = H5Fcreate_async(extFilename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, plist_id, _h5EventSet);
+#else
     file_id = H5Fcreate(extFilename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+#endif
     if (file_id < 0) FLUPS_ERROR("Failed to open the file.", LOCATION);
     // close the property list
     H5Pclose(plist_id);
@@ -120,129 +203,340 @@ void hdf5_write(const Topology *topo, const string filename, const string attrib
     /** - Create the file dataspace and dataset  */
     /** \warning In the dataspace, the last index must be the index of the vector 
      * component (requirement from xdmf). However, in memory, the index of the
-     * vector component is the first one. We will thus need to fill the file 
-     * with the data, component by component, and using a stride of lda.
+     * vector component is the first one. We will thus fill the file component
+     * by component from the staging buffer.
     //-----------------------------------------------------------------------*/
     // the file information is given by the global size = total size reserved for the file
-    hsize_t field_dims[4] = {(hsize_t)topo->nglob(ax2),(hsize_t)topo->nglob(ax1),(hsize_t)topo->nglob(ax0),(hsize_t) topo->lda()};
+    hsize_t field_dims[4] = {(hsize_t)topo->nglob(ax2),(hsize_t)topo->nglob(ax1),(hsize_t)topo->nglob(ax0),(hsize_t) lda};
 
     // setup the property list = option list
     plist_id = H5Pcreate(H5P_DATASET_CREATE);
-    hsize_t chk_dim[4] = {std::min(8,(int)field_dims[0]), std::min(8,(int)field_dims[1]), std::min(8,(int)field_dims[2]), 1};
+    // one chunk per pencil = the largest local size, halved as long as it is over 1GB (the HDF5 limit is 4GB)
+    hsize_t chk_dim[4] = {1, 1, 1, 1};
+    const int chk_ax[3] = {ax2, ax1, ax0};
+    for (int id = 0; id < 3; id++) {
+        const int nproc = topo->nproc(chk_ax[id]);
+        chk_dim[id]     = std::max((hsize_t)1, (hsize_t)((topo->nglob(chk_ax[id]) + nproc - 1) / nproc));
+    }
+    while (chk_dim[0] * chk_dim[1] * chk_dim[2] * sizeof(float) > (((hsize_t)1) << 30)) {
+        const int idmax = (chk_dim[0] >= chk_dim[1] && chk_dim[0] >= chk_dim[2]) ? 0 : ((chk_dim[1] >= chk_dim[2]) ? 1 : 2);
+        chk_dim[idmax]  = (chk_dim[idmax] + 1) / 2;
+    }
     H5Pset_chunk(plist_id, 4, chk_dim);
+    // the chunks are entirely written, no need to fill them first
+    H5Pset_fill_time(plist_id, H5D_FILL_TIME_NEVER);
+
+    // add the filter
+    if (_h5FilterID == H5Z_FILTER_DEFLATE) {
+        H5Pset_deflate(plist_id, _h5FilterParam.empty() ? 1 : _h5FilterParam[0]);
+    } else if (_h5FilterID > 0) {
+        if (H5Zfilter_avail((H5Z_filter_t)_h5FilterID) > 0) {
+            H5Pset_filter(plist_id, (H5Z_filter_t)_h5FilterID, H5Z_FLAG_MANDATORY, _h5FilterParam.size(), _h5FilterParam.data());
+        } else {
+            FLUPS_WARNING("the HDF5 filter %d is not available, the data is written uncompressed", _h5FilterID, LOCATION);
+        }
+    }
 
     // create dataset and dataspace = the whole hard memory reserved for the file
-    if (!topo->isComplex()) {
-        filespace_real = H5Screate_simple(4, field_dims, NULL);
-        fileset_real   = H5Dcreate(file_id, attribute.c_str(), H5T_NATIVE_FLOAT, filespace_real, H5P_DEFAULT, plist_id, H5P_DEFAULT);
-        H5Sclose(filespace_real);
-    } else {
-        string realname = attribute + "_real";
-        filespace_real  = H5Screate_simple(4, field_dims, NULL);
-        fileset_real    = H5Dcreate(file_id, realname.c_str(), H5T_NATIVE_FLOAT, filespace_real, H5P_DEFAULT, plist_id, H5P_DEFAULT);
-
-        string imagname = attribute + "_imag";
-        filespace_imag  = H5Screate_simple(4, field_dims, NULL);
-        fileset_imag    = H5Dcreate(file_id, imagname.c_str(), H5T_NATIVE_FLOAT, filespace_imag, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+    filespace = H5Screate_simple(4, field_dims, NULL);
+    for (int ir = 0; ir < nf; ir++) {
+        const string name = (nf == 1) ? attribute : (attribute + ((ir == 0) ? "_real" : "_imag"));
+#ifdef HAVE_HDF5_ASYNC
+        fileset[ir] = H5Dcreate_async(file_id, name.c_str(), H5T_NATIVE_FLOAT, filespace, H5P_DEFAULT, plist_id, H5P_DEFAULT, _h5EventSet);
+#else
+        fileset[ir] = H5Dcreate(file_id, name.c_str(), H5T_NATIVE_FLOAT, filespace, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+#endif
     }
+    H5Sclose(filespace);
     // close property list
     H5Pclose(plist_id);
 
     //-------------------------------------------------------------------------
-    /** - select the hyperslab inside the file dataset (=writting location)  */
+    /** - Stage the data: one contiguous block per component and per real/imaginary part */
+    //-------------------------------------------------------------------------
+    const int    nloc[3] = {topo->nloc(ax0), topo->nloc(ax1), topo->nloc(ax2)};
+    const size_t nblock  = (size_t)nloc[0] * nloc[1] * nloc[2];
+    int          nmem[3];
+    for (int id = 0; id < 3; id++) {
+        nmem[id] = topo->nmem(id);
+    }
+    float *staging = (float *)flups_malloc(sizeof(float) * std::max(nblock * nf * lda, (size_t)1));
+
+    for (int lia = 0; lia < lda; lia++) {
+        for (int ir = 0; ir < nf; ir++) {
+            float *block = staging + nblock * (lia * nf + ir);
+#pragma omp parallel for default(none) proc_bind(close) schedule(static) firstprivate(block, data, nloc, nmem, ax0, nf, lia, ir)
+            for (int id = 0; id < nloc[1] * nloc[2]; id++) {
+                const int     i1  = id % nloc[1];
+                const int     i2  = id / nloc[1];
+                const double *src = data + localIndex(ax0, 0, i1, i2, ax0, nmem, nf, lia) + ir;
+                float        *trg = block + (size_t)id * nloc[0];
+                for (int i0 = 0; i0 < nloc[0]; i0++) {
+                    trg[i0] = (float)src[i0 * nf];
+                }
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    /** - select the hyperslab inside the file dataset (=writting location) and do the writting */
     //-------------------------------------------------------------------------
     // get the offset from topo
-    // prepare the stide: we will fill the file component by component
     int topo_offset[3];
     topo->get_istart_glob(topo_offset);
-    hsize_t count[4]  = {1, 1, 1, 1};                                                                                          // how many blocks to write
-    hsize_t stride[4] = {1, 1, 1, (hsize_t)topo->lda()};                                                                                          // distance between 2 blocks
-    hsize_t block[4]  = {(hsize_t)topo->nloc(ax2), (hsize_t)topo->nloc(ax1), (hsize_t)topo->nloc(ax0)   ,1};  // the block size = the local size
-    hsize_t offset[4] = {(hsize_t)topo_offset[ax2], (hsize_t)topo_offset[ax1], (hsize_t)topo_offset[ax0],0};                  // offset in the file
+    hsize_t block[4]  = {(hsize_t)nloc[2], (hsize_t)nloc[1], (hsize_t)nloc[0], 1};                                 // the block size = the local size
+    hsize_t offset[4] = {(hsize_t)topo_offset[ax2], (hsize_t)topo_offset[ax1], (hsize_t)topo_offset[ax0], 0};  // offset in the file
 
-    //-------------------------------------------------------------------------
-    /** - Create the memory dataspace */
-    //-------------------------------------------------------------------------
-    // dataspace = volume inside the memory that has a full size of nmem
-    hsize_t memsize[4] = {(hsize_t)topo->lda(), (hsize_t)topo->nmem(ax2), (hsize_t)topo->nmem(ax1), (hsize_t)(topo->nmem(ax0) * topo->nf())};
-    memspace           = H5Screate_simple(4, memsize, NULL);
+    // the memory is one contiguous block
+    memspace = H5Screate_simple(4, block, NULL);
 
     // set the property list
     plist_id = H5Pcreate(H5P_DATASET_XFER);
     H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
 
-    //looping over the vector components. 
-    for (int lia = 0; lia<topo->lda();lia++)
-    {
+    //looping over the vector components and the real/imaginary parts
+    for (int lia = 0; lia < lda; lia++) {
         offset[3] = lia;
-
-        // get the hyperslab within the dataset of the file
-        if (!topo->isComplex()) {
-            filespace_real = H5Dget_space(fileset_real);
-            status         = H5Sselect_hyperslab(filespace_real, H5S_SELECT_SET, offset, stride, count, block);
+        for (int ir = 0; ir < nf; ir++) {
+            // get the hyperslab within the dataset of the file
+            filespace = H5Dget_space(fileset[ir]);
+            status    = H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, block, NULL);
             FLUPS_CHECK(status >= 0, "Failed to select hyperslab in dataset.", LOCATION);
-        } else {
-            filespace_real = H5Dget_space(fileset_real);
-            status         = H5Sselect_hyperslab(filespace_real, H5S_SELECT_SET, offset, stride, count, block);
-            FLUPS_CHECK(status >= 0, "Failed to select real hyperslab in dataset.", LOCATION);
-            filespace_imag = H5Dget_space(fileset_imag);
-            status         = H5Sselect_hyperslab(filespace_imag, H5S_SELECT_SET, offset, stride, count, block);
-            FLUPS_CHECK(status >= 0, "Failed to select complex hyperslab in dataset.", LOCATION);
-        }
-
-        //-------------------------------------------------------------------------
-        /** - do the writting  */
-        //-------------------------------------------------------------------------
-
-        hsize_t memblock[4] = {1, 1, 1, 1};
-        hsize_t memcount[4] = {1  , (hsize_t)topo->nloc(ax2), (hsize_t)topo->nloc(ax1), (hsize_t)topo->nloc(ax0)};
 
-        //each lia component, the dataspace {lia,:,:,:} in memory correspond to the dataspace {:,:,:,lia} in the file
-        if (!topo->isComplex()) {
-            hsize_t memstride[4] = {(hsize_t) topo->lda(), 1, 1, 1};
-            hsize_t memoffset[4] = {(hsize_t) lia, 0, 0, 0};  // offset in memory
-            status               = H5Sselect_hyperslab(memspace, H5S_SELECT_SET, memoffset, memstride, memcount, memblock);
-            FLUPS_CHECK(status >= 0, "Failed to select hyperslab in memmory.", LOCATION);
-            status = H5Dwrite(fileset_real, H5T_NATIVE_DOUBLE, memspace, filespace_real, plist_id, data);
+            // each lia component, the block {lia,ir} in the staging buffer corresponds to the dataspace {:,:,:,lia} in the file
+            const float *buf = staging + nblock * (lia * nf + ir);
+#ifdef HAVE_HDF5_ASYNC
+            status = H5Dwrite_async(fileset[ir], H5T_NATIVE_FLOAT, memspace, filespace, plist_id, buf, _h5EventSet);
+#else
+            status = H5Dwrite(fileset[ir], H5T_NATIVE_FLOAT, memspace, filespace, plist_id, buf);
+#endif
             FLUPS_CHECK(status >= 0, "Failed to write hyperslab to file.", LOCATION);
-        }
-
-        if (topo->isComplex()) {
-            // stride is 2 for complex numbers
-            hsize_t memstride[4] = {(hsize_t)topo->lda(), 1, 1, 2};
-            // real part
-            hsize_t memoffset[4] = {(hsize_t)lia, 0, 0, 0};
-            status               = H5Sselect_hyperslab(memspace, H5S_SELECT_SET, memoffset, memstride, memcount, memblock);
-            FLUPS_CHECK(status >= 0, "Failed to select real hyperslab in memmory.", LOCATION);
-            status = H5Dwrite(fileset_real, H5T_NATIVE_DOUBLE, memspace, filespace_real, plist_id, data);
-            FLUPS_CHECK(status >= 0, "Failed to write real part hyperslab to file.", LOCATION);
-
-            memoffset[3] = 1;  // set an offset on the fastest rotating index
-
-            // imaginary part
-            status = H5Sselect_hyperslab(memspace, H5S_SELECT_SET, memoffset, memstride, memcount, memblock);
-            FLUPS_CHECK(status >= 0, "Failed to select imag hyperslab in memmory.", LOCATION);
-            status = H5Dwrite(fileset_imag, H5T_NATIVE_DOUBLE, memspace, filespace_imag, plist_id, data);
-            FLUPS_CHECK(status >= 0, "Failed to write imaginary part hyperslab to file.", LOCATION);
+            H5Sclose(filespace);
         }
     }
 
     //-------------------------------------------------------------------------
     /** - close everything */
     //-------------------------------------------------------------------------
-    H5Dclose(fileset_real);
-    H5Sclose(filespace_real);
     H5Sclose(memspace);
-    if (topo->isComplex()) {
-        H5Dclose(fileset_imag);
-        H5Sclose(filespace_imag);
+    H5Pclose(plist_id);
+#ifdef HAVE_HDF5_ASYNC
+    // the staging buffer is freed by hdf5_wait, once the write is completed
+    for (int ir = 0; ir < nf; ir++) {
+        H5Dclose_async(fileset[ir], _h5EventSet);
+    }
+    H5Fclose_async(file_id, _h5EventSet);
+    _h5Staging = staging;
+#else
+    for (int ir = 0; ir < nf; ir++) {
+        H5Dclose(fileset[ir]);
     }
+    H5Fclose(file_id);
+    flups_free(staging);
+#endif
 
+    END_FUNC;
+    return;
+}
+
+/**
+ * @brief writes the raw local memory of data in a parallel hdf5 file, together with a key describing the data
+ * 
+ * The memory of each rank (of size topo->memsize(), padding included) is stored one after the other, in the rank order,
+ * inside a 1D dataset `data`. The key is stored as a string attribute `key` of the dataset.
+ * The file can only be read back by the same decomposition, see @ref hdf5_read_cache.
+ * 
+ * @param topo topology of data being exported
+ * @param filename the filename, with its extension
+ * @param key the key identifying the data
+ * @param data the array containing the data associated to the #topo
+ */
+void hdf5_write_cache(const Topology *topo, const string filename, const string key, const double *data) {
+    BEGIN_FUNC;
+
+    MPI_Comm comm = topo->get_comm();
+
+    //-------------------------------------------------------------------------
+    /** - get the offset of this rank inside the file */
+    //-------------------------------------------------------------------------
+    unsigned long long locsize = topo->memsize();
+    unsigned long long offset  = 0;
+    unsigned long long total   = 0;
+    MPI_Exscan(&locsize, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&locsize, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0) offset = 0;
+
+    //-------------------------------------------------------------------------
+    /** - Create a new file collectively  */
+    //-------------------------------------------------------------------------
+    hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_mpio(plist_id, comm, MPI_INFO_NULL);
+    hid_t file_id = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+    if (file_id < 0) FLUPS_ERROR("Failed to open the file %s.", filename.c_str(), LOCATION);
+    H5Pclose(plist_id);
+
+    //-------------------------------------------------------------------------
+    /** - Create the dataset and its key */
+    //-------------------------------------------------------------------------
+    hsize_t field_dims[1] = {(hsize_t)total};
+    hid_t   filespace     = H5Screate_simple(1, field_dims, NULL);
+    hid_t   fileset       = H5Dcreate(file_id, "data", H5T_NATIVE_DOUBLE, filespace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+    hid_t keytype  = H5Tcopy(H5T_C_S1);
+    H5Tset_size(keytype, key.size() + 1);
+    hid_t keyspace = H5Screate(H5S_SCALAR);
+    hid_t keyattr  = H5Acreate(fileset, "key", keytype, keyspace, H5P_DEFAULT, H5P_DEFAULT);
+    herr_t status  = H5Awrite(keyattr, keytype, key.c_str());
+    if (status < 0) FLUPS_ERROR("Failed to write the key.", LOCATION);
+    H5Aclose(keyattr);
+    H5Sclose(keyspace);
+    H5Tclose(keytype);
+
+    //-------------------------------------------------------------------------
+    /** - write the local memory */
+    //-------------------------------------------------------------------------
+    hsize_t memsize[1]  = {(hsize_t)locsize};
+    hsize_t memstart[1] = {(hsize_t)offset};
+    hid_t   memspace    = H5Screate_simple(1, memsize, NULL);
+    status              = H5Sselect_hyperslab(filespace, H5S_SELECT_SET, memstart, NULL, memsize, NULL);
+    if (status < 0) FLUPS_ERROR("Failed to select hyperslab in dataset.", LOCATION);
+
+    plist_id = H5Pcreate(H5P_DATASET_XFER);
+    H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+    status = H5Dwrite(fileset, H5T_NATIVE_DOUBLE, memspace, filespace, plist_id, data);
+    if (status < 0) FLUPS_ERROR("Failed to write hyperslab to file.", LOCATION);
+
+    //-------------------------------------------------------------------------
+    /** - close everything */
+    //-------------------------------------------------------------------------
     H5Pclose(plist_id);
+    H5Sclose(memspace);
+    H5Sclose(filespace);
+    H5Dclose(fileset);
     H5Fclose(file_id);
+    END_FUNC;
+}
+
+/**
+ * @brief reads the raw local memory of data from a parallel hdf5 file written by @ref hdf5_write_cache
+ * 
+ * The data is only read if the file exists, if its key matches the given one and if its size matches the total memory size.
+ * 
+ * @param topo topology of data being imported
+ * @param filename the filename, with its extension
+ * @param key the key identifying the data
+ * @param data the array in which the data is read
+ * @return true if the data has been read
+ * @return false if the file does not exist, does not match or cannot be read (on any rank)
+ */
+bool hdf5_read_cache(const Topology *topo, const string filename, const string key, double *data) {
+    BEGIN_FUNC;
 
+    MPI_Comm comm = topo->get_comm();
+    int      rank;
+    MPI_Comm_rank(comm, &rank);
+
+    //-------------------------------------------------------------------------
+    /** - check that the file exists */
+    //-------------------------------------------------------------------------
+    int exists = 0;
+    if (rank == 0) {
+        struct stat st = {0};
+        exists         = (stat(filename.c_str(), &st) == 0);
+    }
+    MPI_Bcast(&exists, 1, MPI_INT, 0, comm);
+    if (!exists) {
+        FLUPS_INFO("no cache file %s", filename.c_str());
+        END_FUNC;
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    /** - get the offset of this rank inside the file */
+    //-------------------------------------------------------------------------
+    unsigned long long locsize = topo->memsize();
+    unsigned long long offset  = 0;
+    unsigned long long total   = 0;
+    MPI_Exscan(&locsize, &offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&locsize, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) offset = 0;
+
+    //-------------------------------------------------------------------------
+    /** - open the file and check the key and the size */
+    //-------------------------------------------------------------------------
+    hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_mpio(plist_id, comm, MPI_INFO_NULL);
+    hid_t file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, plist_id);
+    H5Pclose(plist_id);
+    if (file_id < 0) {
+        FLUPS_WARNING("unable to open the cache file %s", filename.c_str(), LOCATION);
+        END_FUNC;
+        return false;
+    }
+    hid_t fileset   = H5Dopen(file_id, "data", H5P_DEFAULT);
+    hid_t filespace = H5Dget_space(fileset);
+
+    bool isValid = (H5Aexists(fileset, "key") > 0);
+    if (isValid) {
+        hid_t  keyattr = H5Aopen(fileset, "key", H5P_DEFAULT);
+        hid_t  keytype = H5Aget_type(keyattr);
+        size_t keysize = H5Tget_size(keytype);
+        char*  filekey = (char*)flups_malloc(keysize + 1);
+        std::memset(filekey, 0, keysize + 1);
+        isValid = (H5Aread(keyattr, keytype, filekey) >= 0) && (key.compare(filekey) == 0);
+        flups_free(filekey);
+        H5Tclose(keytype);
+        H5Aclose(keyattr);
+    }
+    hsize_t field_dims[1];
+    isValid = isValid && (H5Sget_simple_extent_dims(filespace, field_dims, NULL) == 1) && (field_dims[0] == (hsize_t)total);
+    // every rank must take the same decision as the read is collective
+    int isValidLoc = isValid;
+    int isValidAll = 0;
+    MPI_Allreduce(&isValidLoc, &isValidAll, 1, MPI_INT, MPI_LAND, comm);
+    isValid = isValidAll;
+
+    if (!isValid) {
+        FLUPS_WARNING("the cache file %s does not match the current setup", filename.c_str(), LOCATION);
+        H5Sclose(filespace);
+        H5Dclose(fileset);
+        H5Fclose(file_id);
+        END_FUNC;
+        return false;
+    }
+
+    //-------------------------------------------------------------------------
+    /** - read the local memory */
+    //-------------------------------------------------------------------------
+    hsize_t memsize[1]  = {(hsize_t)locsize};
+    hsize_t memstart[1] = {(hsize_t)offset};
+    hid_t   memspace    = H5Screate_simple(1, memsize, NULL);
+    herr_t  status      = H5Sselect_hyperslab(filespace, H5S_SELECT_SET, memstart, NULL, memsize, NULL);
+    if (status < 0) FLUPS_ERROR("Failed to select hyperslab in dataset.", LOCATION);
+
+    plist_id = H5Pcreate(H5P_DATASET_XFER);
+    H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+    status = H5Dread(fileset, H5T_NATIVE_DOUBLE, memspace, filespace, plist_id, data);
+    // a failed read leaves data undefined, the Green's function is computed instead
+    int isReadLoc = (status >= 0);
+    int isReadAll = 0;
+    MPI_Allreduce(&isReadLoc, &isReadAll, 1, MPI_INT, MPI_LAND, comm);
+    if (!isReadAll) {
+        FLUPS_WARNING("Failed to read the cache file %s", filename.c_str(), LOCATION);
+    }
+
+    //-------------------------------------------------------------------------
+    /** - close everything */
+    //-------------------------------------------------------------------------
+    H5Pclose(plist_id);
+    H5Sclose(memspace);
+    H5Sclose(filespace);
+    H5Dclose(fileset);
+    H5Fclose(file_id);
     END_FUNC;
-    return;
+    return isReadAll;
 }
 
 /**
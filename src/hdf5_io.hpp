@@ -30,11 +30,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <algorithm>
+#include <vector>
 
 #include "defines.hpp"
 #include "hdf5.h"
 #include "Topology.hpp"
 
+#if defined(HAVE_HDF5_ASYNC) && !H5_VERSION_GE(1, 13, 0)
+#error "HAVE_HDF5_ASYNC requires HDF5 >= 1.13"
+#endif
+
 using namespace std;
 
 void hdf5_dumptest();
@@ -42,5 +47,11 @@ void hdf5_dump(const Topology *topo, const string filename, const double *data);
 
 void xmf_write(const Topology *topo, const string filename, const string attribute);
 void hdf5_write(const Topology *topo, const string filename, const string attribute, const double *data);
+void hdf5_set_aggregators(const int naggr);
+void hdf5_set_filter(const int filterID, const int nparam, const unsigned int *param);
+void hdf5_wait();
+
+void hdf5_write_cache(const Topology *topo, const string filename, const string key, const double *data);
+bool hdf5_read_cache(const Topology *topo, const string filename, const string key, double *data);
 
 #endif
\ No newline at end of file
@@ -30,6 +30,7 @@
 #define _JI0_H
 
 #include <cmath>
+#include <cstddef>
 
 
 #define C_GAMMA 0.5772156649015328606
@@ -65,6 +66,25 @@ static inline double Ji0c(double x){
     return (double) val;
 }
 
+/**
+ * @brief Batched version of @ref Ji0c: y[i] = Ji0c(x[i]) for i < n.
+ * 
+ * The series is evaluated using a Horner scheme instead of one call to pow per term.
+ * The computation is kept in long double to preserve the accuracy of @ref Ji0c.
+ * 
+ * @ref init_Ji0 must be called before.
+ */
+static inline void Ji0c_n(const double* x, double* y, const size_t n){
+    for (size_t i = 0; i < n; i++) {
+        const long double z   = -(.25 * x[i] * x[i]);
+        long double       val = inv_f_sqr[N_KEPT] / N_KEPT;
+        for (int k = N_KEPT - 1; k > 0; k--) {
+            val = val * z + inv_f_sqr[k] / k;
+        }
+        y[i] = (double)(-.5 * val * z);
+    }
+}
+
 /**
  * @brief Numerical approximation of the Bessel-integral function of order zero (for 0 <= x <= ~30).
  * 